@@ -0,0 +1,206 @@
+/* bench_danp_ftp_service.c - FTP service throughput benchmark over the loopback transport */
+
+/* All Rights Reserved */
+
+/* Includes */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "danp/services/danp_ftp_service.h"
+#include "danp/services/danp_ftp_service_client.h"
+#include "danp_loopback.h"
+#include "danp_port.h"
+#include "danp_ram_fs.h"
+
+/* Imports */
+
+
+/* Definitions */
+
+#define BENCH_LOCAL_NODE                      (1)
+#define BENCH_TIMEOUT_MS                      (1000)
+#define BENCH_DEFAULT_SIZE                    (64 * 1024)
+#define BENCH_DEFAULT_ITERATIONS              (20)
+#define BENCH_FILE_NAME                       "bench.bin"
+
+/* Types */
+
+typedef struct bench_buffer_s
+{
+    uint8_t *data;
+    size_t size;
+} bench_buffer_t;
+
+/* Forward Declarations */
+
+
+/* Variables */
+
+
+/* Functions */
+
+static danp_ftp_status_t bench_source_cb(size_t offset, uint8_t *buffer, uint16_t length, void *user_data)
+{
+    bench_buffer_t *source = (bench_buffer_t *)user_data;
+    size_t available = (offset < source->size) ? source->size - offset : 0;
+    size_t copy = (available < length) ? available : length;
+
+    memcpy(buffer, &source->data[offset], copy);
+
+    return (danp_ftp_status_t)copy;
+}
+
+static danp_ftp_status_t bench_sink_cb(size_t offset, const uint8_t *data, uint16_t length, void *user_data)
+{
+    bench_buffer_t *sink = (bench_buffer_t *)user_data;
+
+    if (offset + length > sink->size)
+    {
+        return DANP_FTP_STATUS_ERROR;
+    }
+
+    memcpy(&sink->data[offset], data, length);
+
+    return (danp_ftp_status_t)length;
+}
+
+static void bench_report(const char *name, uint32_t transfers, size_t size, uint32_t elapsed_ms)
+{
+    double seconds = (elapsed_ms > 0) ? (double)elapsed_ms / 1000.0 : 0.001;
+
+    printf(
+        "%-6s %6u transfers %10zu bytes %8u ms %10.1f transfers/s %8.2f MB/s\n",
+        name,
+        transfers,
+        size,
+        elapsed_ms,
+        (double)transfers / seconds,
+        ((double)transfers * (double)size) / (seconds * 1024.0 * 1024.0));
+}
+
+#if defined(CONFIG_DANP_FTP_SERVICE_PROFILER)
+static void bench_report_profile(void)
+{
+    static const char *const stage_names[DANP_FTP_SERVICE_PROF_STAGE_COUNT] = {
+        "fs_read", "fs_write", "crc", "send", "recv", "ack_wait",
+    };
+    danp_ftp_service_profile_t total;
+    const danp_ftp_service_prof_stat_t *stat;
+
+    if (danp_ftp_service_get_profile(&total, NULL) != 0)
+    {
+        return;
+    }
+
+    printf("\n%-8s %10s %10s %10s %10s %12s\n", "stage", "count", "min us", "avg us", "max us", "total ms");
+    for (uint32_t stage = 0; stage < DANP_FTP_SERVICE_PROF_STAGE_COUNT; stage++)
+    {
+        stat = &total.stages[stage];
+        if (stat->count == 0)
+        {
+            continue;
+        }
+
+        printf(
+            "%-8s %10u %10.3f %10.3f %10.3f %12.1f\n",
+            stage_names[stage],
+            stat->count,
+            stat->min_ns / 1000.0,
+            ((double)stat->total_ns / stat->count) / 1000.0,
+            stat->max_ns / 1000.0,
+            stat->total_ns / 1000000.0);
+    }
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    danp_ftp_service_config_t config;
+    bench_buffer_t source;
+    bench_buffer_t sink;
+    size_t size = (argc > 1) ? (size_t)strtoul(argv[1], NULL, 0) : BENCH_DEFAULT_SIZE;
+    uint32_t iterations = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : BENCH_DEFAULT_ITERATIONS;
+    uint32_t start_ms;
+    danp_ftp_status_t status;
+    int ret = 0;
+
+    source.size = size;
+    source.data = malloc(size ? size : 1);
+    sink.size = size;
+    sink.data = malloc(size ? size : 1);
+
+    if (!source.data || !sink.data)
+    {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    for (size_t i = 0; i < size; i++)
+    {
+        source.data[i] = (uint8_t)((i * 31U + (i >> 8)) & 0xFFU);
+    }
+
+    danp_loopback_init(BENCH_LOCAL_NODE);
+
+    memset(&config, 0, sizeof(config));
+    danp_ram_fs_get_api(&config.fs);
+
+    if (danp_ftp_service_init(&config) != 0)
+    {
+        fprintf(stderr, "service init failed\n");
+        return 1;
+    }
+
+    danp_ram_fs_put(BENCH_FILE_NAME, source.data, size);
+
+    start_ms = danp_port_uptime_ms();
+    for (uint32_t i = 0; i < iterations && ret == 0; i++)
+    {
+        status = danp_ftp_service_client_read(
+            BENCH_LOCAL_NODE,
+            (const uint8_t *)BENCH_FILE_NAME,
+            strlen(BENCH_FILE_NAME),
+            bench_sink_cb,
+            &sink,
+            BENCH_TIMEOUT_MS);
+
+        if (status != (danp_ftp_status_t)size || memcmp(source.data, sink.data, size) != 0)
+        {
+            fprintf(stderr, "read %u failed: %d\n", i, status);
+            ret = 1;
+        }
+    }
+    bench_report("read", iterations, size, danp_port_uptime_ms() - start_ms);
+
+    start_ms = danp_port_uptime_ms();
+    for (uint32_t i = 0; i < iterations && ret == 0; i++)
+    {
+        status = danp_ftp_service_client_write(
+            BENCH_LOCAL_NODE,
+            (const uint8_t *)BENCH_FILE_NAME,
+            strlen(BENCH_FILE_NAME),
+            size,
+            bench_source_cb,
+            &source,
+            BENCH_TIMEOUT_MS);
+
+        if (status != (danp_ftp_status_t)size)
+        {
+            fprintf(stderr, "write %u failed: %d\n", i, status);
+            ret = 1;
+        }
+    }
+    bench_report("write", iterations, size, danp_port_uptime_ms() - start_ms);
+
+#if defined(CONFIG_DANP_FTP_SERVICE_PROFILER)
+    /* The last handler folds its profile in when it exits */
+    danp_port_sleep_ms(50);
+    bench_report_profile();
+#endif
+
+    free(source.data);
+    free(sink.data);
+
+    return ret;
+}
@@ -0,0 +1,919 @@
+/* danp_loopback.c - In-process DANP transport for host builds */
+
+/* All Rights Reserved */
+
+/* Includes */
+
+#include "danp_loopback.h"
+#include "danp/danp_log.h"
+#include "danp_port.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+/* Imports */
+
+
+/* Definitions */
+
+#define DANP_LOOPBACK_EPHEMERAL_PORT_BASE     (0x8000)
+#define DANP_LOOPBACK_NODE_LINKS              (8)
+
+/* Types */
+
+typedef struct danp_loopback_packet_s
+{
+    struct danp_loopback_packet_s *next;
+    uint64_t ready_us;                           /* Earliest time the packet may be received */
+    uint16_t length;
+    uint8_t data[DANP_MAX_PACKET_SIZE];
+} danp_loopback_packet_t;
+
+typedef struct danp_loopback_socket_s
+{
+    danp_socket_t base;                          /* Must stay first, handed out to callers */
+    danp_socket_type_t type;
+    uint16_t node;                               /* Node the socket lives on */
+    uint16_t local_port;
+    uint16_t dst_port;
+    bool bound;
+    bool listening;
+    bool peer_closed;
+    struct danp_loopback_socket_s *peer;         /* Other end of a stream connection */
+    struct danp_loopback_socket_s *accept_head;  /* Connections waiting for accept */
+    struct danp_loopback_socket_s *accept_tail;
+    struct danp_loopback_socket_s *accept_next;
+    danp_loopback_packet_t *rx_head;
+    danp_loopback_packet_t *rx_tail;
+    uint64_t link_free_us;                       /* End of the last serialization on this link */
+    uint64_t in_order_us;                        /* Ready time of the last in-order packet */
+    pthread_cond_t cond;
+    struct danp_loopback_socket_s *next;         /* All open sockets */
+} danp_loopback_socket_t;
+
+typedef struct danp_loopback_link_s
+{
+    uint16_t node;                               /* Receiving node, 0 = unused */
+    danp_loopback_impairment_t impairment;
+    uint32_t random_state;
+} danp_loopback_link_t;
+
+typedef struct danp_loopback_context_s
+{
+    pthread_mutex_t lock;
+    uint16_t local_node;
+    uint16_t next_port;
+    danp_log_level_t log_level;
+    danp_loopback_socket_t *sockets;
+    danp_loopback_impairment_t impairment;
+    uint32_t random_state;
+    danp_loopback_link_t node_links[DANP_LOOPBACK_NODE_LINKS]; /* Per receiving node impairment */
+    uint16_t group_node;                         /* DGRAM to this node reaches every bound socket */
+    danp_loopback_stats_t stats;
+    danp_loopback_stats_printer_t stats_printer;
+} danp_loopback_context_t;
+
+/* Forward Declarations */
+
+
+/* Variables */
+
+static danp_loopback_context_t loopback_ctx = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .local_node = 1,
+    .log_level = DANP_LOG_LEVEL_WRN,
+    .next_port = DANP_LOOPBACK_EPHEMERAL_PORT_BASE,
+    .random_state = 0x2545F491U,
+};
+
+/* Node of the sockets the calling thread creates, 0 = the local node */
+static _Thread_local uint16_t loopback_thread_node;
+
+/* Functions */
+
+/**
+ * @brief Get the monotonic time.
+ * @return Time in microseconds.
+ */
+static uint64_t danp_loopback_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000U + (uint64_t)ts.tv_nsec / 1000U;
+}
+
+/**
+ * @brief Wait on a socket condition until an absolute time. Caller holds the lock.
+ * @param sock Socket to wait on.
+ * @param until_us Absolute monotonic time in microseconds.
+ * @return true if the wait timed out.
+ */
+static bool danp_loopback_wait_until(danp_loopback_socket_t *sock, uint64_t until_us)
+{
+    struct timespec deadline;
+
+    deadline.tv_sec = (time_t)(until_us / 1000000U);
+    deadline.tv_nsec = (long)(until_us % 1000000U) * 1000L;
+
+    return pthread_cond_timedwait(&sock->cond, &loopback_ctx.lock, &deadline) == ETIMEDOUT;
+}
+
+/**
+ * @brief Draw a random event with the given probability. Caller holds the lock.
+ * @param state Random state to advance.
+ * @param ppm Probability in parts per million.
+ * @return true if the event happens.
+ */
+static bool danp_loopback_chance(uint32_t *state, uint32_t ppm)
+{
+    uint32_t x = *state;
+
+    if (ppm == 0)
+    {
+        return false;
+    }
+
+    /* xorshift32 */
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+
+    return (x % 1000000U) < ppm;
+}
+
+/**
+ * @brief Draw a uniform random number. Caller holds the lock.
+ * @param state Random state to advance.
+ * @param max Inclusive upper bound.
+ * @return Number in [0, max].
+ */
+static uint32_t danp_loopback_uniform(uint32_t *state, uint32_t max)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+
+    return (max == 0) ? 0 : x % (max + 1U);
+}
+
+/**
+ * @brief Find the impairment slot of a receiving node. Caller holds the lock.
+ * @param node Receiving node.
+ * @return Slot or NULL.
+ */
+static danp_loopback_link_t *danp_loopback_find_link(uint16_t node)
+{
+    danp_loopback_link_t *link = NULL;
+
+    for (size_t i = 0; i < DANP_LOOPBACK_NODE_LINKS; i++)
+    {
+        if (node != 0 && loopback_ctx.node_links[i].node == node)
+        {
+            link = &loopback_ctx.node_links[i];
+            break;
+        }
+    }
+
+    return link;
+}
+
+/**
+ * @brief Find the socket bound to a port. Caller holds the lock.
+ *
+ * A socket on node is preferred, any other bound socket is the fallback
+ * so connections to any node still reach the local listener.
+ *
+ * @param type Socket type.
+ * @param port Local port.
+ * @param node Destination node.
+ * @return Socket or NULL.
+ */
+static danp_loopback_socket_t *danp_loopback_find_bound(danp_socket_type_t type, uint16_t port, uint16_t node)
+{
+    danp_loopback_socket_t *sock = loopback_ctx.sockets;
+    danp_loopback_socket_t *found = NULL;
+
+    while (sock)
+    {
+        if (sock->bound && sock->type == type && sock->local_port == port)
+        {
+            if (sock->node == node)
+            {
+                found = sock;
+                break;
+            }
+            if (!found)
+            {
+                found = sock;
+            }
+        }
+        sock = sock->next;
+    }
+
+    return found;
+}
+
+/**
+ * @brief Allocate a socket and link it into the socket list. Caller holds the lock.
+ * @param type Socket type.
+ * @return Socket or NULL.
+ */
+static danp_loopback_socket_t *danp_loopback_alloc(danp_socket_type_t type)
+{
+    danp_loopback_socket_t *sock = calloc(1, sizeof(danp_loopback_socket_t));
+    pthread_condattr_t attr;
+
+    if (sock)
+    {
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&sock->cond, &attr);
+        pthread_condattr_destroy(&attr);
+
+        sock->type = type;
+        sock->node = loopback_thread_node ? loopback_thread_node : loopback_ctx.local_node;
+        sock->local_port = loopback_ctx.next_port++;
+        if (loopback_ctx.next_port == 0)
+        {
+            loopback_ctx.next_port = DANP_LOOPBACK_EPHEMERAL_PORT_BASE;
+        }
+        sock->next = loopback_ctx.sockets;
+        loopback_ctx.sockets = sock;
+    }
+
+    return sock;
+}
+
+/**
+ * @brief Unlink and free a socket, waking its peer. Caller holds the lock.
+ * @param sock Socket to free.
+ */
+static void danp_loopback_free(danp_loopback_socket_t *sock)
+{
+    danp_loopback_socket_t **link = &loopback_ctx.sockets;
+    danp_loopback_socket_t *pending;
+    danp_loopback_packet_t *packet;
+
+    while (*link && *link != sock)
+    {
+        link = &(*link)->next;
+    }
+    if (*link)
+    {
+        *link = sock->next;
+    }
+
+    if (sock->peer)
+    {
+        sock->peer->peer = NULL;
+        sock->peer->peer_closed = true;
+        pthread_cond_broadcast(&sock->peer->cond);
+    }
+
+    while (sock->accept_head)
+    {
+        pending = sock->accept_head;
+        sock->accept_head = pending->accept_next;
+        danp_loopback_free(pending);
+    }
+
+    while (sock->rx_head)
+    {
+        packet = sock->rx_head;
+        sock->rx_head = packet->next;
+        free(packet);
+    }
+
+    pthread_cond_destroy(&sock->cond);
+    free(sock);
+}
+
+/**
+ * @brief Queue one packet copy, ordered by ready time. Caller holds the lock.
+ * @param dst Destination socket.
+ * @param data Packet data.
+ * @param length Packet length.
+ * @param ready_us Earliest receive time.
+ * @param keep_order Never let this packet overtake queued ones.
+ * @return 0 on success, negative on error.
+ */
+static int32_t danp_loopback_enqueue(
+    danp_loopback_socket_t *dst,
+    const void *data,
+    uint16_t length,
+    uint64_t ready_us,
+    bool keep_order)
+{
+    int32_t ret = 0;
+    danp_loopback_packet_t *packet;
+    danp_loopback_packet_t **link = &dst->rx_head;
+
+    for (;;)
+    {
+        packet = malloc(sizeof(danp_loopback_packet_t));
+        if (!packet)
+        {
+            ret = -1;
+            break;
+        }
+
+        if (keep_order)
+        {
+            if (dst->in_order_us > ready_us)
+            {
+                ready_us = dst->in_order_us;
+            }
+            dst->in_order_us = ready_us;
+        }
+
+        packet->ready_us = ready_us;
+        packet->length = length;
+        memcpy(packet->data, data, length);
+
+        while (*link && (*link)->ready_us <= ready_us)
+        {
+            link = &(*link)->next;
+        }
+        packet->next = *link;
+        *link = packet;
+        if (!packet->next)
+        {
+            dst->rx_tail = packet;
+        }
+
+        loopback_ctx.stats.packets_delivered++;
+        loopback_ctx.stats.bytes_delivered += length;
+        pthread_cond_broadcast(&dst->cond);
+
+        break;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Pass a packet through the impairment layer to its destination. Caller holds the lock.
+ * @param dst Destination socket.
+ * @param data Packet data.
+ * @param length Packet length.
+ * @return 0 on success (including impairment drops), negative on error.
+ */
+static int32_t danp_loopback_deliver(danp_loopback_socket_t *dst, const void *data, uint16_t length)
+{
+    danp_loopback_link_t *link = danp_loopback_find_link(dst->node);
+    const danp_loopback_impairment_t *imp = link ? &link->impairment : &loopback_ctx.impairment;
+    uint32_t *state = link ? &link->random_state : &loopback_ctx.random_state;
+    int32_t ret = 0;
+    uint64_t now_us = danp_loopback_now_us();
+    uint64_t ready_us;
+    uint32_t copies = 1;
+    bool reorder;
+
+    for (;;)
+    {
+        if (danp_loopback_chance(state, imp->loss_ppm))
+        {
+            loopback_ctx.stats.packets_dropped++;
+            break;
+        }
+
+        /* Serialization on the link, queueing behind earlier packets */
+        ready_us = now_us;
+        if (imp->bandwidth_bps > 0)
+        {
+            if (dst->link_free_us > ready_us)
+            {
+                ready_us = dst->link_free_us;
+            }
+            ready_us += ((uint64_t)length * 1000000U) / imp->bandwidth_bps;
+            dst->link_free_us = ready_us;
+        }
+
+        ready_us += (uint64_t)imp->latency_ms * 1000U;
+        ready_us += (uint64_t)danp_loopback_uniform(state, imp->jitter_ms) * 1000U;
+
+        reorder = danp_loopback_chance(state, imp->reorder_ppm);
+        if (reorder)
+        {
+            ready_us += (uint64_t)imp->reorder_delay_ms * 1000U;
+            loopback_ctx.stats.packets_reordered++;
+        }
+
+        if (danp_loopback_chance(state, imp->duplicate_ppm))
+        {
+            copies++;
+            loopback_ctx.stats.packets_duplicated++;
+        }
+
+        while (copies-- > 0 && ret == 0)
+        {
+            ret = danp_loopback_enqueue(dst, data, length, ready_us, !reorder);
+        }
+
+        break;
+    }
+
+    return ret;
+}
+
+int32_t danp_loopback_init(uint16_t local_node)
+{
+    pthread_mutex_lock(&loopback_ctx.lock);
+    loopback_ctx.local_node = local_node;
+    memset(&loopback_ctx.stats, 0, sizeof(loopback_ctx.stats));
+    pthread_mutex_unlock(&loopback_ctx.lock);
+
+    return 0;
+}
+
+void danp_loopback_set_local_node(uint16_t local_node)
+{
+    pthread_mutex_lock(&loopback_ctx.lock);
+    loopback_ctx.local_node = local_node;
+    pthread_mutex_unlock(&loopback_ctx.lock);
+}
+
+void danp_loopback_set_impairment(const danp_loopback_impairment_t *impairment)
+{
+    pthread_mutex_lock(&loopback_ctx.lock);
+
+    if (impairment)
+    {
+        loopback_ctx.impairment = *impairment;
+        if (impairment->seed != 0)
+        {
+            loopback_ctx.random_state = impairment->seed;
+        }
+    }
+    else
+    {
+        memset(&loopback_ctx.impairment, 0, sizeof(loopback_ctx.impairment));
+    }
+
+    pthread_mutex_unlock(&loopback_ctx.lock);
+}
+
+void danp_loopback_set_node_impairment(uint16_t node, const danp_loopback_impairment_t *impairment)
+{
+    danp_loopback_link_t *link;
+
+    pthread_mutex_lock(&loopback_ctx.lock);
+
+    link = danp_loopback_find_link(node);
+    if (!link && impairment)
+    {
+        /* Claim a free slot */
+        for (size_t i = 0; i < DANP_LOOPBACK_NODE_LINKS && !link; i++)
+        {
+            if (loopback_ctx.node_links[i].node == 0)
+            {
+                link = &loopback_ctx.node_links[i];
+            }
+        }
+    }
+
+    if (link && impairment)
+    {
+        link->node = node;
+        link->impairment = *impairment;
+        link->random_state = (impairment->seed != 0) ? impairment->seed : loopback_ctx.random_state;
+    }
+    else if (link)
+    {
+        memset(link, 0, sizeof(danp_loopback_link_t));
+    }
+
+    pthread_mutex_unlock(&loopback_ctx.lock);
+}
+
+void danp_loopback_set_thread_node(uint16_t node)
+{
+    loopback_thread_node = node;
+}
+
+void danp_loopback_set_group_node(uint16_t node)
+{
+    pthread_mutex_lock(&loopback_ctx.lock);
+    loopback_ctx.group_node = node;
+    pthread_mutex_unlock(&loopback_ctx.lock);
+}
+
+void danp_loopback_set_log_level(danp_log_level_t level)
+{
+    loopback_ctx.log_level = level;
+}
+
+void danp_loopback_get_stats(danp_loopback_stats_t *stats)
+{
+    pthread_mutex_lock(&loopback_ctx.lock);
+    *stats = loopback_ctx.stats;
+    pthread_mutex_unlock(&loopback_ctx.lock);
+}
+
+void danp_loopback_reset_stats(void)
+{
+    pthread_mutex_lock(&loopback_ctx.lock);
+    memset(&loopback_ctx.stats, 0, sizeof(loopback_ctx.stats));
+    pthread_mutex_unlock(&loopback_ctx.lock);
+}
+
+danp_socket_t *danp_socket(danp_socket_type_t type)
+{
+    danp_loopback_socket_t *sock;
+
+    pthread_mutex_lock(&loopback_ctx.lock);
+    sock = danp_loopback_alloc(type);
+    pthread_mutex_unlock(&loopback_ctx.lock);
+
+    return sock ? &sock->base : NULL;
+}
+
+int32_t danp_bind(danp_socket_t *socket, uint16_t port)
+{
+    danp_loopback_socket_t *sock = (danp_loopback_socket_t *)socket;
+    danp_loopback_socket_t *existing;
+    int32_t ret = 0;
+
+    pthread_mutex_lock(&loopback_ctx.lock);
+
+    existing = sock ? danp_loopback_find_bound(sock->type, port, sock->node) : NULL;
+
+    /* Datagram sockets on different nodes may share a port, as group members do */
+    if (!sock || (existing && (sock->type == DANP_TYPE_STREAM || existing->node == sock->node)))
+    {
+        ret = -1;
+    }
+    else
+    {
+        sock->local_port = port;
+        sock->bound = true;
+    }
+
+    pthread_mutex_unlock(&loopback_ctx.lock);
+
+    return ret;
+}
+
+int32_t danp_listen(danp_socket_t *socket, int32_t backlog)
+{
+    danp_loopback_socket_t *sock = (danp_loopback_socket_t *)socket;
+    int32_t ret = 0;
+
+    (void)backlog;
+
+    pthread_mutex_lock(&loopback_ctx.lock);
+
+    if (!sock || !sock->bound || sock->type != DANP_TYPE_STREAM)
+    {
+        ret = -1;
+    }
+    else
+    {
+        sock->listening = true;
+    }
+
+    pthread_mutex_unlock(&loopback_ctx.lock);
+
+    return ret;
+}
+
+danp_socket_t *danp_accept(danp_socket_t *socket, uint32_t timeout)
+{
+    danp_loopback_socket_t *sock = (danp_loopback_socket_t *)socket;
+    danp_loopback_socket_t *accepted = NULL;
+    uint64_t deadline_us = danp_loopback_now_us() + (uint64_t)timeout * 1000U;
+
+    pthread_mutex_lock(&loopback_ctx.lock);
+
+    while (sock && sock->listening && !sock->accept_head)
+    {
+        if (danp_loopback_wait_until(sock, deadline_us))
+        {
+            break;
+        }
+    }
+
+    if (sock && sock->accept_head)
+    {
+        accepted = sock->accept_head;
+        sock->accept_head = accepted->accept_next;
+        if (!sock->accept_head)
+        {
+            sock->accept_tail = NULL;
+        }
+        accepted->accept_next = NULL;
+    }
+
+    pthread_mutex_unlock(&loopback_ctx.lock);
+
+    return accepted ? &accepted->base : NULL;
+}
+
+int32_t danp_connect(danp_socket_t *socket, uint16_t node, uint16_t port)
+{
+    danp_loopback_socket_t *sock = (danp_loopback_socket_t *)socket;
+    danp_loopback_socket_t *listener;
+    danp_loopback_socket_t *server;
+    int32_t ret = 0;
+
+    pthread_mutex_lock(&loopback_ctx.lock);
+
+    for (;;)
+    {
+        if (!sock)
+        {
+            ret = -1;
+            break;
+        }
+
+        sock->base.remote_node = node;
+        sock->dst_port = port;
+
+        if (sock->type == DANP_TYPE_DGRAM)
+        {
+            break;
+        }
+
+        listener = danp_loopback_find_bound(DANP_TYPE_STREAM, port, node);
+        if (!listener || !listener->listening)
+        {
+            ret = -1;
+            break;
+        }
+
+        server = danp_loopback_alloc(DANP_TYPE_STREAM);
+        if (!server)
+        {
+            ret = -1;
+            break;
+        }
+
+        server->base.remote_node = sock->node;
+        server->dst_port = sock->local_port;
+        server->peer = sock;
+        sock->peer = server;
+        sock->peer_closed = false;
+
+        if (listener->accept_tail)
+        {
+            listener->accept_tail->accept_next = server;
+        }
+        else
+        {
+            listener->accept_head = server;
+        }
+        listener->accept_tail = server;
+        pthread_cond_broadcast(&listener->cond);
+
+        break;
+    }
+
+    pthread_mutex_unlock(&loopback_ctx.lock);
+
+    return ret;
+}
+
+/**
+ * @brief Deliver a datagram to every socket bound to its port. Caller holds the lock.
+ *
+ * Each member draws its own impairment, so group receivers lose
+ * different packets of the same transmission.
+ *
+ * @param port Destination port.
+ * @param data Packet data.
+ * @param length Packet length.
+ * @return 0 on success, negative on error.
+ */
+static int32_t danp_loopback_deliver_group(uint16_t port, const void *data, uint16_t length)
+{
+    danp_loopback_socket_t *member = loopback_ctx.sockets;
+    int32_t ret = 0;
+
+    while (member && ret == 0)
+    {
+        if (member->bound && member->type == DANP_TYPE_DGRAM && member->local_port == port)
+        {
+            ret = danp_loopback_deliver(member, data, length);
+        }
+        member = member->next;
+    }
+
+    return ret;
+}
+
+int32_t danp_send(danp_socket_t *socket, void *data, uint16_t length)
+{
+    danp_loopback_socket_t *sock = (danp_loopback_socket_t *)socket;
+    danp_loopback_socket_t *dst = NULL;
+    int32_t ret = -1;
+
+    pthread_mutex_lock(&loopback_ctx.lock);
+
+    for (;;)
+    {
+        if (!sock || !data || length > DANP_MAX_PACKET_SIZE)
+        {
+            break;
+        }
+
+        loopback_ctx.stats.packets_sent++;
+
+        if (sock->type == DANP_TYPE_DGRAM &&
+            loopback_ctx.group_node != 0 &&
+            sock->base.remote_node == loopback_ctx.group_node)
+        {
+            if (danp_loopback_deliver_group(sock->dst_port, data, length) == 0)
+            {
+                ret = (int32_t)length;
+            }
+            break;
+        }
+
+        if (sock->type == DANP_TYPE_STREAM)
+        {
+            dst = sock->peer;
+        }
+        else
+        {
+            dst = danp_loopback_find_bound(DANP_TYPE_DGRAM, sock->dst_port, sock->base.remote_node);
+        }
+
+        if (!dst)
+        {
+            /* Datagrams to nobody are dropped silently, streams report the broken link */
+            ret = (sock->type == DANP_TYPE_DGRAM) ? (int32_t)length : -1;
+            break;
+        }
+
+        if (danp_loopback_deliver(dst, data, length) == 0)
+        {
+            ret = (int32_t)length;
+        }
+
+        break;
+    }
+
+    pthread_mutex_unlock(&loopback_ctx.lock);
+
+    return ret;
+}
+
+int32_t danp_recv(danp_socket_t *socket, void *data, uint16_t length, uint32_t timeout)
+{
+    danp_loopback_socket_t *sock = (danp_loopback_socket_t *)socket;
+    danp_loopback_packet_t *packet = NULL;
+    uint64_t deadline_us = danp_loopback_now_us() + (uint64_t)timeout * 1000U;
+    uint64_t now_us;
+    uint64_t wake_us;
+    int32_t ret = 0;
+
+    pthread_mutex_lock(&loopback_ctx.lock);
+
+    for (;;)
+    {
+        if (!sock || !data)
+        {
+            ret = -1;
+            break;
+        }
+
+        for (;;)
+        {
+            now_us = danp_loopback_now_us();
+            if (sock->rx_head && sock->rx_head->ready_us <= now_us)
+            {
+                packet = sock->rx_head;
+                break;
+            }
+
+            if ((!sock->rx_head && sock->peer_closed) || now_us >= deadline_us)
+            {
+                break;
+            }
+
+            /* Sleep until the head packet lands or the caller gives up */
+            wake_us = deadline_us;
+            if (sock->rx_head && sock->rx_head->ready_us < wake_us)
+            {
+                wake_us = sock->rx_head->ready_us;
+            }
+            danp_loopback_wait_until(sock, wake_us);
+        }
+
+        if (!packet)
+        {
+            /* Timeout code as DANP returns it, -1 once the peer has gone away */
+            ret = (!sock->rx_head && sock->peer_closed) ? -1 : DANP_PORT_RECV_TIMEOUT;
+            break;
+        }
+
+        sock->rx_head = packet->next;
+        if (!sock->rx_head)
+        {
+            sock->rx_tail = NULL;
+        }
+
+        ret = (packet->length < length) ? packet->length : length;
+        memcpy(data, packet->data, (size_t)ret);
+        free(packet);
+
+        break;
+    }
+
+    pthread_mutex_unlock(&loopback_ctx.lock);
+
+    return ret;
+}
+
+int32_t danp_close(danp_socket_t *socket)
+{
+    danp_loopback_socket_t *sock = (danp_loopback_socket_t *)socket;
+
+    if (sock)
+    {
+        pthread_mutex_lock(&loopback_ctx.lock);
+        danp_loopback_free(sock);
+        pthread_mutex_unlock(&loopback_ctx.lock);
+    }
+
+    return 0;
+}
+
+void danp_loopback_set_stats_printer(danp_loopback_stats_printer_t printer)
+{
+    pthread_mutex_lock(&loopback_ctx.lock);
+    loopback_ctx.stats_printer = printer;
+    pthread_mutex_unlock(&loopback_ctx.lock);
+}
+
+void danp_print_stats(void (*print_func)(const char *, ...))
+{
+    danp_loopback_stats_printer_t printer;
+    danp_loopback_stats_t stats;
+
+    pthread_mutex_lock(&loopback_ctx.lock);
+    printer = loopback_ctx.stats_printer;
+    pthread_mutex_unlock(&loopback_ctx.lock);
+
+    if (printer)
+    {
+        printer(print_func);
+        return;
+    }
+
+    danp_loopback_get_stats(&stats);
+
+    print_func("DANP loopback statistics:\n");
+    print_func("  TX:\n");
+    print_func("    Packets: %llu\n", (unsigned long long)stats.packets_sent);
+    print_func("  RX:\n");
+    print_func("    Packets: %llu\n", (unsigned long long)stats.packets_delivered);
+    print_func("    Bytes: %llu\n", (unsigned long long)stats.bytes_delivered);
+    print_func("  Impairment:\n");
+    print_func("    Dropped: %llu, Duplicated: %llu, Reordered: %llu\n",
+        (unsigned long long)stats.packets_dropped,
+        (unsigned long long)stats.packets_duplicated,
+        (unsigned long long)stats.packets_reordered);
+}
+
+void danp_log_message_impl(
+    danp_log_level_t level,
+    const char *funcName,
+    const char *message,
+    va_list args)
+{
+    static const char *const level_names[] = {"ERR", "WRN", "INF", "DBG", "VER"};
+    char log_buf[256];
+
+    (void)funcName;
+
+    if (level <= loopback_ctx.log_level)
+    {
+        vsnprintf(log_buf, sizeof(log_buf), message, args);
+        fprintf(
+            stderr,
+            "[%s] %s\n",
+            ((size_t)level < sizeof(level_names) / sizeof(level_names[0])) ? level_names[level] : "???",
+            log_buf);
+    }
+}
+
+void danp_log_message_io_impl(
+    danp_log_level_t level,
+    const char *funcName,
+    const char *message,
+    va_list args)
+{
+    danp_log_message_impl(level, funcName, message, args);
+}
@@ -0,0 +1,132 @@
+/* danp_loopback.h - In-process DANP transport for host builds */
+
+/* All Rights Reserved */
+
+#ifndef INC_DANP_LOOPBACK_H
+#define INC_DANP_LOOPBACK_H
+
+/* Includes */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "danp/danp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Configurations */
+
+
+/* Definitions */
+
+
+/* Types */
+
+typedef struct danp_loopback_impairment_s
+{
+    uint32_t loss_ppm;                           /* Drop probability, parts per million */
+    uint32_t duplicate_ppm;                      /* Duplication probability, parts per million */
+    uint32_t reorder_ppm;                        /* Probability a packet is held back, parts per million */
+    uint32_t reorder_delay_ms;                   /* Extra delay of a held back packet */
+    uint32_t latency_ms;                         /* One way base latency */
+    uint32_t jitter_ms;                          /* Uniform extra latency in [0, jitter_ms] */
+    uint32_t bandwidth_bps;                      /* Link rate in bytes per second, 0 = unlimited */
+    uint32_t seed;                               /* Random seed, 0 keeps the current sequence */
+} danp_loopback_impairment_t;
+
+typedef struct danp_loopback_stats_s
+{
+    uint64_t packets_sent;                       /* Packets handed to the loopback */
+    uint64_t packets_delivered;                  /* Packets queued at the destination */
+    uint64_t bytes_delivered;                    /* Payload bytes queued at the destination */
+    uint64_t packets_dropped;                    /* Packets lost by the impairment layer */
+    uint64_t packets_duplicated;                 /* Extra copies queued by the impairment layer */
+    uint64_t packets_reordered;                  /* Packets held back behind later ones */
+} danp_loopback_stats_t;
+
+/* Prints counters the way danp_print_stats does */
+typedef void (*danp_loopback_stats_printer_t)(void (*print_func)(const char *, ...));
+
+/* External Declarations */
+
+/**
+ * @brief Initialize the loopback transport.
+ *
+ * Every socket created afterwards lives on local_node, connections to any node
+ * are routed to the local listener bound to the destination port.
+ *
+ * @param local_node Node id reported as remote_node on accepted sockets.
+ * @return 0 on success, negative on error.
+ */
+extern int32_t danp_loopback_init(uint16_t local_node);
+
+/**
+ * @brief Set the node id used by sockets connected from now on.
+ * @param local_node Node id reported as remote_node on accepted sockets.
+ */
+extern void danp_loopback_set_local_node(uint16_t local_node);
+
+/**
+ * @brief Set the link impairment applied to every packet from now on.
+ * @param impairment Impairment settings, NULL for a perfect link.
+ */
+extern void danp_loopback_set_impairment(const danp_loopback_impairment_t *impairment);
+
+/**
+ * @brief Set the impairment of packets received by one node, e.g. one group member.
+ *
+ * The node gets its own random sequence, seeded from impairment->seed.
+ * Nodes without one use the danp_loopback_set_impairment() settings.
+ *
+ * @param node Receiving node.
+ * @param impairment Impairment settings, NULL to fall back to the shared ones.
+ */
+extern void danp_loopback_set_node_impairment(uint16_t node, const danp_loopback_impairment_t *impairment);
+
+/**
+ * @brief Set the node sockets created by the calling thread live on.
+ *
+ * Lets one process host several nodes, e.g. group receivers on their own
+ * threads. DGRAM sockets on different nodes may bind the same port, and
+ * listeners see the node as remote_node of the connections it makes.
+ *
+ * @param node Node id, 0 for the local node.
+ */
+extern void danp_loopback_set_thread_node(uint16_t node);
+
+/**
+ * @brief Set the group node whose DGRAM traffic fans out to every bound socket.
+ * @param node Group node id, 0 to disable fan-out.
+ */
+extern void danp_loopback_set_group_node(uint16_t node);
+
+/**
+ * @brief Set the most verbose DANP log level printed to stderr.
+ * @param level Log level, DANP_LOG_LEVEL_WRN by default.
+ */
+extern void danp_loopback_set_log_level(danp_log_level_t level);
+
+/**
+ * @brief Get the loopback traffic counters.
+ * @param stats Pointer to store the counters.
+ */
+extern void danp_loopback_get_stats(danp_loopback_stats_t *stats);
+
+/**
+ * @brief Reset the loopback traffic counters.
+ */
+extern void danp_loopback_reset_stats(void);
+
+/**
+ * @brief Replace the output of danp_print_stats, e.g. with a recorded stack dump.
+ * @param printer Printer to call, NULL for the loopback counters.
+ */
+extern void danp_loopback_set_stats_printer(danp_loopback_stats_printer_t printer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_DANP_LOOPBACK_H */
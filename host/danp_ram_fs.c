@@ -0,0 +1,450 @@
+/* danp_ram_fs.c - RAM backed filesystem callbacks for host builds */
+
+/* All Rights Reserved */
+
+/* Includes */
+
+#include "danp_ram_fs.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Imports */
+
+
+/* Definitions */
+
+
+/* Types */
+
+typedef struct danp_ram_fs_file_s
+{
+    bool used;
+    char name[DANP_RAM_FS_MAX_NAME_LEN + 1];
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+} danp_ram_fs_file_t;
+
+/* Forward Declarations */
+
+
+/* Variables */
+
+static pthread_mutex_t ram_fs_lock = PTHREAD_MUTEX_INITIALIZER;
+static danp_ram_fs_file_t ram_fs_files[DANP_RAM_FS_MAX_FILES];
+
+/* Functions */
+
+/**
+ * @brief Find a file by name. Caller holds the lock.
+ * @param name File name.
+ * @param name_len File name length.
+ * @return File or NULL.
+ */
+static danp_ram_fs_file_t *danp_ram_fs_find(const char *name, size_t name_len)
+{
+    danp_ram_fs_file_t *file = NULL;
+
+    for (size_t i = 0; i < DANP_RAM_FS_MAX_FILES; i++)
+    {
+        if (ram_fs_files[i].used &&
+            strlen(ram_fs_files[i].name) == name_len &&
+            memcmp(ram_fs_files[i].name, name, name_len) == 0)
+        {
+            file = &ram_fs_files[i];
+            break;
+        }
+    }
+
+    return file;
+}
+
+/**
+ * @brief Create an empty file. Caller holds the lock.
+ * @param name File name.
+ * @param name_len File name length.
+ * @return File or NULL when the table is full or the name too long.
+ */
+static danp_ram_fs_file_t *danp_ram_fs_create(const char *name, size_t name_len)
+{
+    danp_ram_fs_file_t *file = NULL;
+
+    for (size_t i = 0; i < DANP_RAM_FS_MAX_FILES && name_len <= DANP_RAM_FS_MAX_NAME_LEN; i++)
+    {
+        if (!ram_fs_files[i].used)
+        {
+            file = &ram_fs_files[i];
+            memset(file, 0, sizeof(danp_ram_fs_file_t));
+            memcpy(file->name, name, name_len);
+            file->used = true;
+            break;
+        }
+    }
+
+    return file;
+}
+
+/**
+ * @brief Grow a file buffer to hold at least size bytes. Caller holds the lock.
+ * @param file File.
+ * @param size Required capacity.
+ * @return 0 on success, negative on error.
+ */
+static int32_t danp_ram_fs_reserve(danp_ram_fs_file_t *file, size_t size)
+{
+    int32_t ret = 0;
+    size_t capacity = file->capacity ? file->capacity : 256;
+    uint8_t *data;
+
+    if (size > file->capacity)
+    {
+        while (capacity < size)
+        {
+            capacity *= 2;
+        }
+
+        data = realloc(file->data, capacity);
+        if (!data)
+        {
+            ret = -1;
+        }
+        else
+        {
+            file->data = data;
+            file->capacity = capacity;
+        }
+    }
+
+    return ret;
+}
+
+static danp_ftp_status_t danp_ram_fs_open(
+    danp_ftp_file_handle_t *file_handle,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    danp_ftp_service_fs_mode_t mode,
+    void *user_data)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    danp_ram_fs_file_t *file;
+
+    (void)user_data;
+
+    pthread_mutex_lock(&ram_fs_lock);
+
+    file = danp_ram_fs_find((const char *)file_id, file_id_len);
+
+    if (!file && mode == DANP_FTP_FS_MODE_READ)
+    {
+        status = DANP_FTP_STATUS_FILE_NOT_FOUND;
+    }
+    else
+    {
+        if (!file)
+        {
+            file = danp_ram_fs_create((const char *)file_id, file_id_len);
+        }
+
+        if (!file)
+        {
+            status = DANP_FTP_STATUS_ERROR;
+        }
+        else
+        {
+            if (mode == DANP_FTP_FS_MODE_WRITE)
+            {
+                file->size = 0;
+            }
+            *file_handle = (danp_ftp_file_handle_t)file;
+        }
+    }
+
+    pthread_mutex_unlock(&ram_fs_lock);
+
+    return status;
+}
+
+static danp_ftp_status_t danp_ram_fs_close(danp_ftp_file_handle_t file_handle, void *user_data)
+{
+    (void)file_handle;
+    (void)user_data;
+
+    return DANP_FTP_STATUS_OK;
+}
+
+static danp_ftp_status_t danp_ram_fs_read(
+    danp_ftp_file_handle_t file_handle,
+    size_t offset,
+    uint8_t *buffer,
+    uint16_t length,
+    void *user_data)
+{
+    danp_ram_fs_file_t *file = (danp_ram_fs_file_t *)file_handle;
+    danp_ftp_status_t status = 0;
+
+    (void)user_data;
+
+    pthread_mutex_lock(&ram_fs_lock);
+
+    if (offset < file->size)
+    {
+        status = (danp_ftp_status_t)((file->size - offset < length) ? file->size - offset : length);
+        memcpy(buffer, &file->data[offset], (size_t)status);
+    }
+
+    pthread_mutex_unlock(&ram_fs_lock);
+
+    return status;
+}
+
+static danp_ftp_status_t danp_ram_fs_write(
+    danp_ftp_file_handle_t file_handle,
+    size_t offset,
+    const uint8_t *data,
+    uint16_t length,
+    void *user_data)
+{
+    danp_ram_fs_file_t *file = (danp_ram_fs_file_t *)file_handle;
+    danp_ftp_status_t status = DANP_FTP_STATUS_ERROR;
+
+    (void)user_data;
+
+    pthread_mutex_lock(&ram_fs_lock);
+
+    if (danp_ram_fs_reserve(file, offset + length) == 0)
+    {
+        if (offset > file->size)
+        {
+            memset(&file->data[file->size], 0, offset - file->size);
+        }
+        memcpy(&file->data[offset], data, length);
+        if (offset + length > file->size)
+        {
+            file->size = offset + length;
+        }
+        status = (danp_ftp_status_t)length;
+    }
+
+    pthread_mutex_unlock(&ram_fs_lock);
+
+    return status;
+}
+
+static danp_ftp_status_t danp_ram_fs_truncate(
+    danp_ftp_file_handle_t file_handle,
+    size_t size,
+    void *user_data)
+{
+    danp_ram_fs_file_t *file = (danp_ram_fs_file_t *)file_handle;
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+
+    (void)user_data;
+
+    pthread_mutex_lock(&ram_fs_lock);
+
+    if (size > file->size)
+    {
+        if (danp_ram_fs_reserve(file, size) == 0)
+        {
+            memset(&file->data[file->size], 0, size - file->size);
+        }
+        else
+        {
+            status = DANP_FTP_STATUS_ERROR;
+        }
+    }
+
+    if (status == DANP_FTP_STATUS_OK)
+    {
+        file->size = size;
+    }
+
+    pthread_mutex_unlock(&ram_fs_lock);
+
+    return status;
+}
+
+static danp_ftp_status_t danp_ram_fs_prepare(
+    danp_ftp_file_handle_t file_handle,
+    size_t offset,
+    size_t size,
+    void *user_data)
+{
+    danp_ram_fs_file_t *file = (danp_ram_fs_file_t *)file_handle;
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+
+    (void)user_data;
+
+    pthread_mutex_lock(&ram_fs_lock);
+
+    /* Grow once up front instead of reallocating as chunks arrive */
+    if (size > SIZE_MAX - offset || danp_ram_fs_reserve(file, offset + size) != 0)
+    {
+        status = DANP_FTP_STATUS_ERROR;
+    }
+
+    pthread_mutex_unlock(&ram_fs_lock);
+
+    return status;
+}
+
+static danp_ftp_status_t danp_ram_fs_readv(
+    danp_ftp_file_handle_t file_handle,
+    size_t offset,
+    const danp_ftp_service_fs_iovec_t *iov,
+    uint8_t iov_count,
+    void *user_data)
+{
+    danp_ram_fs_file_t *file = (danp_ram_fs_file_t *)file_handle;
+    size_t total = 0;
+
+    (void)user_data;
+
+    pthread_mutex_lock(&ram_fs_lock);
+
+    for (uint8_t i = 0; i < iov_count && offset + total < file->size; i++)
+    {
+        size_t copy = file->size - (offset + total);
+
+        if (copy > iov[i].length)
+        {
+            copy = iov[i].length;
+        }
+        memcpy(iov[i].base, &file->data[offset + total], copy);
+        total += copy;
+    }
+
+    pthread_mutex_unlock(&ram_fs_lock);
+
+    return (danp_ftp_status_t)total;
+}
+
+static danp_ftp_status_t danp_ram_fs_writev(
+    danp_ftp_file_handle_t file_handle,
+    size_t offset,
+    const danp_ftp_service_fs_iovec_t *iov,
+    uint8_t iov_count,
+    void *user_data)
+{
+    danp_ram_fs_file_t *file = (danp_ram_fs_file_t *)file_handle;
+    danp_ftp_status_t status = DANP_FTP_STATUS_ERROR;
+    size_t total = 0;
+
+    (void)user_data;
+
+    for (uint8_t i = 0; i < iov_count; i++)
+    {
+        total += iov[i].length;
+    }
+
+    pthread_mutex_lock(&ram_fs_lock);
+
+    if (danp_ram_fs_reserve(file, offset + total) == 0)
+    {
+        if (offset > file->size)
+        {
+            memset(&file->data[file->size], 0, offset - file->size);
+        }
+        total = 0;
+        for (uint8_t i = 0; i < iov_count; i++)
+        {
+            memcpy(&file->data[offset + total], iov[i].base, iov[i].length);
+            total += iov[i].length;
+        }
+        if (offset + total > file->size)
+        {
+            file->size = offset + total;
+        }
+        status = (danp_ftp_status_t)total;
+    }
+
+    pthread_mutex_unlock(&ram_fs_lock);
+
+    return status;
+}
+
+void danp_ram_fs_get_api(danp_ftp_service_fs_api_t *fs)
+{
+    memset(fs, 0, sizeof(danp_ftp_service_fs_api_t));
+    fs->open = danp_ram_fs_open;
+    fs->close = danp_ram_fs_close;
+    fs->read = danp_ram_fs_read;
+    fs->write = danp_ram_fs_write;
+    fs->truncate = danp_ram_fs_truncate;
+    fs->prepare = danp_ram_fs_prepare;
+    fs->readv = danp_ram_fs_readv;
+    fs->writev = danp_ram_fs_writev;
+}
+
+void danp_ram_fs_reset(void)
+{
+    pthread_mutex_lock(&ram_fs_lock);
+
+    for (size_t i = 0; i < DANP_RAM_FS_MAX_FILES; i++)
+    {
+        free(ram_fs_files[i].data);
+        memset(&ram_fs_files[i], 0, sizeof(danp_ram_fs_file_t));
+    }
+
+    pthread_mutex_unlock(&ram_fs_lock);
+}
+
+int32_t danp_ram_fs_put(const char *name, const uint8_t *data, size_t size)
+{
+    int32_t ret = 0;
+    danp_ram_fs_file_t *file;
+
+    pthread_mutex_lock(&ram_fs_lock);
+
+    for (;;)
+    {
+        file = danp_ram_fs_find(name, strlen(name));
+        if (!file)
+        {
+            file = danp_ram_fs_create(name, strlen(name));
+        }
+
+        if (!file || danp_ram_fs_reserve(file, size) != 0)
+        {
+            ret = -1;
+            break;
+        }
+
+        if (size > 0)
+        {
+            memcpy(file->data, data, size);
+        }
+        file->size = size;
+
+        break;
+    }
+
+    pthread_mutex_unlock(&ram_fs_lock);
+
+    return ret;
+}
+
+int32_t danp_ram_fs_get(const char *name, uint8_t *buffer, size_t size)
+{
+    int32_t ret = -1;
+    danp_ram_fs_file_t *file;
+
+    pthread_mutex_lock(&ram_fs_lock);
+
+    file = danp_ram_fs_find(name, strlen(name));
+    if (file)
+    {
+        if (buffer)
+        {
+            memcpy(buffer, file->data, (file->size < size) ? file->size : size);
+        }
+        ret = (int32_t)file->size;
+    }
+
+    pthread_mutex_unlock(&ram_fs_lock);
+
+    return ret;
+}
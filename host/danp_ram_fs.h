@@ -0,0 +1,65 @@
+/* danp_ram_fs.h - RAM backed filesystem callbacks for host builds */
+
+/* All Rights Reserved */
+
+#ifndef INC_DANP_RAM_FS_H
+#define INC_DANP_RAM_FS_H
+
+/* Includes */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "danp/services/danp_ftp_service.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Configurations */
+
+
+/* Definitions */
+
+#define DANP_RAM_FS_MAX_FILES                 (16)
+#define DANP_RAM_FS_MAX_NAME_LEN              (32)
+
+/* Types */
+
+
+/* External Declarations */
+
+/**
+ * @brief Fill a service filesystem API with the RAM filesystem callbacks.
+ * @param fs Pointer to the API to fill.
+ */
+extern void danp_ram_fs_get_api(danp_ftp_service_fs_api_t *fs);
+
+/**
+ * @brief Remove every file.
+ */
+extern void danp_ram_fs_reset(void);
+
+/**
+ * @brief Create or replace a file.
+ * @param name File name.
+ * @param data File contents.
+ * @param size Size of the contents.
+ * @return 0 on success, negative on error.
+ */
+extern int32_t danp_ram_fs_put(const char *name, const uint8_t *data, size_t size);
+
+/**
+ * @brief Copy out the contents of a file.
+ * @param name File name.
+ * @param buffer Buffer to copy into, may be NULL to query the size.
+ * @param size Size of the buffer.
+ * @return File size on success, negative if the file does not exist.
+ */
+extern int32_t danp_ram_fs_get(const char *name, uint8_t *buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_DANP_RAM_FS_H */
@@ -0,0 +1,474 @@
+/* stress_danp_ftp_service.c - Concurrent client stress test for the FTP service over the loopback transport */
+
+/* All Rights Reserved */
+
+/* Includes */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <malloc.h>
+#include <time.h>
+#include "danp/services/danp_ftp_service.h"
+#include "danp/services/danp_ftp_service_client.h"
+#include "danp_loopback.h"
+#include "danp_port.h"
+#include "danp_ram_fs.h"
+
+/* Imports */
+
+
+/* Definitions */
+
+#define STRESS_LOCAL_NODE                     (1)
+#define STRESS_TIMEOUT_MS                     (2000)
+#define STRESS_DEFAULT_SESSIONS               (8)
+#define STRESS_DEFAULT_ITERATIONS             (5)
+#define STRESS_DEFAULT_SIZE                   (16 * 1024)
+#define STRESS_MAX_SESSIONS                   (DANP_RAM_FS_MAX_FILES)
+#define STRESS_HEAP_SAMPLE_MS                 (2)
+
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#define STRESS_HAVE_MALLINFO2                 (1)
+#endif
+
+/* Types */
+
+typedef struct stress_session_s
+{
+    pthread_t thread;
+    uint32_t index;
+    char file_name[DANP_RAM_FS_MAX_NAME_LEN];
+    uint8_t *source;                             /* Pattern written and read back */
+    uint8_t *sink;                               /* Read back buffer */
+    size_t size;
+    uint32_t *latency_us;                        /* One entry per transfer */
+    uint32_t transfers;
+    uint32_t failures;
+    uint64_t bytes;
+    uint64_t elapsed_us;
+} stress_session_t;
+
+/* Forward Declarations */
+
+
+/* Variables */
+
+static danp_ftp_service_fs_api_t stress_ram_fs;
+static pthread_barrier_t stress_barrier;
+static pthread_mutex_t stress_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t stress_stack_peak;
+static size_t stress_heap_base;
+static size_t stress_heap_peak;
+static volatile int stress_monitor_running;
+static uint32_t stress_iterations = STRESS_DEFAULT_ITERATIONS;
+
+/* Functions */
+
+static uint64_t stress_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000U + (uint64_t)ts.tv_nsec / 1000U;
+}
+
+static size_t stress_heap_in_use(void)
+{
+#if defined(STRESS_HAVE_MALLINFO2)
+    struct mallinfo2 info = mallinfo2();
+
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Record how deep the calling service thread is into its stack.
+ */
+static void stress_sample_stack(void)
+{
+    static __thread uintptr_t stack_top;
+    uintptr_t here = (uintptr_t)&here;
+    pthread_attr_t attr;
+    void *stack_addr;
+    size_t stack_size;
+
+    if (!stack_top && pthread_getattr_np(pthread_self(), &attr) == 0)
+    {
+        pthread_attr_getstack(&attr, &stack_addr, &stack_size);
+        stack_top = (uintptr_t)stack_addr + stack_size;
+        pthread_attr_destroy(&attr);
+    }
+
+    if (stack_top > here)
+    {
+        pthread_mutex_lock(&stress_lock);
+        if (stack_top - here > stress_stack_peak)
+        {
+            stress_stack_peak = stack_top - here;
+        }
+        pthread_mutex_unlock(&stress_lock);
+    }
+}
+
+static danp_ftp_status_t stress_fs_read(
+    danp_ftp_file_handle_t file_handle,
+    size_t offset,
+    uint8_t *buffer,
+    uint16_t length,
+    void *user_data)
+{
+    stress_sample_stack();
+
+    return stress_ram_fs.read(file_handle, offset, buffer, length, user_data);
+}
+
+static danp_ftp_status_t stress_fs_write(
+    danp_ftp_file_handle_t file_handle,
+    size_t offset,
+    const uint8_t *data,
+    uint16_t length,
+    void *user_data)
+{
+    stress_sample_stack();
+
+    return stress_ram_fs.write(file_handle, offset, data, length, user_data);
+}
+
+static danp_ftp_status_t stress_fs_readv(
+    danp_ftp_file_handle_t file_handle,
+    size_t offset,
+    const danp_ftp_service_fs_iovec_t *iov,
+    uint8_t iov_count,
+    void *user_data)
+{
+    stress_sample_stack();
+
+    return stress_ram_fs.readv(file_handle, offset, iov, iov_count, user_data);
+}
+
+static danp_ftp_status_t stress_fs_writev(
+    danp_ftp_file_handle_t file_handle,
+    size_t offset,
+    const danp_ftp_service_fs_iovec_t *iov,
+    uint8_t iov_count,
+    void *user_data)
+{
+    stress_sample_stack();
+
+    return stress_ram_fs.writev(file_handle, offset, iov, iov_count, user_data);
+}
+
+static danp_ftp_status_t stress_source_cb(size_t offset, uint8_t *buffer, uint16_t length, void *user_data)
+{
+    stress_session_t *session = (stress_session_t *)user_data;
+    size_t available = (offset < session->size) ? session->size - offset : 0;
+    size_t copy = (available < length) ? available : length;
+
+    memcpy(buffer, &session->source[offset], copy);
+
+    return (danp_ftp_status_t)copy;
+}
+
+static danp_ftp_status_t stress_sink_cb(size_t offset, const uint8_t *data, uint16_t length, void *user_data)
+{
+    stress_session_t *session = (stress_session_t *)user_data;
+
+    if (offset + length > session->size)
+    {
+        return DANP_FTP_STATUS_ERROR;
+    }
+
+    memcpy(&session->sink[offset], data, length);
+
+    return (danp_ftp_status_t)length;
+}
+
+static void *stress_heap_monitor(void *arg)
+{
+    size_t in_use;
+
+    (void)arg;
+
+    while (stress_monitor_running)
+    {
+        in_use = stress_heap_in_use();
+        if (in_use > stress_heap_peak)
+        {
+            stress_heap_peak = in_use;
+        }
+        danp_port_sleep_ms(STRESS_HEAP_SAMPLE_MS);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Alternate write and read back of the session's own file.
+ */
+static void *stress_session_thread(void *arg)
+{
+    stress_session_t *session = (stress_session_t *)arg;
+    size_t name_len = strlen(session->file_name);
+    danp_ftp_status_t status;
+    uint64_t start_us;
+    uint64_t begin_us;
+
+    pthread_barrier_wait(&stress_barrier);
+
+    begin_us = stress_now_us();
+    for (uint32_t i = 0; i < stress_iterations; i++)
+    {
+        start_us = stress_now_us();
+        status = danp_ftp_service_client_write(
+            STRESS_LOCAL_NODE,
+            (const uint8_t *)session->file_name,
+            name_len,
+            session->size,
+            stress_source_cb,
+            session,
+            STRESS_TIMEOUT_MS);
+        session->latency_us[session->transfers++] = (uint32_t)(stress_now_us() - start_us);
+
+        if (status != (danp_ftp_status_t)session->size)
+        {
+            fprintf(stderr, "session %u write %u failed: %d\n", session->index, i, status);
+            session->failures++;
+            continue;
+        }
+        session->bytes += session->size;
+
+        memset(session->sink, 0, session->size);
+        start_us = stress_now_us();
+        status = danp_ftp_service_client_read(
+            STRESS_LOCAL_NODE,
+            (const uint8_t *)session->file_name,
+            name_len,
+            stress_sink_cb,
+            session,
+            STRESS_TIMEOUT_MS);
+        session->latency_us[session->transfers++] = (uint32_t)(stress_now_us() - start_us);
+
+        if (status != (danp_ftp_status_t)session->size ||
+            memcmp(session->source, session->sink, session->size) != 0)
+        {
+            fprintf(stderr, "session %u read %u failed: %d\n", session->index, i, status);
+            session->failures++;
+            continue;
+        }
+        session->bytes += session->size;
+    }
+    session->elapsed_us = stress_now_us() - begin_us;
+
+    return NULL;
+}
+
+static int stress_compare_u32(const void *a, const void *b)
+{
+    uint32_t lhs = *(const uint32_t *)a;
+    uint32_t rhs = *(const uint32_t *)b;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static uint32_t stress_percentile(const uint32_t *sorted, uint32_t count, uint32_t percent)
+{
+    uint32_t index;
+
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    index = (uint32_t)(((uint64_t)count * percent + 99U) / 100U);
+
+    return sorted[(index > 0) ? index - 1 : 0];
+}
+
+int main(int argc, char **argv)
+{
+    danp_ftp_service_config_t config;
+    stress_session_t sessions[STRESS_MAX_SESSIONS];
+    uint32_t session_count = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : STRESS_DEFAULT_SESSIONS;
+    size_t size = (argc > 3) ? (size_t)strtoul(argv[3], NULL, 0) : STRESS_DEFAULT_SIZE;
+    pthread_t monitor;
+    uint32_t *latencies;
+    uint32_t latency_count = 0;
+    uint32_t failures = 0;
+    uint32_t active = 0;
+    uint32_t peak = 0;
+    uint64_t total_bytes = 0;
+    uint64_t start_us;
+    uint64_t elapsed_us;
+    double rate;
+    double rate_sum = 0.0;
+    double rate_sq_sum = 0.0;
+    double rate_min = 0.0;
+    double rate_max = 0.0;
+
+    if (argc > 2)
+    {
+        stress_iterations = (uint32_t)strtoul(argv[2], NULL, 0);
+    }
+
+    if (session_count == 0 || session_count > STRESS_MAX_SESSIONS || size == 0 || stress_iterations == 0)
+    {
+        fprintf(stderr, "usage: %s [sessions 1-%u] [iterations] [size]\n", argv[0], STRESS_MAX_SESSIONS);
+        return 1;
+    }
+
+    danp_loopback_init(STRESS_LOCAL_NODE);
+
+    memset(&config, 0, sizeof(config));
+    danp_ram_fs_get_api(&stress_ram_fs);
+    config.fs = stress_ram_fs;
+    config.fs.read = stress_fs_read;
+    config.fs.write = stress_fs_write;
+    /* The threaded service moves whole windows through these, sample them too */
+    config.fs.readv = stress_fs_readv;
+    config.fs.writev = stress_fs_writev;
+
+    if (danp_ftp_service_init(&config) != 0)
+    {
+        fprintf(stderr, "service init failed\n");
+        return 1;
+    }
+
+    latencies = calloc((size_t)session_count * stress_iterations * 2U, sizeof(uint32_t));
+    if (!latencies)
+    {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    memset(sessions, 0, sizeof(sessions));
+    for (uint32_t i = 0; i < session_count; i++)
+    {
+        stress_session_t *session = &sessions[i];
+
+        session->index = i;
+        session->size = size;
+        snprintf(session->file_name, sizeof(session->file_name), "stress_%u.bin", i);
+        session->source = malloc(size);
+        session->sink = malloc(size);
+        session->latency_us = calloc(stress_iterations * 2U, sizeof(uint32_t));
+
+        if (!session->source || !session->sink || !session->latency_us)
+        {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+
+        for (size_t j = 0; j < size; j++)
+        {
+            session->source[j] = (uint8_t)((i * 131U + j * 31U + (j >> 8)) & 0xFFU);
+        }
+    }
+
+    pthread_barrier_init(&stress_barrier, NULL, session_count + 1U);
+
+    stress_heap_base = stress_heap_in_use();
+    stress_heap_peak = stress_heap_base;
+    stress_monitor_running = 1;
+    pthread_create(&monitor, NULL, stress_heap_monitor, NULL);
+
+    for (uint32_t i = 0; i < session_count; i++)
+    {
+        pthread_create(&sessions[i].thread, NULL, stress_session_thread, &sessions[i]);
+    }
+
+    pthread_barrier_wait(&stress_barrier);
+    start_us = stress_now_us();
+
+    for (uint32_t i = 0; i < session_count; i++)
+    {
+        pthread_join(sessions[i].thread, NULL);
+    }
+
+    elapsed_us = stress_now_us() - start_us;
+    stress_monitor_running = 0;
+    pthread_join(monitor, NULL);
+    pthread_barrier_destroy(&stress_barrier);
+
+    /* Let the last handlers wind down before reading the client count */
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        danp_ftp_service_get_client_count(&active, &peak);
+        if (active == 0)
+        {
+            break;
+        }
+        danp_port_sleep_ms(10);
+    }
+
+    printf("%7s %9s %10s %10s %9s\n", "session", "transfers", "bytes", "ms", "KB/s");
+    for (uint32_t i = 0; i < session_count; i++)
+    {
+        stress_session_t *session = &sessions[i];
+
+        rate = (session->elapsed_us > 0) ?
+            (double)session->bytes * 1000000.0 / (double)session->elapsed_us : 0.0;
+        rate_sum += rate;
+        rate_sq_sum += rate * rate;
+        rate_min = (i == 0 || rate < rate_min) ? rate : rate_min;
+        rate_max = (rate > rate_max) ? rate : rate_max;
+
+        printf(
+            "%7u %9u %10llu %10.1f %9.1f\n",
+            i,
+            session->transfers,
+            (unsigned long long)session->bytes,
+            (double)session->elapsed_us / 1000.0,
+            rate / 1024.0);
+
+        memcpy(&latencies[latency_count], session->latency_us, session->transfers * sizeof(uint32_t));
+        latency_count += session->transfers;
+        failures += session->failures;
+        total_bytes += session->bytes;
+    }
+
+    qsort(latencies, latency_count, sizeof(uint32_t), stress_compare_u32);
+
+    printf("\n");
+    printf("sessions        %u x %u iterations x %zu bytes\n", session_count, stress_iterations, size);
+    printf(
+        "aggregate       %.2f MB/s over %.1f ms\n",
+        ((double)total_bytes * 1000000.0) / ((double)(elapsed_us ? elapsed_us : 1) * 1024.0 * 1024.0),
+        (double)elapsed_us / 1000.0);
+    /* Jain's index, 1.0 when every session got the same rate */
+    printf(
+        "fairness        %.3f (min %.1f KB/s, max %.1f KB/s)\n",
+        (rate_sq_sum > 0.0) ? (rate_sum * rate_sum) / ((double)session_count * rate_sq_sum) : 0.0,
+        rate_min / 1024.0,
+        rate_max / 1024.0);
+    printf(
+        "latency         p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+        stress_percentile(latencies, latency_count, 50) / 1000.0,
+        stress_percentile(latencies, latency_count, 90) / 1000.0,
+        stress_percentile(latencies, latency_count, 99) / 1000.0,
+        (latency_count > 0) ? latencies[latency_count - 1] / 1000.0 : 0.0);
+    printf("handlers        peak %u, live %u\n", peak, active);
+#if defined(STRESS_HAVE_MALLINFO2)
+    printf("heap            peak %zu bytes above baseline\n", stress_heap_peak - stress_heap_base);
+#else
+    printf("heap            n/a\n");
+#endif
+    printf("stack           peak %zu bytes in service threads\n", stress_stack_peak);
+    printf("failures        %u\n", failures);
+
+    for (uint32_t i = 0; i < session_count; i++)
+    {
+        free(sessions[i].source);
+        free(sessions[i].sink);
+        free(sessions[i].latency_us);
+    }
+    free(latencies);
+
+    return ((failures == 0) && (active == 0)) ? 0 : 1;
+}
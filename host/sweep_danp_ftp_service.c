@@ -0,0 +1,382 @@
+/* sweep_danp_ftp_service.c - Goodput of FTP and transactions against link impairment, as CSV */
+
+/* All Rights Reserved */
+
+/* Includes */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "danp/danp.h"
+#include "danp/danp_utilities.h"
+#include "danp/services/danp_ftp_service.h"
+#include "danp/services/danp_ftp_service_client.h"
+#include "danp_loopback.h"
+#include "danp_port.h"
+#include "danp_ram_fs.h"
+
+/* Imports */
+
+
+/* Definitions */
+
+#define SWEEP_LOCAL_NODE                      (1)
+#define SWEEP_ECHO_PORT                       (7)
+#define SWEEP_TIMEOUT_MS                      (5000)
+#define SWEEP_TRANSACTION_TIMEOUT_MS          (1000)
+#define SWEEP_TRANSACTION_SIZE                (64)
+#define SWEEP_DEFAULT_FILE_SIZE               (8 * 1024)
+#define SWEEP_DEFAULT_ITERATIONS              (3)
+#define SWEEP_TRANSACTIONS_PER_ITERATION      (20)
+#define SWEEP_FILE_NAME                       "sweep.bin"
+#define SWEEP_PPM_PER_PERCENT                 (10000)
+#define SWEEP_FEC_K                           (8)
+#define SWEEP_FEC_R                           (2)
+#define SWEEP_PARALLEL_SESSIONS               (4)
+
+/* Types */
+
+typedef struct sweep_buffer_s
+{
+    uint8_t *data;
+    size_t size;
+} sweep_buffer_t;
+
+typedef struct sweep_point_s
+{
+    const char *sweep;                           /* Name of the swept parameter */
+    danp_loopback_impairment_t impairment;
+} sweep_point_t;
+
+typedef struct sweep_result_s
+{
+    uint32_t ok;
+    uint32_t failed;
+    uint64_t bytes;
+    uint32_t elapsed_ms;
+} sweep_result_t;
+
+/* Forward Declarations */
+
+
+/* Variables */
+
+static const sweep_point_t sweep_points[] = {
+    {"loss", {.loss_ppm = 0}},
+    {"loss", {.loss_ppm = SWEEP_PPM_PER_PERCENT / 2}},
+    {"loss", {.loss_ppm = SWEEP_PPM_PER_PERCENT}},
+    {"loss", {.loss_ppm = 2 * SWEEP_PPM_PER_PERCENT}},
+    {"loss", {.loss_ppm = 5 * SWEEP_PPM_PER_PERCENT}},
+    {"loss", {.loss_ppm = 10 * SWEEP_PPM_PER_PERCENT}},
+    {"latency", {.latency_ms = 1}},
+    {"latency", {.latency_ms = 5}},
+    {"latency", {.latency_ms = 10}},
+    {"latency", {.latency_ms = 20}},
+    {"latency", {.latency_ms = 50}},
+    {"jitter", {.latency_ms = 10, .jitter_ms = 2}},
+    {"jitter", {.latency_ms = 10, .jitter_ms = 5}},
+    {"jitter", {.latency_ms = 10, .jitter_ms = 10}},
+    {"jitter", {.latency_ms = 10, .jitter_ms = 20}},
+    {"duplicate", {.duplicate_ppm = SWEEP_PPM_PER_PERCENT}},
+    {"duplicate", {.duplicate_ppm = 5 * SWEEP_PPM_PER_PERCENT}},
+    {"duplicate", {.duplicate_ppm = 10 * SWEEP_PPM_PER_PERCENT}},
+    {"reorder", {.reorder_ppm = SWEEP_PPM_PER_PERCENT, .reorder_delay_ms = 20}},
+    {"reorder", {.reorder_ppm = 5 * SWEEP_PPM_PER_PERCENT, .reorder_delay_ms = 20}},
+    {"reorder", {.reorder_ppm = 10 * SWEEP_PPM_PER_PERCENT, .reorder_delay_ms = 20}},
+    {"bandwidth", {.bandwidth_bps = 1024 * 1024}},
+    {"bandwidth", {.bandwidth_bps = 256 * 1024}},
+    {"bandwidth", {.bandwidth_bps = 64 * 1024}},
+    {"bandwidth", {.bandwidth_bps = 16 * 1024}},
+};
+
+static volatile bool sweep_echo_running = true;
+
+/* Functions */
+
+static danp_ftp_status_t sweep_source_cb(size_t offset, uint8_t *buffer, uint16_t length, void *user_data)
+{
+    sweep_buffer_t *source = (sweep_buffer_t *)user_data;
+    size_t available = (offset < source->size) ? source->size - offset : 0;
+    size_t copy = (available < length) ? available : length;
+
+    memcpy(buffer, &source->data[offset], copy);
+
+    return (danp_ftp_status_t)copy;
+}
+
+static danp_ftp_status_t sweep_sink_cb(size_t offset, const uint8_t *data, uint16_t length, void *user_data)
+{
+    sweep_buffer_t *sink = (sweep_buffer_t *)user_data;
+
+    if (offset + length > sink->size)
+    {
+        return DANP_FTP_STATUS_ERROR;
+    }
+
+    memcpy(&sink->data[offset], data, length);
+
+    return (danp_ftp_status_t)length;
+}
+
+/**
+ * @brief Answer every transaction with the request itself.
+ * @param arg Unused.
+ * @return NULL.
+ */
+static void *sweep_echo_thread(void *arg)
+{
+    danp_socket_t *listen_socket = danp_socket(DANP_TYPE_STREAM);
+    danp_socket_t *client_socket;
+    uint8_t buffer[DANP_MAX_PACKET_SIZE];
+    int32_t length;
+
+    (void)arg;
+
+    danp_bind(listen_socket, SWEEP_ECHO_PORT);
+    danp_listen(listen_socket, 4);
+
+    while (sweep_echo_running)
+    {
+        client_socket = danp_accept(listen_socket, 100);
+        if (!client_socket)
+        {
+            continue;
+        }
+
+        length = danp_recv(client_socket, buffer, sizeof(buffer), SWEEP_TRANSACTION_TIMEOUT_MS);
+        if (length > 0)
+        {
+            danp_send(client_socket, buffer, (uint16_t)length);
+        }
+
+        danp_close(client_socket);
+    }
+
+    danp_close(listen_socket);
+
+    return NULL;
+}
+
+static void sweep_print_row(const sweep_point_t *point, const char *op, const sweep_result_t *result)
+{
+    double seconds = (result->elapsed_ms > 0) ? (double)result->elapsed_ms / 1000.0 : 0.001;
+
+    printf(
+        "%s,%u,%u,%u,%u,%u,%u,%s,%u,%u,%llu,%u,%.1f,%.0f\n",
+        point->sweep,
+        point->impairment.loss_ppm,
+        point->impairment.duplicate_ppm,
+        point->impairment.reorder_ppm,
+        point->impairment.latency_ms,
+        point->impairment.jitter_ms,
+        point->impairment.bandwidth_bps,
+        op,
+        result->ok,
+        result->failed,
+        (unsigned long long)result->bytes,
+        result->elapsed_ms,
+        (double)result->ok / seconds,
+        (double)result->bytes / seconds);
+    fflush(stdout);
+}
+
+static void sweep_run_read(
+    const sweep_point_t *point,
+    sweep_buffer_t *source,
+    sweep_buffer_t *sink,
+    uint32_t iterations,
+    const danp_ftp_service_read_options_t *options,
+    uint8_t sessions,
+    const char *op)
+{
+    sweep_result_t result;
+    danp_ftp_status_t status;
+    uint32_t start_ms;
+
+    memset(&result, 0, sizeof(result));
+    start_ms = danp_port_uptime_ms();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        memset(sink->data, 0, sink->size);
+        if (sessions > 0)
+        {
+            status = danp_ftp_service_client_read_parallel(
+                SWEEP_LOCAL_NODE,
+                (const uint8_t *)SWEEP_FILE_NAME,
+                strlen(SWEEP_FILE_NAME),
+                sessions,
+                sweep_sink_cb,
+                sink,
+                SWEEP_TIMEOUT_MS);
+        }
+        else
+        {
+            status = danp_ftp_service_client_read_ex(
+                SWEEP_LOCAL_NODE,
+                (const uint8_t *)SWEEP_FILE_NAME,
+                strlen(SWEEP_FILE_NAME),
+                options,
+                sweep_sink_cb,
+                sink,
+                NULL,
+                SWEEP_TIMEOUT_MS);
+        }
+
+        if (status == (danp_ftp_status_t)source->size && memcmp(source->data, sink->data, source->size) == 0)
+        {
+            result.ok++;
+            result.bytes += source->size;
+        }
+        else
+        {
+            result.failed++;
+        }
+    }
+    result.elapsed_ms = danp_port_uptime_ms() - start_ms;
+    sweep_print_row(point, op, &result);
+}
+
+static void sweep_run_point(
+    const sweep_point_t *point,
+    sweep_buffer_t *source,
+    sweep_buffer_t *sink,
+    uint32_t iterations)
+{
+    sweep_result_t result;
+    uint8_t request[SWEEP_TRANSACTION_SIZE];
+    uint8_t response[SWEEP_TRANSACTION_SIZE];
+    danp_ftp_service_read_options_t fec = {
+        .fec_k = SWEEP_FEC_K,
+        .fec_r = SWEEP_FEC_R,
+    };
+    danp_ftp_status_t status;
+    int32_t length;
+    uint32_t start_ms;
+
+    danp_loopback_set_impairment(&point->impairment);
+
+    sweep_run_read(point, source, sink, iterations, NULL, 0, "read");
+    sweep_run_read(point, source, sink, iterations, &fec, 0, "read_fec");
+    sweep_run_read(point, source, sink, iterations, NULL, SWEEP_PARALLEL_SESSIONS, "read_parallel");
+
+    memset(&result, 0, sizeof(result));
+    start_ms = danp_port_uptime_ms();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        status = danp_ftp_service_client_write(
+            SWEEP_LOCAL_NODE,
+            (const uint8_t *)SWEEP_FILE_NAME,
+            strlen(SWEEP_FILE_NAME),
+            source->size,
+            sweep_source_cb,
+            source,
+            SWEEP_TIMEOUT_MS);
+
+        if (status == (danp_ftp_status_t)source->size)
+        {
+            result.ok++;
+            result.bytes += source->size;
+        }
+        else
+        {
+            result.failed++;
+        }
+    }
+    result.elapsed_ms = danp_port_uptime_ms() - start_ms;
+    sweep_print_row(point, "write", &result);
+
+    /* Keep the next read point independent of a write that failed half way */
+    danp_loopback_set_impairment(NULL);
+    danp_ram_fs_put(SWEEP_FILE_NAME, source->data, source->size);
+    danp_loopback_set_impairment(&point->impairment);
+
+    memset(&result, 0, sizeof(result));
+    start_ms = danp_port_uptime_ms();
+    for (uint32_t i = 0; i < iterations * SWEEP_TRANSACTIONS_PER_ITERATION; i++)
+    {
+        memset(request, (int)(i & 0xFFU), sizeof(request));
+        length = danp_transaction(
+            SWEEP_LOCAL_NODE,
+            SWEEP_ECHO_PORT,
+            request,
+            sizeof(request),
+            response,
+            sizeof(response),
+            SWEEP_TRANSACTION_TIMEOUT_MS);
+
+        if (length == (int32_t)sizeof(request) && memcmp(request, response, sizeof(request)) == 0)
+        {
+            result.ok++;
+            result.bytes += sizeof(request);
+        }
+        else
+        {
+            result.failed++;
+        }
+    }
+    result.elapsed_ms = danp_port_uptime_ms() - start_ms;
+    sweep_print_row(point, "transaction", &result);
+
+    danp_loopback_set_impairment(NULL);
+}
+
+int main(int argc, char **argv)
+{
+    danp_ftp_service_config_t config;
+    sweep_buffer_t source;
+    sweep_buffer_t sink;
+    pthread_t echo_thread;
+    size_t size = (argc > 1) ? (size_t)strtoul(argv[1], NULL, 0) : SWEEP_DEFAULT_FILE_SIZE;
+    uint32_t iterations = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : SWEEP_DEFAULT_ITERATIONS;
+    danp_loopback_impairment_t seed = {.seed = 0x5EEDU};
+
+    source.size = size;
+    source.data = malloc(size ? size : 1);
+    sink.size = size;
+    sink.data = malloc(size ? size : 1);
+
+    if (!source.data || !sink.data)
+    {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    for (size_t i = 0; i < size; i++)
+    {
+        source.data[i] = (uint8_t)((i * 31U + (i >> 8)) & 0xFFU);
+    }
+
+    danp_loopback_init(SWEEP_LOCAL_NODE);
+    danp_loopback_set_log_level(DANP_LOG_LEVEL_ERR);
+    danp_loopback_set_impairment(&seed);
+
+    memset(&config, 0, sizeof(config));
+    danp_ram_fs_get_api(&config.fs);
+
+    if (danp_ftp_service_init(&config) != 0)
+    {
+        fprintf(stderr, "service init failed\n");
+        return 1;
+    }
+
+    pthread_create(&echo_thread, NULL, sweep_echo_thread, NULL);
+
+    danp_ram_fs_put(SWEEP_FILE_NAME, source.data, size);
+
+    printf("sweep,loss_ppm,duplicate_ppm,reorder_ppm,latency_ms,jitter_ms,bandwidth_bps,op,ok,failed,bytes,elapsed_ms,ops_per_s,goodput_bps\n");
+
+    for (size_t i = 0; i < sizeof(sweep_points) / sizeof(sweep_points[0]); i++)
+    {
+        sweep_run_point(&sweep_points[i], &source, &sink, iterations);
+    }
+
+    sweep_echo_running = false;
+    pthread_join(echo_thread, NULL);
+
+    free(source.data);
+    free(sink.data);
+
+    return 0;
+}
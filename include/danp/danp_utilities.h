@@ -9,6 +9,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -20,9 +21,68 @@ extern "C" {
 
 /* Definitions */
 
+#if defined(CONFIG_DANP_STATS_MAX_COUNTERS)
+#define DANP_STATS_MAX_COUNTERS               (CONFIG_DANP_STATS_MAX_COUNTERS)
+#else
+#define DANP_STATS_MAX_COUNTERS               (32)
+#endif
+
+#define DANP_STATS_NAME_LEN                   (48)
+
+/* Nodes probed at once by danp_map, longer lists are walked in batches */
+#if defined(CONFIG_DANP_MAP_BATCH)
+#define DANP_MAP_BATCH                        (CONFIG_DANP_MAP_BATCH)
+#else
+#define DANP_MAP_BATCH                        (16)
+#endif
+
+/* DGRAM port danp_map collects echoes on when the config leaves it 0 */
+#if defined(CONFIG_DANP_MAP_REPLY_PORT)
+#define DANP_MAP_REPLY_PORT                   (CONFIG_DANP_MAP_REPLY_PORT)
+#else
+#define DANP_MAP_REPLY_PORT                   (26)
+#endif
 
 /* Types */
 
+typedef struct danp_stats_counter_s
+{
+    char name[DANP_STATS_NAME_LEN];              /* "<section>.<label>" as printed by the stack */
+    uint64_t value;
+} danp_stats_counter_t;
+
+typedef struct danp_stats_s
+{
+    uint32_t timestamp_ms;                       /* Uptime when the snapshot was taken */
+    uint32_t count;                              /* Valid entries in counters */
+    danp_stats_counter_t counters[DANP_STATS_MAX_COUNTERS];
+    uint64_t packets;                            /* Sum of packet counters */
+    uint64_t bytes;                              /* Sum of byte counters */
+    uint64_t drops;                              /* Sum of drop and error counters */
+    uint64_t retransmits;                        /* Sum of retransmit and retry counters */
+} danp_stats_t;
+
+typedef struct danp_map_config_s
+{
+    uint16_t local_node;                         /* This node, where echoes are sent back to */
+    uint16_t reply_port;                         /* DGRAM port echoes are collected on, 0 for the default */
+    uint16_t port;                               /* DGRAM echo service port on every node */
+    uint16_t pings;                              /* Pings per node, one outstanding at a time */
+    uint16_t burst;                              /* Full packets in the throughput sample, 0 = skip */
+    uint32_t timeout_ms;                         /* Wait for each ping and for the whole burst */
+} danp_map_config_t;
+
+typedef struct danp_map_result_s
+{
+    uint16_t node;
+    bool reachable;                              /* Answered at least one ping */
+    uint16_t sent;                               /* Pings sent */
+    uint16_t received;                           /* Pings answered in time */
+    uint32_t rtt_min_us;
+    uint32_t rtt_avg_us;
+    uint32_t rtt_max_us;
+    uint32_t throughput_bps;                     /* Echoed burst bytes per second, 0 = not sampled */
+} danp_map_result_t;
 
 /* External Declarations */
 
@@ -34,7 +94,50 @@ extern int32_t danp_transaction(
     uint8_t *resp_buffer,
     size_t resp_buffer_size,
     uint32_t timeout);
-    
+
+/**
+ * @brief Take a snapshot of the DANP stack counters.
+ *
+ * The stack only exposes its counters through danp_print_stats, so every
+ * "label: value" pair it prints is collected and summed into the packet,
+ * byte, drop and retransmit totals by the whole words of its label, e.g.
+ * "Packets", "Bytes", "Dropped" or "Retransmits". Labels without a known
+ * word are kept but not summed. Nothing runs until called.
+ *
+ * @param stats Pointer to store the snapshot.
+ * @return Number of counters collected, negative on error.
+ */
+extern int32_t danp_get_stats(danp_stats_t *stats);
+
+/**
+ * @brief Look up a counter of a snapshot by name.
+ * @param stats Pointer to the snapshot.
+ * @param name Counter name, matched case-insensitively.
+ * @param value Pointer to store the value.
+ * @return 0 on success, negative if the counter is missing.
+ */
+extern int32_t danp_stats_find(const danp_stats_t *stats, const char *name, uint64_t *value);
+
+/**
+ * @brief Probe a list of nodes concurrently for RTT, loss and throughput.
+ *
+ * Pings are datagrams to the DGRAM echo of danp_bench_service carrying
+ * local_node and reply_port, so no connection is set up and every node of
+ * a batch is pinged in parallel. Dead nodes cost one timeout per ping for
+ * the whole batch rather than one per node.
+ *
+ * @param nodes Node ids to probe.
+ * @param node_count Number of entries in nodes and results.
+ * @param config Probe parameters.
+ * @param results Array to store one result per node.
+ * @return Number of reachable nodes, negative on error.
+ */
+extern int32_t danp_map(
+    const uint16_t *nodes,
+    size_t node_count,
+    const danp_map_config_t *config,
+    danp_map_result_t *results);
+
 #ifdef __cplusplus
 }
 #endif
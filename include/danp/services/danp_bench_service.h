@@ -0,0 +1,87 @@
+/* danp_bench_service.h - Echo, discard and chargen services over DANP */
+
+/* All Rights Reserved */
+
+#ifndef INC_DANP_BENCH_SERVICE_H
+#define INC_DANP_BENCH_SERVICE_H
+
+/* Includes */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Configurations */
+
+
+/* Definitions */
+
+/* A DGRAM echo request starts with the node and port to answer, little endian */
+#define DANP_BENCH_DGRAM_ECHO_HEADER_SIZE     (4)
+/* Byte right after the header, datagrams without it are dropped unanswered */
+#define DANP_BENCH_DGRAM_ECHO_MAGIC           (0x4D)
+
+/* Types */
+
+typedef enum danp_bench_service_kind_e
+{
+    DANP_BENCH_SERVICE_ECHO = 0,                 /* Sends every packet back unchanged, STREAM and DGRAM */
+    DANP_BENCH_SERVICE_DISCARD,                  /* Drops everything it receives */
+    DANP_BENCH_SERVICE_CHARGEN,                  /* Streams printable characters until the peer closes */
+    DANP_BENCH_SERVICE_COUNT,
+} danp_bench_service_kind_t;
+
+typedef struct danp_bench_service_config_s
+{
+    uint16_t echo_port;                          /* 0 disables the service */
+    uint16_t discard_port;                       /* 0 disables the service */
+    uint16_t chargen_port;                       /* 0 disables the service */
+} danp_bench_service_config_t;
+
+typedef struct danp_bench_service_stats_s
+{
+    uint16_t port;                               /* Listening port, 0 = disabled */
+    uint32_t connections;                        /* Connections accepted */
+    uint32_t active;                             /* Connections open now */
+    uint32_t rejected;                           /* Connections closed for lack of a handler */
+    uint64_t rx_bytes;                           /* Received by closed connections */
+    uint64_t tx_bytes;                           /* Sent by closed connections */
+    uint32_t datagrams;                          /* DGRAM requests answered, echo only */
+} danp_bench_service_stats_t;
+
+/* External Declarations */
+
+/**
+ * @brief Start the echo, discard and chargen services on STREAM sockets.
+ *
+ * The echo port also answers datagrams: each is sent back whole to the
+ * node and port in its first DANP_BENCH_DGRAM_ECHO_HEADER_SIZE bytes, as
+ * datagrams carry no source address. danp_map probes this way. Only
+ * datagrams with DANP_BENCH_DGRAM_ECHO_MAGIC after the header are
+ * answered, so the echo cannot be used to aim arbitrary traffic at
+ * another service.
+ *
+ * @param config Ports to listen on, NULL for the Kconfig defaults.
+ * @return 0 on success, negative on error.
+ */
+extern int32_t danp_bench_service_init(const danp_bench_service_config_t *config);
+
+/**
+ * @brief Get the counters of one service.
+ * @param kind Service to query.
+ * @param stats Pointer to store the counters.
+ * @return 0 on success, negative on error.
+ */
+extern int32_t danp_bench_service_get_stats(
+    danp_bench_service_kind_t kind,
+    danp_bench_service_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_DANP_BENCH_SERVICE_H */
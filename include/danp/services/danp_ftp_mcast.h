@@ -0,0 +1,98 @@
+/* danp_ftp_mcast.h - One-to-many file distribution over DGRAM with NACK repair */
+
+/* All Rights Reserved */
+
+#ifndef INC_DANP_FTP_MCAST_H
+#define INC_DANP_FTP_MCAST_H
+
+/* Includes */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "danp/ftp/danp_ftp.h"
+#include "danp/services/danp_ftp_service_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Configurations */
+
+
+/* Definitions */
+
+
+/* Types */
+
+typedef struct danp_ftp_mcast_config_s
+{
+    uint16_t local_node;                         /* This node, announced by the sender and named in NACKs */
+    uint16_t group_node;                         /* Sender: destination of group traffic, e.g. a broadcast node */
+    uint16_t data_port;                          /* DGRAM port receivers listen on, 0 for the Kconfig default */
+    uint16_t nack_port;                          /* DGRAM port the sender collects NACKs on, 0 for the default */
+    uint16_t session_id;                         /* Transfer id, 0 on a receiver follows the first announced */
+    uint16_t receivers;                          /* Sender: receivers to wait for, 0 stops after a silent round */
+    uint32_t round_ms;                           /* Sender: NACK collection window, 0 for the default */
+    uint32_t max_rounds;                         /* Sender: repair rounds before giving up, 0 for the default */
+} danp_ftp_mcast_config_t;
+
+typedef struct danp_ftp_mcast_stats_s
+{
+    uint32_t chunks;                             /* Chunks in the file */
+    uint32_t rounds;                             /* Rounds run, the first pass included */
+    uint32_t data_packets;                       /* DATA packets sent or received */
+    uint32_t repairs;                            /* Sender: chunks sent again in repair rounds */
+    uint32_t duplicates;                         /* Receiver: chunks received more than once */
+    uint32_t nacks;                              /* NACK packets sent or collected */
+    uint32_t completed;                          /* Sender: receivers that reported the file complete */
+} danp_ftp_mcast_stats_t;
+
+/* External Declarations */
+
+/**
+ * @brief Distribute a file to a group of receivers.
+ *
+ * Every chunk is sent once to the group, followed by repair rounds that
+ * resend the union of the chunks receivers reported missing, so airtime
+ * grows with the file size and the loss, not with the number of nodes.
+ *
+ * @param config Group, ports and round settings.
+ * @param size Size of the file.
+ * @param read_cb Callback reading the local file.
+ * @param user_data User data passed to read_cb.
+ * @param stats Optional pointer to store transfer statistics.
+ * @return Number of receivers that completed, negative status on error.
+ */
+extern danp_ftp_status_t danp_ftp_mcast_send(
+    const danp_ftp_mcast_config_t *config,
+    size_t size,
+    danp_ftp_service_client_read_cb_t read_cb,
+    void *user_data,
+    danp_ftp_mcast_stats_t *stats);
+
+/**
+ * @brief Join a group transfer and receive the file.
+ *
+ * Chunks are passed to write_cb as they arrive, which is in file order
+ * for the first pass and by offset for repairs.
+ *
+ * @param config Local node, data port and session to follow.
+ * @param write_cb Callback storing the received data.
+ * @param user_data User data passed to write_cb.
+ * @param stats Optional pointer to store transfer statistics.
+ * @param timeout_ms Give up after this long without a packet of the followed session.
+ * @return Number of bytes received, at most INT32_MAX, negative status on error.
+ */
+extern danp_ftp_status_t danp_ftp_mcast_receive(
+    const danp_ftp_mcast_config_t *config,
+    danp_ftp_service_client_write_cb_t write_cb,
+    void *user_data,
+    danp_ftp_mcast_stats_t *stats,
+    uint32_t timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_DANP_FTP_MCAST_H */
@@ -21,6 +21,10 @@ extern "C" {
 
 /* Definitions */
 
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_ASYNC)
+/* Returned by read_async and write_async when the result follows through danp_ftp_service_fs_complete() */
+#define DANP_FTP_SERVICE_FS_PENDING           (-0x100)
+#endif
 
 /* Types */
 
@@ -28,8 +32,23 @@ typedef enum danp_ftp_service_fs_mode_e
 {
     DANP_FTP_FS_MODE_READ  = 0,
     DANP_FTP_FS_MODE_WRITE,
+    DANP_FTP_FS_MODE_UPDATE,                     /* Read/write, keep contents, create if missing */
 } danp_ftp_service_fs_mode_t;
 
+typedef enum danp_ftp_service_priority_e
+{
+    DANP_FTP_SERVICE_PRIORITY_BULK = 0,          /* Background transfers, yield to everything */
+    DANP_FTP_SERVICE_PRIORITY_NORMAL,
+    DANP_FTP_SERVICE_PRIORITY_URGENT,            /* Preempts lower priority transfers */
+    DANP_FTP_SERVICE_PRIORITY_COUNT,
+} danp_ftp_service_priority_t;
+
+typedef struct danp_ftp_service_priority_map_s
+{
+    uint16_t node;                               /* Remote node id */
+    danp_ftp_service_priority_t priority;        /* Session priority for that node */
+} danp_ftp_service_priority_map_t;
+
 typedef uintptr_t danp_ftp_file_handle_t;
 
 typedef danp_ftp_status_t (*danp_ftp_service_fs_open_cb_t)(
@@ -61,24 +80,215 @@ typedef danp_ftp_status_t (*danp_ftp_service_fs_write_cb_t)(
     void *user_data                              /* User data */
 );
 
+typedef danp_ftp_status_t (*danp_ftp_service_fs_digest_cb_t)(
+    danp_ftp_file_handle_t file_handle,          /* File handle */
+    size_t *size,                                /* File size output */
+    uint32_t *crc,                               /* CRC32 of the whole file output */
+    void *user_data                              /* User data */
+);
+
+typedef danp_ftp_status_t (*danp_ftp_service_fs_truncate_cb_t)(
+    danp_ftp_file_handle_t file_handle,          /* File handle */
+    size_t size,                                 /* New file size */
+    void *user_data                              /* User data */
+);
+
+typedef struct danp_ftp_service_fs_iovec_s
+{
+    uint8_t *base;                               /* Chunk buffer */
+    uint16_t length;                             /* Chunk length */
+} danp_ftp_service_fs_iovec_t;
+
+typedef danp_ftp_status_t (*danp_ftp_service_fs_readv_cb_t)(
+    danp_ftp_file_handle_t file_handle,          /* File handle */
+    size_t offset,                               /* Offset in file of the first buffer */
+    const danp_ftp_service_fs_iovec_t *iov,      /* Buffers to fill in order, short only at end of file */
+    uint8_t iov_count,                           /* Number of buffers */
+    void *user_data                              /* User data */
+);
+
+typedef danp_ftp_status_t (*danp_ftp_service_fs_writev_cb_t)(
+    danp_ftp_file_handle_t file_handle,          /* File handle */
+    size_t offset,                               /* Offset in file of the first buffer */
+    const danp_ftp_service_fs_iovec_t *iov,      /* Buffers to write back to back */
+    uint8_t iov_count,                           /* Number of buffers */
+    void *user_data                              /* User data */
+);
+
+typedef danp_ftp_status_t (*danp_ftp_service_fs_prepare_cb_t)(
+    danp_ftp_file_handle_t file_handle,          /* File handle */
+    size_t offset,                               /* Offset of the first byte to be written */
+    size_t size,                                 /* Bytes announced by the client */
+    void *user_data                              /* User data */
+);
+
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_ASYNC)
+/* In-flight filesystem operation, owned by the service */
+typedef struct danp_ftp_service_fs_op_s danp_ftp_service_fs_op_t;
+
+typedef danp_ftp_status_t (*danp_ftp_service_fs_read_async_cb_t)(
+    danp_ftp_file_handle_t file_handle,          /* File handle */
+    size_t offset,                               /* Offset in file */
+    uint8_t *buffer,                             /* Buffer to read data into, valid until completion */
+    uint16_t length,                             /* Length of data to read */
+    danp_ftp_service_fs_op_t *op,                /* Operation to complete if pending */
+    void *user_data                              /* User data */
+);
+
+typedef danp_ftp_status_t (*danp_ftp_service_fs_write_async_cb_t)(
+    danp_ftp_file_handle_t file_handle,          /* File handle */
+    size_t offset,                               /* Offset in file */
+    const uint8_t *data,                         /* Data to write, valid until completion */
+    uint16_t length,                             /* Length of data to write */
+    danp_ftp_service_fs_op_t *op,                /* Operation to complete if pending */
+    void *user_data                              /* User data */
+);
+#endif
+
 typedef struct danp_ftp_service_fs_api_s
 {
     danp_ftp_service_fs_open_cb_t open;
     danp_ftp_service_fs_close_cb_t close;
     danp_ftp_service_fs_read_cb_t read;
     danp_ftp_service_fs_write_cb_t write;
+    danp_ftp_service_fs_digest_cb_t digest;      /* Optional, NULL to stream via read */
+    danp_ftp_service_fs_truncate_cb_t truncate;  /* Optional, without it SYNC fails to shrink files */
+    danp_ftp_service_fs_prepare_cb_t prepare;    /* Optional, reserve or erase space before WRITE data */
+    danp_ftp_service_fs_readv_cb_t readv;        /* Optional, READ handler threads fetch several chunks per call */
+    danp_ftp_service_fs_writev_cb_t writev;      /* Optional, WRITE handler threads store several chunks per call */
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_ASYNC)
+    danp_ftp_service_fs_read_async_cb_t read_async;   /* Optional, used for READ chunks instead of read */
+    danp_ftp_service_fs_write_async_cb_t write_async; /* Optional, used for WRITE chunks instead of write */
+#endif
 } danp_ftp_service_fs_api_t;
 
 typedef struct danp_ftp_service_config_s
 {
     void *user_data;
     danp_ftp_service_fs_api_t fs;
+    const danp_ftp_service_priority_map_t *priority_map; /* Optional node to priority table */
+    size_t priority_map_len;                     /* Entries in priority_map */
 } danp_ftp_service_config_t;
 
+#if defined(CONFIG_DANP_FTP_SERVICE_PROFILER)
+/* Log2 microsecond buckets: 0 is < 1 us, n is [2^(n-1), 2^n) us, the last is open ended */
+#define DANP_FTP_SERVICE_PROF_BUCKETS         (20)
+
+typedef enum danp_ftp_service_prof_stage_e
+{
+    DANP_FTP_SERVICE_PROF_FS_READ = 0,           /* fs.read of a chunk and the EOF peek */
+    DANP_FTP_SERVICE_PROF_FS_WRITE,              /* fs.write of a chunk */
+    DANP_FTP_SERVICE_PROF_CRC,                   /* Message CRC on send and receive */
+    DANP_FTP_SERVICE_PROF_SEND,                  /* danp_send */
+    DANP_FTP_SERVICE_PROF_RECV,                  /* danp_recv of a chunk or command */
+    DANP_FTP_SERVICE_PROF_ACK_WAIT,              /* Chunk sent until its ACK arrived */
+    DANP_FTP_SERVICE_PROF_STAGE_COUNT
+} danp_ftp_service_prof_stage_t;
+
+typedef struct danp_ftp_service_prof_stat_s
+{
+    uint32_t count;
+    uint32_t min_ns;
+    uint32_t max_ns;
+    uint64_t total_ns;
+    uint32_t histogram[DANP_FTP_SERVICE_PROF_BUCKETS];
+} danp_ftp_service_prof_stat_t;
+
+typedef struct danp_ftp_service_profile_s
+{
+    uint32_t sessions;                           /* Sessions folded into this profile */
+    danp_ftp_service_prof_stat_t stages[DANP_FTP_SERVICE_PROF_STAGE_COUNT];
+} danp_ftp_service_profile_t;
+#endif
+
+typedef struct danp_ftp_service_rate_stats_s
+{
+    uint32_t global_limit_bps;                   /* Global limit, 0 = unlimited */
+    uint32_t session_limit_bps;                  /* Per-session limit, 0 = unlimited */
+    uint32_t achieved_bps;                       /* Transmit rate over the last window */
+    uint32_t throttled_ms;                       /* Total time spent waiting for tokens */
+    uint64_t bytes_sent;                         /* Total bytes sent by the service */
+    uint32_t retransmits;                        /* Sends repeated after an ACK timeout */
+} danp_ftp_service_rate_stats_t;
+
+typedef struct danp_ftp_service_mem_stats_s
+{
+    uint32_t service_stack_size;                 /* Service thread stack size */
+    uint32_t service_stack_used;                 /* Service thread high-water mark, 0 = unknown */
+    uint32_t client_stack_size;                  /* Client handler thread stack size */
+    uint32_t client_stack_peak;                  /* Highest high-water mark of any handler */
+    uint32_t client_stack_last;                  /* High-water mark of the last handler */
+    uint32_t client_stack_samples;               /* Handlers sampled, 0 = stack info unavailable */
+    uint32_t context_size;                       /* Heap bytes of one client context */
+    uint32_t heap_in_use;                        /* Heap bytes held by client contexts now */
+    uint32_t heap_peak;                          /* Highest heap_in_use since init */
+    uint32_t static_bytes;                       /* Statically reserved session state */
+} danp_ftp_service_mem_stats_t;
+
 /* External Declarations */
 
 extern int32_t danp_ftp_service_init(const danp_ftp_service_config_t *config);
 
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_ASYNC)
+/**
+ * @brief Complete a filesystem operation that returned DANP_FTP_SERVICE_FS_PENDING.
+ *
+ * Every pending operation must be completed exactly once. It may be
+ * called from any thread or from an ISR, such as a DMA done handler.
+ *
+ * @param op Operation passed to the async callback.
+ * @param result Bytes read or written, negative status on error.
+ */
+extern void danp_ftp_service_fs_complete(danp_ftp_service_fs_op_t *op, danp_ftp_status_t result);
+#endif
+
+/**
+ * @brief Set the transmit rate limits of the FTP service.
+ * @param global_bps Limit shared by all sessions in bytes per second, 0 = unlimited.
+ * @param session_bps Limit of each session in bytes per second, 0 = unlimited.
+ * @return 0 on success, negative on error.
+ */
+extern int32_t danp_ftp_service_set_rate_limit(uint32_t global_bps, uint32_t session_bps);
+
+/**
+ * @brief Get the transmit rate limits and achieved rate of the FTP service.
+ * @param stats Pointer to store the statistics.
+ * @return 0 on success, negative on error.
+ */
+extern int32_t danp_ftp_service_get_rate_stats(danp_ftp_service_rate_stats_t *stats);
+
+/**
+ * @brief Get the number of live and peak concurrent client handlers.
+ * @param active Pointer to store the live handler count.
+ * @param peak Pointer to store the peak handler count since init.
+ * @return 0 on success, negative on error.
+ */
+extern int32_t danp_ftp_service_get_client_count(uint32_t *active, uint32_t *peak);
+
+/**
+ * @brief Get the stack high-water marks and heap usage of the FTP service.
+ * @param stats Pointer to store the statistics.
+ * @return 0 on success, negative on error.
+ */
+extern int32_t danp_ftp_service_get_mem_stats(danp_ftp_service_mem_stats_t *stats);
+
+#if defined(CONFIG_DANP_FTP_SERVICE_PROFILER)
+/**
+ * @brief Get the stage profile of the FTP service.
+ * @param total Pointer to store the profile summed over all finished sessions, may be NULL.
+ * @param last Pointer to store the profile of the last finished session, may be NULL.
+ * @return 0 on success, negative on error.
+ */
+extern int32_t danp_ftp_service_get_profile(
+    danp_ftp_service_profile_t *total,
+    danp_ftp_service_profile_t *last);
+
+/**
+ * @brief Clear the stage profile of the FTP service.
+ */
+extern void danp_ftp_service_reset_profile(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
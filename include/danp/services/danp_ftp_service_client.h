@@ -0,0 +1,256 @@
+/* danp_ftp_service_client.h - Client helpers for extended FTP service commands */
+
+/* All Rights Reserved */
+
+#ifndef INC_DANP_FTP_SERVICE_CLIENT_H
+#define INC_DANP_FTP_SERVICE_CLIENT_H
+
+/* Includes */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "danp/ftp/danp_ftp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Configurations */
+
+
+/* Definitions */
+
+#define DANP_FTP_SERVICE_CLIENT_MAX_SESSIONS  (8)
+
+/* Types */
+
+typedef struct danp_ftp_service_file_info_s
+{
+    size_t size;                                 /* File size in bytes */
+    uint32_t crc;                                /* CRC32 of the whole file */
+} danp_ftp_service_file_info_t;
+
+typedef danp_ftp_status_t (*danp_ftp_service_client_read_cb_t)(
+    size_t offset,                               /* Offset in local file */
+    uint8_t *buffer,                             /* Buffer to read data into */
+    uint16_t length,                             /* Length of data to read */
+    void *user_data                              /* User data */
+);
+
+typedef danp_ftp_status_t (*danp_ftp_service_client_write_cb_t)(
+    size_t offset,                               /* Offset in local file */
+    const uint8_t *data,                         /* Received data */
+    uint16_t length,                             /* Length of received data */
+    void *user_data                              /* User data */
+);
+
+typedef struct danp_ftp_service_sync_stats_s
+{
+    size_t remote_size;                          /* Size of the remote copy before sync */
+    uint32_t blocks_total;                       /* Blocks in the local file */
+    uint32_t blocks_sent;                        /* Blocks that differed and were sent */
+    size_t bytes_sent;                           /* Payload bytes sent as patches */
+} danp_ftp_service_sync_stats_t;
+
+typedef struct danp_ftp_service_read_options_s
+{
+    uint8_t fec_k;                               /* Data chunks per FEC block, 0 disables FEC */
+    uint8_t fec_r;                               /* XOR parity chunks per FEC block */
+    int64_t offset;                              /* First byte to read, negative = from the end */
+    uint64_t length;                             /* Most bytes to read, 0 = to the end of the file */
+} danp_ftp_service_read_options_t;
+
+typedef struct danp_ftp_service_read_stats_s
+{
+    size_t offset;                               /* File offset of the first byte read */
+    uint8_t fec_k;                               /* Accepted data chunks per block, 0 = plain read */
+    uint8_t fec_r;                               /* Accepted parity chunks per block */
+    uint32_t fec_blocks;                         /* FEC blocks received */
+    uint32_t fec_recovered;                      /* Chunks rebuilt from parity */
+    uint32_t fec_repaired;                       /* Chunks asked for again in a block ACK */
+} danp_ftp_service_read_stats_t;
+
+/* External Declarations */
+
+/**
+ * @brief Query size and whole-file CRC32 of a file on a remote FTP service.
+ * @param remote_node Node running the FTP service.
+ * @param file_id File name/id.
+ * @param file_id_len File name/id length.
+ * @param info Pointer to store the file information.
+ * @param timeout_ms Response timeout in milliseconds.
+ * @return DANP_FTP_STATUS_OK on success, negative status on error.
+ */
+extern danp_ftp_status_t danp_ftp_service_client_stat(
+    uint16_t remote_node,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    danp_ftp_service_file_info_t *info,
+    uint32_t timeout_ms);
+
+/**
+ * @brief Download a file from a remote FTP service.
+ * @param remote_node Node running the FTP service.
+ * @param file_id File name/id.
+ * @param file_id_len File name/id length.
+ * @param write_cb Callback storing the received data.
+ * @param user_data User data passed to write_cb.
+ * @param timeout_ms Per message timeout in milliseconds.
+ * @return Number of bytes received, at most INT32_MAX, negative status on error.
+ */
+extern danp_ftp_status_t danp_ftp_service_client_read(
+    uint16_t remote_node,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    danp_ftp_service_client_write_cb_t write_cb,
+    void *user_data,
+    uint32_t timeout_ms);
+
+/**
+ * @brief Download a file from a remote FTP service with read options.
+ *
+ * With FEC requested the service sends parity with every block of data
+ * chunks, so isolated losses are rebuilt locally instead of waiting out
+ * a retransmit timeout. A service without FEC support falls back to the
+ * plain read, reported as fec_k = 0 in the statistics.
+ *
+ * A non-zero offset or length reads only that byte range; write_cb
+ * still receives file offsets, so ranges land where they belong. A
+ * negative offset counts back from the end of the file, so an offset of
+ * -4096 tails the last 4 KiB; the resolved start is reported in stats.
+ * Negative offsets and offsets past 2 GiB are sent in u64 fields, which
+ * the service also asks for when a tail starts beyond 4 GiB.
+ *
+ * @param remote_node Node running the FTP service.
+ * @param file_id File name/id.
+ * @param file_id_len File name/id length.
+ * @param options Optional read options, NULL for a plain read.
+ * @param write_cb Callback storing the received data.
+ * @param user_data User data passed to write_cb.
+ * @param stats Optional pointer to store read statistics.
+ * @param timeout_ms Per message timeout in milliseconds.
+ * @return Number of bytes received, at most INT32_MAX, negative status on error.
+ */
+extern danp_ftp_status_t danp_ftp_service_client_read_ex(
+    uint16_t remote_node,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    const danp_ftp_service_read_options_t *options,
+    danp_ftp_service_client_write_cb_t write_cb,
+    void *user_data,
+    danp_ftp_service_read_stats_t *stats,
+    uint32_t timeout_ms);
+
+/**
+ * @brief Download a file over several concurrent sessions.
+ *
+ * The file is split into one byte range per session and all ranges are
+ * transferred at once, so a link whose round trip limits one session
+ * carries several chunks per round trip. write_cb is called in arrival
+ * order with file offsets and must place data by offset.
+ *
+ * @param remote_node Node running the FTP service.
+ * @param file_id File name/id.
+ * @param file_id_len File name/id length.
+ * @param sessions Sessions to use, at most DANP_FTP_SERVICE_CLIENT_MAX_SESSIONS.
+ * @param write_cb Callback storing the received data.
+ * @param user_data User data passed to write_cb.
+ * @param timeout_ms Per message timeout in milliseconds.
+ * @return Number of bytes received, at most INT32_MAX, negative status on error.
+ */
+extern danp_ftp_status_t danp_ftp_service_client_read_parallel(
+    uint16_t remote_node,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    uint8_t sessions,
+    danp_ftp_service_client_write_cb_t write_cb,
+    void *user_data,
+    uint32_t timeout_ms);
+
+/**
+ * @brief Upload a file to a remote FTP service.
+ *
+ * The size is announced with the command so the service can reserve or
+ * erase storage before the first chunk arrives.
+ *
+ * @param remote_node Node running the FTP service.
+ * @param file_id File name/id.
+ * @param file_id_len File name/id length.
+ * @param size Size of the local file.
+ * @param read_cb Callback reading the local file.
+ * @param user_data User data passed to read_cb.
+ * @param timeout_ms Per message timeout in milliseconds.
+ * @return Number of bytes sent, at most INT32_MAX, negative status on error.
+ */
+extern danp_ftp_status_t danp_ftp_service_client_write(
+    uint16_t remote_node,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    size_t size,
+    danp_ftp_service_client_read_cb_t read_cb,
+    void *user_data,
+    uint32_t timeout_ms);
+
+/**
+ * @brief Update a byte range of a file on a remote FTP service.
+ *
+ * The rest of the remote file is kept, so several ranges of one file
+ * can be written by concurrent sessions.
+ *
+ * @param remote_node Node running the FTP service.
+ * @param file_id File name/id.
+ * @param file_id_len File name/id length.
+ * @param offset First byte of the range.
+ * @param size Size of the range.
+ * @param read_cb Callback reading the local file, called with file offsets.
+ * @param user_data User data passed to read_cb.
+ * @param timeout_ms Per message timeout in milliseconds.
+ * @return Number of bytes sent, at most INT32_MAX, negative status on error.
+ */
+extern danp_ftp_status_t danp_ftp_service_client_write_range(
+    uint16_t remote_node,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    size_t offset,
+    size_t size,
+    danp_ftp_service_client_read_cb_t read_cb,
+    void *user_data,
+    uint32_t timeout_ms);
+
+/**
+ * @brief Bring a remote file up to date by sending only the blocks that differ.
+ *
+ * Fixed-block compare: the service sends a CRC32 per block of its copy and
+ * the client sends every local block whose CRC32 differs at the same index.
+ * In-place edits cost one block each, an insertion or deletion resends the
+ * rest of the file. Both copies must be at most UINT32_MAX bytes.
+ *
+ * @param remote_node Node running the FTP service.
+ * @param file_id File name/id.
+ * @param file_id_len File name/id length.
+ * @param size Size of the local file.
+ * @param block_size Requested block size, 0 for the service default.
+ * @param read_cb Callback reading the local file.
+ * @param user_data User data passed to read_cb.
+ * @param stats Optional pointer to store sync statistics.
+ * @param timeout_ms Per message timeout in milliseconds.
+ * @return DANP_FTP_STATUS_OK on success, DANP_FTP_STATUS_INVALID_PARAM if size
+ *         does not fit u32, negative status on error.
+ */
+extern danp_ftp_status_t danp_ftp_service_client_sync(
+    uint16_t remote_node,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    size_t size,
+    uint16_t block_size,
+    danp_ftp_service_client_read_cb_t read_cb,
+    void *user_data,
+    danp_ftp_service_sync_stats_t *stats,
+    uint32_t timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_DANP_FTP_SERVICE_CLIENT_H */
@@ -0,0 +1,242 @@
+/* danp_port.h - Time, sleep and locking primitives for DANP support code */
+
+/* All Rights Reserved */
+
+#ifndef INC_DANP_PORT_H
+#define INC_DANP_PORT_H
+
+/* Includes */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#if defined(__ZEPHYR__)
+#include <zephyr/kernel.h>
+#else
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Configurations */
+
+
+/* Definitions */
+
+#define DANP_PORT_WAIT_FOREVER                (UINT32_MAX)
+
+/*
+ * danp_recv() result of a wait that expired with nothing queued. The stack
+ * hands back the kernel wait code; older builds reported 0 bytes instead,
+ * danp_port_recv_timed_out() accepts both.
+ */
+#define DANP_PORT_RECV_TIMEOUT                (-EAGAIN)
+
+
+/* Types */
+
+#if defined(__ZEPHYR__)
+typedef struct k_mutex danp_port_mutex_t;
+typedef struct k_sem danp_port_sem_t;
+#define DANP_PORT_MUTEX_DEFINE(name)          static K_MUTEX_DEFINE(name)
+#else
+typedef pthread_mutex_t danp_port_mutex_t;
+typedef sem_t danp_port_sem_t;
+#define DANP_PORT_MUTEX_DEFINE(name)          static danp_port_mutex_t name = PTHREAD_MUTEX_INITIALIZER
+#endif
+
+/* External Declarations */
+
+#if defined(__ZEPHYR__)
+
+static inline uint32_t danp_port_uptime_ms(void)
+{
+    return k_uptime_get_32();
+}
+
+static inline void danp_port_sleep_ms(uint32_t ms)
+{
+    k_msleep((int32_t)ms);
+}
+
+static inline uint32_t danp_port_cycles(void)
+{
+    return k_cycle_get_32();
+}
+
+static inline uint64_t danp_port_cycles_to_ns(uint32_t cycles)
+{
+    return k_cyc_to_ns_floor64(cycles);
+}
+
+/* Needs CONFIG_THREAD_STACK_INFO and CONFIG_INIT_STACKS for the painted stack */
+static inline int32_t danp_port_stack_unused(size_t *unused)
+{
+#if defined(CONFIG_THREAD_STACK_INFO) && defined(CONFIG_INIT_STACKS)
+    return k_thread_stack_space_get(k_current_get(), unused);
+#else
+    *unused = 0;
+    return -1;
+#endif
+}
+
+static inline void danp_port_mutex_init(danp_port_mutex_t *mutex)
+{
+    k_mutex_init(mutex);
+}
+
+static inline void danp_port_mutex_lock(danp_port_mutex_t *mutex)
+{
+    k_mutex_lock(mutex, K_FOREVER);
+}
+
+static inline void danp_port_mutex_unlock(danp_port_mutex_t *mutex)
+{
+    k_mutex_unlock(mutex);
+}
+
+static inline void danp_port_sem_init(danp_port_sem_t *sem)
+{
+    k_sem_init(sem, 0, 1);
+}
+
+/* Safe to call from an ISR */
+static inline void danp_port_sem_give(danp_port_sem_t *sem)
+{
+    k_sem_give(sem);
+}
+
+/* 0 polls, DANP_PORT_WAIT_FOREVER blocks, returns 0 once taken */
+static inline int32_t danp_port_sem_take(danp_port_sem_t *sem, uint32_t timeout_ms)
+{
+    if (timeout_ms == DANP_PORT_WAIT_FOREVER)
+    {
+        return k_sem_take(sem, K_FOREVER);
+    }
+
+    return k_sem_take(sem, K_MSEC(timeout_ms));
+}
+
+#else
+
+static inline uint32_t danp_port_uptime_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000U + (uint64_t)ts.tv_nsec / 1000000U);
+}
+
+static inline void danp_port_sleep_ms(uint32_t ms)
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(ms / 1000U);
+    ts.tv_nsec = (long)(ms % 1000U) * 1000000L;
+    nanosleep(&ts, NULL);
+}
+
+/* Host "cycles" are monotonic nanoseconds, wrapping like a 32 bit counter */
+static inline uint32_t danp_port_cycles(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec);
+}
+
+static inline uint64_t danp_port_cycles_to_ns(uint32_t cycles)
+{
+    return cycles;
+}
+
+/* Host stacks are not painted, so there is no high-water mark to read */
+static inline int32_t danp_port_stack_unused(size_t *unused)
+{
+    *unused = 0;
+    return -1;
+}
+
+static inline void danp_port_mutex_init(danp_port_mutex_t *mutex)
+{
+    pthread_mutex_init(mutex, NULL);
+}
+
+static inline void danp_port_mutex_lock(danp_port_mutex_t *mutex)
+{
+    pthread_mutex_lock(mutex);
+}
+
+static inline void danp_port_mutex_unlock(danp_port_mutex_t *mutex)
+{
+    pthread_mutex_unlock(mutex);
+}
+
+static inline void danp_port_sem_init(danp_port_sem_t *sem)
+{
+    sem_init(sem, 0, 0);
+}
+
+static inline void danp_port_sem_give(danp_port_sem_t *sem)
+{
+    sem_post(sem);
+}
+
+static inline int32_t danp_port_sem_take(danp_port_sem_t *sem, uint32_t timeout_ms)
+{
+    struct timespec ts;
+    int ret;
+
+    if (timeout_ms == DANP_PORT_WAIT_FOREVER)
+    {
+        do
+        {
+            ret = sem_wait(sem);
+        } while (ret != 0);
+        return 0;
+    }
+
+    if (timeout_ms == 0)
+    {
+        return (sem_trywait(sem) == 0) ? 0 : -1;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += (time_t)(timeout_ms / 1000U);
+    ts.tv_nsec += (long)(timeout_ms % 1000U) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+
+    do
+    {
+        ret = sem_timedwait(sem, &ts);
+    } while (ret != 0 && errno == EINTR);
+
+    return (ret == 0) ? 0 : -1;
+}
+
+#endif
+
+/* true for a danp_recv() wait that expired, negative codes other than the timeout are socket errors */
+static inline bool danp_port_recv_timed_out(int32_t result)
+{
+    return result == 0 || result == DANP_PORT_RECV_TIMEOUT;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_DANP_PORT_H */
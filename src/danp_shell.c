@@ -12,6 +12,7 @@
 
 #include "danp/danp.h"
 #include "danp/danp_utilities.h"
+#include "danp/services/danp_bench_service.h"
 
 /* Imports */
 
@@ -20,6 +21,16 @@
 
 LOG_MODULE_DECLARE(danp);
 
+#if defined(CONFIG_DANP_BENCH_ECHO_PORT)
+#define DANP_SHELL_MAP_PORT (CONFIG_DANP_BENCH_ECHO_PORT)
+#else
+#define DANP_SHELL_MAP_PORT (7)
+#endif
+#define DANP_SHELL_MAP_MAX_NODES (256)
+#define DANP_SHELL_MAP_PINGS (4)
+#define DANP_SHELL_MAP_BURST (8)
+#define DANP_SHELL_MAP_TIMEOUT_MS (500)
+
 /* Types */
 
 
@@ -28,9 +39,24 @@ LOG_MODULE_DECLARE(danp);
 static int danp_shell_transaction(const struct shell *shell, size_t argc, char **argv);
 static int danp_shell_test(const struct shell *shell, size_t argc, char **argv);
 static int danp_shell_stats(const struct shell *shell, size_t argc, char **argv);
+static int danp_shell_stats_watch(const struct shell *shell, size_t argc, char **argv);
+static int danp_shell_bench(const struct shell *shell, size_t argc, char **argv);
+static int danp_shell_map(const struct shell *shell, size_t argc, char **argv);
 
 /* Variables */
 
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_danp_stats_cmds,
+    SHELL_CMD_ARG(
+        watch,
+        NULL,
+        "Print packet, byte, drop and retransmit rates\nUsage: danp stats watch <interval_ms> [<samples>]",
+        danp_shell_stats_watch,
+        2,
+        1
+    ),
+    SHELL_SUBCMD_SET_END
+);
+
 SHELL_STATIC_SUBCMD_SET_CREATE(sub_danp_cmds,
     SHELL_CMD(
         transaction,
@@ -46,10 +72,28 @@ SHELL_STATIC_SUBCMD_SET_CREATE(sub_danp_cmds,
     ),
     SHELL_CMD(
         stats,
-        NULL,
+        &sub_danp_stats_cmds,
         "Print DANP statistics",
         danp_shell_stats
     ),
+    SHELL_CMD_ARG(
+        bench,
+        NULL,
+        "Show echo/discard/chargen service counters\nUsage: danp bench [start]\n  start: listen on the Kconfig ports",
+        danp_shell_bench,
+        1,
+        1
+    ),
+    SHELL_CMD_ARG(
+        map,
+        NULL,
+        "Probe nodes for RTT, loss and throughput against their DGRAM echo service\n"
+        "Usage: danp map <local_id> <first_id> <last_id> [<pings>] [<port>]\n"
+        "       danp map <local_id> <id,id,...> [<pings>] [<port>]",
+        danp_shell_map,
+        3,
+        3
+    ),
     SHELL_SUBCMD_SET_END
 );
 
@@ -236,3 +280,206 @@ static int danp_shell_stats(const struct shell *shell, size_t argc, char **argv)
     danp_print_stats((void (*)(const char *, ...))danp_shell_print_func);
     return 0;
 }
+
+static uint32_t danp_shell_stats_rate(uint64_t current, uint64_t previous, uint32_t elapsed_ms) {
+    /* A counter that went backwards was reset, count from zero */
+    uint64_t delta = (current >= previous) ? current - previous : current;
+
+    return (uint32_t)((delta * 1000U) / elapsed_ms);
+}
+
+static int danp_shell_stats_watch(const struct shell *shell, size_t argc, char **argv) {
+    /* Two snapshots are too large for the shell stack */
+    static danp_stats_t previous;
+    static danp_stats_t current;
+    uint32_t interval_ms = (uint32_t)strtoul(argv[1], NULL, 0);
+    uint32_t samples = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : 10;
+    uint32_t elapsed_ms;
+
+    if (interval_ms == 0) {
+        shell_error(shell, "Interval must be non-zero");
+        return -EINVAL;
+    }
+
+    if (danp_get_stats(&previous) < 0) {
+        shell_error(shell, "Failed to read DANP statistics");
+        return -EIO;
+    }
+
+    shell_print(shell, "%u counters, sampling every %u ms", previous.count, interval_ms);
+    shell_print(shell, "%10s %10s %10s %10s", "pkts/s", "bytes/s", "drops/s", "retx/s");
+
+    for (uint32_t i = 0; i < samples; i++) {
+        k_msleep((int32_t)interval_ms);
+
+        if (danp_get_stats(&current) < 0) {
+            shell_error(shell, "Failed to read DANP statistics");
+            return -EIO;
+        }
+
+        elapsed_ms = current.timestamp_ms - previous.timestamp_ms;
+        if (elapsed_ms == 0) {
+            elapsed_ms = 1;
+        }
+
+        shell_print(shell, "%10u %10u %10u %10u",
+                    danp_shell_stats_rate(current.packets, previous.packets, elapsed_ms),
+                    danp_shell_stats_rate(current.bytes, previous.bytes, elapsed_ms),
+                    danp_shell_stats_rate(current.drops, previous.drops, elapsed_ms),
+                    danp_shell_stats_rate(current.retransmits, previous.retransmits, elapsed_ms));
+
+        previous = current;
+    }
+
+    return 0;
+}
+
+static int danp_shell_bench(const struct shell *shell, size_t argc, char **argv) {
+    static const char *const names[DANP_BENCH_SERVICE_COUNT] = {"echo", "discard", "chargen"};
+    danp_bench_service_stats_t stats;
+
+    if (argc > 1) {
+        if (strcmp(argv[1], "start") != 0) {
+            shell_error(shell, "Unknown argument: %s", argv[1]);
+            return -EINVAL;
+        }
+
+        if (danp_bench_service_init(NULL) < 0) {
+            shell_error(shell, "Failed to start bench services");
+            return -EIO;
+        }
+    }
+
+    for (uint32_t kind = 0; kind < DANP_BENCH_SERVICE_COUNT; kind++) {
+        if (danp_bench_service_get_stats((danp_bench_service_kind_t)kind, &stats) < 0) {
+            shell_error(shell, "Bench services not running, use 'danp bench start'");
+            return -ENODEV;
+        }
+
+        if (stats.port == 0) {
+            shell_print(shell, "%-8s disabled", names[kind]);
+            continue;
+        }
+
+        shell_print(shell, "%-8s port %u: %u conns (%u active, %u rejected), rx %llu B, tx %llu B",
+                    names[kind],
+                    stats.port,
+                    stats.connections,
+                    stats.active,
+                    stats.rejected,
+                    (unsigned long long)stats.rx_bytes,
+                    (unsigned long long)stats.tx_bytes);
+    }
+
+    return 0;
+}
+
+static int danp_shell_map(const struct shell *shell, size_t argc, char **argv) {
+    danp_map_config_t config = {
+        .port = DANP_SHELL_MAP_PORT,
+        .pings = DANP_SHELL_MAP_PINGS,
+        .burst = DANP_SHELL_MAP_BURST,
+        .timeout_ms = DANP_SHELL_MAP_TIMEOUT_MS,
+    };
+    uint16_t *nodes = NULL;
+    danp_map_result_t *results = NULL;
+    size_t count = 0;
+    size_t next_arg;
+    char *cursor;
+    uint32_t first;
+    uint32_t last;
+    int32_t reachable;
+    int ret = 0;
+
+    for (;;) {
+        nodes = k_malloc(DANP_SHELL_MAP_MAX_NODES * sizeof(uint16_t));
+        if (!nodes) {
+            ret = -ENOMEM;
+            break;
+        }
+
+        /* Echoes come back to this node, datagrams carry no source */
+        config.local_node = (uint16_t)strtoul(argv[1], NULL, 0);
+
+        if (strchr(argv[2], ',')) {
+            /* Explicit list, DANP has no discovery to fall back on */
+            cursor = argv[2];
+            while (*cursor && count < DANP_SHELL_MAP_MAX_NODES) {
+                nodes[count++] = (uint16_t)strtoul(cursor, &cursor, 0);
+                while (*cursor == ',') {
+                    cursor++;
+                }
+            }
+            next_arg = 3;
+        } else {
+            if (argc < 4) {
+                shell_error(shell, "Missing last_id");
+                ret = -EINVAL;
+                break;
+            }
+
+            first = (uint32_t)strtoul(argv[2], NULL, 0);
+            last = (uint32_t)strtoul(argv[3], NULL, 0);
+            if (last < first || last - first >= DANP_SHELL_MAP_MAX_NODES) {
+                shell_error(shell, "Range must be ascending and at most %u nodes", DANP_SHELL_MAP_MAX_NODES);
+                ret = -EINVAL;
+                break;
+            }
+
+            for (uint32_t node = first; node <= last; node++) {
+                nodes[count++] = (uint16_t)node;
+            }
+            next_arg = 4;
+        }
+
+        if (argc > next_arg) {
+            config.pings = (uint16_t)strtoul(argv[next_arg], NULL, 0);
+        }
+        if (argc > next_arg + 1) {
+            config.port = (uint16_t)strtoul(argv[next_arg + 1], NULL, 0);
+        }
+
+        results = k_malloc(count * sizeof(danp_map_result_t));
+        if (!results) {
+            ret = -ENOMEM;
+            break;
+        }
+
+        shell_print(shell, "Probing %u nodes on port %u, %u pings each", (uint32_t)count, config.port, config.pings);
+
+        reachable = danp_map(nodes, count, &config, results);
+        if (reachable < 0) {
+            shell_error(shell, "Map failed");
+            ret = -EINVAL;
+            break;
+        }
+
+        shell_print(shell, "%6s %6s %10s %10s %10s %10s", "node", "loss%", "min us", "avg us", "max us", "B/s");
+        for (size_t i = 0; i < count; i++) {
+            if (!results[i].reachable) {
+                shell_print(shell, "%6u %6s", results[i].node, "down");
+                continue;
+            }
+
+            shell_print(shell, "%6u %6u %10u %10u %10u %10u",
+                        results[i].node,
+                        (uint32_t)(100U * (results[i].sent - results[i].received) / results[i].sent),
+                        results[i].rtt_min_us,
+                        results[i].rtt_avg_us,
+                        results[i].rtt_max_us,
+                        results[i].throughput_bps);
+        }
+        shell_print(shell, "%d/%u nodes reachable", reachable, (uint32_t)count);
+
+        break;
+    }
+
+    if (nodes) {
+        k_free(nodes);
+    }
+    if (results) {
+        k_free(results);
+    }
+
+    return ret;
+}
@@ -0,0 +1,76 @@
+/* danp_trace.h - Zephyr tracing hooks for DANP support code */
+
+/* All Rights Reserved */
+
+#ifndef INC_DANP_TRACE_H
+#define INC_DANP_TRACE_H
+
+/* Includes */
+
+#include <stdint.h>
+
+#if defined(CONFIG_DANP_TRACING)
+#include <zephyr/tracing/tracing.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Configurations */
+
+
+/* Definitions */
+
+/*
+ * Named events, kept within the 20 characters the CTF named event carries.
+ * Arguments are listed as (arg0, arg1).
+ */
+#define DANP_TRACE_FTP_SESSION_START          "ftp_session_start"  /* (node, priority) */
+#define DANP_TRACE_FTP_SESSION_END            "ftp_session_end"    /* (node, retransmits) */
+#define DANP_TRACE_FTP_TX                     "ftp_tx"             /* (seq, type << 16 | len) */
+#define DANP_TRACE_FTP_RX                     "ftp_rx"             /* (seq, type << 16 | len) */
+#define DANP_TRACE_FTP_ACK_WAIT_BEGIN         "ftp_ack_wait_begin" /* (seq, rto ms) */
+#define DANP_TRACE_FTP_ACK_WAIT_END           "ftp_ack_wait_end"   /* (seq, status) */
+#define DANP_TRACE_FTP_FS_BEGIN               "ftp_fs_begin"       /* (op, offset) */
+#define DANP_TRACE_FTP_FS_END                 "ftp_fs_end"         /* (op, result) */
+#define DANP_TRACE_FTP_CLIENT_TX              "ftp_client_tx"      /* (seq, type << 16 | len) */
+#define DANP_TRACE_FTP_CLIENT_RX              "ftp_client_rx"      /* (seq, type << 16 | len) */
+#define DANP_TRACE_TXN_BEGIN                  "danp_txn_begin"     /* (node, port) */
+#define DANP_TRACE_TXN_END                    "danp_txn_end"       /* (node, result) */
+#define DANP_TRACE_FTP_TEST_TX                "ftp_test_tx"        /* (offset, len) */
+#define DANP_TRACE_FTP_TEST_RX                "ftp_test_rx"        /* (offset, len) */
+#define DANP_TRACE_FTP_BENCH_BEGIN            "ftp_bench_begin"    /* (size, iterations) */
+#define DANP_TRACE_FTP_BENCH_END              "ftp_bench_end"      /* (tx passed, rx passed) */
+
+#define DANP_TRACE_FS_READ                    (0)
+#define DANP_TRACE_FS_WRITE                   (1)
+
+/* Types */
+
+
+/* External Declarations */
+
+/**
+ * @brief Emit a named tracing event, compiled out unless CONFIG_DANP_TRACING is set.
+ * @param name Event name, one of the DANP_TRACE_* strings.
+ * @param arg0 First event argument.
+ * @param arg1 Second event argument.
+ */
+static inline void danp_trace(const char *name, uint32_t arg0, uint32_t arg1)
+{
+#if defined(CONFIG_DANP_TRACING)
+    sys_trace_named_event(name, arg0, arg1);
+#else
+    (void)name;
+    (void)arg0;
+    (void)arg1;
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_DANP_TRACE_H */
@@ -4,29 +4,435 @@
 
 /* Includes */
 
-#include <zephyr/logging/log.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
 
 #include "danp/danp_utilities.h"
 #include "danp/danp.h"
+#include "danp/services/danp_bench_service.h"
+#include "danp_debug.h"
+#include "danp_trace.h"
+#include "danp_port.h"
 
 /* Imports */
 
 
 /* Definitions */
 
-LOG_MODULE_DECLARE(danp);
+#define DANP_STATS_LINE_LEN                   (128)
+/* Section prefix kept in counter names, the label gets the rest */
+#define DANP_STATS_SECTION_LEN                (16)
+/* Longest word looked up in danp_stats_words */
+#define DANP_STATS_WORD_LEN                   (16)
+
+#define DANP_MAP_MAGIC                        (DANP_BENCH_DGRAM_ECHO_MAGIC)
+#define DANP_MAP_KIND_PING                    (0x01)
+#define DANP_MAP_KIND_BULK                    (0x02)
+/* DGRAM echo reply header, then magic(1) + kind(1) + sequence(2) + index(2) */
+#define DANP_MAP_PING_SIZE                    (DANP_BENCH_DGRAM_ECHO_HEADER_SIZE + 6)
+#define DANP_MAP_POLL_MS                      (1)
 
 /* Types */
 
+/* Ranked, a label with words of several categories counts in the highest */
+typedef enum danp_stats_category_e
+{
+    DANP_STATS_CATEGORY_NONE = 0,
+    DANP_STATS_CATEGORY_PACKETS,
+    DANP_STATS_CATEGORY_BYTES,
+    DANP_STATS_CATEGORY_DROPS,
+    DANP_STATS_CATEGORY_RETRANSMITS,
+} danp_stats_category_t;
+
+typedef struct danp_stats_word_s
+{
+    const char *word;                            /* Lower case whole word */
+    danp_stats_category_t category;
+} danp_stats_word_t;
+
+typedef enum danp_map_state_e
+{
+    DANP_MAP_STATE_PING = 0,
+    DANP_MAP_STATE_BURST,
+    DANP_MAP_STATE_DONE,
+} danp_map_state_t;
+
+typedef struct danp_map_probe_s
+{
+    danp_map_result_t *result;
+    danp_socket_t *socket;                       /* Connected to the echo service of the node */
+    uint16_t index;                              /* Position in the node list, echoed back */
+    danp_map_state_t state;
+    bool outstanding;                            /* Ping sequence sent is awaiting its echo */
+    uint16_t sequence;
+    uint16_t burst_sent;
+    uint16_t burst_received;
+    uint32_t sent_ms;                            /* Ping or burst start, for the timeout */
+    uint32_t sent_cycles;                        /* Ping or burst start, for the measurement */
+    uint64_t rtt_total_us;
+} danp_map_probe_t;
+
 
 /* Forward Declarations */
 
+static void danp_stats_collect(const char *fmt, ...);
 
 /* Variables */
 
+static const danp_stats_word_t danp_stats_words[] = {
+    {"packets", DANP_STATS_CATEGORY_PACKETS},
+    {"packet", DANP_STATS_CATEGORY_PACKETS},
+    {"pkts", DANP_STATS_CATEGORY_PACKETS},
+    {"frames", DANP_STATS_CATEGORY_PACKETS},
+    {"bytes", DANP_STATS_CATEGORY_BYTES},
+    {"octets", DANP_STATS_CATEGORY_BYTES},
+    {"dropped", DANP_STATS_CATEGORY_DROPS},
+    {"drops", DANP_STATS_CATEGORY_DROPS},
+    {"discarded", DANP_STATS_CATEGORY_DROPS},
+    {"discards", DANP_STATS_CATEGORY_DROPS},
+    {"lost", DANP_STATS_CATEGORY_DROPS},
+    {"errors", DANP_STATS_CATEGORY_DROPS},
+    {"error", DANP_STATS_CATEGORY_DROPS},
+    {"failed", DANP_STATS_CATEGORY_DROPS},
+    {"failures", DANP_STATS_CATEGORY_DROPS},
+    {"retransmits", DANP_STATS_CATEGORY_RETRANSMITS},
+    {"retransmitted", DANP_STATS_CATEGORY_RETRANSMITS},
+    {"retransmissions", DANP_STATS_CATEGORY_RETRANSMITS},
+    {"retries", DANP_STATS_CATEGORY_RETRANSMITS},
+    {"retx", DANP_STATS_CATEGORY_RETRANSMITS},
+};
+
+DANP_PORT_MUTEX_DEFINE(danp_stats_lock);
+
+/* Collection state, only valid while danp_stats_lock is held */
+static danp_stats_t *danp_stats_target;
+static char danp_stats_line[DANP_STATS_LINE_LEN];
+static size_t danp_stats_line_len;
+static char danp_stats_section[DANP_STATS_SECTION_LEN];
 
 /* Functions */
 
+/**
+ * @brief Find the category of a label from its whole words, ignoring case.
+ *
+ * The highest ranked category of any word wins, so "Retransmitted packets"
+ * is a retransmit counter and "Packets dropped" a drop counter. Words not in
+ * danp_stats_words, such as "transferred", do not categorize a label.
+ *
+ * @param label Label as printed, without the section.
+ * @return Category, DANP_STATS_CATEGORY_NONE if no word is known.
+ */
+static danp_stats_category_t danp_stats_classify(const char *label)
+{
+    danp_stats_category_t category = DANP_STATS_CATEGORY_NONE;
+    char word[DANP_STATS_WORD_LEN];
+    size_t length;
+
+    while (*label)
+    {
+        if (!isalpha((unsigned char)*label))
+        {
+            label++;
+            continue;
+        }
+
+        length = 0;
+        while (isalpha((unsigned char)*label))
+        {
+            if (length < sizeof(word) - 1)
+            {
+                word[length] = (char)tolower((unsigned char)*label);
+            }
+            length++;
+            label++;
+        }
+
+        if (length >= sizeof(word))
+        {
+            continue;
+        }
+        word[length] = '\0';
+
+        for (size_t i = 0; i < sizeof(danp_stats_words) / sizeof(danp_stats_words[0]); i++)
+        {
+            if (strcmp(word, danp_stats_words[i].word) == 0 && danp_stats_words[i].category > category)
+            {
+                category = danp_stats_words[i].category;
+            }
+        }
+    }
+
+    return category;
+}
+
+/**
+ * @brief Store a counter in the target snapshot and add it to its category total.
+ * @param label Label as printed, without the section.
+ * @param value Counter value.
+ */
+static void danp_stats_add(const char *label, uint64_t value)
+{
+    danp_stats_t *stats = danp_stats_target;
+    danp_stats_counter_t *counter;
+
+    switch (danp_stats_classify(label))
+    {
+    case DANP_STATS_CATEGORY_RETRANSMITS:
+        stats->retransmits += value;
+        break;
+    case DANP_STATS_CATEGORY_DROPS:
+        stats->drops += value;
+        break;
+    case DANP_STATS_CATEGORY_BYTES:
+        stats->bytes += value;
+        break;
+    case DANP_STATS_CATEGORY_PACKETS:
+        stats->packets += value;
+        break;
+    default:
+        break;
+    }
+
+    if (stats->count >= DANP_STATS_MAX_COUNTERS)
+    {
+        return;
+    }
+
+    counter = &stats->counters[stats->count++];
+    if (danp_stats_section[0] != '\0')
+    {
+        /* Keep "TX.Packets" and "RX.Packets" apart */
+        snprintf(counter->name, sizeof(counter->name), "%.*s.%.*s",
+            DANP_STATS_SECTION_LEN - 1, danp_stats_section,
+            DANP_STATS_NAME_LEN - DANP_STATS_SECTION_LEN - 1, label);
+    }
+    else
+    {
+        snprintf(counter->name, sizeof(counter->name), "%.*s", DANP_STATS_NAME_LEN - 1, label);
+    }
+    counter->value = value;
+}
+
+/**
+ * @brief Strip separators and blanks from both ends of a label in place.
+ * @param start First character of the label.
+ * @param end One past the last character, overwritten with the terminator.
+ * @return Pointer to the trimmed label.
+ */
+static char *danp_stats_trim(char *start, char *end)
+{
+    while (start < end && (isspace((unsigned char)*start) || strchr(",;|-*", *start)))
+    {
+        start++;
+    }
+
+    while (end > start && (isspace((unsigned char)end[-1]) || strchr(",;|-*", end[-1])))
+    {
+        end--;
+    }
+
+    *end = '\0';
+
+    return start;
+}
+
+/**
+ * @brief Parse one printed line into counters.
+ *
+ * Accepts "label: value" and "label = value" pairs, several per line, and a
+ * bare "label value" line. A line ending in ':' starts a section that
+ * prefixes the following labels.
+ *
+ * @param line Line without its newline, modified in place.
+ */
+static void danp_stats_parse_line(char *line)
+{
+    char *label = line;
+    char *cursor = line;
+    char *sep;
+    char *value_end;
+    char *text;
+    uint64_t value;
+    bool found = false;
+
+    for (;;)
+    {
+        sep = strpbrk(cursor, ":=");
+        if (!sep)
+        {
+            break;
+        }
+
+        cursor = sep + 1;
+        while (*cursor == ' ' || *cursor == '\t')
+        {
+            cursor++;
+        }
+
+        if (*cursor == '\0')
+        {
+            /* Section header */
+            text = danp_stats_trim(label, sep);
+            if (!found && *text != '\0')
+            {
+                snprintf(danp_stats_section, sizeof(danp_stats_section), "%s", text);
+            }
+            return;
+        }
+
+        if (!isdigit((unsigned char)*cursor))
+        {
+            continue;
+        }
+
+        value = strtoull(cursor, &value_end, 10);
+        text = danp_stats_trim(label, sep);
+        if (*text != '\0')
+        {
+            danp_stats_add(text, value);
+            found = true;
+        }
+
+        /* A unit such as "B" or "ms" is dropped when a delimiter ends the pair */
+        sep = strpbrk(value_end, ":=");
+        cursor = strpbrk(value_end, ",;|");
+        if (!cursor || (sep && sep < cursor))
+        {
+            cursor = value_end;
+        }
+        label = cursor;
+    }
+
+    if (found)
+    {
+        return;
+    }
+
+    /* "label value" without a separator */
+    value_end = line + strlen(line);
+    while (value_end > line && isspace((unsigned char)value_end[-1]))
+    {
+        value_end--;
+    }
+
+    cursor = value_end;
+    while (cursor > line && isdigit((unsigned char)cursor[-1]))
+    {
+        cursor--;
+    }
+
+    if (cursor < value_end && cursor > line && isspace((unsigned char)cursor[-1]))
+    {
+        value = strtoull(cursor, NULL, 10);
+        text = danp_stats_trim(line, cursor);
+        if (*text != '\0')
+        {
+            danp_stats_add(text, value);
+        }
+    }
+}
+
+/**
+ * @brief danp_print_stats sink, splits the printed text into lines.
+ * @param fmt printf style format.
+ */
+static void danp_stats_collect(const char *fmt, ...)
+{
+    char chunk[DANP_STATS_LINE_LEN];
+    va_list args;
+    int32_t length;
+
+    if (!danp_stats_target)
+    {
+        return;
+    }
+
+    va_start(args, fmt);
+    length = vsnprintf(chunk, sizeof(chunk), fmt, args);
+    va_end(args);
+
+    if (length < 0)
+    {
+        return;
+    }
+
+    for (const char *c = chunk; *c; c++)
+    {
+        if (*c == '\n' || *c == '\r')
+        {
+            danp_stats_line[danp_stats_line_len] = '\0';
+            danp_stats_parse_line(danp_stats_line);
+            danp_stats_line_len = 0;
+        }
+        else if (danp_stats_line_len < sizeof(danp_stats_line) - 1)
+        {
+            danp_stats_line[danp_stats_line_len++] = *c;
+        }
+    }
+}
+
+int32_t danp_get_stats(danp_stats_t *stats)
+{
+    if (!stats)
+    {
+        return -1;
+    }
+
+    memset(stats, 0, sizeof(danp_stats_t));
+
+    danp_port_mutex_lock(&danp_stats_lock);
+
+    danp_stats_target = stats;
+    danp_stats_line_len = 0;
+    danp_stats_section[0] = '\0';
+
+    danp_print_stats(danp_stats_collect);
+
+    /* Last line without a newline */
+    danp_stats_line[danp_stats_line_len] = '\0';
+    danp_stats_parse_line(danp_stats_line);
+    danp_stats_target = NULL;
+
+    danp_port_mutex_unlock(&danp_stats_lock);
+
+    stats->timestamp_ms = danp_port_uptime_ms();
+
+    return (int32_t)stats->count;
+}
+
+int32_t danp_stats_find(const danp_stats_t *stats, const char *name, uint64_t *value)
+{
+    const char *a;
+    const char *b;
+
+    if (!stats || !name || !value)
+    {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < stats->count; i++)
+    {
+        a = stats->counters[i].name;
+        b = name;
+        while (*a && tolower((unsigned char)*a) == tolower((unsigned char)*b))
+        {
+            a++;
+            b++;
+        }
+
+        if (*a == '\0' && *b == '\0')
+        {
+            *value = stats->counters[i].value;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
 int32_t danp_transaction(
     uint16_t dest_id,
     uint16_t dest_port,
@@ -42,13 +448,15 @@ int32_t danp_transaction(
     int32_t recv_len = 0;
     int32_t sent_len = 0;
 
+    danp_trace(DANP_TRACE_TXN_BEGIN, dest_id, dest_port);
+
     for (;;)
     {
         sock = danp_socket(DANP_TYPE_STREAM);
         if (!sock)
         {
             ret = -1; // Socket creation failed
-            LOG_ERR("Failed to create socket");
+            danp_log_message(DANP_LOG_LEVEL_ERR, "Failed to create socket");
             break;
         }
         is_sock_created = true;
@@ -57,7 +465,7 @@ int32_t danp_transaction(
         if (ret != 0)
         {
             ret = -2; // Connection failed
-            LOG_ERR("Failed to connect to %u:%u", dest_id, dest_port);
+            danp_log_message(DANP_LOG_LEVEL_ERR, "Failed to connect to %u:%u", dest_id, dest_port);
             break;
         }
 
@@ -65,7 +473,7 @@ int32_t danp_transaction(
         if (sent_len < 0)
         {
             ret = -3; // Send failed
-            LOG_ERR("Failed to send data");
+            danp_log_message(DANP_LOG_LEVEL_ERR, "Failed to send data");
             break;
         }
 
@@ -73,7 +481,7 @@ int32_t danp_transaction(
         {
             // No response expected
             ret = 0;
-            LOG_DBG("No response expected, transaction complete");
+            danp_log_message(DANP_LOG_LEVEL_DBG, "No response expected, transaction complete");
             break;
         }
 
@@ -81,13 +489,13 @@ int32_t danp_transaction(
         if (recv_len < 0)
         {
             ret = -4; // Receive failed
-            LOG_ERR("Failed to receive data");
+            danp_log_message(DANP_LOG_LEVEL_ERR, "Failed to receive data");
             break;
         }
 
         ret = (size_t)recv_len; // Actual bytes received
 
-        LOG_DBG("Transaction completed successfully, received %d bytes", recv_len);
+        danp_log_message(DANP_LOG_LEVEL_DBG, "Transaction completed successfully, received %d bytes", recv_len);
 
         break;
     }
@@ -97,6 +505,343 @@ int32_t danp_transaction(
         danp_close(sock);
     }
 
+    danp_trace(DANP_TRACE_TXN_END, dest_id, (uint32_t)ret);
+
     return ret;
 }
 
+/**
+ * @brief Microseconds elapsed since a cycle counter sample.
+ * @param start_cycles Sample taken with danp_port_cycles.
+ * @return Elapsed time, saturated to 32 bits.
+ */
+static uint32_t danp_map_elapsed_us(uint32_t start_cycles)
+{
+    uint64_t us = danp_port_cycles_to_ns(danp_port_cycles() - start_cycles) / 1000U;
+
+    return (us > UINT32_MAX) ? UINT32_MAX : (uint32_t)us;
+}
+
+/**
+ * @brief Fill the header of a probe datagram.
+ *
+ * The DGRAM echo answers to the node and port in the first bytes, the
+ * index tells the answers of the nodes sharing the reply port apart.
+ *
+ * @param probe Probe sending the datagram.
+ * @param config Probe parameters with the reply port resolved.
+ * @param kind DANP_MAP_KIND_PING or DANP_MAP_KIND_BULK.
+ * @param packet Buffer of at least DANP_MAP_PING_SIZE bytes.
+ */
+static void danp_map_build(
+    const danp_map_probe_t *probe,
+    const danp_map_config_t *config,
+    uint8_t kind,
+    uint8_t *packet)
+{
+    packet[0] = (uint8_t)(config->local_node);
+    packet[1] = (uint8_t)(config->local_node >> 8);
+    packet[2] = (uint8_t)(config->reply_port);
+    packet[3] = (uint8_t)(config->reply_port >> 8);
+    packet[4] = DANP_MAP_MAGIC;
+    packet[5] = kind;
+    packet[6] = (uint8_t)(probe->sequence);
+    packet[7] = (uint8_t)(probe->sequence >> 8);
+    packet[8] = (uint8_t)(probe->index);
+    packet[9] = (uint8_t)(probe->index >> 8);
+}
+
+/**
+ * @brief Send the next ping of a probe.
+ * @param probe Probe to advance.
+ * @param config Probe parameters with the reply port resolved.
+ * @param now_ms Current uptime.
+ */
+static void danp_map_send_ping(danp_map_probe_t *probe, const danp_map_config_t *config, uint32_t now_ms)
+{
+    uint8_t ping[DANP_MAP_PING_SIZE];
+
+    probe->sequence++;
+    danp_map_build(probe, config, DANP_MAP_KIND_PING, ping);
+
+    probe->sent_ms = now_ms;
+    probe->sent_cycles = danp_port_cycles();
+    probe->result->sent++;
+    probe->outstanding = (danp_send(probe->socket, ping, sizeof(ping)) == sizeof(ping));
+}
+
+/**
+ * @brief Send the throughput burst of a probe.
+ * @param probe Probe to advance.
+ * @param config Probe parameters with the reply port resolved.
+ * @param now_ms Current uptime.
+ */
+static void danp_map_send_burst(danp_map_probe_t *probe, const danp_map_config_t *config, uint32_t now_ms)
+{
+    uint8_t packet[DANP_MAX_PACKET_SIZE];
+
+    memset(packet, 0, sizeof(packet));
+    danp_map_build(probe, config, DANP_MAP_KIND_BULK, packet);
+
+    probe->sent_ms = now_ms;
+    probe->sent_cycles = danp_port_cycles();
+    for (probe->burst_sent = 0; probe->burst_sent < config->burst; probe->burst_sent++)
+    {
+        if (danp_send(probe->socket, packet, sizeof(packet)) < 0)
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Match one echo to the probe named by its index.
+ * @param probes Probes of the batch.
+ * @param first Index of the first probe of the batch.
+ * @param batch_count Probes in the batch.
+ * @param packet Echoed datagram.
+ * @param length Datagram length.
+ */
+static void danp_map_match(
+    danp_map_probe_t *probes,
+    size_t first,
+    size_t batch_count,
+    const uint8_t *packet,
+    int32_t length)
+{
+    danp_map_probe_t *probe;
+    danp_map_result_t *result;
+    uint16_t index;
+    uint32_t rtt_us;
+
+    if (length < DANP_MAP_PING_SIZE || packet[4] != DANP_MAP_MAGIC)
+    {
+        return;
+    }
+
+    /* Echoes of an earlier batch fall outside this one */
+    index = (uint16_t)(packet[8] | (packet[9] << 8));
+    if (index < first || index - first >= batch_count)
+    {
+        return;
+    }
+    probe = &probes[index - first];
+    result = probe->result;
+
+    if (packet[5] == DANP_MAP_KIND_PING && probe->state == DANP_MAP_STATE_PING && probe->outstanding &&
+        (uint16_t)(packet[6] | (packet[7] << 8)) == probe->sequence)
+    {
+        rtt_us = danp_map_elapsed_us(probe->sent_cycles);
+        if (result->received == 0 || rtt_us < result->rtt_min_us)
+        {
+            result->rtt_min_us = rtt_us;
+        }
+        if (rtt_us > result->rtt_max_us)
+        {
+            result->rtt_max_us = rtt_us;
+        }
+        probe->rtt_total_us += rtt_us;
+        result->received++;
+        probe->outstanding = false;
+    }
+    else if (packet[5] == DANP_MAP_KIND_BULK && probe->state == DANP_MAP_STATE_BURST)
+    {
+        probe->burst_received++;
+        if (probe->burst_received == probe->burst_sent)
+        {
+            rtt_us = danp_map_elapsed_us(probe->sent_cycles);
+            result->throughput_bps = (uint32_t)(((uint64_t)probe->burst_received * DANP_MAX_PACKET_SIZE *
+                                                 1000000U) / ((rtt_us > 0) ? rtt_us : 1U));
+            probe->state = DANP_MAP_STATE_DONE;
+        }
+    }
+}
+
+/**
+ * @brief Advance a probe once its echoes have been matched.
+ * @param probe Probe to advance.
+ * @param config Probe parameters with the reply port resolved.
+ * @param now_ms Current uptime.
+ * @return true if anything was sent or the probe finished.
+ */
+static bool danp_map_advance(danp_map_probe_t *probe, const danp_map_config_t *config, uint32_t now_ms)
+{
+    danp_map_result_t *result = probe->result;
+    bool progress = false;
+
+    if (probe->state == DANP_MAP_STATE_PING)
+    {
+        if (probe->outstanding && (now_ms - probe->sent_ms) >= config->timeout_ms)
+        {
+            /* Lost, a late echo no longer matches the sequence */
+            probe->outstanding = false;
+        }
+
+        if (!probe->outstanding)
+        {
+            if (result->sent < config->pings)
+            {
+                danp_map_send_ping(probe, config, now_ms);
+            }
+            else if (result->received > 0 && config->burst > 0)
+            {
+                probe->state = DANP_MAP_STATE_BURST;
+                danp_map_send_burst(probe, config, now_ms);
+                if (probe->burst_sent == 0)
+                {
+                    probe->state = DANP_MAP_STATE_DONE;
+                }
+            }
+            else
+            {
+                probe->state = DANP_MAP_STATE_DONE;
+            }
+            progress = true;
+        }
+    }
+    else if (probe->state == DANP_MAP_STATE_BURST && (now_ms - probe->sent_ms) >= config->timeout_ms)
+    {
+        /* Part of the burst was lost, no rate is better than a wrong one */
+        probe->state = DANP_MAP_STATE_DONE;
+        progress = true;
+    }
+
+    return progress;
+}
+
+int32_t danp_map(
+    const uint16_t *nodes,
+    size_t node_count,
+    const danp_map_config_t *config,
+    danp_map_result_t *results)
+{
+    danp_map_probe_t probes[DANP_MAP_BATCH];
+    danp_map_probe_t *probe;
+    danp_map_config_t probe_config;
+    danp_socket_t *reply_socket = NULL;
+    uint8_t packet[DANP_MAX_PACKET_SIZE];
+    int32_t length;
+    size_t batch_count;
+    uint32_t live;
+    uint32_t now_ms;
+    bool progress;
+    int32_t reachable = 0;
+
+    if (!nodes || !config || !results || config->pings == 0 || node_count > UINT16_MAX)
+    {
+        return -1;
+    }
+
+    probe_config = *config;
+    if (probe_config.reply_port == 0)
+    {
+        probe_config.reply_port = DANP_MAP_REPLY_PORT;
+    }
+
+    /* Every echo of every node comes back to this one socket */
+    reply_socket = danp_socket(DANP_TYPE_DGRAM);
+    if (!reply_socket || danp_bind(reply_socket, probe_config.reply_port) < 0)
+    {
+        danp_log_message(DANP_LOG_LEVEL_ERR, "Map failed to bind reply port %u", probe_config.reply_port);
+        if (reply_socket)
+        {
+            danp_close(reply_socket);
+        }
+        return -1;
+    }
+
+    memset(results, 0, node_count * sizeof(danp_map_result_t));
+
+    for (size_t first = 0; first < node_count; first += batch_count)
+    {
+        batch_count = node_count - first;
+        if (batch_count > DANP_MAP_BATCH)
+        {
+            batch_count = DANP_MAP_BATCH;
+        }
+
+        memset(probes, 0, sizeof(probes));
+        for (size_t i = 0; i < batch_count; i++)
+        {
+            probe = &probes[i];
+            probe->result = &results[first + i];
+            probe->result->node = nodes[first + i];
+            probe->index = (uint16_t)(first + i);
+            probe->state = DANP_MAP_STATE_DONE;
+
+            /* A DGRAM connect only sets the destination, dead nodes cost no handshake */
+            probe->socket = danp_socket(DANP_TYPE_DGRAM);
+            if (!probe->socket)
+            {
+                danp_log_message(DANP_LOG_LEVEL_ERR, "Map failed to create socket");
+                continue;
+            }
+
+            if (danp_connect(probe->socket, nodes[first + i], probe_config.port) != 0)
+            {
+                danp_log_message(DANP_LOG_LEVEL_DBG, "Map: node %u has no route", nodes[first + i]);
+                continue;
+            }
+
+            probe->state = DANP_MAP_STATE_PING;
+        }
+
+        for (;;)
+        {
+            progress = false;
+
+            for (;;)
+            {
+                length = danp_recv(reply_socket, packet, sizeof(packet), 0);
+                if (length <= 0)
+                {
+                    break;
+                }
+                danp_map_match(probes, first, batch_count, packet, length);
+                progress = true;
+            }
+
+            now_ms = danp_port_uptime_ms();
+            live = 0;
+
+            for (size_t i = 0; i < batch_count; i++)
+            {
+                if (probes[i].state != DANP_MAP_STATE_DONE)
+                {
+                    progress |= danp_map_advance(&probes[i], &probe_config, now_ms);
+                    live += (probes[i].state != DANP_MAP_STATE_DONE) ? 1U : 0U;
+                }
+            }
+
+            if (live == 0)
+            {
+                break;
+            }
+
+            if (!progress)
+            {
+                danp_port_sleep_ms(DANP_MAP_POLL_MS);
+            }
+        }
+
+        for (size_t i = 0; i < batch_count; i++)
+        {
+            probe = &probes[i];
+            if (probe->socket)
+            {
+                danp_close(probe->socket);
+            }
+
+            if (probe->result->received > 0)
+            {
+                probe->result->reachable = true;
+                probe->result->rtt_avg_us = (uint32_t)(probe->rtt_total_us / probe->result->received);
+                reachable++;
+            }
+        }
+    }
+
+    danp_close(reply_socket);
+
+    return reachable;
+}
@@ -0,0 +1,544 @@
+/* danp_bench_service.c - Echo, discard and chargen services over DANP */
+
+/* All Rights Reserved */
+
+/* Includes */
+
+#include "osal/osal_thread.h"
+#include "osal/osal_memory.h"
+#include "danp/services/danp_bench_service.h"
+#include "danp/danp.h"
+#include "danp_debug.h"
+#include "danp_port.h"
+#include <string.h>
+
+/* Imports */
+
+
+/* Definitions */
+
+#if defined(CONFIG_DANP_BENCH_ECHO_PORT)
+#define DANP_BENCH_ECHO_PORT                  (CONFIG_DANP_BENCH_ECHO_PORT)
+#define DANP_BENCH_DISCARD_PORT               (CONFIG_DANP_BENCH_DISCARD_PORT)
+#define DANP_BENCH_CHARGEN_PORT               (CONFIG_DANP_BENCH_CHARGEN_PORT)
+#else
+#define DANP_BENCH_ECHO_PORT                  (7)
+#define DANP_BENCH_DISCARD_PORT               (9)
+#define DANP_BENCH_CHARGEN_PORT               (19)
+#endif
+
+#if defined(CONFIG_DANP_BENCH_SERVICE_MAX_CLIENTS)
+#define DANP_BENCH_SERVICE_MAX_CLIENTS        (CONFIG_DANP_BENCH_SERVICE_MAX_CLIENTS)
+#define DANP_BENCH_SERVICE_STACK_SIZE         (CONFIG_DANP_BENCH_SERVICE_STACK_SIZE)
+#define DANP_BENCH_SERVICE_IDLE_MS            (CONFIG_DANP_BENCH_SERVICE_IDLE_MS)
+#else
+#define DANP_BENCH_SERVICE_MAX_CLIENTS        (4)
+#define DANP_BENCH_SERVICE_STACK_SIZE         (1024 * 2)
+#define DANP_BENCH_SERVICE_IDLE_MS            (10000)
+#endif
+
+#define DANP_BENCH_SERVICE_BACKLOG            (4)
+/* Accept wait per listener, one thread round-robins all of them */
+#define DANP_BENCH_SERVICE_ACCEPT_MS          (20)
+#define DANP_BENCH_DGRAM_WAIT_MS              (1000)
+
+/* Chargen cycles through the printable ASCII range */
+#define DANP_BENCH_CHARGEN_FIRST              (' ')
+#define DANP_BENCH_CHARGEN_PERIOD             (95)
+
+/* Types */
+
+typedef struct danp_bench_listener_s
+{
+    danp_bench_service_kind_t kind;
+    danp_socket_t *socket;
+    danp_bench_service_stats_t stats;
+} danp_bench_listener_t;
+
+typedef struct danp_bench_client_s
+{
+    danp_bench_listener_t *listener;
+    danp_socket_t *socket;
+} danp_bench_client_t;
+
+typedef struct danp_bench_service_context_s
+{
+    bool is_initialized;
+    danp_port_mutex_t lock;
+    uint32_t client_count;
+    danp_bench_listener_t listeners[DANP_BENCH_SERVICE_COUNT];
+    osal_thread_handle_t service_thread;
+    danp_socket_t *dgram_socket;                 /* DGRAM echo, bound to the echo port */
+    danp_socket_t *dgram_reply;                  /* Re-aimed at each requester */
+    osal_thread_handle_t dgram_thread;
+} danp_bench_service_context_t;
+
+/* Forward Declarations */
+
+static void danp_bench_service_thread(void *arg);
+static void danp_bench_client_thread(void *arg);
+static void danp_bench_dgram_thread(void *arg);
+
+/* Variables */
+
+static danp_bench_service_context_t bench_service_ctx;
+
+static const char *const bench_service_names[DANP_BENCH_SERVICE_COUNT] = {
+    "echo", "discard", "chargen",
+};
+
+/* One period plus a full packet, so any offset can be sent without wrapping */
+static uint8_t bench_chargen_pattern[DANP_BENCH_CHARGEN_PERIOD + DANP_MAX_PACKET_SIZE];
+
+/* Functions */
+
+/**
+ * @brief Send every received packet back from the receive buffer.
+ * @param socket Connected socket.
+ * @param rx_bytes Pointer to accumulate received bytes.
+ * @param tx_bytes Pointer to accumulate sent bytes.
+ */
+static void danp_bench_serve_echo(danp_socket_t *socket, uint64_t *rx_bytes, uint64_t *tx_bytes)
+{
+    uint8_t buffer[DANP_MAX_PACKET_SIZE];
+    int32_t length;
+
+    for (;;)
+    {
+        length = danp_recv(socket, buffer, sizeof(buffer), DANP_BENCH_SERVICE_IDLE_MS);
+        if (length <= 0)
+        {
+            break;
+        }
+        *rx_bytes += (uint64_t)length;
+
+        if (danp_send(socket, buffer, (uint16_t)length) < 0)
+        {
+            break;
+        }
+        *tx_bytes += (uint64_t)length;
+    }
+}
+
+/**
+ * @brief Receive and drop packets until the peer closes or goes idle.
+ * @param socket Connected socket.
+ * @param rx_bytes Pointer to accumulate received bytes.
+ */
+static void danp_bench_serve_discard(danp_socket_t *socket, uint64_t *rx_bytes)
+{
+    uint8_t buffer[DANP_MAX_PACKET_SIZE];
+    int32_t length;
+
+    for (;;)
+    {
+        length = danp_recv(socket, buffer, sizeof(buffer), DANP_BENCH_SERVICE_IDLE_MS);
+        if (length <= 0)
+        {
+            break;
+        }
+        *rx_bytes += (uint64_t)length;
+    }
+}
+
+/**
+ * @brief Send full packets straight out of the pattern table until the peer closes.
+ * @param socket Connected socket.
+ * @param tx_bytes Pointer to accumulate sent bytes.
+ */
+static void danp_bench_serve_chargen(danp_socket_t *socket, uint64_t *tx_bytes)
+{
+    uint32_t offset = 0;
+
+    while (danp_send(socket, &bench_chargen_pattern[offset], DANP_MAX_PACKET_SIZE) >= 0)
+    {
+        *tx_bytes += DANP_MAX_PACKET_SIZE;
+        offset = (offset + DANP_MAX_PACKET_SIZE) % DANP_BENCH_CHARGEN_PERIOD;
+    }
+}
+
+/**
+ * @brief Answer echo datagrams to the node and port they name.
+ * @param arg Pointer to the service context.
+ */
+static void danp_bench_dgram_thread(void *arg)
+{
+    danp_bench_service_context_t *svc = (danp_bench_service_context_t *)arg;
+    uint8_t buffer[DANP_MAX_PACKET_SIZE];
+    int32_t length;
+    uint16_t node;
+    uint16_t port;
+
+    for (;;)
+    {
+        length = danp_recv(svc->dgram_socket, buffer, sizeof(buffer), DANP_BENCH_DGRAM_WAIT_MS);
+        if (length <= DANP_BENCH_DGRAM_ECHO_HEADER_SIZE ||
+            buffer[DANP_BENCH_DGRAM_ECHO_HEADER_SIZE] != DANP_BENCH_DGRAM_ECHO_MAGIC)
+        {
+            continue;
+        }
+
+        node = (uint16_t)(buffer[0] | (buffer[1] << 8));
+        port = (uint16_t)(buffer[2] | (buffer[3] << 8));
+
+        if (danp_connect(svc->dgram_reply, node, port) == 0 &&
+            danp_send(svc->dgram_reply, buffer, (uint16_t)length) >= 0)
+        {
+            danp_port_mutex_lock(&svc->lock);
+            svc->listeners[DANP_BENCH_SERVICE_ECHO].stats.datagrams++;
+            danp_port_mutex_unlock(&svc->lock);
+        }
+    }
+}
+
+/**
+ * @brief Open the DGRAM side of the echo service.
+ * @param svc Pointer to the service context.
+ * @param port Echo port.
+ * @param thread_attr Attributes of the echo thread.
+ * @return 0 on success, negative on error.
+ */
+static int32_t danp_bench_service_dgram_open(
+    danp_bench_service_context_t *svc,
+    uint16_t port,
+    osal_thread_attr_t *thread_attr)
+{
+    svc->dgram_socket = danp_socket(DANP_TYPE_DGRAM);
+    svc->dgram_reply = danp_socket(DANP_TYPE_DGRAM);
+    if (!svc->dgram_socket || !svc->dgram_reply || danp_bind(svc->dgram_socket, port) < 0)
+    {
+        danp_log_message(DANP_LOG_LEVEL_ERR, "Bench echo failed to bind DGRAM port %u", port);
+        return -1;
+    }
+
+    thread_attr->name = "benchDgram";
+    svc->dgram_thread = osal_thread_create(danp_bench_dgram_thread, svc, thread_attr);
+    if (!svc->dgram_thread)
+    {
+        danp_log_message(DANP_LOG_LEVEL_ERR, "Bench echo failed to create DGRAM thread");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Connection handler thread.
+ * @param arg Pointer to the client context, freed on exit.
+ */
+static void danp_bench_client_thread(void *arg)
+{
+    danp_bench_client_t *client = (danp_bench_client_t *)arg;
+    danp_bench_listener_t *listener = client->listener;
+    uint64_t rx_bytes = 0;
+    uint64_t tx_bytes = 0;
+
+    switch (listener->kind)
+    {
+    case DANP_BENCH_SERVICE_ECHO:
+        danp_bench_serve_echo(client->socket, &rx_bytes, &tx_bytes);
+        break;
+    case DANP_BENCH_SERVICE_DISCARD:
+        danp_bench_serve_discard(client->socket, &rx_bytes);
+        break;
+    case DANP_BENCH_SERVICE_CHARGEN:
+        danp_bench_serve_chargen(client->socket, &tx_bytes);
+        break;
+    default:
+        break;
+    }
+
+    danp_close(client->socket);
+
+    /* Counters are folded in once per connection to keep the data path lock free */
+    danp_port_mutex_lock(&bench_service_ctx.lock);
+    listener->stats.active--;
+    listener->stats.rx_bytes += rx_bytes;
+    listener->stats.tx_bytes += tx_bytes;
+    bench_service_ctx.client_count--;
+    danp_port_mutex_unlock(&bench_service_ctx.lock);
+
+    danp_log_message(
+        DANP_LOG_LEVEL_DBG,
+        "Bench %s connection closed: rx=%llu tx=%llu",
+        bench_service_names[listener->kind],
+        (unsigned long long)rx_bytes,
+        (unsigned long long)tx_bytes);
+
+    osal_memory_free(client);
+}
+
+/**
+ * @brief Hand an accepted connection to a new handler thread.
+ * @param listener Listener the connection arrived on.
+ * @param socket Accepted socket.
+ */
+static void danp_bench_service_dispatch(danp_bench_listener_t *listener, danp_socket_t *socket)
+{
+    danp_bench_client_t *client = NULL;
+    osal_thread_handle_t thread = NULL;
+    osal_thread_attr_t thread_attr = {
+        .name = "benchClient",
+        .stack_size = DANP_BENCH_SERVICE_STACK_SIZE,
+        .stack_mem = NULL,
+        .priority = OSAL_THREAD_PRIORITY_NORMAL,
+        .cb_mem = NULL,
+        .cb_size = 0,
+    };
+
+    for (;;)
+    {
+        danp_port_mutex_lock(&bench_service_ctx.lock);
+        listener->stats.connections++;
+        if (bench_service_ctx.client_count >= DANP_BENCH_SERVICE_MAX_CLIENTS)
+        {
+            listener->stats.rejected++;
+            danp_port_mutex_unlock(&bench_service_ctx.lock);
+            break;
+        }
+        bench_service_ctx.client_count++;
+        listener->stats.active++;
+        danp_port_mutex_unlock(&bench_service_ctx.lock);
+
+        client = (danp_bench_client_t *)osal_memory_alloc(sizeof(danp_bench_client_t));
+        if (client)
+        {
+            client->listener = listener;
+            client->socket = socket;
+            thread = osal_thread_create(danp_bench_client_thread, client, &thread_attr);
+        }
+
+        if (!thread)
+        {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "Bench service failed to start a handler");
+            osal_memory_free(client);
+            danp_port_mutex_lock(&bench_service_ctx.lock);
+            bench_service_ctx.client_count--;
+            listener->stats.active--;
+            listener->stats.rejected++;
+            danp_port_mutex_unlock(&bench_service_ctx.lock);
+            break;
+        }
+
+        return;
+    }
+
+    danp_close(socket);
+}
+
+/**
+ * @brief Accept connections on every enabled listener.
+ * @param arg Pointer to the service context.
+ */
+static void danp_bench_service_thread(void *arg)
+{
+    danp_bench_service_context_t *svc = (danp_bench_service_context_t *)arg;
+    danp_bench_listener_t *listener;
+    danp_socket_t *socket;
+    uint32_t enabled = 0;
+
+    for (uint32_t i = 0; i < DANP_BENCH_SERVICE_COUNT; i++)
+    {
+        enabled += svc->listeners[i].socket ? 1U : 0U;
+    }
+
+    for (;;)
+    {
+        for (uint32_t i = 0; i < DANP_BENCH_SERVICE_COUNT; i++)
+        {
+            listener = &svc->listeners[i];
+            if (!listener->socket)
+            {
+                continue;
+            }
+
+            /* A single listener can block as long as the FTP service does */
+            socket = danp_accept(listener->socket, (enabled == 1) ? 1000 : DANP_BENCH_SERVICE_ACCEPT_MS);
+            if (socket)
+            {
+                danp_bench_service_dispatch(listener, socket);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Open and bind the listening socket of one service.
+ * @param listener Listener to set up.
+ * @param port Port to bind, 0 leaves the service disabled.
+ * @return 0 on success, negative on error.
+ */
+static int32_t danp_bench_service_listen(danp_bench_listener_t *listener, uint16_t port)
+{
+    danp_socket_t *sock;
+
+    if (port == 0)
+    {
+        return 0;
+    }
+
+    sock = danp_socket(DANP_TYPE_STREAM);
+    if (!sock)
+    {
+        danp_log_message(DANP_LOG_LEVEL_ERR, "Bench %s failed to create socket", bench_service_names[listener->kind]);
+        return -1;
+    }
+
+    if (danp_bind(sock, port) < 0)
+    {
+        danp_log_message(
+            DANP_LOG_LEVEL_ERR,
+            "Bench %s failed to bind to port %u",
+            bench_service_names[listener->kind],
+            port);
+        danp_close(sock);
+        return -1;
+    }
+
+    danp_listen(sock, DANP_BENCH_SERVICE_BACKLOG);
+
+    listener->socket = sock;
+    listener->stats.port = port;
+
+    return 0;
+}
+
+/**
+ * @brief Start the echo, discard and chargen services on STREAM sockets.
+ * @param config Ports to listen on, NULL for the Kconfig defaults.
+ * @return 0 on success, negative on error.
+ */
+int32_t danp_bench_service_init(const danp_bench_service_config_t *config)
+{
+    int32_t ret = 0;
+    danp_bench_service_config_t defaults = {
+        .echo_port = DANP_BENCH_ECHO_PORT,
+        .discard_port = DANP_BENCH_DISCARD_PORT,
+        .chargen_port = DANP_BENCH_CHARGEN_PORT,
+    };
+    osal_thread_attr_t thread_attr = {
+        .name = "benchService",
+        .stack_size = DANP_BENCH_SERVICE_STACK_SIZE,
+        .stack_mem = NULL,
+        .priority = OSAL_THREAD_PRIORITY_NORMAL,
+        .cb_mem = NULL,
+        .cb_size = 0,
+    };
+
+    for (;;)
+    {
+        if (bench_service_ctx.is_initialized)
+        {
+            danp_log_message(DANP_LOG_LEVEL_WRN, "Bench service already initialized");
+            ret = -1;
+            break;
+        }
+
+        if (!config)
+        {
+            config = &defaults;
+        }
+
+        memset(&bench_service_ctx, 0, sizeof(danp_bench_service_context_t));
+        danp_port_mutex_init(&bench_service_ctx.lock);
+
+        for (uint32_t i = 0; i < sizeof(bench_chargen_pattern); i++)
+        {
+            bench_chargen_pattern[i] = (uint8_t)(DANP_BENCH_CHARGEN_FIRST + (i % DANP_BENCH_CHARGEN_PERIOD));
+        }
+
+        for (uint32_t i = 0; i < DANP_BENCH_SERVICE_COUNT; i++)
+        {
+            bench_service_ctx.listeners[i].kind = (danp_bench_service_kind_t)i;
+        }
+
+        if (danp_bench_service_listen(&bench_service_ctx.listeners[DANP_BENCH_SERVICE_ECHO], config->echo_port) < 0 ||
+            danp_bench_service_listen(&bench_service_ctx.listeners[DANP_BENCH_SERVICE_DISCARD], config->discard_port) < 0 ||
+            danp_bench_service_listen(&bench_service_ctx.listeners[DANP_BENCH_SERVICE_CHARGEN], config->chargen_port) < 0)
+        {
+            ret = -1;
+        }
+        else if (!config->echo_port && !config->discard_port && !config->chargen_port)
+        {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "Bench service has no port enabled");
+            ret = -1;
+        }
+        else if (config->echo_port && danp_bench_service_dgram_open(&bench_service_ctx, config->echo_port, &thread_attr) < 0)
+        {
+            ret = -1;
+        }
+        else
+        {
+            thread_attr.name = "benchService";
+            bench_service_ctx.service_thread = osal_thread_create(
+                danp_bench_service_thread,
+                &bench_service_ctx,
+                &thread_attr);
+            if (!bench_service_ctx.service_thread)
+            {
+                danp_log_message(DANP_LOG_LEVEL_ERR, "Bench service failed to create service thread");
+                ret = -1;
+            }
+        }
+
+        if (ret < 0)
+        {
+            for (uint32_t i = 0; i < DANP_BENCH_SERVICE_COUNT; i++)
+            {
+                if (bench_service_ctx.listeners[i].socket)
+                {
+                    danp_close(bench_service_ctx.listeners[i].socket);
+                    bench_service_ctx.listeners[i].socket = NULL;
+                }
+            }
+            /* A started DGRAM thread keeps its sockets, it cannot be stopped */
+            if (!bench_service_ctx.dgram_thread)
+            {
+                if (bench_service_ctx.dgram_socket)
+                {
+                    danp_close(bench_service_ctx.dgram_socket);
+                }
+                if (bench_service_ctx.dgram_reply)
+                {
+                    danp_close(bench_service_ctx.dgram_reply);
+                }
+            }
+            break;
+        }
+
+        bench_service_ctx.is_initialized = true;
+
+        danp_log_message(
+            DANP_LOG_LEVEL_INF,
+            "Bench services initialized: echo=%u discard=%u chargen=%u",
+            config->echo_port,
+            config->discard_port,
+            config->chargen_port);
+
+        break;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Get the counters of one service.
+ * @param kind Service to query.
+ * @param stats Pointer to store the counters.
+ * @return 0 on success, negative on error.
+ */
+int32_t danp_bench_service_get_stats(
+    danp_bench_service_kind_t kind,
+    danp_bench_service_stats_t *stats)
+{
+    if (!stats || kind >= DANP_BENCH_SERVICE_COUNT || !bench_service_ctx.is_initialized)
+    {
+        return -1;
+    }
+
+    danp_port_mutex_lock(&bench_service_ctx.lock);
+    *stats = bench_service_ctx.listeners[kind].stats;
+    danp_port_mutex_unlock(&bench_service_ctx.lock);
+
+    return 0;
+}
@@ -0,0 +1,759 @@
+/* danp_ftp_mcast.c - One-to-many file distribution over DGRAM with NACK repair */
+
+/* All Rights Reserved */
+
+/* Includes */
+
+#include "osal/osal_memory.h"
+#include "danp/services/danp_ftp_mcast.h"
+#include "danp/danp.h"
+#include "danp_debug.h"
+#include "danp_port.h"
+#include "services/danp_ftp_service_int.h"
+#include <string.h>
+
+/* Imports */
+
+
+/* Definitions */
+
+#if defined(CONFIG_DANP_FTP_MCAST_DATA_PORT)
+#define DANP_FTP_MCAST_DATA_PORT              (CONFIG_DANP_FTP_MCAST_DATA_PORT)
+#define DANP_FTP_MCAST_NACK_PORT              (CONFIG_DANP_FTP_MCAST_NACK_PORT)
+#define DANP_FTP_MCAST_ROUND_MS               (CONFIG_DANP_FTP_MCAST_ROUND_MS)
+#define DANP_FTP_MCAST_MAX_ROUNDS             (CONFIG_DANP_FTP_MCAST_MAX_ROUNDS)
+#define DANP_FTP_MCAST_MAX_RECEIVERS          (CONFIG_DANP_FTP_MCAST_MAX_RECEIVERS)
+#else
+#define DANP_FTP_MCAST_DATA_PORT              (24)
+#define DANP_FTP_MCAST_NACK_PORT              (25)
+#define DANP_FTP_MCAST_ROUND_MS               (200)
+#define DANP_FTP_MCAST_MAX_ROUNDS             (16)
+#define DANP_FTP_MCAST_MAX_RECEIVERS          (32)
+#endif
+
+#define DANP_FTP_MCAST_TYPE_ANNOUNCE          (0x01)
+#define DANP_FTP_MCAST_TYPE_DATA              (0x02)
+#define DANP_FTP_MCAST_TYPE_POLL              (0x03)
+#define DANP_FTP_MCAST_TYPE_NACK              (0x04)
+#define DANP_FTP_MCAST_TYPE_DONE              (0x05)
+#define DANP_FTP_MCAST_TYPE_END               (0x06)
+
+/* type(1) + reserved(1) + session(2) + index(4) + crc32(4) */
+#define DANP_FTP_MCAST_HEADER_SIZE            (12)
+#define DANP_FTP_MCAST_CHUNK_SIZE             (DANP_MAX_PACKET_SIZE - DANP_FTP_MCAST_HEADER_SIZE)
+/* ANNOUNCE: size(4) + chunk count(4) + sender node(2) + NACK port(2) */
+#define DANP_FTP_MCAST_ANNOUNCE_SIZE          (12)
+/* NACK: node(2) + bitmap of missing chunks starting at the header index */
+#define DANP_FTP_MCAST_NODE_SIZE              (2)
+#define DANP_FTP_MCAST_NACK_BITMAP_SIZE       (DANP_FTP_MCAST_CHUNK_SIZE - DANP_FTP_MCAST_NODE_SIZE)
+/* NACK packets a receiver sends per poll, later gaps wait for the next round */
+#define DANP_FTP_MCAST_NACKS_PER_POLL         (4)
+
+/* Types */
+
+typedef struct danp_ftp_mcast_header_s
+{
+    uint8_t type;                                /* DANP_FTP_MCAST_TYPE_* */
+    uint8_t reserved;
+    uint16_t session_id;                         /* Transfer the packet belongs to */
+    uint32_t index;                              /* Chunk, round for POLL, first chunk of a NACK bitmap */
+    uint32_t crc;                                /* CRC32 of the payload */
+} danp_ftp_mcast_header_t;
+
+typedef struct danp_ftp_mcast_packet_s
+{
+    danp_ftp_mcast_header_t header;
+    uint8_t payload[DANP_FTP_MCAST_CHUNK_SIZE];
+} danp_ftp_mcast_packet_t;
+
+/* Forward Declarations */
+
+
+/* Variables */
+
+
+/* Functions */
+
+static inline bool danp_ftp_mcast_bit_test(const uint8_t *bitmap, uint32_t bit)
+{
+    return (bitmap[bit >> 3] & (1U << (bit & 7U))) != 0;
+}
+
+static inline void danp_ftp_mcast_bit_set(uint8_t *bitmap, uint32_t bit)
+{
+    bitmap[bit >> 3] |= (uint8_t)(1U << (bit & 7U));
+}
+
+static inline void danp_ftp_mcast_bit_clear(uint8_t *bitmap, uint32_t bit)
+{
+    bitmap[bit >> 3] &= (uint8_t)~(1U << (bit & 7U));
+}
+
+/**
+ * @brief Length of one chunk of the file.
+ * @param size Size of the file.
+ * @param index Chunk index.
+ * @return Chunk length in bytes.
+ */
+static uint16_t danp_ftp_mcast_chunk_length(size_t size, uint32_t index)
+{
+    size_t offset = (size_t)index * DANP_FTP_MCAST_CHUNK_SIZE;
+
+    if (offset >= size)
+    {
+        return 0;
+    }
+
+    return (uint16_t)((size - offset < DANP_FTP_MCAST_CHUNK_SIZE) ? size - offset : DANP_FTP_MCAST_CHUNK_SIZE);
+}
+
+/**
+ * @brief Send one group protocol packet.
+ * @param socket Connected DGRAM socket.
+ * @param type Packet type.
+ * @param session_id Transfer id.
+ * @param index Chunk index, round or bitmap base.
+ * @param payload Pointer to the payload data.
+ * @param payload_length Length of the payload.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_mcast_send_packet(
+    danp_socket_t *socket,
+    uint8_t type,
+    uint16_t session_id,
+    uint32_t index,
+    const uint8_t *payload,
+    uint16_t payload_length)
+{
+    danp_ftp_mcast_packet_t packet;
+
+    if (payload_length > DANP_FTP_MCAST_CHUNK_SIZE)
+    {
+        return DANP_FTP_STATUS_INVALID_PARAM;
+    }
+
+    packet.header.type = type;
+    packet.header.reserved = 0;
+    packet.header.session_id = session_id;
+    packet.header.index = index;
+
+    if (payload && payload_length > 0)
+    {
+        memcpy(packet.payload, payload, payload_length);
+    }
+
+    packet.header.crc = danp_ftp_service_crc32_update(
+        DANP_FTP_CRC32_INIT,
+        packet.payload,
+        payload_length) ^ DANP_FTP_CRC32_INIT;
+
+    if (danp_send(socket, &packet, (uint16_t)(DANP_FTP_MCAST_HEADER_SIZE + payload_length)) < 0)
+    {
+        danp_log_message(DANP_LOG_LEVEL_ERR, "FTP mcast send failed");
+        return DANP_FTP_STATUS_TRANSFER_FAILED;
+    }
+
+    return DANP_FTP_STATUS_OK;
+}
+
+/**
+ * @brief Receive one group protocol packet.
+ * @param socket Bound DGRAM socket.
+ * @param packet Pointer to store the packet.
+ * @param timeout_ms Timeout in milliseconds.
+ * @return Payload length, DANP_FTP_STATUS_TIMEOUT on timeout, DANP_FTP_STATUS_ERROR on a socket
+ *         error, other negative status on a bad packet.
+ */
+static danp_ftp_status_t danp_ftp_mcast_receive_packet(
+    danp_socket_t *socket,
+    danp_ftp_mcast_packet_t *packet,
+    uint32_t timeout_ms)
+{
+    int32_t recv_result;
+    uint16_t payload_length;
+
+    recv_result = danp_recv(socket, packet, sizeof(danp_ftp_mcast_packet_t), timeout_ms);
+    if (danp_port_recv_timed_out(recv_result))
+    {
+        return DANP_FTP_STATUS_TIMEOUT;
+    }
+
+    if (recv_result < 0)
+    {
+        danp_log_message(DANP_LOG_LEVEL_ERR, "FTP mcast receive failed: %d", recv_result);
+        return DANP_FTP_STATUS_ERROR;
+    }
+
+    if (recv_result < DANP_FTP_MCAST_HEADER_SIZE)
+    {
+        return DANP_FTP_STATUS_TRANSFER_FAILED;
+    }
+
+    payload_length = (uint16_t)(recv_result - DANP_FTP_MCAST_HEADER_SIZE);
+
+    if ((danp_ftp_service_crc32_update(DANP_FTP_CRC32_INIT, packet->payload, payload_length) ^
+         DANP_FTP_CRC32_INIT) != packet->header.crc)
+    {
+        danp_log_message(DANP_LOG_LEVEL_WRN, "FTP mcast CRC mismatch");
+        return DANP_FTP_STATUS_TRANSFER_FAILED;
+    }
+
+    return (danp_ftp_status_t)payload_length;
+}
+
+/**
+ * @brief Report the chunks still missing, one bitmap per gap region.
+ * @param socket DGRAM socket connected to the sender.
+ * @param local_node This node.
+ * @param session_id Transfer id.
+ * @param have Bitmap of chunks received.
+ * @param chunks Chunks in the file.
+ * @param stats Pointer to the receiver statistics.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_mcast_send_nacks(
+    danp_socket_t *socket,
+    uint16_t local_node,
+    uint16_t session_id,
+    const uint8_t *have,
+    uint32_t chunks,
+    danp_ftp_mcast_stats_t *stats)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    uint8_t payload[DANP_FTP_MCAST_CHUNK_SIZE];
+    uint32_t base = 0;
+    uint32_t span;
+
+    for (uint32_t n = 0; n < DANP_FTP_MCAST_NACKS_PER_POLL && status >= 0; n++)
+    {
+        while (base < chunks && danp_ftp_mcast_bit_test(have, base))
+        {
+            base++;
+        }
+
+        if (base >= chunks)
+        {
+            break;
+        }
+
+        span = chunks - base;
+        if (span > DANP_FTP_MCAST_NACK_BITMAP_SIZE * 8U)
+        {
+            span = DANP_FTP_MCAST_NACK_BITMAP_SIZE * 8U;
+        }
+
+        memset(payload, 0, sizeof(payload));
+        danp_ftp_service_put_u16(payload, local_node);
+        for (uint32_t i = 0; i < span; i++)
+        {
+            if (!danp_ftp_mcast_bit_test(have, base + i))
+            {
+                danp_ftp_mcast_bit_set(&payload[DANP_FTP_MCAST_NODE_SIZE], i);
+            }
+        }
+
+        status = danp_ftp_mcast_send_packet(
+            socket,
+            DANP_FTP_MCAST_TYPE_NACK,
+            session_id,
+            base,
+            payload,
+            (uint16_t)(DANP_FTP_MCAST_NODE_SIZE + (span + 7U) / 8U));
+
+        stats->nacks++;
+        base += span;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Distribute a file to a group of receivers.
+ * @param config Group, ports and round settings.
+ * @param size Size of the file.
+ * @param read_cb Callback reading the local file.
+ * @param user_data User data passed to read_cb.
+ * @param stats Optional pointer to store transfer statistics.
+ * @return Number of receivers that completed, negative status on error.
+ */
+danp_ftp_status_t danp_ftp_mcast_send(
+    const danp_ftp_mcast_config_t *config,
+    size_t size,
+    danp_ftp_service_client_read_cb_t read_cb,
+    void *user_data,
+    danp_ftp_mcast_stats_t *stats)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    danp_ftp_mcast_stats_t local_stats;
+    danp_ftp_mcast_packet_t packet;
+    danp_socket_t *group_socket = NULL;
+    danp_socket_t *nack_socket = NULL;
+    uint8_t *pending = NULL;
+    uint16_t done_nodes[DANP_FTP_MCAST_MAX_RECEIVERS];
+    uint32_t done_count = 0;
+    uint8_t announce[DANP_FTP_MCAST_ANNOUNCE_SIZE];
+    uint16_t data_port;
+    uint16_t nack_port;
+    uint32_t round_ms;
+    uint32_t max_rounds;
+    uint32_t chunks;
+    uint32_t start_ms;
+    uint32_t elapsed_ms;
+    uint32_t base;
+    uint32_t bits;
+    uint16_t node;
+    uint16_t length;
+    danp_ftp_status_t result;
+    bool nacked;
+    bool known;
+
+    if (!stats)
+    {
+        stats = &local_stats;
+    }
+    memset(stats, 0, sizeof(danp_ftp_mcast_stats_t));
+
+    for (;;)
+    {
+        if (!config || !read_cb || size > UINT32_MAX)
+        {
+            status = DANP_FTP_STATUS_INVALID_PARAM;
+            break;
+        }
+
+        data_port = config->data_port ? config->data_port : DANP_FTP_MCAST_DATA_PORT;
+        nack_port = config->nack_port ? config->nack_port : DANP_FTP_MCAST_NACK_PORT;
+        round_ms = config->round_ms ? config->round_ms : DANP_FTP_MCAST_ROUND_MS;
+        max_rounds = config->max_rounds ? config->max_rounds : DANP_FTP_MCAST_MAX_ROUNDS;
+
+        /* An empty file is still one (empty) chunk, so receivers see a DATA */
+        chunks = (uint32_t)((size + DANP_FTP_MCAST_CHUNK_SIZE - 1) / DANP_FTP_MCAST_CHUNK_SIZE);
+        if (chunks == 0)
+        {
+            chunks = 1;
+        }
+        stats->chunks = chunks;
+
+        pending = (uint8_t *)osal_memory_alloc((chunks + 7U) / 8U);
+        if (!pending)
+        {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP mcast out of memory for %u chunks", chunks);
+            status = DANP_FTP_STATUS_ERROR;
+            break;
+        }
+        memset(pending, 0xFF, (chunks + 7U) / 8U);
+
+        group_socket = danp_socket(DANP_TYPE_DGRAM);
+        nack_socket = danp_socket(DANP_TYPE_DGRAM);
+        if (!group_socket || !nack_socket ||
+            danp_connect(group_socket, config->group_node, data_port) < 0 ||
+            danp_bind(nack_socket, nack_port) < 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP mcast failed to open group sockets");
+            status = DANP_FTP_STATUS_ERROR;
+            break;
+        }
+
+        danp_ftp_service_put_u32(&announce[0], (uint32_t)size);
+        danp_ftp_service_put_u32(&announce[4], chunks);
+        danp_ftp_service_put_u16(&announce[8], config->local_node);
+        danp_ftp_service_put_u16(&announce[10], nack_port);
+
+        for (uint32_t round = 0; ; round++)
+        {
+            stats->rounds++;
+
+            /* Repeated every round so receivers that missed it can still join */
+            status = danp_ftp_mcast_send_packet(
+                group_socket,
+                DANP_FTP_MCAST_TYPE_ANNOUNCE,
+                config->session_id,
+                round,
+                announce,
+                sizeof(announce));
+
+            for (uint32_t i = 0; i < chunks && status >= 0; i++)
+            {
+                if (!danp_ftp_mcast_bit_test(pending, i))
+                {
+                    continue;
+                }
+
+                length = danp_ftp_mcast_chunk_length(size, i);
+                if (length > 0)
+                {
+                    result = read_cb((size_t)i * DANP_FTP_MCAST_CHUNK_SIZE, packet.payload, length, user_data);
+                    if (result != (danp_ftp_status_t)length)
+                    {
+                        danp_log_message(DANP_LOG_LEVEL_ERR, "FTP mcast read of chunk %u failed: %d", i, result);
+                        status = (result < 0) ? result : DANP_FTP_STATUS_ERROR;
+                        break;
+                    }
+                }
+
+                status = danp_ftp_mcast_send_packet(
+                    group_socket,
+                    DANP_FTP_MCAST_TYPE_DATA,
+                    config->session_id,
+                    i,
+                    packet.payload,
+                    length);
+
+                danp_ftp_mcast_bit_clear(pending, i);
+                stats->data_packets++;
+                if (round > 0)
+                {
+                    stats->repairs++;
+                }
+            }
+
+            if (status >= 0)
+            {
+                status = danp_ftp_mcast_send_packet(
+                    group_socket,
+                    DANP_FTP_MCAST_TYPE_POLL,
+                    config->session_id,
+                    round,
+                    NULL,
+                    0);
+            }
+
+            if (status < 0)
+            {
+                break;
+            }
+
+            /* Collect NACKs and completions, merging every bitmap into the next round */
+            nacked = false;
+            start_ms = danp_port_uptime_ms();
+            for (;;)
+            {
+                elapsed_ms = danp_port_uptime_ms() - start_ms;
+                if (elapsed_ms >= round_ms || (config->receivers > 0 && done_count >= config->receivers))
+                {
+                    break;
+                }
+
+                result = danp_ftp_mcast_receive_packet(nack_socket, &packet, round_ms - elapsed_ms);
+                if (result < DANP_FTP_MCAST_NODE_SIZE || packet.header.session_id != config->session_id)
+                {
+                    continue;
+                }
+
+                node = danp_ftp_service_get_u16(packet.payload);
+
+                if (packet.header.type == DANP_FTP_MCAST_TYPE_NACK)
+                {
+                    stats->nacks++;
+                    nacked = true;
+                    base = packet.header.index;
+                    bits = (uint32_t)(result - DANP_FTP_MCAST_NODE_SIZE) * 8U;
+                    for (uint32_t i = 0; i < bits && base + i < chunks; i++)
+                    {
+                        if (danp_ftp_mcast_bit_test(&packet.payload[DANP_FTP_MCAST_NODE_SIZE], i))
+                        {
+                            danp_ftp_mcast_bit_set(pending, base + i);
+                        }
+                    }
+                }
+                else if (packet.header.type == DANP_FTP_MCAST_TYPE_DONE)
+                {
+                    known = false;
+                    for (uint32_t i = 0; i < done_count; i++)
+                    {
+                        known = known || (done_nodes[i] == node);
+                    }
+                    if (!known && done_count < DANP_FTP_MCAST_MAX_RECEIVERS)
+                    {
+                        done_nodes[done_count++] = node;
+                        danp_log_message(DANP_LOG_LEVEL_INF, "FTP mcast node %u complete", node);
+                    }
+                }
+            }
+
+            stats->completed = done_count;
+
+            if ((config->receivers > 0) ? (done_count >= config->receivers) : !nacked)
+            {
+                break;
+            }
+
+            if (round + 1 >= max_rounds)
+            {
+                danp_log_message(
+                    DANP_LOG_LEVEL_ERR,
+                    "FTP mcast giving up after %u rounds, %u receivers complete",
+                    stats->rounds,
+                    done_count);
+                status = DANP_FTP_STATUS_TRANSFER_FAILED;
+                break;
+            }
+        }
+
+        danp_ftp_mcast_send_packet(group_socket, DANP_FTP_MCAST_TYPE_END, config->session_id, 0, NULL, 0);
+
+        if (status >= 0)
+        {
+            status = (danp_ftp_status_t)done_count;
+        }
+
+        break;
+    }
+
+    if (group_socket)
+    {
+        danp_close(group_socket);
+    }
+    if (nack_socket)
+    {
+        danp_close(nack_socket);
+    }
+    if (pending)
+    {
+        osal_memory_free(pending);
+    }
+
+    return status;
+}
+
+/**
+ * @brief Join a group transfer and receive the file.
+ * @param config Local node, data port and session to follow.
+ * @param write_cb Callback storing the received data.
+ * @param user_data User data passed to write_cb.
+ * @param stats Optional pointer to store transfer statistics.
+ * @param timeout_ms Give up after this long without a packet of the followed session.
+ * @return Number of bytes received, at most INT32_MAX, negative status on error.
+ */
+danp_ftp_status_t danp_ftp_mcast_receive(
+    const danp_ftp_mcast_config_t *config,
+    danp_ftp_service_client_write_cb_t write_cb,
+    void *user_data,
+    danp_ftp_mcast_stats_t *stats,
+    uint32_t timeout_ms)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    danp_ftp_mcast_stats_t local_stats;
+    danp_ftp_mcast_packet_t packet;
+    danp_socket_t *group_socket = NULL;
+    danp_socket_t *nack_socket = NULL;
+    uint8_t *have = NULL;
+    uint8_t node[DANP_FTP_MCAST_NODE_SIZE];
+    uint16_t session_id;
+    size_t size = 0;
+    uint32_t chunks = 0;
+    uint32_t received = 0;
+    danp_ftp_status_t length;
+    uint32_t last_ms;
+    uint32_t elapsed_ms;
+    bool finished = false;
+
+    if (!stats)
+    {
+        stats = &local_stats;
+    }
+    memset(stats, 0, sizeof(danp_ftp_mcast_stats_t));
+
+    for (;;)
+    {
+        if (!config || !write_cb)
+        {
+            status = DANP_FTP_STATUS_INVALID_PARAM;
+            break;
+        }
+
+        session_id = config->session_id;
+        danp_ftp_service_put_u16(node, config->local_node);
+
+        group_socket = danp_socket(DANP_TYPE_DGRAM);
+        if (!group_socket ||
+            danp_bind(group_socket, config->data_port ? config->data_port : DANP_FTP_MCAST_DATA_PORT) < 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP mcast failed to join the group port");
+            status = DANP_FTP_STATUS_ERROR;
+            break;
+        }
+
+        /* Bad packets and other sessions do not hold the deadline off */
+        last_ms = danp_port_uptime_ms();
+        while (!finished)
+        {
+            elapsed_ms = danp_port_uptime_ms() - last_ms;
+            length = (elapsed_ms < timeout_ms) ?
+                     danp_ftp_mcast_receive_packet(group_socket, &packet, timeout_ms - elapsed_ms) :
+                     DANP_FTP_STATUS_TIMEOUT;
+            if (length == DANP_FTP_STATUS_TIMEOUT)
+            {
+                /* The END packet may be lost, a complete file is still a success */
+                if (!have || received < chunks)
+                {
+                    danp_log_message(DANP_LOG_LEVEL_WRN, "FTP mcast timeout with %u/%u chunks", received, chunks);
+                    status = DANP_FTP_STATUS_TIMEOUT;
+                }
+                break;
+            }
+
+            if (length == DANP_FTP_STATUS_ERROR)
+            {
+                status = DANP_FTP_STATUS_ERROR;
+                break;
+            }
+
+            if (length < 0 || (session_id != 0 && packet.header.session_id != session_id))
+            {
+                continue;
+            }
+            last_ms = danp_port_uptime_ms();
+
+            switch (packet.header.type)
+            {
+            case DANP_FTP_MCAST_TYPE_ANNOUNCE:
+                if (have || length < DANP_FTP_MCAST_ANNOUNCE_SIZE)
+                {
+                    break;
+                }
+
+                size = danp_ftp_service_get_u32(&packet.payload[0]);
+                chunks = (uint32_t)((size + DANP_FTP_MCAST_CHUNK_SIZE - 1) / DANP_FTP_MCAST_CHUNK_SIZE);
+                if (chunks == 0)
+                {
+                    chunks = 1;
+                }
+                if (chunks != danp_ftp_service_get_u32(&packet.payload[4]))
+                {
+                    break;
+                }
+
+                have = (uint8_t *)osal_memory_alloc((chunks + 7U) / 8U);
+                nack_socket = danp_socket(DANP_TYPE_DGRAM);
+                if (!have || !nack_socket ||
+                    danp_connect(
+                        nack_socket,
+                        danp_ftp_service_get_u16(&packet.payload[8]),
+                        danp_ftp_service_get_u16(&packet.payload[10])) < 0)
+                {
+                    danp_log_message(DANP_LOG_LEVEL_ERR, "FTP mcast out of resources for %u chunks", chunks);
+                    status = DANP_FTP_STATUS_ERROR;
+                    finished = true;
+                    break;
+                }
+
+                memset(have, 0, (chunks + 7U) / 8U);
+                session_id = packet.header.session_id;
+                stats->chunks = chunks;
+                danp_log_message(
+                    DANP_LOG_LEVEL_INF,
+                    "FTP mcast joined session %u: %u bytes in %u chunks",
+                    session_id,
+                    (uint32_t)size,
+                    chunks);
+                break;
+
+            case DANP_FTP_MCAST_TYPE_DATA:
+                /* Chunks before the announcement are reported missing at the next poll */
+                if (!have || packet.header.index >= chunks)
+                {
+                    break;
+                }
+
+                stats->data_packets++;
+                if (danp_ftp_mcast_bit_test(have, packet.header.index))
+                {
+                    stats->duplicates++;
+                    break;
+                }
+
+                if (length != danp_ftp_mcast_chunk_length(size, packet.header.index))
+                {
+                    break;
+                }
+
+                if (length > 0)
+                {
+                    status = write_cb(
+                        (size_t)packet.header.index * DANP_FTP_MCAST_CHUNK_SIZE,
+                        packet.payload,
+                        (uint16_t)length,
+                        user_data);
+                    if (status < 0)
+                    {
+                        finished = true;
+                        break;
+                    }
+                }
+
+                danp_ftp_mcast_bit_set(have, packet.header.index);
+                received++;
+                break;
+
+            case DANP_FTP_MCAST_TYPE_POLL:
+                if (!have)
+                {
+                    break;
+                }
+
+                stats->rounds++;
+                if (received == chunks)
+                {
+                    status = danp_ftp_mcast_send_packet(
+                        nack_socket,
+                        DANP_FTP_MCAST_TYPE_DONE,
+                        session_id,
+                        packet.header.index,
+                        node,
+                        sizeof(node));
+                }
+                else
+                {
+                    status = danp_ftp_mcast_send_nacks(
+                        nack_socket,
+                        config->local_node,
+                        session_id,
+                        have,
+                        chunks,
+                        stats);
+                }
+                finished = (status < 0);
+                break;
+
+            case DANP_FTP_MCAST_TYPE_END:
+                if (have && received == chunks)
+                {
+                    finished = true;
+                }
+                else if (have)
+                {
+                    danp_log_message(DANP_LOG_LEVEL_WRN, "FTP mcast sender ended with %u/%u chunks", received, chunks);
+                    status = DANP_FTP_STATUS_TRANSFER_FAILED;
+                    finished = true;
+                }
+                break;
+
+            default:
+                break;
+            }
+        }
+
+        if (status >= 0)
+        {
+            status = (size > (size_t)INT32_MAX) ? INT32_MAX : (danp_ftp_status_t)size;
+        }
+
+        break;
+    }
+
+    if (group_socket)
+    {
+        danp_close(group_socket);
+    }
+    if (nack_socket)
+    {
+        danp_close(nack_socket);
+    }
+    if (have)
+    {
+        osal_memory_free(have);
+    }
+
+    return status;
+}
@@ -10,6 +10,9 @@
 #include "danp/ftp/danp_ftp.h"
 #include "danp/danp.h"
 #include "danp_debug.h"
+#include "danp_port.h"
+#include "danp_trace.h"
+#include "services/danp_ftp_service_int.h"
 #include <string.h>
 
 /* Imports */
@@ -17,44 +20,150 @@
 
 /* Definitions */
 
-#define DANP_FTP_SERVICE_PORT                 (CONFIG_DANP_FTP_SERVICE_PORT)
+#if defined(CONFIG_DANP_FTP_SERVICE_STACK_SIZE)
+#define DANP_FTP_SERVICE_STACK_SIZE           (CONFIG_DANP_FTP_SERVICE_STACK_SIZE)
+#define DANP_FTP_SERVICE_CLIENT_STACK_SIZE    (CONFIG_DANP_FTP_SERVICE_CLIENT_STACK_SIZE)
+#else
 #define DANP_FTP_SERVICE_STACK_SIZE           (1024 * 4)
+#define DANP_FTP_SERVICE_CLIENT_STACK_SIZE    (1024 * 4)
+#endif
 #define DANP_FTP_SERVICE_BACKLOG              (5)
 #define DANP_FTP_SERVICE_TIMEOUT_MS           (30000)
 #define DANP_FTP_SERVICE_MAX_CLIENTS          (4)
 
-#define DANP_FTP_MAX_PAYLOAD_SIZE             (DANP_MAX_PACKET_SIZE - sizeof(danp_ftp_header_t))
-
-#define DANP_FTP_CMD_REQUEST_READ             (0x01)
-#define DANP_FTP_CMD_REQUEST_WRITE            (0x02)
-#define DANP_FTP_CMD_ABORT                    (0x03)
-
-#define DANP_FTP_RESP_OK                      (0x00)
-#define DANP_FTP_RESP_ERROR                   (0x01)
-#define DANP_FTP_RESP_FILE_NOT_FOUND          (0x02)
-#define DANP_FTP_RESP_BUSY                    (0x03)
-
-#define DANP_FTP_FLAG_NONE                    (0x00)
-#define DANP_FTP_FLAG_LAST_CHUNK              (0x01)
-#define DANP_FTP_FLAG_FIRST_CHUNK             (0x02)
+#if defined(CONFIG_DANP_FTP_SERVICE_SCHED_SLICE_MS)
+#define DANP_FTP_SERVICE_SCHED_SLICE_MS       (CONFIG_DANP_FTP_SERVICE_SCHED_SLICE_MS)
+#else
+#define DANP_FTP_SERVICE_SCHED_SLICE_MS       (20)
+#endif
+
+#if defined(CONFIG_DANP_FTP_SERVICE_WEIGHT_BULK)
+#define DANP_FTP_SERVICE_WEIGHT_BULK          (CONFIG_DANP_FTP_SERVICE_WEIGHT_BULK)
+#define DANP_FTP_SERVICE_WEIGHT_NORMAL        (CONFIG_DANP_FTP_SERVICE_WEIGHT_NORMAL)
+#define DANP_FTP_SERVICE_WEIGHT_URGENT        (CONFIG_DANP_FTP_SERVICE_WEIGHT_URGENT)
+#else
+#define DANP_FTP_SERVICE_WEIGHT_BULK          (1)
+#define DANP_FTP_SERVICE_WEIGHT_NORMAL        (4)
+#define DANP_FTP_SERVICE_WEIGHT_URGENT        (16)
+#endif
+
+#if defined(CONFIG_DANP_FTP_SERVICE_RATE_LIMIT_BPS)
+#define DANP_FTP_SERVICE_RATE_LIMIT_BPS       (CONFIG_DANP_FTP_SERVICE_RATE_LIMIT_BPS)
+#define DANP_FTP_SERVICE_SESSION_RATE_BPS     (CONFIG_DANP_FTP_SERVICE_SESSION_RATE_BPS)
+#define DANP_FTP_SERVICE_RATE_BURST_MS        (CONFIG_DANP_FTP_SERVICE_RATE_BURST_MS)
+#else
+#define DANP_FTP_SERVICE_RATE_LIMIT_BPS       (0)
+#define DANP_FTP_SERVICE_SESSION_RATE_BPS     (0)
+#define DANP_FTP_SERVICE_RATE_BURST_MS        (100)
+#endif
+
+#define DANP_FTP_SERVICE_RATE_WINDOW_MS       (1000)
+
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_VEC_CHUNKS)
+#define DANP_FTP_SERVICE_FS_VEC_CHUNKS        (CONFIG_DANP_FTP_SERVICE_FS_VEC_CHUNKS)
+#else
+#define DANP_FTP_SERVICE_FS_VEC_CHUNKS        (4)
+#endif
+
+#if defined(CONFIG_DANP_FTP_SERVICE_MIN_RTO_MS)
+#define DANP_FTP_SERVICE_MIN_RTO_MS           (CONFIG_DANP_FTP_SERVICE_MIN_RTO_MS)
+#define DANP_FTP_SERVICE_INITIAL_RTO_MS       (CONFIG_DANP_FTP_SERVICE_INITIAL_RTO_MS)
+#define DANP_FTP_SERVICE_MAX_RETRANSMITS      (CONFIG_DANP_FTP_SERVICE_MAX_RETRANSMITS)
+#else
+#define DANP_FTP_SERVICE_MIN_RTO_MS           (200)
+#define DANP_FTP_SERVICE_INITIAL_RTO_MS       (1000)
+#define DANP_FTP_SERVICE_MAX_RETRANSMITS      (5)
+#endif
+#define DANP_FTP_SERVICE_MAX_RTO_MS           (DANP_FTP_SERVICE_TIMEOUT_MS)
+
+#if defined(CONFIG_DANP_FTP_SERVICE_PROFILER)
+#define DANP_FTP_PROF_BEGIN(name)             uint32_t name = danp_port_cycles()
+#define DANP_FTP_PROF_END(ctx, stage, name)   \
+    danp_ftp_service_prof_record(&(ctx)->profile, (stage), danp_port_cycles() - (name))
+#else
+#define DANP_FTP_PROF_BEGIN(name)
+#define DANP_FTP_PROF_END(ctx, stage, name)
+#endif
+
+#if defined(CONFIG_DANP_FTP_SERVICE_REACTOR)
+#define DANP_FTP_SERVICE_REACTOR_SESSIONS     (CONFIG_DANP_FTP_SERVICE_REACTOR_SESSIONS)
+#define DANP_FTP_SERVICE_REACTOR_IDLE_MS      (CONFIG_DANP_FTP_SERVICE_REACTOR_IDLE_MS)
+#if defined(CONFIG_DANP_FTP_SERVICE_REACTOR_HANDOFFS)
+#define DANP_FTP_SERVICE_REACTOR_HANDOFFS     (CONFIG_DANP_FTP_SERVICE_REACTOR_HANDOFFS)
+#else
+#define DANP_FTP_SERVICE_REACTOR_HANDOFFS     (2)
+#endif
+#endif
 
 /* Types */
 
-typedef struct danp_ftp_message_s
+typedef struct danp_ftp_token_bucket_s
 {
-    danp_ftp_header_t header;
-    uint8_t payload[DANP_FTP_MAX_PAYLOAD_SIZE];
-} PACKED danp_ftp_message_t;
+    uint32_t rate_bps;
+    uint32_t tokens;
+    uint32_t last_ms;
+    bool primed;
+} danp_ftp_token_bucket_t;
 
 typedef struct danp_ftp_service_context_s
 {
     danp_ftp_service_config_t config;
     danp_socket_t *listen_socket;
     osal_thread_handle_t service_thread;
+    danp_port_mutex_t sched_lock;
+    uint8_t active_sessions[DANP_FTP_SERVICE_PRIORITY_COUNT];
+    danp_ftp_token_bucket_t tx_bucket;
+    danp_ftp_token_bucket_t class_bucket[DANP_FTP_SERVICE_PRIORITY_COUNT]; /* Weighted shares of tx_bucket */
+    uint32_t session_rate_bps;
+    uint32_t rate_window_start_ms;
+    uint32_t rate_window_bytes;
+    uint32_t achieved_bps;
+    uint32_t throttled_ms;
+    uint64_t bytes_sent;
+    uint32_t retransmits;                        /* Sends repeated after an ACK timeout */
+    uint32_t client_count;                       /* Live client handler threads */
+    uint32_t client_peak;
+    uint32_t handoff_count;                      /* Reactor sessions running on a handler thread */
+    uint32_t service_stack_used;                 /* Service thread high-water mark, 0 = unknown */
+    uint32_t client_stack_peak;                  /* Highest client thread high-water mark */
+    uint32_t client_stack_last;
+    uint32_t client_stack_samples;
+    uint32_t heap_in_use;                        /* Client contexts and handed over commands */
+    uint32_t heap_peak;
+#if defined(CONFIG_DANP_FTP_SERVICE_PROFILER)
+    danp_ftp_service_profile_t profile_total;
+    danp_ftp_service_profile_t profile_last;
+#endif
     bool is_running;
     bool is_initialized;
 } danp_ftp_service_context_t;
 
+/* READ chunks fetched with one fs.readv call */
+typedef struct danp_ftp_service_read_window_s
+{
+    uint8_t data[DANP_FTP_SERVICE_FS_VEC_CHUNKS * DANP_FTP_MAX_PAYLOAD_SIZE + 1]; /* +1 for the EOF peek byte */
+    size_t offset;                               /* File offset of data[0] */
+    size_t length;                               /* Bytes held */
+    bool more;                                   /* Data follows the window */
+    bool valid;
+} danp_ftp_service_read_window_t;
+
+/* WRITE chunks received but not yet passed to fs.writev */
+typedef struct danp_ftp_service_write_window_s
+{
+    danp_ftp_message_t messages[DANP_FTP_SERVICE_FS_VEC_CHUNKS];
+    size_t offset;                               /* File offset of the first held chunk */
+    uint8_t count;                               /* Chunks held */
+} danp_ftp_service_write_window_t;
+
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_ASYNC)
+struct danp_ftp_service_fs_op_s
+{
+    danp_port_sem_t done;                        /* Given by danp_ftp_service_fs_complete() */
+    danp_ftp_status_t result;
+};
+#endif
+
 typedef struct danp_ftp_client_context_s
 {
     danp_socket_t *socket;
@@ -62,11 +171,79 @@ typedef struct danp_ftp_client_context_s
     uint16_t sequence_number;
     danp_ftp_file_handle_t file_handle;
     bool file_open;
+    size_t range_start;                          /* First byte of the READ */
+    size_t range_end;                            /* End of the READ, SIZE_MAX = end of file */
+    bool wide;                                   /* Command fields are u64, DANP_FTP_CMD_WIDE */
+    danp_ftp_service_priority_t priority;
+    bool session_active;
+    danp_ftp_token_bucket_t tx_bucket;
+    uint32_t srtt_x8;                            /* Smoothed RTT, ms scaled by 8 */
+    uint32_t rttvar_x4;                          /* RTT variance, ms scaled by 4 */
+    uint32_t rto_ms;
+    uint32_t retransmits;
+    bool rtt_valid;
+    danp_ftp_message_t *command;                 /* Command already received by the reactor */
+    bool handed_over;                            /* Counted in handoff_count */
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_ASYNC)
+    danp_ftp_service_fs_op_t fs_op;              /* Chunk read or write in flight */
+#endif
+#if defined(CONFIG_DANP_FTP_SERVICE_PROFILER)
+    danp_ftp_service_profile_t profile;
+#endif
 } danp_ftp_client_context_t;
 
+#if defined(CONFIG_DANP_FTP_SERVICE_REACTOR)
+typedef enum danp_ftp_reactor_state_e
+{
+    DANP_FTP_REACTOR_STATE_FREE = 0,
+    DANP_FTP_REACTOR_STATE_COMMAND,              /* Waiting for the command */
+    DANP_FTP_REACTOR_STATE_RESPONSE,             /* Response waiting for rate limit tokens */
+    DANP_FTP_REACTOR_STATE_READ_DATA,            /* Next READ chunk to send */
+    DANP_FTP_REACTOR_STATE_READ_ACK,             /* READ chunk in flight */
+    DANP_FTP_REACTOR_STATE_WRITE_DATA,           /* Waiting for the next WRITE chunk */
+    DANP_FTP_REACTOR_STATE_WRITE_ACK,            /* WRITE chunk stored, ACK not sent yet */
+    DANP_FTP_REACTOR_STATE_STAT_DIGEST,          /* STAT streaming the file through CRC32 */
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_ASYNC)
+    DANP_FTP_REACTOR_STATE_READ_FS,              /* Async READ chunk or EOF peek in flight */
+    DANP_FTP_REACTOR_STATE_READ_SEND,            /* READ chunk read, waiting for rate limit tokens */
+    DANP_FTP_REACTOR_STATE_WRITE_FS,             /* Async WRITE chunk in flight */
+#endif
+    DANP_FTP_REACTOR_STATE_DONE,
+} danp_ftp_reactor_state_t;
+
+typedef struct danp_ftp_reactor_session_s
+{
+    danp_ftp_client_context_t client;
+    danp_ftp_reactor_state_t state;
+    danp_ftp_reactor_state_t next_state;         /* State after the queued response */
+    uint8_t response[DANP_FTP_STAT_RESPONSE_SIZE(true)];
+    uint8_t response_len;
+    uint8_t chunk_flags;
+    uint16_t chunk_len;
+    size_t offset;
+    uint32_t wake_ms;                            /* Not stepped before, for rate and priority yields */
+    uint32_t deadline_ms;                        /* Receive or ACK deadline */
+    uint32_t sent_ms;
+    uint32_t attempt;
+    uint32_t digest_crc;                         /* STAT CRC32 register, bytes so far in offset */
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_ASYNC)
+    bool fs_peek;                                /* READ_FS waits for the EOF peek, not the chunk */
+    uint8_t chunk[DANP_FTP_MAX_PAYLOAD_SIZE + 1]; /* Own chunk, storage may still be working on it */
+#endif
+#if defined(CONFIG_DANP_FTP_SERVICE_PROFILER)
+    uint32_t sent_cycles;
+    uint32_t fs_cycles;                          /* Chunk handed to storage */
+#endif
+} danp_ftp_reactor_session_t;
+#endif
+
 /* Forward Declarations */
 
+#if defined(CONFIG_DANP_FTP_SERVICE_REACTOR)
+static void danp_ftp_service_reactor_thread(void *arg);
+#else
 static void danp_ftp_service_thread(void *arg);
+#endif
 static void danp_ftp_client_handler_thread(void *arg);
 static uint32_t danp_ftp_service_calculate_crc(const uint8_t *data, size_t length);
 static danp_ftp_status_t danp_ftp_service_send_message(
@@ -82,28 +259,54 @@ static danp_ftp_status_t danp_ftp_service_receive_message(
 static danp_ftp_status_t danp_ftp_service_handle_read_request(
     danp_ftp_client_context_t *ctx,
     const uint8_t *file_id,
-    size_t file_id_len);
+    size_t file_id_len,
+    uint8_t fec_k,
+    uint8_t fec_r,
+    const uint8_t *range);
 static danp_ftp_status_t danp_ftp_service_handle_write_request(
+    danp_ftp_client_context_t *ctx,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    size_t size_hint,
+    const uint8_t *range);
+static danp_ftp_status_t danp_ftp_service_handle_stat_request(
     danp_ftp_client_context_t *ctx,
     const uint8_t *file_id,
     size_t file_id_len);
+static danp_ftp_status_t danp_ftp_service_handle_sync_request(
+    danp_ftp_client_context_t *ctx,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    uint16_t block_size);
 
 /* Variables */
 
 static danp_ftp_service_context_t ftp_service_ctx;
 
+/* Share of the global rate each priority class gets while several are active */
+static const uint32_t ftp_priority_weights[DANP_FTP_SERVICE_PRIORITY_COUNT] = {
+    DANP_FTP_SERVICE_WEIGHT_BULK,
+    DANP_FTP_SERVICE_WEIGHT_NORMAL,
+    DANP_FTP_SERVICE_WEIGHT_URGENT,
+};
+
+#if defined(CONFIG_DANP_FTP_SERVICE_REACTOR)
+static danp_ftp_reactor_session_t ftp_reactor_sessions[DANP_FTP_SERVICE_REACTOR_SESSIONS];
+static danp_ftp_message_t ftp_reactor_message;
+static uint8_t ftp_reactor_chunk[DANP_FTP_MAX_PAYLOAD_SIZE + 1]; /* +1 for the EOF peek byte */
+#endif
+
 /* Functions */
 
 /**
- * @brief Calculate CRC32 for data integrity verification.
+ * @brief Feed data into a running CRC32 register.
+ * @param crc Current register value.
  * @param data Pointer to the data buffer.
  * @param length Length of the data.
- * @return Calculated CRC32 value.
+ * @return Updated register value.
  */
-static uint32_t danp_ftp_service_calculate_crc(const uint8_t *data, size_t length)
+uint32_t danp_ftp_service_crc32_update(uint32_t crc, const uint8_t *data, size_t length)
 {
-    uint32_t crc = 0xFFFFFFFFU;
-
     for (size_t i = 0; i < length; i++)
     {
         crc ^= data[i];
@@ -120,709 +323,4167 @@ static uint32_t danp_ftp_service_calculate_crc(const uint8_t *data, size_t lengt
         }
     }
 
-    return crc ^ 0xFFFFFFFFU;
+    return crc;
 }
 
 /**
- * @brief Send an FTP protocol message from service.
- * @param ctx Pointer to the client context.
- * @param type Packet type.
- * @param flags Packet flags.
- * @param payload Pointer to the payload data.
- * @param payload_length Length of the payload.
- * @return Status code.
+ * @brief Calculate CRC32 for data integrity verification.
+ * @param data Pointer to the data buffer.
+ * @param length Length of the data.
+ * @return Calculated CRC32 value.
  */
-static danp_ftp_status_t danp_ftp_service_send_message(
-    danp_ftp_client_context_t *ctx,
-    danp_ftp_packet_type_t type,
-    uint8_t flags,
-    const uint8_t *payload,
-    uint16_t payload_length)
+static uint32_t danp_ftp_service_calculate_crc(const uint8_t *data, size_t length)
 {
-    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
-    danp_ftp_message_t message;
-    int32_t send_result;
+    return danp_ftp_service_crc32_update(DANP_FTP_CRC32_INIT, data, length) ^ DANP_FTP_CRC32_INIT;
+}
 
-    for (;;)
+/**
+ * @brief Look up the default session priority of a remote node.
+ * @param svc Pointer to the service context.
+ * @param node Remote node id.
+ * @return Priority from the configured map, normal if the node is not listed.
+ */
+static danp_ftp_service_priority_t danp_ftp_service_lookup_priority(
+    const danp_ftp_service_context_t *svc,
+    uint16_t node)
+{
+    danp_ftp_service_priority_t priority = DANP_FTP_SERVICE_PRIORITY_NORMAL;
+
+    for (size_t i = 0; svc->config.priority_map && i < svc->config.priority_map_len; i++)
     {
-        if (!ctx || !ctx->socket)
+        if (svc->config.priority_map[i].node == node &&
+            svc->config.priority_map[i].priority < DANP_FTP_SERVICE_PRIORITY_COUNT)
         {
-            status = DANP_FTP_STATUS_INVALID_PARAM;
+            priority = svc->config.priority_map[i].priority;
             break;
         }
+    }
 
-        if (payload_length > DANP_FTP_MAX_PAYLOAD_SIZE)
-        {
-            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service payload too large: %u", payload_length);
-            status = DANP_FTP_STATUS_INVALID_PARAM;
-            break;
-        }
+    return priority;
+}
 
-        memset(&message, 0, sizeof(danp_ftp_message_t));
+#if defined(CONFIG_DANP_FTP_SERVICE_PROFILER)
+/**
+ * @brief Account one stage duration to a profile.
+ * @param profile Pointer to the profile.
+ * @param stage Stage that was measured.
+ * @param cycles Duration in cycle counter ticks.
+ */
+static void danp_ftp_service_prof_record(
+    danp_ftp_service_profile_t *profile,
+    danp_ftp_service_prof_stage_t stage,
+    uint32_t cycles)
+{
+    danp_ftp_service_prof_stat_t *stat = &profile->stages[stage];
+    uint64_t ns = danp_port_cycles_to_ns(cycles);
+    uint32_t us;
+    uint32_t bucket = 0;
 
-        message.header.type = (uint8_t)type;
-        message.header.flags = flags;
-        message.header.sequence_number = ctx->sequence_number;
-        message.header.payload_length = payload_length;
+    if (ns > UINT32_MAX)
+    {
+        ns = UINT32_MAX;
+    }
 
-        if (payload && payload_length > 0)
-        {
-            memcpy(message.payload, payload, payload_length);
-        }
+    if (stat->count == 0 || ns < stat->min_ns)
+    {
+        stat->min_ns = (uint32_t)ns;
+    }
+    if (ns > stat->max_ns)
+    {
+        stat->max_ns = (uint32_t)ns;
+    }
+    stat->count++;
+    stat->total_ns += ns;
 
-        message.header.crc = danp_ftp_service_calculate_crc(
-            message.payload,
-            payload_length);
+    for (us = (uint32_t)(ns / 1000U); us > 0 && bucket < DANP_FTP_SERVICE_PROF_BUCKETS - 1; us >>= 1)
+    {
+        bucket++;
+    }
+    stat->histogram[bucket]++;
+}
 
-        send_result = danp_send(
-            ctx->socket,
-            &message,
-            sizeof(danp_ftp_header_t) + payload_length);
+/**
+ * @brief Fold a finished session's profile into the service totals.
+ * @param ctx Pointer to the client context.
+ */
+static void danp_ftp_service_prof_commit(danp_ftp_client_context_t *ctx)
+{
+    danp_ftp_service_context_t *svc = ctx->service;
+    danp_ftp_service_prof_stat_t *dst;
+    danp_ftp_service_prof_stat_t *src;
 
-        if (send_result < 0)
+    danp_port_mutex_lock(&svc->sched_lock);
+
+    for (uint32_t stage = 0; stage < DANP_FTP_SERVICE_PROF_STAGE_COUNT; stage++)
+    {
+        dst = &svc->profile_total.stages[stage];
+        src = &ctx->profile.stages[stage];
+
+        if (src->count == 0)
         {
-            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service send failed: %d", send_result);
-            status = DANP_FTP_STATUS_TRANSFER_FAILED;
-            break;
+            continue;
         }
 
-        danp_log_message(
-            DANP_LOG_LEVEL_DBG,
-            "FTP SVC TX: type=%u flags=0x%02X seq=%u len=%u",
-            type,
-            flags,
-            ctx->sequence_number,
-            payload_length);
+        if (dst->count == 0 || src->min_ns < dst->min_ns)
+        {
+            dst->min_ns = src->min_ns;
+        }
+        if (src->max_ns > dst->max_ns)
+        {
+            dst->max_ns = src->max_ns;
+        }
+        dst->count += src->count;
+        dst->total_ns += src->total_ns;
 
-        break;
+        for (uint32_t bucket = 0; bucket < DANP_FTP_SERVICE_PROF_BUCKETS; bucket++)
+        {
+            dst->histogram[bucket] += src->histogram[bucket];
+        }
     }
 
-    return status;
+    svc->profile_total.sessions++;
+    memcpy(&svc->profile_last, &ctx->profile, sizeof(danp_ftp_service_profile_t));
+    svc->profile_last.sessions = 1;
+
+    danp_port_mutex_unlock(&svc->sched_lock);
 }
+#endif
 
 /**
- * @brief Receive an FTP protocol message.
- * @param ctx Pointer to the client context.
- * @param message Pointer to store the received message.
- * @param timeout_ms Timeout in milliseconds.
- * @return Status code or bytes received.
+ * @brief Allocate service memory and account it towards the heap statistics.
+ * @param svc Pointer to the service context.
+ * @param size Number of bytes.
+ * @return Pointer to the memory, NULL on failure.
  */
-static danp_ftp_status_t danp_ftp_service_receive_message(
-    danp_ftp_client_context_t *ctx,
-    danp_ftp_message_t *message,
-    uint32_t timeout_ms)
+static void *danp_ftp_service_alloc(danp_ftp_service_context_t *svc, size_t size)
 {
-    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
-    int32_t recv_result;
-    uint32_t calculated_crc;
+    void *ptr = osal_memory_alloc(size);
 
-    for (;;)
+    if (ptr)
     {
-        if (!ctx || !ctx->socket || !message)
+        danp_port_mutex_lock(&svc->sched_lock);
+        svc->heap_in_use += (uint32_t)size;
+        if (svc->heap_in_use > svc->heap_peak)
         {
-            status = DANP_FTP_STATUS_INVALID_PARAM;
-            break;
+            svc->heap_peak = svc->heap_in_use;
         }
+        danp_port_mutex_unlock(&svc->sched_lock);
+    }
 
-        memset(message, 0, sizeof(danp_ftp_message_t));
+    return ptr;
+}
 
-        recv_result = danp_recv(
-            ctx->socket,
-            message,
-            sizeof(danp_ftp_message_t),
-            timeout_ms);
+/**
+ * @brief Free memory from danp_ftp_service_alloc.
+ * @param svc Pointer to the service context.
+ * @param ptr Pointer to the memory.
+ * @param size Number of bytes it was allocated with.
+ */
+static void danp_ftp_service_free(danp_ftp_service_context_t *svc, void *ptr, size_t size)
+{
+    osal_memory_free(ptr);
 
-        if (recv_result < (int32_t)sizeof(danp_ftp_header_t))
-        {
-            if (recv_result == 0)
-            {
-                danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service receive timeout");
-            }
-            else
-            {
-                danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service receive failed: %d", recv_result);
-            }
-            status = DANP_FTP_STATUS_TRANSFER_FAILED;
-            break;
-        }
+    danp_port_mutex_lock(&svc->sched_lock);
+    svc->heap_in_use -= (uint32_t)size;
+    danp_port_mutex_unlock(&svc->sched_lock);
+}
+
+/**
+ * @brief Record the stack high-water mark of the calling thread.
+ * @param svc Pointer to the service context.
+ * @param client true for a client handler thread, false for the service thread.
+ */
+static void danp_ftp_service_stack_sample(danp_ftp_service_context_t *svc, bool client)
+{
+    size_t unused = 0;
+    uint32_t used;
 
-        calculated_crc = danp_ftp_service_calculate_crc(
-            message->payload,
-            message->header.payload_length);
+    if (danp_port_stack_unused(&unused) < 0)
+    {
+        return;
+    }
 
-        if (calculated_crc != message->header.crc)
+    danp_port_mutex_lock(&svc->sched_lock);
+    if (client)
+    {
+        used = (uint32_t)(DANP_FTP_SERVICE_CLIENT_STACK_SIZE - unused);
+        svc->client_stack_last = used;
+        svc->client_stack_samples++;
+        if (used > svc->client_stack_peak)
         {
-            danp_log_message(
-                DANP_LOG_LEVEL_WRN,
-                "FTP service CRC mismatch: expected=0x%08X got=0x%08X",
-                message->header.crc,
-                calculated_crc);
-            status = DANP_FTP_STATUS_TRANSFER_FAILED;
-            break;
+            svc->client_stack_peak = used;
         }
+    }
+    else
+    {
+        svc->service_stack_used = (uint32_t)(DANP_FTP_SERVICE_STACK_SIZE - unused);
+    }
+    danp_port_mutex_unlock(&svc->sched_lock);
+}
 
-        danp_log_message(
-            DANP_LOG_LEVEL_DBG,
-            "FTP SVC RX: type=%u flags=0x%02X seq=%u len=%u",
-            message->header.type,
-            message->header.flags,
-            message->header.sequence_number,
-            message->header.payload_length);
-
-        status = (danp_ftp_status_t)message->header.payload_length;
+/**
+ * @brief Register a session as active at its priority.
+ * @param ctx Pointer to the client context.
+ */
+static void danp_ftp_service_session_begin(danp_ftp_client_context_t *ctx)
+{
+    danp_ftp_service_context_t *svc = ctx->service;
 
-        break;
-    }
+    danp_port_mutex_lock(&svc->sched_lock);
+    svc->active_sessions[ctx->priority]++;
+    ctx->session_active = true;
+    danp_port_mutex_unlock(&svc->sched_lock);
 
-    return status;
+    danp_trace(DANP_TRACE_FTP_SESSION_START, ctx->socket->remote_node, ctx->priority);
 }
 
 /**
- * @brief Wait for ACK from client.
+ * @brief Remove a session from the active set.
  * @param ctx Pointer to the client context.
- * @param expected_seq Expected sequence number.
- * @param timeout_ms Timeout in milliseconds.
- * @return Status code.
  */
-static danp_ftp_status_t danp_ftp_service_wait_for_ack(
-    danp_ftp_client_context_t *ctx,
-    uint16_t expected_seq,
-    uint32_t timeout_ms)
+static void danp_ftp_service_session_end(danp_ftp_client_context_t *ctx)
 {
-    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
-    danp_ftp_message_t message;
+    danp_ftp_service_context_t *svc = ctx->service;
 
-    for (;;)
+    danp_port_mutex_lock(&svc->sched_lock);
+    if (ctx->session_active && svc->active_sessions[ctx->priority] > 0)
     {
-        status = danp_ftp_service_receive_message(ctx, &message, timeout_ms);
-        if (status < 0)
-        {
-            break;
-        }
+        svc->active_sessions[ctx->priority]--;
+        danp_trace(DANP_TRACE_FTP_SESSION_END, ctx->socket ? ctx->socket->remote_node : 0, ctx->retransmits);
+    }
+    ctx->session_active = false;
+    danp_port_mutex_unlock(&svc->sched_lock);
+}
 
-        if (message.header.type == DANP_FTP_PACKET_TYPE_ACK)
-        {
-            if (message.header.sequence_number == expected_seq)
-            {
-                status = DANP_FTP_STATUS_OK;
-                break;
-            }
-            else
-            {
-                danp_log_message(
-                    DANP_LOG_LEVEL_WRN,
-                    "FTP service ACK seq mismatch: expected=%u got=%u",
-                    expected_seq,
-                    message.header.sequence_number);
-                status = DANP_FTP_STATUS_TRANSFER_FAILED;
-                break;
-            }
-        }
-        else if (message.header.type == DANP_FTP_PACKET_TYPE_NACK)
-        {
-            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service received NACK");
-            status = DANP_FTP_STATUS_TRANSFER_FAILED;
-            break;
-        }
-        else
+/**
+ * @brief Time a session has to give way to higher priority sessions.
+ *
+ * With a global rate limit the link capacity is known and the weighted
+ * class buckets of danp_ftp_service_rate_try() split it, so nothing waits
+ * here. Without one, a session keeps running at full speed while nothing
+ * more urgent is active. Otherwise it moves one chunk per scheduling
+ * slice, scaled by the priority gap, so urgent transfers take the
+ * bandwidth while bulk ones keep trickling and never hit the client
+ * timeout.
+ *
+ * @param ctx Pointer to the client context.
+ * @return Milliseconds to wait before the next chunk, 0 to go ahead.
+ */
+static uint32_t danp_ftp_service_schedule_delay(danp_ftp_client_context_t *ctx)
+{
+    danp_ftp_service_context_t *svc = ctx->service;
+    int32_t highest = (int32_t)ctx->priority;
+
+    danp_port_mutex_lock(&svc->sched_lock);
+    for (int32_t p = DANP_FTP_SERVICE_PRIORITY_COUNT - 1;
+         svc->tx_bucket.rate_bps == 0 && p > (int32_t)ctx->priority;
+         p--)
+    {
+        if (svc->active_sessions[p] > 0)
         {
-            danp_log_message(
-                DANP_LOG_LEVEL_WRN,
-                "FTP service unexpected packet type: %u",
-                message.header.type);
-            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            highest = p;
             break;
         }
-
-        break;
     }
+    danp_port_mutex_unlock(&svc->sched_lock);
 
-    return status;
+    return DANP_FTP_SERVICE_SCHED_SLICE_MS * (uint32_t)(highest - (int32_t)ctx->priority);
 }
 
 /**
- * @brief Handle a file read request from client.
+ * @brief Yield the link to higher priority sessions between chunks.
  * @param ctx Pointer to the client context.
- * @param file_id File identifier.
- * @param file_id_len Length of file identifier.
- * @return Status code.
  */
-static danp_ftp_status_t danp_ftp_service_handle_read_request(
-    danp_ftp_client_context_t *ctx,
-    const uint8_t *file_id,
-    size_t file_id_len)
+static void danp_ftp_service_schedule(danp_ftp_client_context_t *ctx)
 {
-    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
-    danp_ftp_service_context_t *svc = ctx->service;
-    danp_ftp_file_handle_t file_handle = 0;
-    uint8_t response_payload[1];
-    uint8_t data_buffer[DANP_FTP_MAX_PAYLOAD_SIZE];
-    size_t offset = 0;
-    uint8_t flags;
-    bool more = true;
+    uint32_t delay_ms = danp_ftp_service_schedule_delay(ctx);
 
-    for (;;)
+    if (delay_ms > 0)
     {
-        danp_log_message(
-            DANP_LOG_LEVEL_INF,
-            "FTP service handling read request for file (len=%zu)",
-            file_id_len);
+        danp_port_sleep_ms(delay_ms);
+    }
+}
 
-        /* Open file for reading */
-        status = svc->config.fs.open(
-            &file_handle,
-            file_id,
-            file_id_len,
-            DANP_FTP_FS_MODE_READ,
-            svc->config.user_data);
+/**
+ * @brief Refill a token bucket and return how long to wait for enough tokens.
+ * @param bucket Pointer to the bucket.
+ * @param bytes Number of bytes about to be sent.
+ * @param now_ms Current uptime in milliseconds.
+ * @return Milliseconds to wait, 0 if the bytes may be sent now.
+ */
+static uint32_t danp_ftp_token_bucket_wait(
+    danp_ftp_token_bucket_t *bucket,
+    uint32_t bytes,
+    uint32_t now_ms)
+{
+    uint32_t burst;
+    uint64_t refill;
 
-        if (status < 0)
-        {
-            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service file open failed: %d", status);
+    if (bucket->rate_bps == 0)
+    {
+        return 0;
+    }
 
-            if (status == DANP_FTP_STATUS_FILE_NOT_FOUND)
-            {
-                response_payload[0] = DANP_FTP_RESP_FILE_NOT_FOUND;
-            }
-            else
-            {
-                response_payload[0] = DANP_FTP_RESP_ERROR;
-            }
+    burst = (uint32_t)(((uint64_t)bucket->rate_bps * DANP_FTP_SERVICE_RATE_BURST_MS) / 1000U);
+    if (burst < DANP_MAX_PACKET_SIZE)
+    {
+        burst = DANP_MAX_PACKET_SIZE;
+    }
 
-            danp_ftp_service_send_message(
-                ctx,
-                DANP_FTP_PACKET_TYPE_RESPONSE,
-                DANP_FTP_FLAG_NONE,
-                response_payload,
-                1);
-            break;
-        }
+    if (!bucket->primed)
+    {
+        bucket->tokens = burst;
+        bucket->last_ms = now_ms;
+        bucket->primed = true;
+    }
 
-        ctx->file_handle = file_handle;
-        ctx->file_open = true;
+    if (bucket->tokens > burst)
+    {
+        bucket->tokens = burst;
+    }
 
-        /* Send OK response */
-        response_payload[0] = DANP_FTP_RESP_OK;
-        status = danp_ftp_service_send_message(
-            ctx,
-            DANP_FTP_PACKET_TYPE_RESPONSE,
-            DANP_FTP_FLAG_NONE,
-            response_payload,
-            1);
+    refill = ((uint64_t)(now_ms - bucket->last_ms) * bucket->rate_bps) / 1000U;
+    if (refill >= burst - bucket->tokens)
+    {
+        bucket->tokens = burst;
+        bucket->last_ms = now_ms;
+    }
+    else if (refill > 0)
+    {
+        /* Advance by the time actually converted so fractions are not lost */
+        bucket->tokens += (uint32_t)refill;
+        bucket->last_ms += (uint32_t)((refill * 1000U) / bucket->rate_bps);
+    }
 
-        if (status < 0)
-        {
-            break;
-        }
+    if (bucket->tokens >= bytes)
+    {
+        return 0;
+    }
 
-        ctx->sequence_number++;
+    return (uint32_t)((((uint64_t)(bytes - bucket->tokens) * 1000U) + bucket->rate_bps - 1) / bucket->rate_bps);
+}
 
-        /* Send file data in chunks */
-        while (more)
+/**
+ * @brief Rate of the class bucket of a priority. Caller holds sched_lock.
+ *
+ * The global rate is split between the classes with active sessions in
+ * proportion to their weights, so a lone class gets all of it.
+ *
+ * @param svc Pointer to the service context.
+ * @param priority Class of the sending session.
+ * @return Class rate in bytes per second, 0 = unlimited.
+ */
+static uint32_t danp_ftp_service_class_rate(
+    const danp_ftp_service_context_t *svc,
+    danp_ftp_service_priority_t priority)
+{
+    uint32_t total = ftp_priority_weights[priority];
+
+    for (uint32_t p = 0; p < DANP_FTP_SERVICE_PRIORITY_COUNT; p++)
+    {
+        if (p != (uint32_t)priority && svc->active_sessions[p] > 0)
         {
-            danp_ftp_status_t read_result = svc->config.fs.read(
-                file_handle,
-                offset,
-                data_buffer,
-                DANP_FTP_MAX_PAYLOAD_SIZE,
-                svc->config.user_data);
+            total += ftp_priority_weights[p];
+        }
+    }
 
-            if (read_result < 0)
-            {
-                danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service file read failed: %d", read_result);
-                status = read_result;
-                break;
-            }
+    return (uint32_t)(((uint64_t)svc->tx_bucket.rate_bps * ftp_priority_weights[priority]) / total);
+}
 
-            if (read_result == 0)
-            {
-                more = false;
-                continue;
-            }
+/**
+ * @brief Take tokens from the global, class and session buckets if all allow a send.
+ * @param ctx Pointer to the client context.
+ * @param bytes Number of bytes about to be sent.
+ * @return Milliseconds to wait before trying again, 0 if the tokens were taken.
+ */
+static uint32_t danp_ftp_service_rate_try(danp_ftp_client_context_t *ctx, uint32_t bytes)
+{
+    danp_ftp_service_context_t *svc = ctx->service;
+    danp_ftp_token_bucket_t *class_bucket = &svc->class_bucket[ctx->priority];
+    uint32_t now_ms;
+    uint32_t wait_ms;
+    uint32_t other_wait_ms;
 
-            /* Check if this is the last chunk */
-            danp_ftp_status_t peek_result = svc->config.fs.read(
-                file_handle,
-                offset + read_result,
-                data_buffer + read_result,
-                1,
-                svc->config.user_data);
+    danp_port_mutex_lock(&svc->sched_lock);
 
-            if (peek_result <= 0)
-            {
-                more = false;
-            }
+    now_ms = danp_port_uptime_ms();
+    ctx->tx_bucket.rate_bps = svc->session_rate_bps;
+    class_bucket->rate_bps = danp_ftp_service_class_rate(svc, ctx->priority);
 
-            flags = DANP_FTP_FLAG_NONE;
-            if (offset == 0)
-            {
-                flags |= DANP_FTP_FLAG_FIRST_CHUNK;
-            }
-            if (!more)
-            {
-                flags |= DANP_FTP_FLAG_LAST_CHUNK;
-            }
+    wait_ms = danp_ftp_token_bucket_wait(&svc->tx_bucket, bytes, now_ms);
+    other_wait_ms = danp_ftp_token_bucket_wait(class_bucket, bytes, now_ms);
+    if (other_wait_ms > wait_ms)
+    {
+        wait_ms = other_wait_ms;
+    }
+    other_wait_ms = danp_ftp_token_bucket_wait(&ctx->tx_bucket, bytes, now_ms);
+    if (other_wait_ms > wait_ms)
+    {
+        wait_ms = other_wait_ms;
+    }
 
-            status = danp_ftp_service_send_message(
-                ctx,
-                DANP_FTP_PACKET_TYPE_DATA,
-                flags,
-                data_buffer,
-                (uint16_t)read_result);
+    if (wait_ms == 0)
+    {
+        if (svc->tx_bucket.rate_bps > 0)
+        {
+            svc->tx_bucket.tokens -= bytes;
+        }
+        if (class_bucket->rate_bps > 0)
+        {
+            class_bucket->tokens -= bytes;
+        }
+        if (ctx->tx_bucket.rate_bps > 0)
+        {
+            ctx->tx_bucket.tokens -= bytes;
+        }
+    }
+    else
+    {
+        svc->throttled_ms += wait_ms;
+    }
 
-            if (status < 0)
-            {
-                break;
-            }
+    danp_port_mutex_unlock(&svc->sched_lock);
 
-            /* Wait for ACK */
-            status = danp_ftp_service_wait_for_ack(
-                ctx,
-                ctx->sequence_number,
-                DANP_FTP_SERVICE_TIMEOUT_MS);
+    return wait_ms;
+}
 
-            if (status < 0)
-            {
-                danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service ACK timeout");
-                break;
-            }
+/**
+ * @brief Block until both the global and the session bucket allow a send.
+ * @param ctx Pointer to the client context.
+ * @param bytes Number of bytes about to be sent.
+ */
+static void danp_ftp_service_rate_acquire(danp_ftp_client_context_t *ctx, uint32_t bytes)
+{
+    uint32_t wait_ms;
 
-            offset += read_result;
-            ctx->sequence_number++;
+    for (;;)
+    {
+        wait_ms = danp_ftp_service_rate_try(ctx, bytes);
+        if (wait_ms == 0)
+        {
+            break;
         }
 
-        /* Close file */
-        svc->config.fs.close(file_handle, svc->config.user_data);
-        ctx->file_open = false;
+        danp_port_sleep_ms(wait_ms);
+    }
+}
 
-        if (status >= 0)
-        {
-            danp_log_message(
-                DANP_LOG_LEVEL_INF,
-                "FTP service read complete: %zu bytes",
-                offset);
-            status = (danp_ftp_status_t)offset;
-        }
+/**
+ * @brief Account sent bytes towards the achieved rate.
+ * @param svc Pointer to the service context.
+ * @param bytes Number of bytes sent.
+ */
+static void danp_ftp_service_rate_account(danp_ftp_service_context_t *svc, uint32_t bytes)
+{
+    uint32_t now_ms;
+    uint32_t elapsed_ms;
 
-        break;
+    danp_port_mutex_lock(&svc->sched_lock);
+
+    now_ms = danp_port_uptime_ms();
+    svc->bytes_sent += bytes;
+    svc->rate_window_bytes += bytes;
+
+    elapsed_ms = now_ms - svc->rate_window_start_ms;
+    if (elapsed_ms >= DANP_FTP_SERVICE_RATE_WINDOW_MS)
+    {
+        svc->achieved_bps = (uint32_t)(((uint64_t)svc->rate_window_bytes * 1000U) / elapsed_ms);
+        svc->rate_window_bytes = 0;
+        svc->rate_window_start_ms = now_ms;
     }
 
-    return status;
+    danp_port_mutex_unlock(&svc->sched_lock);
 }
 
 /**
- * @brief Handle a file write request from client.
+ * @brief Count a retransmit in the session and in the service totals.
  * @param ctx Pointer to the client context.
- * @param file_id File identifier.
- * @param file_id_len Length of file identifier.
+ */
+static void danp_ftp_service_count_retransmit(danp_ftp_client_context_t *ctx)
+{
+    ctx->retransmits++;
+
+    danp_port_mutex_lock(&ctx->service->sched_lock);
+    ctx->service->retransmits++;
+    danp_port_mutex_unlock(&ctx->service->sched_lock);
+}
+
+/**
+ * @brief Send an FTP protocol message without waiting for rate limit tokens.
+ * @param ctx Pointer to the client context.
+ * @param type Packet type.
+ * @param flags Packet flags.
+ * @param payload Pointer to the payload data.
+ * @param payload_length Length of the payload.
  * @return Status code.
  */
-static danp_ftp_status_t danp_ftp_service_handle_write_request(
+static danp_ftp_status_t danp_ftp_service_transmit(
     danp_ftp_client_context_t *ctx,
-    const uint8_t *file_id,
-    size_t file_id_len)
+    danp_ftp_packet_type_t type,
+    uint8_t flags,
+    const uint8_t *payload,
+    uint16_t payload_length)
 {
     danp_ftp_status_t status = DANP_FTP_STATUS_OK;
-    danp_ftp_service_context_t *svc = ctx->service;
-    danp_ftp_file_handle_t file_handle = 0;
-    danp_ftp_message_t data_msg;
-    uint8_t response_payload[1];
-    size_t offset = 0;
-    bool more = true;
+    danp_ftp_message_t message;
+    int32_t send_result;
 
     for (;;)
     {
-        danp_log_message(
-            DANP_LOG_LEVEL_INF,
-            "FTP service handling write request for file (len=%zu)",
-            file_id_len);
-
-        /* Open file for writing */
-        status = svc->config.fs.open(
-            &file_handle,
-            file_id,
-            file_id_len,
-            DANP_FTP_FS_MODE_WRITE,
-            svc->config.user_data);
-
-        if (status < 0)
+        if (!ctx || !ctx->socket)
         {
-            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service file open failed: %d", status);
-            response_payload[0] = DANP_FTP_RESP_ERROR;
-
-            danp_ftp_service_send_message(
-                ctx,
-                DANP_FTP_PACKET_TYPE_RESPONSE,
-                DANP_FTP_FLAG_NONE,
-                response_payload,
-                1);
+            status = DANP_FTP_STATUS_INVALID_PARAM;
             break;
         }
 
-        ctx->file_handle = file_handle;
-        ctx->file_open = true;
-
-        /* Send OK response */
-        response_payload[0] = DANP_FTP_RESP_OK;
-        status = danp_ftp_service_send_message(
-            ctx,
-            DANP_FTP_PACKET_TYPE_RESPONSE,
-            DANP_FTP_FLAG_NONE,
-            response_payload,
-            1);
-
-        if (status < 0)
+        if (payload_length > DANP_FTP_MAX_PAYLOAD_SIZE)
         {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service payload too large: %u", payload_length);
+            status = DANP_FTP_STATUS_INVALID_PARAM;
             break;
         }
 
-        ctx->sequence_number++;
+        memset(&message, 0, sizeof(danp_ftp_message_t));
 
-        /* Receive file data chunks */
-        while (more)
+        message.header.type = (uint8_t)type;
+        message.header.flags = flags;
+        message.header.sequence_number = ctx->sequence_number;
+        message.header.payload_length = payload_length;
+
+        if (payload && payload_length > 0)
         {
-            status = danp_ftp_service_receive_message(
-                ctx,
-                &data_msg,
-                DANP_FTP_SERVICE_TIMEOUT_MS);
+            memcpy(message.payload, payload, payload_length);
+        }
 
-            if (status < 0)
-            {
-                danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service receive data failed");
-                break;
-            }
+        DANP_FTP_PROF_BEGIN(crc_start);
+        message.header.crc = danp_ftp_service_calculate_crc(
+            message.payload,
+            payload_length);
+        DANP_FTP_PROF_END(ctx, DANP_FTP_SERVICE_PROF_CRC, crc_start);
 
-            if (data_msg.header.type != DANP_FTP_PACKET_TYPE_DATA)
+        danp_trace(DANP_TRACE_FTP_TX, ctx->sequence_number, ((uint32_t)type << 16) | payload_length);
+
+        DANP_FTP_PROF_BEGIN(send_start);
+        send_result = danp_send(
+            ctx->socket,
+            &message,
+            sizeof(danp_ftp_header_t) + payload_length);
+        DANP_FTP_PROF_END(ctx, DANP_FTP_SERVICE_PROF_SEND, send_start);
+
+        if (send_result < 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service send failed: %d", send_result);
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+
+        danp_ftp_service_rate_account(ctx->service, sizeof(danp_ftp_header_t) + payload_length);
+
+        danp_log_message(
+            DANP_LOG_LEVEL_DBG,
+            "FTP SVC TX: type=%u flags=0x%02X seq=%u len=%u",
+            type,
+            flags,
+            ctx->sequence_number,
+            payload_length);
+
+        break;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Send an FTP protocol message from service.
+ * @param ctx Pointer to the client context.
+ * @param type Packet type.
+ * @param flags Packet flags.
+ * @param payload Pointer to the payload data.
+ * @param payload_length Length of the payload.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_send_message(
+    danp_ftp_client_context_t *ctx,
+    danp_ftp_packet_type_t type,
+    uint8_t flags,
+    const uint8_t *payload,
+    uint16_t payload_length)
+{
+    if (ctx && ctx->service && payload_length <= DANP_FTP_MAX_PAYLOAD_SIZE)
+    {
+        danp_ftp_service_rate_acquire(ctx, sizeof(danp_ftp_header_t) + payload_length);
+    }
+
+    return danp_ftp_service_transmit(ctx, type, flags, payload, payload_length);
+}
+
+/**
+ * @brief Verify the CRC of a received FTP protocol message.
+ * @param ctx Pointer to the client context.
+ * @param message Pointer to the received message.
+ * @return Payload length on success, negative status on error.
+ */
+static danp_ftp_status_t danp_ftp_service_check_message(
+    danp_ftp_client_context_t *ctx,
+    const danp_ftp_message_t *message)
+{
+    uint32_t calculated_crc;
+
+    (void)ctx;
+
+    DANP_FTP_PROF_BEGIN(crc_start);
+    calculated_crc = danp_ftp_service_calculate_crc(
+        message->payload,
+        message->header.payload_length);
+    DANP_FTP_PROF_END(ctx, DANP_FTP_SERVICE_PROF_CRC, crc_start);
+
+    if (calculated_crc != message->header.crc)
+    {
+        danp_log_message(
+            DANP_LOG_LEVEL_WRN,
+            "FTP service CRC mismatch: expected=0x%08X got=0x%08X",
+            message->header.crc,
+            calculated_crc);
+        return DANP_FTP_STATUS_TRANSFER_FAILED;
+    }
+
+    danp_trace(
+        DANP_TRACE_FTP_RX,
+        message->header.sequence_number,
+        ((uint32_t)message->header.type << 16) | message->header.payload_length);
+
+    danp_log_message(
+        DANP_LOG_LEVEL_DBG,
+        "FTP SVC RX: type=%u flags=0x%02X seq=%u len=%u",
+        message->header.type,
+        message->header.flags,
+        message->header.sequence_number,
+        message->header.payload_length);
+
+    return (danp_ftp_status_t)message->header.payload_length;
+}
+
+/**
+ * @brief Receive an FTP protocol message.
+ * @param ctx Pointer to the client context.
+ * @param message Pointer to store the received message.
+ * @param timeout_ms Timeout in milliseconds.
+ * @return Status code or bytes received.
+ */
+static danp_ftp_status_t danp_ftp_service_receive_message(
+    danp_ftp_client_context_t *ctx,
+    danp_ftp_message_t *message,
+    uint32_t timeout_ms)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    int32_t recv_result;
+
+    for (;;)
+    {
+        if (!ctx || !ctx->socket || !message)
+        {
+            status = DANP_FTP_STATUS_INVALID_PARAM;
+            break;
+        }
+
+        memset(message, 0, sizeof(danp_ftp_message_t));
+
+        DANP_FTP_PROF_BEGIN(recv_start);
+        recv_result = danp_recv(
+            ctx->socket,
+            message,
+            sizeof(danp_ftp_message_t),
+            timeout_ms);
+        DANP_FTP_PROF_END(ctx, DANP_FTP_SERVICE_PROF_RECV, recv_start);
+
+        if (recv_result < (int32_t)sizeof(danp_ftp_header_t))
+        {
+            if (danp_port_recv_timed_out(recv_result))
+            {
+                danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service receive timeout");
+            }
+            else
+            {
+                danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service receive failed: %d", recv_result);
+            }
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+
+        status = danp_ftp_service_check_message(ctx, message);
+
+        break;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Wait for ACK from client.
+ *
+ * Duplicate ACKs of earlier chunks, caused by retransmits, are skipped
+ * until the timeout expires.
+ *
+ * @param ctx Pointer to the client context.
+ * @param expected_seq Expected sequence number.
+ * @param timeout_ms Timeout in milliseconds.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_wait_for_ack(
+    danp_ftp_client_context_t *ctx,
+    uint16_t expected_seq,
+    uint32_t timeout_ms)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    danp_ftp_message_t message;
+    uint32_t start_ms = danp_port_uptime_ms();
+    uint32_t elapsed_ms;
+
+    for (;;)
+    {
+        elapsed_ms = danp_port_uptime_ms() - start_ms;
+        if (elapsed_ms >= timeout_ms)
+        {
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+
+        status = danp_ftp_service_receive_message(ctx, &message, timeout_ms - elapsed_ms);
+        if (status < 0)
+        {
+            break;
+        }
+
+        if (message.header.type == DANP_FTP_PACKET_TYPE_ACK)
+        {
+            if (message.header.sequence_number == expected_seq)
+            {
+                status = DANP_FTP_STATUS_OK;
+                break;
+            }
+
+            danp_log_message(
+                DANP_LOG_LEVEL_DBG,
+                "FTP service skipping stale ACK: expected=%u got=%u",
+                expected_seq,
+                message.header.sequence_number);
+            continue;
+        }
+        else if (message.header.type == DANP_FTP_PACKET_TYPE_NACK)
+        {
+            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service received NACK");
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+        else
+        {
+            danp_log_message(
+                DANP_LOG_LEVEL_WRN,
+                "FTP service unexpected packet type: %u",
+                message.header.type);
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+    }
+
+    return status;
+}
+
+/**
+ * @brief Feed one RTT measurement into the session estimator.
+ *
+ * Jacobson/Karels smoothing as in RFC 6298, kept in fixed point:
+ * SRTT += (R - SRTT) / 8, RTTVAR += (|R - SRTT| - RTTVAR) / 4,
+ * RTO = SRTT + 4 * RTTVAR, clamped to [MIN_RTO, MAX_RTO].
+ *
+ * @param ctx Pointer to the client context.
+ * @param rtt_ms Measured round trip time in milliseconds.
+ */
+static void danp_ftp_service_rtt_sample(danp_ftp_client_context_t *ctx, uint32_t rtt_ms)
+{
+    int32_t delta;
+    uint32_t rto_ms;
+
+    if (!ctx->rtt_valid)
+    {
+        ctx->srtt_x8 = rtt_ms << 3;
+        ctx->rttvar_x4 = rtt_ms << 1;
+        ctx->rtt_valid = true;
+    }
+    else
+    {
+        delta = (int32_t)rtt_ms - (int32_t)(ctx->srtt_x8 >> 3);
+        ctx->srtt_x8 = (uint32_t)((int32_t)ctx->srtt_x8 + delta);
+        if (delta < 0)
+        {
+            delta = -delta;
+        }
+        delta -= (int32_t)(ctx->rttvar_x4 >> 2);
+        ctx->rttvar_x4 = (uint32_t)((int32_t)ctx->rttvar_x4 + delta);
+    }
+
+    rto_ms = (ctx->srtt_x8 >> 3) + ((ctx->rttvar_x4 > 0) ? ctx->rttvar_x4 : 1U);
+    if (rto_ms < DANP_FTP_SERVICE_MIN_RTO_MS)
+    {
+        rto_ms = DANP_FTP_SERVICE_MIN_RTO_MS;
+    }
+    if (rto_ms > DANP_FTP_SERVICE_MAX_RTO_MS)
+    {
+        rto_ms = DANP_FTP_SERVICE_MAX_RTO_MS;
+    }
+
+    ctx->rto_ms = rto_ms;
+}
+
+/**
+ * @brief Send a message and wait for its ACK, retransmitting on loss.
+ *
+ * Waits use the adaptive RTO and back off exponentially. RTT is only
+ * sampled from chunks acknowledged without a retransmit (Karn).
+ *
+ * @param ctx Pointer to the client context.
+ * @param type Packet type.
+ * @param flags Packet flags.
+ * @param payload Pointer to the payload data.
+ * @param payload_length Length of the payload.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_send_reliable(
+    danp_ftp_client_context_t *ctx,
+    danp_ftp_packet_type_t type,
+    uint8_t flags,
+    const uint8_t *payload,
+    uint16_t payload_length)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    uint32_t attempt = 0;
+    uint32_t sent_ms;
+
+    for (;;)
+    {
+        sent_ms = danp_port_uptime_ms();
+
+        status = danp_ftp_service_send_message(ctx, type, flags, payload, payload_length);
+        if (status < 0)
+        {
+            break;
+        }
+
+        danp_trace(DANP_TRACE_FTP_ACK_WAIT_BEGIN, ctx->sequence_number, ctx->rto_ms);
+        DANP_FTP_PROF_BEGIN(ack_start);
+        status = danp_ftp_service_wait_for_ack(ctx, ctx->sequence_number, ctx->rto_ms);
+        DANP_FTP_PROF_END(ctx, DANP_FTP_SERVICE_PROF_ACK_WAIT, ack_start);
+        danp_trace(DANP_TRACE_FTP_ACK_WAIT_END, ctx->sequence_number, (uint32_t)status);
+        if (status >= 0)
+        {
+            if (attempt == 0)
+            {
+                danp_ftp_service_rtt_sample(ctx, danp_port_uptime_ms() - sent_ms);
+            }
+            break;
+        }
+
+        if (attempt >= DANP_FTP_SERVICE_MAX_RETRANSMITS)
+        {
+            danp_log_message(
+                DANP_LOG_LEVEL_ERR,
+                "FTP service giving up on seq=%u after %u retransmits",
+                ctx->sequence_number,
+                attempt);
+            break;
+        }
+
+        attempt++;
+        danp_ftp_service_count_retransmit(ctx);
+        ctx->rto_ms = (ctx->rto_ms > DANP_FTP_SERVICE_MAX_RTO_MS / 2) ?
+                      DANP_FTP_SERVICE_MAX_RTO_MS : ctx->rto_ms * 2;
+
+        danp_log_message(
+            DANP_LOG_LEVEL_WRN,
+            "FTP service retransmit seq=%u attempt=%u rto=%u ms",
+            ctx->sequence_number,
+            attempt,
+            ctx->rto_ms);
+    }
+
+    return status;
+}
+
+/**
+ * @brief Acknowledge a data message by sequence number.
+ *
+ * Used to repeat the ACK of a chunk the client retransmitted because our
+ * earlier ACK was lost.
+ *
+ * @param ctx Pointer to the client context.
+ * @param sequence_number Sequence number to acknowledge.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_send_ack(
+    danp_ftp_client_context_t *ctx,
+    uint16_t sequence_number)
+{
+    danp_ftp_status_t status;
+    uint16_t current = ctx->sequence_number;
+
+    ctx->sequence_number = sequence_number;
+    status = danp_ftp_service_send_message(
+        ctx,
+        DANP_FTP_PACKET_TYPE_ACK,
+        DANP_FTP_FLAG_NONE,
+        NULL,
+        0);
+    ctx->sequence_number = current;
+
+    return status;
+}
+
+/**
+ * @brief Wait for the ACK that closes an FEC block.
+ * @param ctx Pointer to the client context.
+ * @param block_seq Sequence number of the first chunk of the block.
+ * @param timeout_ms Timeout in milliseconds.
+ * @param missing Pointer to store the bitmap of chunks the client could not recover.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_wait_for_block_ack(
+    danp_ftp_client_context_t *ctx,
+    uint16_t block_seq,
+    uint32_t timeout_ms,
+    uint32_t *missing)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    danp_ftp_message_t message;
+    uint32_t start_ms = danp_port_uptime_ms();
+    uint32_t elapsed_ms;
+
+    for (;;)
+    {
+        elapsed_ms = danp_port_uptime_ms() - start_ms;
+        if (elapsed_ms >= timeout_ms)
+        {
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+
+        status = danp_ftp_service_receive_message(ctx, &message, timeout_ms - elapsed_ms);
+        if (status < 0)
+        {
+            break;
+        }
+
+        if (message.header.type != DANP_FTP_PACKET_TYPE_ACK)
+        {
+            danp_log_message(
+                DANP_LOG_LEVEL_WRN,
+                "FTP service unexpected packet type: %u",
+                message.header.type);
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+
+        if (message.header.sequence_number != block_seq)
+        {
+            danp_log_message(
+                DANP_LOG_LEVEL_DBG,
+                "FTP service skipping stale block ACK: expected=%u got=%u",
+                block_seq,
+                message.header.sequence_number);
+            continue;
+        }
+
+        *missing = (message.header.payload_length >= DANP_FTP_FEC_ACK_SIZE) ?
+                   danp_ftp_service_get_u32(message.payload) : 0U;
+        status = DANP_FTP_STATUS_OK;
+        break;
+    }
+
+    return status;
+}
+
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_ASYNC)
+/**
+ * @brief Wait for an async filesystem operation if it is still pending.
+ * @param ctx Pointer to the client context.
+ * @param result Value returned by the async callback.
+ * @return Result of the operation.
+ */
+static danp_ftp_status_t danp_ftp_service_fs_wait(danp_ftp_client_context_t *ctx, danp_ftp_status_t result)
+{
+    if (result == DANP_FTP_SERVICE_FS_PENDING)
+    {
+        danp_port_sem_take(&ctx->fs_op.done, DANP_PORT_WAIT_FOREVER);
+        result = ctx->fs_op.result;
+    }
+
+    return result;
+}
+#endif
+
+/**
+ * @brief Read transfer data through fs.read_async when the backend has it, fs.read otherwise.
+ * @param ctx Pointer to the client context with the file open.
+ * @param offset Offset in file.
+ * @param buffer Buffer to read data into.
+ * @param length Length of data to read.
+ * @return Bytes read, negative status on error.
+ */
+static danp_ftp_status_t danp_ftp_service_fs_read(
+    danp_ftp_client_context_t *ctx,
+    size_t offset,
+    uint8_t *buffer,
+    uint16_t length)
+{
+    danp_ftp_service_context_t *svc = ctx->service;
+
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_ASYNC)
+    if (svc->config.fs.read_async)
+    {
+        return danp_ftp_service_fs_wait(
+            ctx,
+            svc->config.fs.read_async(ctx->file_handle, offset, buffer, length, &ctx->fs_op, svc->config.user_data));
+    }
+#endif
+
+    return svc->config.fs.read(ctx->file_handle, offset, buffer, length, svc->config.user_data);
+}
+
+/**
+ * @brief Write transfer data through fs.write_async when the backend has it, fs.write otherwise.
+ * @param ctx Pointer to the client context with the file open.
+ * @param offset Offset in file.
+ * @param data Data to write.
+ * @param length Length of data to write.
+ * @return Bytes written, negative status on error.
+ */
+static danp_ftp_status_t danp_ftp_service_fs_write(
+    danp_ftp_client_context_t *ctx,
+    size_t offset,
+    const uint8_t *data,
+    uint16_t length)
+{
+    danp_ftp_service_context_t *svc = ctx->service;
+
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_ASYNC)
+    if (svc->config.fs.write_async)
+    {
+        return danp_ftp_service_fs_wait(
+            ctx,
+            svc->config.fs.write_async(ctx->file_handle, offset, data, length, &ctx->fs_op, svc->config.user_data));
+    }
+#endif
+
+    return svc->config.fs.write(ctx->file_handle, offset, data, length, svc->config.user_data);
+}
+
+/**
+ * @brief Get the READ chunk at an offset, refilling the window with one fs.readv call.
+ *
+ * The window holds DANP_FTP_SERVICE_FS_VEC_CHUNKS chunks and the byte
+ * after them, which tells whether the last chunk ends the file. A
+ * retransmit finds its chunk still in the window.
+ *
+ * @param ctx Pointer to the client context with the file open.
+ * @param window Pointer to the read window.
+ * @param offset File offset of the chunk.
+ * @param chunk Pointer to store the chunk data.
+ * @param more Pointer to store whether data follows the chunk.
+ * @return Chunk length on success, negative status on error.
+ */
+static danp_ftp_status_t danp_ftp_service_window_read(
+    danp_ftp_client_context_t *ctx,
+    danp_ftp_service_read_window_t *window,
+    size_t offset,
+    uint8_t **chunk,
+    bool *more)
+{
+    danp_ftp_service_context_t *svc = ctx->service;
+    danp_ftp_service_fs_iovec_t iov[DANP_FTP_SERVICE_FS_VEC_CHUNKS + 1];
+    danp_ftp_status_t result;
+    size_t want = DANP_FTP_SERVICE_FS_VEC_CHUNKS * DANP_FTP_MAX_PAYLOAD_SIZE;
+    size_t position;
+    uint8_t count = 0;
+
+    if (!window->valid || offset < window->offset || offset - window->offset >= window->length)
+    {
+        if (offset >= ctx->range_end)
+        {
+            want = 0;
+        }
+        else if (ctx->range_end - offset < want)
+        {
+            want = ctx->range_end - offset;
+        }
+
+        for (position = 0; position < want; position += DANP_FTP_MAX_PAYLOAD_SIZE)
+        {
+            iov[count].base = &window->data[position];
+            iov[count].length = (uint16_t)((want - position < DANP_FTP_MAX_PAYLOAD_SIZE) ?
+                                           want - position : DANP_FTP_MAX_PAYLOAD_SIZE);
+            count++;
+        }
+        if (want > 0 && offset + want < ctx->range_end)
+        {
+            iov[count].base = &window->data[want];
+            iov[count].length = 1;
+            count++;
+        }
+
+        danp_trace(DANP_TRACE_FTP_FS_BEGIN, DANP_TRACE_FS_READ, (uint32_t)offset);
+        DANP_FTP_PROF_BEGIN(read_start);
+        result = (count > 0) ?
+                 svc->config.fs.readv(ctx->file_handle, offset, iov, count, svc->config.user_data) : 0;
+        DANP_FTP_PROF_END(ctx, DANP_FTP_SERVICE_PROF_FS_READ, read_start);
+        danp_trace(DANP_TRACE_FTP_FS_END, DANP_TRACE_FS_READ, (uint32_t)result);
+
+        if (result < 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service file readv failed: %d", result);
+            window->valid = false;
+            return result;
+        }
+
+        window->offset = offset;
+        window->length = ((size_t)result < want) ? (size_t)result : want;
+        window->more = ((size_t)result > want);
+        window->valid = true;
+    }
+
+    position = offset - window->offset;
+    result = (danp_ftp_status_t)((window->length - position < DANP_FTP_MAX_PAYLOAD_SIZE) ?
+                                 window->length - position : DANP_FTP_MAX_PAYLOAD_SIZE);
+    *chunk = &window->data[position];
+    *more = (position + (size_t)result < window->length) || window->more;
+
+    return result;
+}
+
+/**
+ * @brief Pass the WRITE chunks held in the window to storage with one fs.writev call.
+ * @param ctx Pointer to the client context with the file open.
+ * @param window Pointer to the write window.
+ * @return Bytes written, negative status on error.
+ */
+static danp_ftp_status_t danp_ftp_service_window_flush(
+    danp_ftp_client_context_t *ctx,
+    danp_ftp_service_write_window_t *window)
+{
+    danp_ftp_service_context_t *svc = ctx->service;
+    danp_ftp_service_fs_iovec_t iov[DANP_FTP_SERVICE_FS_VEC_CHUNKS];
+    danp_ftp_status_t result;
+    size_t expected = 0;
+
+    if (window->count == 0)
+    {
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < window->count; i++)
+    {
+        iov[i].base = window->messages[i].payload;
+        iov[i].length = window->messages[i].header.payload_length;
+        expected += iov[i].length;
+    }
+
+    danp_trace(DANP_TRACE_FTP_FS_BEGIN, DANP_TRACE_FS_WRITE, (uint32_t)window->offset);
+    DANP_FTP_PROF_BEGIN(write_start);
+    result = svc->config.fs.writev(ctx->file_handle, window->offset, iov, window->count, svc->config.user_data);
+    DANP_FTP_PROF_END(ctx, DANP_FTP_SERVICE_PROF_FS_WRITE, write_start);
+    danp_trace(DANP_TRACE_FTP_FS_END, DANP_TRACE_FS_WRITE, (uint32_t)result);
+
+    if (result >= 0 && (size_t)result != expected)
+    {
+        result = DANP_FTP_STATUS_ERROR;
+    }
+
+    window->offset += expected;
+    window->count = 0;
+
+    return result;
+}
+
+/**
+ * @brief Read one FEC data chunk.
+ *
+ * The client places chunks by sequence number, so every chunk but the
+ * last one must be full; short file system reads are repeated.
+ *
+ * @param ctx Pointer to the client context.
+ * @param offset File offset of the chunk.
+ * @param buffer Buffer of DANP_FTP_FEC_CHUNK_SIZE + 1 bytes.
+ * @param more Pointer to store whether data follows the chunk.
+ * @return Chunk length on success, negative status on error.
+ */
+static danp_ftp_status_t danp_ftp_service_fec_read_chunk(
+    danp_ftp_client_context_t *ctx,
+    size_t offset,
+    uint8_t *buffer,
+    bool *more)
+{
+    danp_ftp_status_t result = 0;
+    uint16_t length = 0;
+    uint16_t limit = DANP_FTP_FEC_CHUNK_SIZE;
+
+    *more = false;
+
+    if (offset >= ctx->range_end)
+    {
+        limit = 0;
+    }
+    else if (ctx->range_end - offset < limit)
+    {
+        limit = (uint16_t)(ctx->range_end - offset);
+    }
+
+    danp_trace(DANP_TRACE_FTP_FS_BEGIN, DANP_TRACE_FS_READ, (uint32_t)offset);
+    DANP_FTP_PROF_BEGIN(read_start);
+    while (length < limit)
+    {
+        result = danp_ftp_service_fs_read(ctx, offset + length, buffer + length, limit - length);
+        if (result <= 0)
+        {
+            break;
+        }
+        length += (uint16_t)result;
+    }
+
+    if (result >= 0 && length == DANP_FTP_FEC_CHUNK_SIZE && offset + length < ctx->range_end)
+    {
+        /* Peek one byte to tell whether this is the last chunk */
+        result = danp_ftp_service_fs_read(ctx, offset + length, buffer + length, 1);
+        *more = (result > 0);
+    }
+    DANP_FTP_PROF_END(ctx, DANP_FTP_SERVICE_PROF_FS_READ, read_start);
+    danp_trace(DANP_TRACE_FTP_FS_END, DANP_TRACE_FS_READ, (uint32_t)result);
+
+    if (result < 0)
+    {
+        danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service file read failed: %d", result);
+        return result;
+    }
+
+    return (danp_ftp_status_t)length;
+}
+
+/**
+ * @brief Send a message under an explicit sequence number.
+ * @param ctx Pointer to the client context.
+ * @param sequence_number Sequence number to send under.
+ * @param flags Packet flags.
+ * @param payload Pointer to the payload data.
+ * @param payload_length Length of the payload.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_fec_send(
+    danp_ftp_client_context_t *ctx,
+    uint16_t sequence_number,
+    uint8_t flags,
+    const uint8_t *payload,
+    uint16_t payload_length)
+{
+    danp_ftp_status_t status;
+    uint16_t current = ctx->sequence_number;
+
+    ctx->sequence_number = sequence_number;
+    status = danp_ftp_service_send_message(
+        ctx,
+        DANP_FTP_PACKET_TYPE_DATA,
+        flags,
+        payload,
+        payload_length);
+    ctx->sequence_number = current;
+
+    return status;
+}
+
+/**
+ * @brief Stream an open file in FEC blocks.
+ *
+ * Each block is up to fec_k data chunks followed by fec_r XOR parity
+ * chunks; parity j covers the chunks whose index is j modulo fec_r, so
+ * the client rebuilds one loss per residue class without a round trip.
+ * Parity chunks travel under the sequence number of the first chunk of
+ * the block, the last one is flagged BLOCK_END and answered with a
+ * bitmap of chunks the client still lacks. Those are retransmitted, and
+ * the parity is repeated if the block ACK itself does not arrive.
+ *
+ * @param ctx Pointer to the client context.
+ * @param fec_k Data chunks per block.
+ * @param fec_r Parity chunks per block.
+ * @param offset Pointer to the file offset, advanced as blocks complete.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_read_fec(
+    danp_ftp_client_context_t *ctx,
+    uint8_t fec_k,
+    uint8_t fec_r,
+    size_t *offset)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    uint8_t parity[DANP_FTP_FEC_MAX_R][DANP_FTP_MAX_PAYLOAD_SIZE];
+    uint16_t parity_span[DANP_FTP_FEC_MAX_R];
+    uint16_t parity_length[DANP_FTP_FEC_MAX_R];
+    uint8_t chunk[DANP_FTP_FEC_CHUNK_SIZE + 1]; /* +1 for the EOF peek byte */
+    danp_ftp_status_t length;
+    uint16_t block_seq;
+    size_t block_offset;
+    uint8_t count;
+    uint8_t parity_count;
+    uint8_t group;
+    uint8_t flags;
+    uint32_t missing;
+    uint32_t attempt;
+    uint32_t sent_ms;
+    bool more = true;
+    bool chunk_more;
+
+    while (more)
+    {
+        danp_ftp_service_schedule(ctx);
+
+        block_seq = ctx->sequence_number;
+        block_offset = *offset;
+        count = 0;
+        memset(parity, 0, sizeof(parity));
+        memset(parity_span, 0, sizeof(parity_span));
+        memset(parity_length, 0, sizeof(parity_length));
+
+        /* Data chunks, an empty file still sends one empty LAST chunk */
+        while (more && count < fec_k)
+        {
+            length = danp_ftp_service_fec_read_chunk(ctx, *offset, chunk, &more);
+            if (length < 0)
+            {
+                status = length;
+                break;
+            }
+
+            flags = (*offset == ctx->range_start) ? DANP_FTP_FLAG_FIRST_CHUNK : DANP_FTP_FLAG_NONE;
+            if (!more)
+            {
+                flags |= DANP_FTP_FLAG_LAST_CHUNK;
+            }
+
+            status = danp_ftp_service_send_message(
+                ctx,
+                DANP_FTP_PACKET_TYPE_DATA,
+                flags,
+                chunk,
+                (uint16_t)length);
+            if (status < 0)
+            {
+                break;
+            }
+
+            group = count % fec_r;
+            for (uint16_t i = 0; i < (uint16_t)length; i++)
+            {
+                parity[group][DANP_FTP_FEC_HEADER_SIZE + i] ^= chunk[i];
+            }
+            parity_length[group] ^= (uint16_t)length;
+            if ((uint16_t)length > parity_span[group])
+            {
+                parity_span[group] = (uint16_t)length;
+            }
+
+            count++;
+            *offset += (size_t)length;
+            ctx->sequence_number++;
+        }
+
+        if (status < 0)
+        {
+            break;
+        }
+
+        parity_count = (count < fec_r) ? count : fec_r;
+        for (group = 0; group < parity_count; group++)
+        {
+            parity[group][0] = group;
+            parity[group][1] = count;
+            danp_ftp_service_put_u16(&parity[group][2], parity_length[group]);
+        }
+
+        /* Parity, then wait for the block ACK and repair what it reports */
+        flags = DANP_FTP_FLAG_PARITY | (more ? DANP_FTP_FLAG_NONE : DANP_FTP_FLAG_LAST_CHUNK);
+        group = 0;
+        attempt = 0;
+        for (;;)
+        {
+            sent_ms = danp_port_uptime_ms();
+
+            for (; group < parity_count && status >= 0; group++)
+            {
+                status = danp_ftp_service_fec_send(
+                    ctx,
+                    block_seq,
+                    flags | ((group == parity_count - 1) ? DANP_FTP_FLAG_BLOCK_END : DANP_FTP_FLAG_NONE),
+                    parity[group],
+                    DANP_FTP_FEC_HEADER_SIZE + parity_span[group]);
+            }
+            if (status < 0)
+            {
+                break;
+            }
+
+            missing = 0;
+            danp_trace(DANP_TRACE_FTP_ACK_WAIT_BEGIN, block_seq, ctx->rto_ms);
+            DANP_FTP_PROF_BEGIN(ack_start);
+            status = danp_ftp_service_wait_for_block_ack(ctx, block_seq, ctx->rto_ms, &missing);
+            DANP_FTP_PROF_END(ctx, DANP_FTP_SERVICE_PROF_ACK_WAIT, ack_start);
+            danp_trace(DANP_TRACE_FTP_ACK_WAIT_END, block_seq, (uint32_t)status);
+
+            if (status >= 0 && missing == 0)
+            {
+                if (attempt == 0)
+                {
+                    danp_ftp_service_rtt_sample(ctx, danp_port_uptime_ms() - sent_ms);
+                }
+                break;
+            }
+
+            if (attempt >= DANP_FTP_SERVICE_MAX_RETRANSMITS)
+            {
+                danp_log_message(
+                    DANP_LOG_LEVEL_ERR,
+                    "FTP service giving up on FEC block seq=%u after %u retransmits",
+                    block_seq,
+                    attempt);
+                status = DANP_FTP_STATUS_TRANSFER_FAILED;
+                break;
+            }
+
+            attempt++;
+            danp_ftp_service_count_retransmit(ctx);
+
+            if (status < 0)
+            {
+                /* Block ACK lost or parity lost: repeat all of the parity */
+                ctx->rto_ms = (ctx->rto_ms > DANP_FTP_SERVICE_MAX_RTO_MS / 2) ?
+                              DANP_FTP_SERVICE_MAX_RTO_MS : ctx->rto_ms * 2;
+                group = 0;
+                status = DANP_FTP_STATUS_OK;
+                continue;
+            }
+
+            danp_log_message(
+                DANP_LOG_LEVEL_WRN,
+                "FTP service FEC block seq=%u repairing 0x%08X",
+                block_seq,
+                missing);
+
+            for (uint8_t i = 0; i < count && status >= 0; i++)
+            {
+                if (!(missing & (1UL << i)))
+                {
+                    continue;
+                }
+
+                length = danp_ftp_service_fec_read_chunk(
+                    ctx,
+                    block_offset + (size_t)i * DANP_FTP_FEC_CHUNK_SIZE,
+                    chunk,
+                    &chunk_more);
+                if (length < 0)
+                {
+                    status = length;
+                    break;
+                }
+
+                status = danp_ftp_service_fec_send(
+                    ctx,
+                    (uint16_t)(block_seq + i),
+                    (uint8_t)(((block_offset == ctx->range_start && i == 0) ? DANP_FTP_FLAG_FIRST_CHUNK : DANP_FTP_FLAG_NONE) |
+                              (chunk_more ? DANP_FTP_FLAG_NONE : DANP_FTP_FLAG_LAST_CHUNK)),
+                    chunk,
+                    (uint16_t)length);
+            }
+            if (status < 0)
+            {
+                break;
+            }
+
+            /* Only the BLOCK_END parity needs repeating to ask for the next bitmap */
+            group = parity_count - 1;
+        }
+
+        if (status < 0)
+        {
+            break;
+        }
+    }
+
+    return status;
+}
+
+/**
+ * @brief Find the size of an open file with one byte reads.
+ *
+ * Offsets double until a read comes back empty, then the gap between the
+ * last byte found and the first one missing is bisected, so this costs
+ * about 2 * log2(size) reads and needs nothing beyond fs.read.
+ *
+ * @param svc Pointer to the service context.
+ * @param file_handle Open file handle.
+ * @param size Pointer to store the file size.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_probe_size(
+    danp_ftp_service_context_t *svc,
+    danp_ftp_file_handle_t file_handle,
+    size_t *size)
+{
+    danp_ftp_status_t result;
+    uint8_t probe;
+    size_t low = 0;                              /* File holds at least low bytes */
+    size_t high = 1;                             /* File holds fewer than high bytes */
+    size_t mid;
+
+    for (;;)
+    {
+        result = svc->config.fs.read(file_handle, high - 1, &probe, 1, svc->config.user_data);
+        if (result <= 0 || high > SIZE_MAX / 2)
+        {
+            break;
+        }
+        low = high;
+        high *= 2;
+    }
+
+    while (result >= 0 && high - low > 1)
+    {
+        mid = low + (high - low) / 2;
+        result = svc->config.fs.read(file_handle, mid - 1, &probe, 1, svc->config.user_data);
+        if (result > 0)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    if (result < 0)
+    {
+        return result;
+    }
+
+    *size = low;
+
+    return DANP_FTP_STATUS_OK;
+}
+
+/**
+ * @brief Set the READ range of a session from the command arguments.
+ *
+ * The fields are u32 or, when ctx->wide is set, u64. A u32 offset is
+ * always from the start. A u64 offset is signed: a negative one counts
+ * back from the end of the file, which is found with
+ * danp_ftp_service_probe_size(), and is clamped to the start.
+ *
+ * @param ctx Pointer to the client context with the file open.
+ * @param range Offset and length arguments, NULL for the whole file.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_set_range(
+    danp_ftp_client_context_t *ctx,
+    const uint8_t *range)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    int64_t offset_arg;
+    uint64_t length_arg;
+    uint64_t back;
+    size_t size = 0;
+
+    ctx->range_start = 0;
+    ctx->range_end = SIZE_MAX;
+
+    if (range)
+    {
+        if (ctx->wide)
+        {
+            offset_arg = (int64_t)danp_ftp_service_get_field(&range[0], true);
+        }
+        else
+        {
+            offset_arg = (int64_t)danp_ftp_service_get_u32(&range[0]);
+        }
+        length_arg = danp_ftp_service_get_field(&range[DANP_FTP_FIELD_SIZE(ctx->wide)], ctx->wide);
+
+        if (offset_arg < 0)
+        {
+            back = 0U - (uint64_t)offset_arg;
+            status = danp_ftp_service_probe_size(ctx->service, ctx->file_handle, &size);
+            ctx->range_start = (size > back) ? size - (size_t)back : 0;
+        }
+        else
+        {
+            ctx->range_start = danp_ftp_service_to_size((uint64_t)offset_arg);
+        }
+
+        if (length_arg > 0 && length_arg <= SIZE_MAX - ctx->range_start)
+        {
+            ctx->range_end = ctx->range_start + length_arg;
+        }
+    }
+
+    return status;
+}
+
+/**
+ * @brief Handle a file read request from client.
+ * @param ctx Pointer to the client context.
+ * @param file_id File identifier.
+ * @param file_id_len Length of file identifier.
+ * @param fec_k Data chunks per FEC block, 0 for plain stop-and-wait.
+ * @param fec_r Parity chunks per FEC block.
+ * @param range Optional offset and length arguments, NULL to read the whole file.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_handle_read_request(
+    danp_ftp_client_context_t *ctx,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    uint8_t fec_k,
+    uint8_t fec_r,
+    const uint8_t *range)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    danp_ftp_service_context_t *svc = ctx->service;
+    danp_ftp_file_handle_t file_handle = 0;
+    uint8_t response_payload[DANP_FTP_RANGE_RESPONSE_SIZE(true)];
+    uint8_t data_buffer[DANP_FTP_MAX_PAYLOAD_SIZE + 1]; /* +1 for the EOF peek byte */
+    danp_ftp_service_read_window_t *window = NULL;
+    size_t offset = 0;
+    uint16_t length;
+    uint8_t flags;
+    bool more = true;
+
+    ctx->range_start = 0;
+
+    for (;;)
+    {
+        danp_log_message(
+            DANP_LOG_LEVEL_INF,
+            "FTP service handling read request for file (len=%zu)",
+            file_id_len);
+
+        /* Open file for reading */
+        status = svc->config.fs.open(
+            &file_handle,
+            file_id,
+            file_id_len,
+            DANP_FTP_FS_MODE_READ,
+            svc->config.user_data);
+
+        if (status < 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service file open failed: %d", status);
+
+            if (status == DANP_FTP_STATUS_FILE_NOT_FOUND)
+            {
+                response_payload[0] = DANP_FTP_RESP_FILE_NOT_FOUND;
+            }
+            else
+            {
+                response_payload[0] = DANP_FTP_RESP_ERROR;
+            }
+
+            danp_ftp_service_send_message(
+                ctx,
+                DANP_FTP_PACKET_TYPE_RESPONSE,
+                DANP_FTP_FLAG_NONE,
+                response_payload,
+                1);
+            break;
+        }
+
+        ctx->file_handle = file_handle;
+        ctx->file_open = true;
+
+        status = danp_ftp_service_set_range(ctx, range);
+        if (status >= 0 && range && !ctx->wide && !danp_ftp_service_fits_u32(ctx->range_start))
+        {
+            /* The first offset cannot be echoed in u32, the client asks again with u64 fields */
+            response_payload[0] = DANP_FTP_RESP_WIDE;
+            danp_ftp_service_send_message(
+                ctx,
+                DANP_FTP_PACKET_TYPE_RESPONSE,
+                DANP_FTP_FLAG_NONE,
+                response_payload,
+                1);
+            svc->config.fs.close(file_handle, svc->config.user_data);
+            ctx->file_open = false;
+            status = DANP_FTP_STATUS_INVALID_PARAM;
+            break;
+        }
+        if (status < 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service file size probe failed: %d", status);
+            response_payload[0] = DANP_FTP_RESP_ERROR;
+            danp_ftp_service_send_message(
+                ctx,
+                DANP_FTP_PACKET_TYPE_RESPONSE,
+                DANP_FTP_FLAG_NONE,
+                response_payload,
+                1);
+            svc->config.fs.close(file_handle, svc->config.user_data);
+            ctx->file_open = false;
+            break;
+        }
+        offset = ctx->range_start;
+
+        /* Send OK response, with the accepted FEC parameters if FEC was asked for */
+        if (fec_k > DANP_FTP_FEC_MAX_K)
+        {
+            fec_k = DANP_FTP_FEC_MAX_K;
+        }
+        if (fec_r > DANP_FTP_FEC_MAX_R)
+        {
+            fec_r = DANP_FTP_FEC_MAX_R;
+        }
+        if (fec_r > fec_k)
+        {
+            fec_r = fec_k;
+        }
+
+        if (fec_r == 0)
+        {
+            fec_k = 0;
+        }
+
+        response_payload[0] = DANP_FTP_RESP_OK;
+        response_payload[1] = fec_k;
+        response_payload[2] = fec_r;
+        danp_ftp_service_put_field(&response_payload[3], ctx->range_start, ctx->wide);
+        status = danp_ftp_service_send_message(
+            ctx,
+            DANP_FTP_PACKET_TYPE_RESPONSE,
+            DANP_FTP_FLAG_NONE,
+            response_payload,
+            range ? DANP_FTP_RANGE_RESPONSE_SIZE(ctx->wide) : ((fec_k > 0) ? DANP_FTP_FEC_RESPONSE_SIZE : 1));
+
+        if (status < 0)
+        {
+            break;
+        }
+
+        ctx->sequence_number++;
+
+        if (fec_k > 0)
+        {
+            more = false;
+            status = danp_ftp_service_read_fec(ctx, fec_k, fec_r, &offset);
+        }
+
+        /* Fetch several chunks per filesystem call when the backend can, per chunk if memory is short */
+        if (more && svc->config.fs.readv != NULL)
+        {
+            window = danp_ftp_service_alloc(svc, sizeof(*window));
+            if (window)
+            {
+                window->valid = false;
+            }
+        }
+
+        /* Send file data in chunks */
+        while (more)
+        {
+            danp_ftp_service_schedule(ctx);
+
+            uint8_t *chunk = data_buffer;
+            danp_ftp_status_t read_result = 0;
+            danp_ftp_status_t peek_result = 0;
+
+            if (window)
+            {
+                bool window_more = false;
+
+                read_result = danp_ftp_service_window_read(ctx, window, offset, &chunk, &window_more);
+                peek_result = window_more ? 1 : 0;
+            }
+            else
+            {
+                length = DANP_FTP_MAX_PAYLOAD_SIZE;
+                if (offset >= ctx->range_end)
+                {
+                    length = 0;
+                }
+                else if (ctx->range_end - offset < length)
+                {
+                    length = (uint16_t)(ctx->range_end - offset);
+                }
+
+                danp_trace(DANP_TRACE_FTP_FS_BEGIN, DANP_TRACE_FS_READ, (uint32_t)offset);
+                DANP_FTP_PROF_BEGIN(read_start);
+                if (length > 0)
+                {
+                    read_result = danp_ftp_service_fs_read(ctx, offset, data_buffer, length);
+                }
+                danp_trace(DANP_TRACE_FTP_FS_END, DANP_TRACE_FS_READ, (uint32_t)read_result);
+
+                /* Check if this is the last chunk, an empty file or range ends with an empty one */
+                if (read_result > 0 && offset + (size_t)read_result < ctx->range_end)
+                {
+                    peek_result = danp_ftp_service_fs_read(ctx, offset + read_result, data_buffer + read_result, 1);
+                }
+                DANP_FTP_PROF_END(ctx, DANP_FTP_SERVICE_PROF_FS_READ, read_start);
+            }
+
+            if (read_result < 0)
+            {
+                danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service file read failed: %d", read_result);
+                status = read_result;
+                break;
+            }
+
+            if (read_result == 0 && offset != ctx->range_start)
+            {
+                more = false;
+                continue;
+            }
+
+            if (peek_result <= 0)
+            {
+                more = false;
+            }
+
+            flags = DANP_FTP_FLAG_NONE;
+            if (offset == ctx->range_start)
+            {
+                flags |= DANP_FTP_FLAG_FIRST_CHUNK;
+            }
+            if (!more)
+            {
+                flags |= DANP_FTP_FLAG_LAST_CHUNK;
+            }
+
+            status = danp_ftp_service_send_reliable(
+                ctx,
+                DANP_FTP_PACKET_TYPE_DATA,
+                flags,
+                chunk,
+                (uint16_t)read_result);
+
+            if (status < 0)
+            {
+                danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service chunk not acknowledged");
+                break;
+            }
+
+            offset += read_result;
+            ctx->sequence_number++;
+        }
+
+        if (window)
+        {
+            danp_ftp_service_free(svc, window, sizeof(*window));
+        }
+
+        /* Close file */
+        svc->config.fs.close(file_handle, svc->config.user_data);
+        ctx->file_open = false;
+
+        if (status >= 0)
+        {
+            danp_log_message(
+                DANP_LOG_LEVEL_INF,
+                "FTP service read complete: %zu bytes",
+                offset - ctx->range_start);
+            status = (danp_ftp_status_t)(offset - ctx->range_start);
+        }
+
+        break;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Let the filesystem reserve or erase space for an announced WRITE.
+ *
+ * Backends that erase flash or allocate extents do it here, before the
+ * first chunk, instead of stalling the transfer on the first write that
+ * crosses into unprepared space.
+ *
+ * @param svc Pointer to the service context.
+ * @param file_handle Open file handle.
+ * @param offset Offset of the first byte to be written.
+ * @param size Bytes announced by the client, 0 if unknown.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_prepare_write(
+    danp_ftp_service_context_t *svc,
+    danp_ftp_file_handle_t file_handle,
+    size_t offset,
+    size_t size)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+
+    if (svc->config.fs.prepare && size > 0)
+    {
+        status = svc->config.fs.prepare(file_handle, offset, size, svc->config.user_data);
+        if (status < 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service prepare of %zu bytes failed: %d", size, status);
+        }
+    }
+
+    return status;
+}
+
+/**
+ * @brief Handle a file write request from client.
+ * @param ctx Pointer to the client context.
+ * @param file_id File identifier.
+ * @param file_id_len Length of file identifier.
+ * @param size_hint Bytes the client announced, 0 if unknown.
+ * @param range Optional offset argument, NULL to replace the whole file.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_handle_write_request(
+    danp_ftp_client_context_t *ctx,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    size_t size_hint,
+    const uint8_t *range)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    danp_ftp_service_context_t *svc = ctx->service;
+    danp_ftp_file_handle_t file_handle = 0;
+    danp_ftp_message_t data_msg;
+    danp_ftp_message_t *msg = &data_msg;
+    danp_ftp_service_write_window_t *window = NULL;
+    uint8_t response_payload[DANP_FTP_WRITE_RANGE_RESPONSE_SIZE(true)];
+    size_t start = range ? danp_ftp_service_to_size(danp_ftp_service_get_field(range, ctx->wide)) : 0;
+    size_t offset = start;
+    bool more = true;
+
+    for (;;)
+    {
+        danp_log_message(
+            DANP_LOG_LEVEL_INF,
+            "FTP service handling write request for file (len=%zu)",
+            file_id_len);
+
+        /* Open file for writing, a range updates it in place so other ranges survive */
+        status = svc->config.fs.open(
+            &file_handle,
+            file_id,
+            file_id_len,
+            range ? DANP_FTP_FS_MODE_UPDATE : DANP_FTP_FS_MODE_WRITE,
+            svc->config.user_data);
+
+        if (status < 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service file open failed: %d", status);
+            response_payload[0] = DANP_FTP_RESP_ERROR;
+
+            danp_ftp_service_send_message(
+                ctx,
+                DANP_FTP_PACKET_TYPE_RESPONSE,
+                DANP_FTP_FLAG_NONE,
+                response_payload,
+                1);
+            break;
+        }
+
+        ctx->file_handle = file_handle;
+        ctx->file_open = true;
+
+        status = danp_ftp_service_prepare_write(svc, file_handle, start, size_hint);
+        if (status < 0)
+        {
+            response_payload[0] = DANP_FTP_RESP_ERROR;
+            danp_ftp_service_send_message(
+                ctx,
+                DANP_FTP_PACKET_TYPE_RESPONSE,
+                DANP_FTP_FLAG_NONE,
+                response_payload,
+                1);
+            svc->config.fs.close(file_handle, svc->config.user_data);
+            ctx->file_open = false;
+            break;
+        }
+
+        /* Send OK response */
+        response_payload[0] = DANP_FTP_RESP_OK;
+        danp_ftp_service_put_field(&response_payload[1], start, ctx->wide);
+        status = danp_ftp_service_send_message(
+            ctx,
+            DANP_FTP_PACKET_TYPE_RESPONSE,
+            DANP_FTP_FLAG_NONE,
+            response_payload,
+            range ? DANP_FTP_WRITE_RANGE_RESPONSE_SIZE(ctx->wide) : 1);
+
+        if (status < 0)
+        {
+            break;
+        }
+
+        ctx->sequence_number++;
+
+        /* Hold several chunks per filesystem call when the backend can, per chunk if memory is short */
+        if (svc->config.fs.writev != NULL)
+        {
+            window = danp_ftp_service_alloc(svc, sizeof(*window));
+            if (window)
+            {
+                window->offset = start;
+                window->count = 0;
+            }
+        }
+
+        /* Receive file data chunks */
+        while (more)
+        {
+            if (window)
+            {
+                msg = &window->messages[window->count];
+            }
+
+            status = danp_ftp_service_receive_message(
+                ctx,
+                msg,
+                DANP_FTP_SERVICE_TIMEOUT_MS);
+
+            if (status < 0)
+            {
+                danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service receive data failed");
+                break;
+            }
+
+            if (msg->header.type != DANP_FTP_PACKET_TYPE_DATA)
+            {
+                danp_log_message(
+                    DANP_LOG_LEVEL_WRN,
+                    "FTP service unexpected packet type: %u",
+                    msg->header.type);
+
+                /* Send NACK */
+                danp_ftp_service_send_message(
+                    ctx,
+                    DANP_FTP_PACKET_TYPE_NACK,
+                    DANP_FTP_FLAG_NONE,
+                    NULL,
+                    0);
+                continue;
+            }
+
+            if (msg->header.sequence_number == (uint16_t)(ctx->sequence_number - 1))
+            {
+                /* Client missed our ACK and retransmitted, repeat it */
+                danp_ftp_service_send_ack(ctx, msg->header.sequence_number);
+                continue;
+            }
+
+            if (msg->header.sequence_number != ctx->sequence_number)
+            {
+                danp_log_message(
+                    DANP_LOG_LEVEL_WRN,
+                    "FTP service seq mismatch: expected=%u got=%u",
+                    ctx->sequence_number,
+                    msg->header.sequence_number);
+
+                /* Send NACK */
+                danp_ftp_service_send_message(
+                    ctx,
+                    DANP_FTP_PACKET_TYPE_NACK,
+                    DANP_FTP_FLAG_NONE,
+                    NULL,
+                    0);
+                continue;
+            }
+
+            danp_ftp_service_schedule(ctx);
+
+            /* Write data to file, a held chunk is acknowledged and written with the ones after it */
+            danp_ftp_status_t write_result;
+            if (window)
+            {
+                window->count++;
+                write_result = 0;
+                if (window->count == DANP_FTP_SERVICE_FS_VEC_CHUNKS ||
+                    (msg->header.flags & DANP_FTP_FLAG_LAST_CHUNK))
+                {
+                    write_result = danp_ftp_service_window_flush(ctx, window);
+                }
+            }
+            else
+            {
+                danp_trace(DANP_TRACE_FTP_FS_BEGIN, DANP_TRACE_FS_WRITE, (uint32_t)offset);
+                DANP_FTP_PROF_BEGIN(write_start);
+                write_result = danp_ftp_service_fs_write(
+                    ctx,
+                    offset,
+                    msg->payload,
+                    msg->header.payload_length);
+                DANP_FTP_PROF_END(ctx, DANP_FTP_SERVICE_PROF_FS_WRITE, write_start);
+                danp_trace(DANP_TRACE_FTP_FS_END, DANP_TRACE_FS_WRITE, (uint32_t)write_result);
+            }
+
+            if (write_result < 0)
+            {
+                danp_log_message(
+                    DANP_LOG_LEVEL_ERR,
+                    "FTP service file write failed: %d",
+                    write_result);
+                status = write_result;
+
+                /* Send NACK */
+                danp_ftp_service_send_message(
+                    ctx,
+                    DANP_FTP_PACKET_TYPE_NACK,
+                    DANP_FTP_FLAG_NONE,
+                    NULL,
+                    0);
+                break;
+            }
+
+            /* Check if this is the last chunk */
+            if (msg->header.flags & DANP_FTP_FLAG_LAST_CHUNK)
+            {
+                more = false;
+            }
+
+            /* Send ACK */
+            status = danp_ftp_service_send_message(
+                ctx,
+                DANP_FTP_PACKET_TYPE_ACK,
+                DANP_FTP_FLAG_NONE,
+                NULL,
+                0);
+
+            if (status < 0)
+            {
+                break;
+            }
+
+            offset += msg->header.payload_length;
+            ctx->sequence_number++;
+        }
+
+        if (window)
+        {
+            /* Chunks already acknowledged reach storage even if the transfer failed after them */
+            if (window->count > 0 && danp_ftp_service_window_flush(ctx, window) < 0 && status >= 0)
+            {
+                status = DANP_FTP_STATUS_ERROR;
+            }
+            danp_ftp_service_free(svc, window, sizeof(*window));
+        }
+
+        /* Close file */
+        svc->config.fs.close(file_handle, svc->config.user_data);
+        ctx->file_open = false;
+
+        if (status >= 0)
+        {
+            danp_log_message(
+                DANP_LOG_LEVEL_INF,
+                "FTP service write complete: %zu bytes",
+                offset - start);
+            status = (danp_ftp_status_t)(offset - start);
+        }
+
+        break;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Compute size and CRC32 of an open file by streaming it through fs.read.
+ * @param svc Pointer to the service context.
+ * @param file_handle Open file handle.
+ * @param size Pointer to store the file size.
+ * @param crc Pointer to store the file CRC32.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_stream_digest(
+    danp_ftp_service_context_t *svc,
+    danp_ftp_file_handle_t file_handle,
+    size_t *size,
+    uint32_t *crc)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    uint8_t data_buffer[DANP_FTP_MAX_PAYLOAD_SIZE];
+    uint32_t crc_register = DANP_FTP_CRC32_INIT;
+    size_t offset = 0;
+
+    for (;;)
+    {
+        status = svc->config.fs.read(
+            file_handle,
+            offset,
+            data_buffer,
+            DANP_FTP_MAX_PAYLOAD_SIZE,
+            svc->config.user_data);
+
+        if (status <= 0)
+        {
+            break;
+        }
+
+        crc_register = danp_ftp_service_crc32_update(crc_register, data_buffer, (size_t)status);
+        offset += (size_t)status;
+    }
+
+    if (status >= 0)
+    {
+        *size = offset;
+        *crc = crc_register ^ DANP_FTP_CRC32_INIT;
+        status = DANP_FTP_STATUS_OK;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Handle a file stat request from client.
+ *
+ * Replies with the file size and whole-file CRC32 so the client can skip
+ * transfers of identical files and verify a completed transfer end-to-end.
+ *
+ * @param ctx Pointer to the client context.
+ * @param file_id File identifier.
+ * @param file_id_len Length of file identifier.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_handle_stat_request(
+    danp_ftp_client_context_t *ctx,
+    const uint8_t *file_id,
+    size_t file_id_len)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    danp_ftp_service_context_t *svc = ctx->service;
+    danp_ftp_file_handle_t file_handle = 0;
+    uint8_t response_payload[DANP_FTP_STAT_RESPONSE_SIZE(true)];
+    size_t size = 0;
+    uint32_t crc = 0;
+
+    for (;;)
+    {
+        danp_log_message(
+            DANP_LOG_LEVEL_INF,
+            "FTP service handling stat request for file (len=%zu)",
+            file_id_len);
+
+        status = svc->config.fs.open(
+            &file_handle,
+            file_id,
+            file_id_len,
+            DANP_FTP_FS_MODE_READ,
+            svc->config.user_data);
+
+        if (status < 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service file open failed: %d", status);
+
+            if (status == DANP_FTP_STATUS_FILE_NOT_FOUND)
+            {
+                response_payload[0] = DANP_FTP_RESP_FILE_NOT_FOUND;
+            }
+            else
+            {
+                response_payload[0] = DANP_FTP_RESP_ERROR;
+            }
+
+            danp_ftp_service_send_message(
+                ctx,
+                DANP_FTP_PACKET_TYPE_RESPONSE,
+                DANP_FTP_FLAG_NONE,
+                response_payload,
+                1);
+            break;
+        }
+
+        ctx->file_handle = file_handle;
+        ctx->file_open = true;
+
+        if (svc->config.fs.digest)
+        {
+            status = svc->config.fs.digest(file_handle, &size, &crc, svc->config.user_data);
+        }
+        else
+        {
+            status = danp_ftp_service_stream_digest(svc, file_handle, &size, &crc);
+        }
+
+        svc->config.fs.close(file_handle, svc->config.user_data);
+        ctx->file_open = false;
+
+        if (status < 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service digest failed: %d", status);
+            response_payload[0] = DANP_FTP_RESP_ERROR;
+            danp_ftp_service_send_message(
+                ctx,
+                DANP_FTP_PACKET_TYPE_RESPONSE,
+                DANP_FTP_FLAG_NONE,
+                response_payload,
+                1);
+            break;
+        }
+
+        if (!ctx->wide && !danp_ftp_service_fits_u32(size))
+        {
+            /* The client asks again with u64 fields */
+            response_payload[0] = DANP_FTP_RESP_WIDE;
+            danp_ftp_service_send_message(
+                ctx,
+                DANP_FTP_PACKET_TYPE_RESPONSE,
+                DANP_FTP_FLAG_NONE,
+                response_payload,
+                1);
+            break;
+        }
+
+        response_payload[0] = DANP_FTP_RESP_OK;
+        danp_ftp_service_put_field(&response_payload[1], size, ctx->wide);
+        danp_ftp_service_put_u32(&response_payload[1 + DANP_FTP_FIELD_SIZE(ctx->wide)], crc);
+
+        status = danp_ftp_service_send_message(
+            ctx,
+            DANP_FTP_PACKET_TYPE_RESPONSE,
+            DANP_FTP_FLAG_NONE,
+            response_payload,
+            DANP_FTP_STAT_RESPONSE_SIZE(ctx->wide));
+
+        if (status >= 0)
+        {
+            danp_log_message(
+                DANP_LOG_LEVEL_INF,
+                "FTP service stat complete: %zu bytes crc=0x%08X",
+                size,
+                crc);
+        }
+
+        break;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Stream per-block CRC32 signatures of an open file to the client.
+ *
+ * Signatures are packed into DATA messages and acknowledged one message at
+ * a time. The last message carries the file size after its signatures.
+ *
+ * @param ctx Pointer to the client context.
+ * @param file_handle Open file handle.
+ * @param block_size Signature block size.
+ * @param file_size Pointer to store the size of the file.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_sync_send_signatures(
+    danp_ftp_client_context_t *ctx,
+    danp_ftp_file_handle_t file_handle,
+    uint16_t block_size,
+    size_t *file_size)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    danp_ftp_service_context_t *svc = ctx->service;
+    uint8_t data_buffer[DANP_FTP_MAX_PAYLOAD_SIZE];
+    uint8_t signature_payload[DANP_FTP_MAX_PAYLOAD_SIZE];
+    size_t signature_length = 0;
+    size_t offset = 0;
+    size_t block_fill = 0;
+    uint32_t crc = DANP_FTP_CRC32_INIT;
+    uint16_t read_length;
+    uint8_t flags;
+    bool eof = false;
+
+    while (!eof)
+    {
+        read_length = DANP_FTP_MAX_PAYLOAD_SIZE;
+        if (block_size - block_fill < read_length)
+        {
+            read_length = (uint16_t)(block_size - block_fill);
+        }
+
+        status = svc->config.fs.read(
+            file_handle,
+            offset,
+            data_buffer,
+            read_length,
+            svc->config.user_data);
+
+        if (status < 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service file read failed: %d", status);
+            break;
+        }
+
+        if (status == 0)
+        {
+            eof = true;
+        }
+        else
+        {
+            crc = danp_ftp_service_crc32_update(crc, data_buffer, (size_t)status);
+            offset += (size_t)status;
+            block_fill += (size_t)status;
+        }
+
+        if (block_fill == block_size || (eof && block_fill > 0))
+        {
+            danp_ftp_service_put_u32(&signature_payload[signature_length], crc ^ DANP_FTP_CRC32_INIT);
+            signature_length += DANP_FTP_SYNC_SIGNATURE_SIZE;
+            block_fill = 0;
+            crc = DANP_FTP_CRC32_INIT;
+        }
+
+        /* Keep room for the size trailer of the last message */
+        if (!eof && signature_length + DANP_FTP_SYNC_SIGNATURE_SIZE + 4 <= DANP_FTP_MAX_PAYLOAD_SIZE)
+        {
+            continue;
+        }
+
+        danp_ftp_service_schedule(ctx);
+
+        flags = DANP_FTP_FLAG_NONE;
+        if (eof)
+        {
+            danp_ftp_service_put_u32(&signature_payload[signature_length], (uint32_t)offset);
+            signature_length += 4;
+            flags |= DANP_FTP_FLAG_LAST_CHUNK;
+        }
+
+        status = danp_ftp_service_send_reliable(
+            ctx,
+            DANP_FTP_PACKET_TYPE_DATA,
+            flags,
+            signature_payload,
+            (uint16_t)signature_length);
+
+        if (status < 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service signatures not acknowledged");
+            break;
+        }
+
+        signature_length = 0;
+        ctx->sequence_number++;
+    }
+
+    *file_size = offset;
+
+    return status;
+}
+
+/**
+ * @brief Receive changed blocks from the client and apply them in place.
+ *
+ * Each DATA message carries a file offset followed by the new bytes. The
+ * last message carries only the final file size, a file that has to shrink
+ * without fs.truncate is answered with a NACK and fails the sync.
+ *
+ * @param ctx Pointer to the client context.
+ * @param file_handle Open file handle.
+ * @param file_size Size of the file before the patches.
+ * @return Number of patched bytes, negative on error.
+ */
+static danp_ftp_status_t danp_ftp_service_sync_receive_patches(
+    danp_ftp_client_context_t *ctx,
+    danp_ftp_file_handle_t file_handle,
+    size_t file_size)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    danp_ftp_service_context_t *svc = ctx->service;
+    danp_ftp_message_t data_msg;
+    size_t patched = 0;
+    size_t final_size;
+    bool more = true;
+
+    while (more)
+    {
+        status = danp_ftp_service_receive_message(
+            ctx,
+            &data_msg,
+            DANP_FTP_SERVICE_TIMEOUT_MS);
+
+        if (status < 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service receive patch failed");
+            break;
+        }
+
+        if (data_msg.header.type == DANP_FTP_PACKET_TYPE_DATA &&
+            data_msg.header.sequence_number == (uint16_t)(ctx->sequence_number - 1))
+        {
+            danp_ftp_service_send_ack(ctx, data_msg.header.sequence_number);
+            continue;
+        }
+
+        if (data_msg.header.type != DANP_FTP_PACKET_TYPE_DATA ||
+            data_msg.header.sequence_number != ctx->sequence_number ||
+            data_msg.header.payload_length < DANP_FTP_SYNC_PATCH_HEADER_SIZE)
+        {
+            danp_log_message(
+                DANP_LOG_LEVEL_WRN,
+                "FTP service unexpected patch: type=%u seq=%u len=%u",
+                data_msg.header.type,
+                data_msg.header.sequence_number,
+                data_msg.header.payload_length);
+
+            danp_ftp_service_send_message(
+                ctx,
+                DANP_FTP_PACKET_TYPE_NACK,
+                DANP_FTP_FLAG_NONE,
+                NULL,
+                0);
+            continue;
+        }
+
+        danp_ftp_service_schedule(ctx);
+
+        if (data_msg.header.flags & DANP_FTP_FLAG_LAST_CHUNK)
+        {
+            final_size = danp_ftp_service_get_u32(data_msg.payload);
+
+            if (svc->config.fs.truncate)
+            {
+                status = svc->config.fs.truncate(file_handle, final_size, svc->config.user_data);
+            }
+            else if (final_size < file_size)
+            {
+                /* The old tail would survive and the client would be told the copy matches */
+                danp_log_message(
+                    DANP_LOG_LEVEL_WRN,
+                    "FTP service sync cannot shrink %zu to %zu bytes without truncate",
+                    file_size,
+                    final_size);
+                status = DANP_FTP_STATUS_ERROR;
+            }
+
+            more = false;
+        }
+        else
+        {
+            status = svc->config.fs.write(
+                file_handle,
+                danp_ftp_service_get_u32(data_msg.payload),
+                &data_msg.payload[DANP_FTP_SYNC_PATCH_HEADER_SIZE],
+                (uint16_t)(data_msg.header.payload_length - DANP_FTP_SYNC_PATCH_HEADER_SIZE),
+                svc->config.user_data);
+
+            patched += data_msg.header.payload_length - DANP_FTP_SYNC_PATCH_HEADER_SIZE;
+        }
+
+        if (status < 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service sync write failed: %d", status);
+
+            danp_ftp_service_send_message(
+                ctx,
+                DANP_FTP_PACKET_TYPE_NACK,
+                DANP_FTP_FLAG_NONE,
+                NULL,
+                0);
+            break;
+        }
+
+        status = danp_ftp_service_send_message(
+            ctx,
+            DANP_FTP_PACKET_TYPE_ACK,
+            DANP_FTP_FLAG_NONE,
+            NULL,
+            0);
+
+        if (status < 0)
+        {
+            break;
+        }
+
+        ctx->sequence_number++;
+    }
+
+    if (status >= 0)
+    {
+        status = (danp_ftp_status_t)patched;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Handle a differential sync request from client.
+ *
+ * The service first streams per-block CRC32 signatures of its copy, then
+ * applies only the blocks the client reports as different. Blocks are
+ * compared at the same index, data shifted by an insertion is resent.
+ *
+ * @param ctx Pointer to the client context.
+ * @param file_id File identifier.
+ * @param file_id_len Length of file identifier.
+ * @param block_size Signature block size.
+ * @return Number of patched bytes, negative on error.
+ */
+static danp_ftp_status_t danp_ftp_service_handle_sync_request(
+    danp_ftp_client_context_t *ctx,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    uint16_t block_size)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    danp_ftp_service_context_t *svc = ctx->service;
+    danp_ftp_file_handle_t file_handle = 0;
+    uint8_t response_payload[3];
+    size_t file_size = 0;
+
+    for (;;)
+    {
+        danp_log_message(
+            DANP_LOG_LEVEL_INF,
+            "FTP service handling sync request for file (len=%zu) block=%u",
+            file_id_len,
+            block_size);
+
+        status = svc->config.fs.open(
+            &file_handle,
+            file_id,
+            file_id_len,
+            DANP_FTP_FS_MODE_UPDATE,
+            svc->config.user_data);
+
+        if (status < 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service file open failed: %d", status);
+            response_payload[0] = DANP_FTP_RESP_ERROR;
+
+            danp_ftp_service_send_message(
+                ctx,
+                DANP_FTP_PACKET_TYPE_RESPONSE,
+                DANP_FTP_FLAG_NONE,
+                response_payload,
+                1);
+            break;
+        }
+
+        ctx->file_handle = file_handle;
+        ctx->file_open = true;
+
+        /* The size trailer and patch offsets are u32, SYNC has no DANP_FTP_CMD_WIDE form */
+        if (svc->config.fs.read(file_handle, (size_t)UINT32_MAX, response_payload, 1, svc->config.user_data) > 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service sync refused, file larger than 4 GiB");
+            response_payload[0] = DANP_FTP_RESP_ERROR;
+
+            danp_ftp_service_send_message(
+                ctx,
+                DANP_FTP_PACKET_TYPE_RESPONSE,
+                DANP_FTP_FLAG_NONE,
+                response_payload,
+                1);
+
+            svc->config.fs.close(file_handle, svc->config.user_data);
+            ctx->file_open = false;
+            status = DANP_FTP_STATUS_INVALID_PARAM;
+            break;
+        }
+
+        /* Send OK response with the block size in use */
+        response_payload[0] = DANP_FTP_RESP_OK;
+        danp_ftp_service_put_u16(&response_payload[1], block_size);
+        status = danp_ftp_service_send_message(
+            ctx,
+            DANP_FTP_PACKET_TYPE_RESPONSE,
+            DANP_FTP_FLAG_NONE,
+            response_payload,
+            sizeof(response_payload));
+
+        if (status >= 0)
+        {
+            ctx->sequence_number++;
+            status = danp_ftp_service_sync_send_signatures(ctx, file_handle, block_size, &file_size);
+        }
+
+        if (status >= 0)
+        {
+            status = danp_ftp_service_sync_receive_patches(ctx, file_handle, file_size);
+        }
+
+        svc->config.fs.close(file_handle, svc->config.user_data);
+        ctx->file_open = false;
+
+        if (status >= 0)
+        {
+            danp_log_message(
+                DANP_LOG_LEVEL_INF,
+                "FTP service sync complete: %d bytes patched",
+                status);
+        }
+
+        break;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Client handler thread function.
+ * @param arg Pointer to client context.
+ */
+static void danp_ftp_client_handler_thread(void *arg)
+{
+    danp_ftp_client_context_t *ctx = (danp_ftp_client_context_t *)arg;
+    danp_ftp_message_t message;
+    danp_ftp_status_t status;
+    uint8_t command;
+    uint8_t file_id_len;
+    const uint8_t *file_id;
+    uint8_t response_payload[1];
+    uint16_t block_size;
+    uint8_t fec_k;
+    uint8_t fec_r;
+    size_t size_hint;
+    const uint8_t *range;
+    uint8_t priority_bits;
+    danp_ftp_service_context_t *svc;
+
+    for (;;)
+    {
+        if (!ctx || !ctx->socket)
+        {
+            break;
+        }
+
+        danp_log_message(
+            DANP_LOG_LEVEL_INF,
+            "FTP service client handler started for node %u",
+            ctx->socket->remote_node);
+
+        if (ctx->command)
+        {
+            /* Handed over by the reactor with the command already read */
+            memcpy(&message, ctx->command, sizeof(danp_ftp_message_t));
+            danp_ftp_service_free(ctx->service, ctx->command, sizeof(danp_ftp_message_t));
+            ctx->command = NULL;
+            status = DANP_FTP_STATUS_OK;
+        }
+        else
+        {
+            /* Wait for command */
+            status = danp_ftp_service_receive_message(
+                ctx,
+                &message,
+                DANP_FTP_SERVICE_TIMEOUT_MS);
+        }
+
+        if (status < 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service command receive failed");
+            break;
+        }
+
+        if (message.header.type != DANP_FTP_PACKET_TYPE_COMMAND)
+        {
+            danp_log_message(
+                DANP_LOG_LEVEL_WRN,
+                "FTP service expected command, got type: %u",
+                message.header.type);
+            break;
+        }
+
+        if (message.header.payload_length < 2)
+        {
+            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service command payload too short");
+            response_payload[0] = DANP_FTP_RESP_ERROR;
+            danp_ftp_service_send_message(
+                ctx,
+                DANP_FTP_PACKET_TYPE_RESPONSE,
+                DANP_FTP_FLAG_NONE,
+                response_payload,
+                1);
+            break;
+        }
+
+        command = message.payload[0] & DANP_FTP_CMD_MASK;
+        ctx->wide = (message.payload[0] & DANP_FTP_CMD_WIDE) != 0;
+        priority_bits = (message.payload[0] & DANP_FTP_CMD_PRIORITY_MASK) >> DANP_FTP_CMD_PRIORITY_SHIFT;
+        file_id_len = message.payload[1];
+        file_id = &message.payload[2];
+
+        if (file_id_len + 2 > message.header.payload_length)
+        {
+            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service invalid file_id_len");
+            response_payload[0] = DANP_FTP_RESP_ERROR;
+            danp_ftp_service_send_message(
+                ctx,
+                DANP_FTP_PACKET_TYPE_RESPONSE,
+                DANP_FTP_FLAG_NONE,
+                response_payload,
+                1);
+            break;
+        }
+
+        if (priority_bits > 0)
+        {
+            ctx->priority = (danp_ftp_service_priority_t)(priority_bits - 1);
+        }
+
+        danp_log_message(
+            DANP_LOG_LEVEL_INF,
+            "FTP service command %u from node %u at priority %u",
+            command,
+            ctx->socket->remote_node,
+            ctx->priority);
+
+        danp_ftp_service_session_begin(ctx);
+
+        switch (command)
+        {
+        case DANP_FTP_CMD_REQUEST_READ:
+            fec_k = 0;
+            fec_r = 0;
+            range = NULL;
+            if (message.header.payload_length >= file_id_len + 4)
             {
-                danp_log_message(
-                    DANP_LOG_LEVEL_WRN,
-                    "FTP service unexpected packet type: %u",
-                    data_msg.header.type);
+                fec_k = file_id[file_id_len];
+                fec_r = file_id[file_id_len + 1];
+            }
+            if (message.header.payload_length >= file_id_len + 4 + DANP_FTP_RANGE_ARGS_SIZE(ctx->wide))
+            {
+                range = &file_id[file_id_len + 2];
+            }
+            danp_ftp_service_handle_read_request(ctx, file_id, file_id_len, fec_k, fec_r, range);
+            break;
+
+        case DANP_FTP_CMD_REQUEST_WRITE:
+            size_hint = 0;
+            range = NULL;
+            if (message.header.payload_length >= file_id_len + 2 + DANP_FTP_WRITE_SIZE_ARGS_SIZE(ctx->wide))
+            {
+                size_hint = danp_ftp_service_to_size(danp_ftp_service_get_field(&file_id[file_id_len], ctx->wide));
+            }
+            if (message.header.payload_length >= file_id_len + 2 + DANP_FTP_WRITE_RANGE_ARGS_SIZE(ctx->wide))
+            {
+                range = &file_id[file_id_len + DANP_FTP_WRITE_SIZE_ARGS_SIZE(ctx->wide)];
+            }
+            danp_ftp_service_handle_write_request(ctx, file_id, file_id_len, size_hint, range);
+            break;
+
+        case DANP_FTP_CMD_REQUEST_STAT:
+            danp_ftp_service_handle_stat_request(ctx, file_id, file_id_len);
+            break;
+
+        case DANP_FTP_CMD_REQUEST_SYNC:
+            block_size = DANP_FTP_SYNC_DEFAULT_BLOCK_SIZE;
+            if (message.header.payload_length >= file_id_len + 4)
+            {
+                block_size = danp_ftp_service_get_u16(&file_id[file_id_len]);
+            }
+            if (block_size < DANP_FTP_SYNC_MIN_BLOCK_SIZE)
+            {
+                block_size = DANP_FTP_SYNC_MIN_BLOCK_SIZE;
+            }
+            danp_ftp_service_handle_sync_request(ctx, file_id, file_id_len, block_size);
+            break;
+
+        case DANP_FTP_CMD_ABORT:
+            danp_log_message(DANP_LOG_LEVEL_INF, "FTP service received abort command");
+            break;
+
+        default:
+            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service unknown command: %u", command);
+            response_payload[0] = DANP_FTP_RESP_ERROR;
+            danp_ftp_service_send_message(
+                ctx,
+                DANP_FTP_PACKET_TYPE_RESPONSE,
+                DANP_FTP_FLAG_NONE,
+                response_payload,
+                1);
+            break;
+        }
+
+        break;
+    }
+
+    /* Cleanup */
+    if (ctx)
+    {
+        if (ctx->service)
+        {
+            danp_ftp_service_session_end(ctx);
+#if defined(CONFIG_DANP_FTP_SERVICE_PROFILER)
+            danp_ftp_service_prof_commit(ctx);
+#endif
+        }
+
+        if (ctx->file_open && ctx->service)
+        {
+            ctx->service->config.fs.close(
+                ctx->file_handle,
+                ctx->service->config.user_data);
+        }
+
+        if (ctx->socket)
+        {
+            danp_close(ctx->socket);
+        }
+
+        danp_log_message(
+            DANP_LOG_LEVEL_INF,
+            "FTP service client handler terminated: srtt=%u ms rttvar=%u ms rto=%u ms retransmits=%u",
+            ctx->srtt_x8 >> 3,
+            ctx->rttvar_x4 >> 2,
+            ctx->rto_ms,
+            ctx->retransmits);
+
+        if (ctx->service)
+        {
+            svc = ctx->service;
+            danp_ftp_service_stack_sample(svc, true);
+
+            danp_port_mutex_lock(&svc->sched_lock);
+            svc->client_count--;
+            if (ctx->handed_over)
+            {
+                svc->handoff_count--;
+            }
+            danp_port_mutex_unlock(&svc->sched_lock);
+
+            /* Free client context */
+            memset(ctx, 0, sizeof(danp_ftp_client_context_t));
+            danp_ftp_service_free(svc, ctx, sizeof(danp_ftp_client_context_t));
+        }
+        else
+        {
+            osal_memory_free(ctx);
+        }
+    }
+}
+
+#if defined(CONFIG_DANP_FTP_SERVICE_REACTOR)
+/**
+ * @brief Check whether a uptime timestamp has been reached.
+ * @param now_ms Current uptime in milliseconds.
+ * @param at_ms Timestamp to compare against.
+ * @return true if at_ms is not in the future.
+ */
+static inline bool danp_ftp_reactor_reached(uint32_t now_ms, uint32_t at_ms)
+{
+    return (int32_t)(now_ms - at_ms) >= 0;
+}
+
+/**
+ * @brief Receive a message without blocking.
+ * @param session Pointer to the reactor session.
+ * @return 1 if ftp_reactor_message holds a message, 0 if nothing arrived, negative on error.
+ */
+static int32_t danp_ftp_reactor_poll_message(danp_ftp_reactor_session_t *session)
+{
+    int32_t recv_result;
+
+    DANP_FTP_PROF_BEGIN(recv_start);
+    recv_result = danp_recv(
+        session->client.socket,
+        &ftp_reactor_message,
+        sizeof(danp_ftp_message_t),
+        0);
+
+    if (danp_port_recv_timed_out(recv_result))
+    {
+        return 0;
+    }
+    DANP_FTP_PROF_END(&session->client, DANP_FTP_SERVICE_PROF_RECV, recv_start);
+
+    if (recv_result < (int32_t)sizeof(danp_ftp_header_t))
+    {
+        danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service receive failed: %d", recv_result);
+        return DANP_FTP_STATUS_TRANSFER_FAILED;
+    }
+
+    if (danp_ftp_service_check_message(&session->client, &ftp_reactor_message) < 0)
+    {
+        return DANP_FTP_STATUS_TRANSFER_FAILED;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Queue a response and the state to enter once it is sent.
+ * @param session Pointer to the reactor session.
+ * @param payload Response payload.
+ * @param length Length of the payload.
+ * @param next_state State after the response, DONE ends the session.
+ */
+static void danp_ftp_reactor_respond(
+    danp_ftp_reactor_session_t *session,
+    const uint8_t *payload,
+    uint8_t length,
+    danp_ftp_reactor_state_t next_state)
+{
+    memcpy(session->response, payload, length);
+    session->response_len = length;
+    session->next_state = next_state;
+    session->state = DANP_FTP_REACTOR_STATE_RESPONSE;
+}
+
+/**
+ * @brief Give back a handoff slot taken by danp_ftp_reactor_handoff().
+ * @param svc Pointer to the service context.
+ */
+static void danp_ftp_reactor_handoff_release(danp_ftp_service_context_t *svc)
+{
+    danp_port_mutex_lock(&svc->sched_lock);
+    svc->handoff_count--;
+    danp_port_mutex_unlock(&svc->sched_lock);
+}
+
+/**
+ * @brief Hand a session over to a client handler thread.
+ *
+ * SYNC runs long block-by-block exchanges that the reactor does not
+ * model, so it keeps the threaded handler. The socket and the client
+ * count move to the thread. At most DANP_FTP_SERVICE_REACTOR_HANDOFFS
+ * threads run at once so the reactor keeps its memory bound.
+ *
+ * @param session Pointer to the reactor session.
+ * @return true if the thread took the session.
+ */
+static bool danp_ftp_reactor_handoff(danp_ftp_reactor_session_t *session)
+{
+    danp_ftp_service_context_t *svc = session->client.service;
+    danp_ftp_client_context_t *client_ctx = NULL;
+    osal_thread_handle_t client_thread = NULL;
+    osal_thread_attr_t client_thread_attr = {
+        .name = "ftpClient",
+        .stack_size = DANP_FTP_SERVICE_CLIENT_STACK_SIZE,
+        .stack_mem = NULL,
+        .priority = OSAL_THREAD_PRIORITY_NORMAL,
+        .cb_mem = NULL,
+        .cb_size = 0,
+    };
+
+    danp_port_mutex_lock(&svc->sched_lock);
+    if (svc->handoff_count >= DANP_FTP_SERVICE_REACTOR_HANDOFFS)
+    {
+        danp_port_mutex_unlock(&svc->sched_lock);
+        return false;
+    }
+    svc->handoff_count++;
+    danp_port_mutex_unlock(&svc->sched_lock);
+
+    client_ctx = (danp_ftp_client_context_t *)danp_ftp_service_alloc(
+        svc,
+        sizeof(danp_ftp_client_context_t));
+    if (!client_ctx)
+    {
+        danp_ftp_reactor_handoff_release(svc);
+        return false;
+    }
+
+    memcpy(client_ctx, &session->client, sizeof(danp_ftp_client_context_t));
+    client_ctx->handed_over = true;
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_ASYNC)
+    danp_port_sem_init(&client_ctx->fs_op.done);
+#endif
+    client_ctx->command = (danp_ftp_message_t *)danp_ftp_service_alloc(
+        client_ctx->service,
+        sizeof(danp_ftp_message_t));
+    if (!client_ctx->command)
+    {
+        danp_ftp_service_free(client_ctx->service, client_ctx, sizeof(danp_ftp_client_context_t));
+        danp_ftp_reactor_handoff_release(svc);
+        return false;
+    }
+
+    memcpy(client_ctx->command, &ftp_reactor_message, sizeof(danp_ftp_message_t));
+
+    client_thread = osal_thread_create(
+        danp_ftp_client_handler_thread,
+        client_ctx,
+        &client_thread_attr);
+
+    if (!client_thread)
+    {
+        danp_ftp_service_free(client_ctx->service, client_ctx->command, sizeof(danp_ftp_message_t));
+        danp_ftp_service_free(client_ctx->service, client_ctx, sizeof(danp_ftp_client_context_t));
+        danp_ftp_reactor_handoff_release(svc);
+        return false;
+    }
+
+    memset(session, 0, sizeof(danp_ftp_reactor_session_t));
+
+    return true;
+}
+
+/**
+ * @brief Close the file of a STAT session and queue its response.
+ * @param session Pointer to the reactor session.
+ * @param status Digest status.
+ * @param size File size.
+ * @param crc File CRC32.
+ */
+static void danp_ftp_reactor_stat_reply(
+    danp_ftp_reactor_session_t *session,
+    danp_ftp_status_t status,
+    size_t size,
+    uint32_t crc)
+{
+    danp_ftp_client_context_t *ctx = &session->client;
+    danp_ftp_service_context_t *svc = ctx->service;
+    uint8_t response_payload[DANP_FTP_STAT_RESPONSE_SIZE(true)];
+
+    svc->config.fs.close(ctx->file_handle, svc->config.user_data);
+    ctx->file_open = false;
+
+    response_payload[0] = DANP_FTP_RESP_ERROR;
+
+    if (status < 0)
+    {
+        danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service digest failed: %d", status);
+        danp_ftp_reactor_respond(session, response_payload, 1, DANP_FTP_REACTOR_STATE_DONE);
+        return;
+    }
+
+    if (!ctx->wide && !danp_ftp_service_fits_u32(size))
+    {
+        /* The client asks again with u64 fields */
+        response_payload[0] = DANP_FTP_RESP_WIDE;
+        danp_ftp_reactor_respond(session, response_payload, 1, DANP_FTP_REACTOR_STATE_DONE);
+        return;
+    }
+
+    response_payload[0] = DANP_FTP_RESP_OK;
+    danp_ftp_service_put_field(&response_payload[1], size, ctx->wide);
+    danp_ftp_service_put_u32(&response_payload[1 + DANP_FTP_FIELD_SIZE(ctx->wide)], crc);
+    danp_ftp_reactor_respond(
+        session,
+        response_payload,
+        DANP_FTP_STAT_RESPONSE_SIZE(ctx->wide),
+        DANP_FTP_REACTOR_STATE_DONE);
+}
+
+/**
+ * @brief Feed the next chunk of a STAT file into its CRC32, reply at end of file.
+ * @param session Pointer to the reactor session.
+ * @return true, the session always makes progress.
+ */
+static bool danp_ftp_reactor_stat_digest(danp_ftp_reactor_session_t *session)
+{
+    danp_ftp_client_context_t *ctx = &session->client;
+    danp_ftp_service_context_t *svc = ctx->service;
+    danp_ftp_status_t status;
+
+    status = svc->config.fs.read(
+        ctx->file_handle,
+        session->offset,
+        ftp_reactor_chunk,
+        DANP_FTP_MAX_PAYLOAD_SIZE,
+        svc->config.user_data);
+
+    if (status > 0)
+    {
+        session->digest_crc = danp_ftp_service_crc32_update(session->digest_crc, ftp_reactor_chunk, (size_t)status);
+        session->offset += (size_t)status;
+        return true;
+    }
+
+    danp_ftp_reactor_stat_reply(session, status, session->offset, session->digest_crc ^ DANP_FTP_CRC32_INIT);
+
+    return true;
+}
+
+/**
+ * @brief Parse the received command and set the session up to serve it.
+ * @param session Pointer to the reactor session.
+ */
+static void danp_ftp_reactor_start(danp_ftp_reactor_session_t *session)
+{
+    danp_ftp_client_context_t *ctx = &session->client;
+    danp_ftp_service_context_t *svc = ctx->service;
+    danp_ftp_message_t *message = &ftp_reactor_message;
+    danp_ftp_status_t status;
+    uint8_t response_payload[DANP_FTP_STAT_RESPONSE_SIZE(true)];
+    uint8_t command;
+    uint8_t file_id_len;
+    const uint8_t *file_id;
+    const uint8_t *args;
+    uint8_t priority_bits;
+    uint8_t response_len = 1;
+    bool range = false;
+    size_t size_hint = 0;
+    size_t size = 0;
+    uint32_t crc = 0;
+
+    response_payload[0] = DANP_FTP_RESP_ERROR;
+
+    for (;;)
+    {
+        if (message->header.type != DANP_FTP_PACKET_TYPE_COMMAND)
+        {
+            danp_log_message(
+                DANP_LOG_LEVEL_WRN,
+                "FTP service expected command, got type: %u",
+                message->header.type);
+            session->state = DANP_FTP_REACTOR_STATE_DONE;
+            break;
+        }
+
+        command = message->payload[0] & DANP_FTP_CMD_MASK;
+        ctx->wide = (message->payload[0] & DANP_FTP_CMD_WIDE) != 0;
+        priority_bits = (message->payload[0] & DANP_FTP_CMD_PRIORITY_MASK) >> DANP_FTP_CMD_PRIORITY_SHIFT;
+        file_id_len = message->payload[1];
+        file_id = &message->payload[2];
+
+        if (message->header.payload_length < 2 || file_id_len + 2 > message->header.payload_length)
+        {
+            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service invalid command payload");
+            danp_ftp_reactor_respond(session, response_payload, 1, DANP_FTP_REACTOR_STATE_DONE);
+            break;
+        }
+
+        if (priority_bits > 0)
+        {
+            ctx->priority = (danp_ftp_service_priority_t)(priority_bits - 1);
+        }
+
+        danp_log_message(
+            DANP_LOG_LEVEL_INF,
+            "FTP service command %u from node %u at priority %u",
+            command,
+            ctx->socket->remote_node,
+            ctx->priority);
+
+        /* SYNC and FEC reads block on their exchanges, so they get a thread of their own */
+        args = &file_id[file_id_len];
+        if (command == DANP_FTP_CMD_REQUEST_SYNC ||
+            (command == DANP_FTP_CMD_REQUEST_READ &&
+             message->header.payload_length >= file_id_len + 4 &&
+             args[0] > 0 && args[1] > 0))
+        {
+            if (!danp_ftp_reactor_handoff(session))
+            {
+                danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service refused command %u, no handler thread free", command);
+                response_payload[0] = DANP_FTP_RESP_BUSY;
+                danp_ftp_reactor_respond(session, response_payload, 1, DANP_FTP_REACTOR_STATE_DONE);
+            }
+            break;
+        }
+
+        if (command == DANP_FTP_CMD_ABORT)
+        {
+            danp_log_message(DANP_LOG_LEVEL_INF, "FTP service received abort command");
+            session->state = DANP_FTP_REACTOR_STATE_DONE;
+            break;
+        }
+
+        if (command != DANP_FTP_CMD_REQUEST_READ &&
+            command != DANP_FTP_CMD_REQUEST_WRITE &&
+            command != DANP_FTP_CMD_REQUEST_STAT)
+        {
+            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service unknown command: %u", command);
+            danp_ftp_reactor_respond(session, response_payload, 1, DANP_FTP_REACTOR_STATE_DONE);
+            break;
+        }
+
+        danp_ftp_service_session_begin(ctx);
+
+        /* Ranges start the transfer part way into the file */
+        ctx->range_start = 0;
+        ctx->range_end = SIZE_MAX;
+        if (command == DANP_FTP_CMD_REQUEST_READ &&
+            message->header.payload_length >= file_id_len + 4 + DANP_FTP_RANGE_ARGS_SIZE(ctx->wide))
+        {
+            range = true;
+        }
+        if (command == DANP_FTP_CMD_REQUEST_WRITE &&
+            message->header.payload_length >= file_id_len + 2 + DANP_FTP_WRITE_SIZE_ARGS_SIZE(ctx->wide))
+        {
+            size_hint = danp_ftp_service_to_size(danp_ftp_service_get_field(args, ctx->wide));
+        }
+        if (command == DANP_FTP_CMD_REQUEST_WRITE &&
+            message->header.payload_length >= file_id_len + 2 + DANP_FTP_WRITE_RANGE_ARGS_SIZE(ctx->wide))
+        {
+            range = true;
+            ctx->range_start = danp_ftp_service_to_size(
+                danp_ftp_service_get_field(&args[DANP_FTP_WRITE_SIZE_ARGS_SIZE(ctx->wide)], ctx->wide));
+        }
+
+        status = svc->config.fs.open(
+            &ctx->file_handle,
+            file_id,
+            file_id_len,
+            (command != DANP_FTP_CMD_REQUEST_WRITE) ? DANP_FTP_FS_MODE_READ :
+                (range ? DANP_FTP_FS_MODE_UPDATE : DANP_FTP_FS_MODE_WRITE),
+            svc->config.user_data);
 
-                /* Send NACK */
-                danp_ftp_service_send_message(
-                    ctx,
-                    DANP_FTP_PACKET_TYPE_NACK,
-                    DANP_FTP_FLAG_NONE,
-                    NULL,
-                    0);
-                continue;
+        if (status < 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service file open failed: %d", status);
+            if (status == DANP_FTP_STATUS_FILE_NOT_FOUND && command != DANP_FTP_CMD_REQUEST_WRITE)
+            {
+                response_payload[0] = DANP_FTP_RESP_FILE_NOT_FOUND;
             }
+            danp_ftp_reactor_respond(session, response_payload, 1, DANP_FTP_REACTOR_STATE_DONE);
+            break;
+        }
 
-            if (data_msg.header.sequence_number != ctx->sequence_number)
-            {
-                danp_log_message(
-                    DANP_LOG_LEVEL_WRN,
-                    "FTP service seq mismatch: expected=%u got=%u",
-                    ctx->sequence_number,
-                    data_msg.header.sequence_number);
+        ctx->file_open = true;
 
-                /* Send NACK */
-                danp_ftp_service_send_message(
-                    ctx,
-                    DANP_FTP_PACKET_TYPE_NACK,
-                    DANP_FTP_FLAG_NONE,
-                    NULL,
-                    0);
-                continue;
+        if (command == DANP_FTP_CMD_REQUEST_STAT)
+        {
+            if (svc->config.fs.digest)
+            {
+                status = svc->config.fs.digest(ctx->file_handle, &size, &crc, svc->config.user_data);
+                danp_ftp_reactor_stat_reply(session, status, size, crc);
+                break;
             }
 
-            /* Write data to file */
-            danp_ftp_status_t write_result = svc->config.fs.write(
-                file_handle,
-                offset,
-                data_msg.payload,
-                data_msg.header.payload_length,
-                svc->config.user_data);
+            /* One chunk per pass, a large file does not hold up the other sessions */
+            session->offset = 0;
+            session->digest_crc = DANP_FTP_CRC32_INIT;
+            session->state = DANP_FTP_REACTOR_STATE_STAT_DIGEST;
+            break;
+        }
 
-            if (write_result < 0)
+        if (command == DANP_FTP_CMD_REQUEST_WRITE)
+        {
+            status = danp_ftp_service_prepare_write(svc, ctx->file_handle, ctx->range_start, size_hint);
+            if (status < 0)
             {
-                danp_log_message(
-                    DANP_LOG_LEVEL_ERR,
-                    "FTP service file write failed: %d",
-                    write_result);
-                status = write_result;
+                svc->config.fs.close(ctx->file_handle, svc->config.user_data);
+                ctx->file_open = false;
+                danp_ftp_reactor_respond(session, response_payload, 1, DANP_FTP_REACTOR_STATE_DONE);
+                break;
+            }
+        }
 
-                /* Send NACK */
-                danp_ftp_service_send_message(
-                    ctx,
-                    DANP_FTP_PACKET_TYPE_NACK,
-                    DANP_FTP_FLAG_NONE,
-                    NULL,
-                    0);
+        if (range && command == DANP_FTP_CMD_REQUEST_READ)
+        {
+            status = danp_ftp_service_set_range(ctx, &args[2]);
+            if (status >= 0 && !ctx->wide && !danp_ftp_service_fits_u32(ctx->range_start))
+            {
+                /* The first offset cannot be echoed in u32, the client asks again with u64 fields */
+                response_payload[0] = DANP_FTP_RESP_WIDE;
+                danp_ftp_reactor_respond(session, response_payload, 1, DANP_FTP_REACTOR_STATE_DONE);
+                break;
+            }
+            if (status < 0)
+            {
+                danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service file size probe failed: %d", status);
+                danp_ftp_reactor_respond(session, response_payload, 1, DANP_FTP_REACTOR_STATE_DONE);
                 break;
             }
+        }
+        session->offset = ctx->range_start;
 
-            /* Check if this is the last chunk */
-            if (data_msg.header.flags & DANP_FTP_FLAG_LAST_CHUNK)
+        response_payload[0] = DANP_FTP_RESP_OK;
+        if (range && command == DANP_FTP_CMD_REQUEST_READ)
+        {
+            response_payload[1] = 0;
+            response_payload[2] = 0;
+            danp_ftp_service_put_field(&response_payload[3], ctx->range_start, ctx->wide);
+            response_len = DANP_FTP_RANGE_RESPONSE_SIZE(ctx->wide);
+        }
+        else if (range)
+        {
+            danp_ftp_service_put_field(&response_payload[1], ctx->range_start, ctx->wide);
+            response_len = DANP_FTP_WRITE_RANGE_RESPONSE_SIZE(ctx->wide);
+        }
+        danp_ftp_reactor_respond(
+            session,
+            response_payload,
+            response_len,
+            (command == DANP_FTP_CMD_REQUEST_READ) ?
+                DANP_FTP_REACTOR_STATE_READ_DATA : DANP_FTP_REACTOR_STATE_WRITE_DATA);
+        break;
+    }
+}
+
+/**
+ * @brief Transmit the READ chunk described by the session and wait for its ACK.
+ * @param session Pointer to the reactor session.
+ * @param now_ms Current uptime in milliseconds.
+ * @param chunk Chunk data of session->chunk_len bytes.
+ */
+static void danp_ftp_reactor_send_chunk(danp_ftp_reactor_session_t *session, uint32_t now_ms, const uint8_t *chunk)
+{
+    danp_ftp_client_context_t *ctx = &session->client;
+
+    if (danp_ftp_service_transmit(
+            ctx,
+            DANP_FTP_PACKET_TYPE_DATA,
+            session->chunk_flags,
+            chunk,
+            session->chunk_len) < 0)
+    {
+        session->state = DANP_FTP_REACTOR_STATE_DONE;
+        return;
+    }
+
+    session->sent_ms = now_ms;
+#if defined(CONFIG_DANP_FTP_SERVICE_PROFILER)
+    session->sent_cycles = danp_port_cycles();
+#endif
+    session->deadline_ms = now_ms + ctx->rto_ms;
+    session->state = DANP_FTP_REACTOR_STATE_READ_ACK;
+    danp_trace(DANP_TRACE_FTP_ACK_WAIT_BEGIN, ctx->sequence_number, ctx->rto_ms);
+}
+
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_ASYNC)
+/**
+ * @brief Take the result of an async READ chunk or EOF peek and start the next step.
+ *
+ * The chunk stays in the session buffer, so it is sent from READ_SEND
+ * once there are tokens and resent from there after a timeout.
+ *
+ * @param session Pointer to the reactor session.
+ * @param result Bytes read, negative status on error.
+ * @return true, the session always makes progress.
+ */
+static bool danp_ftp_reactor_read_done(danp_ftp_reactor_session_t *session, danp_ftp_status_t result)
+{
+    danp_ftp_client_context_t *ctx = &session->client;
+    danp_ftp_service_context_t *svc = ctx->service;
+
+    danp_trace(DANP_TRACE_FTP_FS_END, DANP_TRACE_FS_READ, (uint32_t)result);
+
+    if (!session->fs_peek)
+    {
+        /* An empty file or range still gets one empty LAST chunk */
+        if (result < 0 || (result == 0 && session->offset != ctx->range_start))
+        {
+            if (result < 0)
             {
-                more = false;
+                danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service file read failed: %d", result);
             }
+            session->state = DANP_FTP_REACTOR_STATE_DONE;
+            return true;
+        }
 
-            /* Send ACK */
-            status = danp_ftp_service_send_message(
-                ctx,
-                DANP_FTP_PACKET_TYPE_ACK,
-                DANP_FTP_FLAG_NONE,
-                NULL,
-                0);
+        session->chunk_len = (uint16_t)result;
+        session->chunk_flags = DANP_FTP_FLAG_NONE;
+        if (session->offset == ctx->range_start)
+        {
+            session->chunk_flags |= DANP_FTP_FLAG_FIRST_CHUNK;
+        }
 
-            if (status < 0)
+        result = 0;
+        if (session->chunk_len > 0 && session->offset + session->chunk_len < ctx->range_end)
+        {
+            session->fs_peek = true;
+            danp_trace(DANP_TRACE_FTP_FS_BEGIN, DANP_TRACE_FS_READ, (uint32_t)(session->offset + session->chunk_len));
+            result = svc->config.fs.read_async(
+                ctx->file_handle,
+                session->offset + session->chunk_len,
+                &session->chunk[session->chunk_len],
+                1,
+                &ctx->fs_op,
+                svc->config.user_data);
+            if (result == DANP_FTP_SERVICE_FS_PENDING)
             {
-                break;
+                session->state = DANP_FTP_REACTOR_STATE_READ_FS;
+                return true;
             }
+            danp_trace(DANP_TRACE_FTP_FS_END, DANP_TRACE_FS_READ, (uint32_t)result);
+        }
+    }
+
+    DANP_FTP_PROF_END(ctx, DANP_FTP_SERVICE_PROF_FS_READ, session->fs_cycles);
+
+    session->fs_peek = false;
+    if (result <= 0)
+    {
+        session->chunk_flags |= DANP_FTP_FLAG_LAST_CHUNK;
+    }
+    session->state = DANP_FTP_REACTOR_STATE_READ_SEND;
+
+    return true;
+}
+
+/**
+ * @brief Start an async read of the next READ chunk.
+ * @param session Pointer to the reactor session.
+ * @return true, the session always makes progress.
+ */
+static bool danp_ftp_reactor_read_start(danp_ftp_reactor_session_t *session)
+{
+    danp_ftp_client_context_t *ctx = &session->client;
+    danp_ftp_service_context_t *svc = ctx->service;
+    danp_ftp_status_t result = 0;
+    uint16_t length = DANP_FTP_MAX_PAYLOAD_SIZE;
+
+    if (session->offset >= ctx->range_end)
+    {
+        length = 0;
+    }
+    else if (ctx->range_end - session->offset < length)
+    {
+        length = (uint16_t)(ctx->range_end - session->offset);
+    }
+
+    session->fs_peek = false;
+    danp_trace(DANP_TRACE_FTP_FS_BEGIN, DANP_TRACE_FS_READ, (uint32_t)session->offset);
+#if defined(CONFIG_DANP_FTP_SERVICE_PROFILER)
+    session->fs_cycles = danp_port_cycles();
+#endif
+    if (length > 0)
+    {
+        result = svc->config.fs.read_async(
+            ctx->file_handle,
+            session->offset,
+            session->chunk,
+            length,
+            &ctx->fs_op,
+            svc->config.user_data);
+        if (result == DANP_FTP_SERVICE_FS_PENDING)
+        {
+            session->state = DANP_FTP_REACTOR_STATE_READ_FS;
+            return true;
+        }
+    }
+
+    return danp_ftp_reactor_read_done(session, result);
+}
+#endif
+
+/**
+ * @brief Send the next READ chunk, or resend the one in flight after a timeout.
+ * @param session Pointer to the reactor session.
+ * @param now_ms Current uptime in milliseconds.
+ * @return true if the session made progress.
+ */
+static bool danp_ftp_reactor_read_data(danp_ftp_reactor_session_t *session, uint32_t now_ms)
+{
+    danp_ftp_client_context_t *ctx = &session->client;
+    danp_ftp_service_context_t *svc = ctx->service;
+    danp_ftp_status_t read_result = 0;
+    danp_ftp_status_t peek_result = 0;
+    uint16_t length = DANP_FTP_MAX_PAYLOAD_SIZE;
+    uint32_t wait_ms;
+
+    wait_ms = danp_ftp_service_schedule_delay(ctx);
+    if (wait_ms > 0)
+    {
+        session->wake_ms = now_ms + wait_ms;
+        return false;
+    }
+
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_ASYNC)
+    if (svc->config.fs.read_async)
+    {
+        return danp_ftp_reactor_read_start(session);
+    }
+#endif
+
+    if (session->offset >= ctx->range_end)
+    {
+        length = 0;
+    }
+    else if (ctx->range_end - session->offset < length)
+    {
+        length = (uint16_t)(ctx->range_end - session->offset);
+    }
+
+    /* Chunks are read again on a retransmit instead of being kept per session */
+    danp_trace(DANP_TRACE_FTP_FS_BEGIN, DANP_TRACE_FS_READ, (uint32_t)session->offset);
+    DANP_FTP_PROF_BEGIN(read_start);
+    if (length > 0)
+    {
+        read_result = svc->config.fs.read(
+            ctx->file_handle,
+            session->offset,
+            ftp_reactor_chunk,
+            length,
+            svc->config.user_data);
+    }
+    danp_trace(DANP_TRACE_FTP_FS_END, DANP_TRACE_FS_READ, (uint32_t)read_result);
+
+    /* An empty file or range still gets one empty LAST chunk */
+    if (read_result < 0 || (read_result == 0 && session->offset != ctx->range_start))
+    {
+        if (read_result < 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service file read failed: %d", read_result);
+        }
+        session->state = DANP_FTP_REACTOR_STATE_DONE;
+        return true;
+    }
+
+    wait_ms = danp_ftp_service_rate_try(ctx, sizeof(danp_ftp_header_t) + (uint32_t)read_result);
+    if (wait_ms > 0)
+    {
+        session->wake_ms = now_ms + wait_ms;
+        return false;
+    }
+
+    if (read_result > 0 && session->offset + (size_t)read_result < ctx->range_end)
+    {
+        peek_result = svc->config.fs.read(
+            ctx->file_handle,
+            session->offset + (size_t)read_result,
+            ftp_reactor_chunk + read_result,
+            1,
+            svc->config.user_data);
+    }
+    DANP_FTP_PROF_END(ctx, DANP_FTP_SERVICE_PROF_FS_READ, read_start);
+
+    session->chunk_flags = DANP_FTP_FLAG_NONE;
+    if (session->offset == ctx->range_start)
+    {
+        session->chunk_flags |= DANP_FTP_FLAG_FIRST_CHUNK;
+    }
+    if (peek_result <= 0)
+    {
+        session->chunk_flags |= DANP_FTP_FLAG_LAST_CHUNK;
+    }
+    session->chunk_len = (uint16_t)read_result;
+    danp_ftp_reactor_send_chunk(session, now_ms, ftp_reactor_chunk);
+
+    return true;
+}
+
+/**
+ * @brief Match an ACK to the READ chunk in flight, or back off and resend on timeout or NACK.
+ * @param session Pointer to the reactor session.
+ * @param now_ms Current uptime in milliseconds.
+ * @return true if the session made progress.
+ */
+static bool danp_ftp_reactor_read_ack(danp_ftp_reactor_session_t *session, uint32_t now_ms)
+{
+    danp_ftp_client_context_t *ctx = &session->client;
+    int32_t poll_result;
+    bool lost;
+
+    poll_result = danp_ftp_reactor_poll_message(session);
+    if (poll_result < 0)
+    {
+        session->state = DANP_FTP_REACTOR_STATE_DONE;
+        return true;
+    }
+
+    if (poll_result == 0 && !danp_ftp_reactor_reached(now_ms, session->deadline_ms))
+    {
+        return false;
+    }
+
+    /* A NACK or stray packet is a loss, as in the threaded wait for ACK */
+    lost = (poll_result == 0);
+    if (!lost && ftp_reactor_message.header.type == DANP_FTP_PACKET_TYPE_NACK)
+    {
+        danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service received NACK");
+        lost = true;
+    }
+    else if (!lost && ftp_reactor_message.header.type != DANP_FTP_PACKET_TYPE_ACK)
+    {
+        danp_log_message(
+            DANP_LOG_LEVEL_WRN,
+            "FTP service unexpected packet type: %u",
+            ftp_reactor_message.header.type);
+        lost = true;
+    }
+
+    if (lost)
+    {
+        if (session->attempt >= DANP_FTP_SERVICE_MAX_RETRANSMITS)
+        {
+            danp_log_message(
+                DANP_LOG_LEVEL_ERR,
+                "FTP service giving up on seq=%u after %u retransmits",
+                ctx->sequence_number,
+                session->attempt);
+            session->state = DANP_FTP_REACTOR_STATE_DONE;
+            return true;
+        }
+
+        danp_trace(DANP_TRACE_FTP_ACK_WAIT_END, ctx->sequence_number, (uint32_t)DANP_FTP_STATUS_TRANSFER_FAILED);
+
+        session->attempt++;
+        danp_ftp_service_count_retransmit(ctx);
+        ctx->rto_ms = (ctx->rto_ms > DANP_FTP_SERVICE_MAX_RTO_MS / 2) ?
+                      DANP_FTP_SERVICE_MAX_RTO_MS : ctx->rto_ms * 2;
+
+        danp_log_message(
+            DANP_LOG_LEVEL_WRN,
+            "FTP service retransmit seq=%u attempt=%u rto=%u ms",
+            ctx->sequence_number,
+            session->attempt,
+            ctx->rto_ms);
+
+        session->state = DANP_FTP_REACTOR_STATE_READ_DATA;
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_ASYNC)
+        if (ctx->service->config.fs.read_async)
+        {
+            /* The chunk is still in the session buffer */
+            session->state = DANP_FTP_REACTOR_STATE_READ_SEND;
+        }
+#endif
+        return true;
+    }
+
+    if (ftp_reactor_message.header.sequence_number != ctx->sequence_number)
+    {
+        danp_log_message(
+            DANP_LOG_LEVEL_DBG,
+            "FTP service skipping stale ACK: expected=%u got=%u",
+            ctx->sequence_number,
+            ftp_reactor_message.header.sequence_number);
+        return true;
+    }
+
+    if (session->attempt == 0)
+    {
+        danp_ftp_service_rtt_sample(ctx, now_ms - session->sent_ms);
+    }
+    DANP_FTP_PROF_END(ctx, DANP_FTP_SERVICE_PROF_ACK_WAIT, session->sent_cycles);
+    danp_trace(DANP_TRACE_FTP_ACK_WAIT_END, ctx->sequence_number, DANP_FTP_STATUS_OK);
+
+    session->attempt = 0;
+    session->offset += session->chunk_len;
+    ctx->sequence_number++;
+
+    if (session->chunk_flags & DANP_FTP_FLAG_LAST_CHUNK)
+    {
+        danp_log_message(DANP_LOG_LEVEL_INF, "FTP service read complete: %zu bytes", session->offset - ctx->range_start);
+        session->state = DANP_FTP_REACTOR_STATE_DONE;
+    }
+    else
+    {
+        session->state = DANP_FTP_REACTOR_STATE_READ_DATA;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Take the result of storing a WRITE chunk.
+ * @param session Pointer to the reactor session.
+ * @param result Bytes written, negative status on error.
+ * @return true, the session always makes progress.
+ */
+static bool danp_ftp_reactor_write_done(danp_ftp_reactor_session_t *session, danp_ftp_status_t result)
+{
+    danp_ftp_client_context_t *ctx = &session->client;
+
+    DANP_FTP_PROF_END(ctx, DANP_FTP_SERVICE_PROF_FS_WRITE, session->fs_cycles);
+    danp_trace(DANP_TRACE_FTP_FS_END, DANP_TRACE_FS_WRITE, (uint32_t)result);
+
+    if (result < 0)
+    {
+        danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service file write failed: %d", result);
+        danp_ftp_service_transmit(ctx, DANP_FTP_PACKET_TYPE_NACK, DANP_FTP_FLAG_NONE, NULL, 0);
+        session->state = DANP_FTP_REACTOR_STATE_DONE;
+        return true;
+    }
+
+    session->state = DANP_FTP_REACTOR_STATE_WRITE_ACK;
+
+    return true;
+}
+
+/**
+ * @brief Take the next WRITE chunk if one has arrived.
+ * @param session Pointer to the reactor session.
+ * @param now_ms Current uptime in milliseconds.
+ * @return true if the session made progress.
+ */
+static bool danp_ftp_reactor_write_data(danp_ftp_reactor_session_t *session, uint32_t now_ms)
+{
+    danp_ftp_client_context_t *ctx = &session->client;
+    danp_ftp_service_context_t *svc = ctx->service;
+    danp_ftp_message_t *message = &ftp_reactor_message;
+    danp_ftp_status_t write_result;
+    uint16_t current;
+    uint32_t wait_ms;
+    int32_t poll_result;
+
+    wait_ms = danp_ftp_service_schedule_delay(ctx);
+    if (wait_ms > 0)
+    {
+        session->wake_ms = now_ms + wait_ms;
+        return false;
+    }
+
+    poll_result = danp_ftp_reactor_poll_message(session);
+    if (poll_result < 0)
+    {
+        session->state = DANP_FTP_REACTOR_STATE_DONE;
+        return true;
+    }
+
+    if (poll_result == 0)
+    {
+        if (danp_ftp_reactor_reached(now_ms, session->deadline_ms))
+        {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service receive data failed");
+            session->state = DANP_FTP_REACTOR_STATE_DONE;
+            return true;
+        }
+        return false;
+    }
+
+    if (message->header.type == DANP_FTP_PACKET_TYPE_DATA &&
+        message->header.sequence_number == (uint16_t)(ctx->sequence_number - 1))
+    {
+        /* Client missed our ACK and retransmitted, repeat it */
+        current = ctx->sequence_number;
+        ctx->sequence_number = message->header.sequence_number;
+        danp_ftp_service_transmit(ctx, DANP_FTP_PACKET_TYPE_ACK, DANP_FTP_FLAG_NONE, NULL, 0);
+        ctx->sequence_number = current;
+        return true;
+    }
+
+    if (message->header.type != DANP_FTP_PACKET_TYPE_DATA ||
+        message->header.sequence_number != ctx->sequence_number)
+    {
+        danp_log_message(
+            DANP_LOG_LEVEL_WRN,
+            "FTP service unexpected packet: type=%u seq=%u expected=%u",
+            message->header.type,
+            message->header.sequence_number,
+            ctx->sequence_number);
+        danp_ftp_service_transmit(ctx, DANP_FTP_PACKET_TYPE_NACK, DANP_FTP_FLAG_NONE, NULL, 0);
+        return true;
+    }
 
-            offset += data_msg.header.payload_length;
-            ctx->sequence_number++;
-        }
+    session->chunk_len = message->header.payload_length;
+    session->chunk_flags = message->header.flags;
 
-        /* Close file */
-        svc->config.fs.close(file_handle, svc->config.user_data);
-        ctx->file_open = false;
+    danp_trace(DANP_TRACE_FTP_FS_BEGIN, DANP_TRACE_FS_WRITE, (uint32_t)session->offset);
+#if defined(CONFIG_DANP_FTP_SERVICE_PROFILER)
+    session->fs_cycles = danp_port_cycles();
+#endif
 
-        if (status >= 0)
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_ASYNC)
+    if (svc->config.fs.write_async)
+    {
+        /* The shared message buffer is reused by the next session, keep the data */
+        memcpy(session->chunk, message->payload, session->chunk_len);
+        write_result = svc->config.fs.write_async(
+            ctx->file_handle,
+            session->offset,
+            session->chunk,
+            session->chunk_len,
+            &ctx->fs_op,
+            svc->config.user_data);
+        if (write_result == DANP_FTP_SERVICE_FS_PENDING)
         {
-            danp_log_message(
-                DANP_LOG_LEVEL_INF,
-                "FTP service write complete: %zu bytes",
-                offset);
-            status = (danp_ftp_status_t)offset;
+            session->state = DANP_FTP_REACTOR_STATE_WRITE_FS;
+            return true;
         }
-
-        break;
+        return danp_ftp_reactor_write_done(session, write_result);
     }
+#endif
 
-    return status;
+    write_result = svc->config.fs.write(
+        ctx->file_handle,
+        session->offset,
+        message->payload,
+        message->header.payload_length,
+        svc->config.user_data);
+
+    return danp_ftp_reactor_write_done(session, write_result);
 }
 
 /**
- * @brief Client handler thread function.
- * @param arg Pointer to client context.
+ * @brief Run one session until it would block.
+ * @param session Pointer to the reactor session.
+ * @param now_ms Current uptime in milliseconds.
+ * @return true if the session made progress.
  */
-static void danp_ftp_client_handler_thread(void *arg)
+static bool danp_ftp_reactor_step(danp_ftp_reactor_session_t *session, uint32_t now_ms)
 {
-    danp_ftp_client_context_t *ctx = (danp_ftp_client_context_t *)arg;
-    danp_ftp_message_t message;
-    danp_ftp_status_t status;
-    uint8_t command;
-    uint8_t file_id_len;
-    const uint8_t *file_id;
-    uint8_t response_payload[1];
+    danp_ftp_client_context_t *ctx = &session->client;
+    uint32_t wait_ms;
+    int32_t poll_result;
+    bool progress = false;
 
-    for (;;)
+    switch (session->state)
     {
-        if (!ctx || !ctx->socket)
+    case DANP_FTP_REACTOR_STATE_COMMAND:
+        poll_result = danp_ftp_reactor_poll_message(session);
+        if (poll_result > 0)
         {
-            break;
+            danp_ftp_reactor_start(session);
+            progress = true;
         }
-
-        danp_log_message(
-            DANP_LOG_LEVEL_INF,
-            "FTP service client handler started for node %u",
-            ctx->socket->remote_node);
-
-        /* Wait for command */
-        status = danp_ftp_service_receive_message(
-            ctx,
-            &message,
-            DANP_FTP_SERVICE_TIMEOUT_MS);
-
-        if (status < 0)
+        else if (poll_result < 0 || danp_ftp_reactor_reached(now_ms, session->deadline_ms))
         {
             danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service command receive failed");
-            break;
+            session->state = DANP_FTP_REACTOR_STATE_DONE;
+            progress = true;
         }
+        break;
 
-        if (message.header.type != DANP_FTP_PACKET_TYPE_COMMAND)
+    case DANP_FTP_REACTOR_STATE_RESPONSE:
+        wait_ms = danp_ftp_service_rate_try(ctx, sizeof(danp_ftp_header_t) + session->response_len);
+        if (wait_ms > 0)
         {
-            danp_log_message(
-                DANP_LOG_LEVEL_WRN,
-                "FTP service expected command, got type: %u",
-                message.header.type);
+            session->wake_ms = now_ms + wait_ms;
             break;
         }
 
-        if (message.header.payload_length < 2)
-        {
-            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service command payload too short");
-            response_payload[0] = DANP_FTP_RESP_ERROR;
-            danp_ftp_service_send_message(
+        progress = true;
+        if (danp_ftp_service_transmit(
                 ctx,
                 DANP_FTP_PACKET_TYPE_RESPONSE,
                 DANP_FTP_FLAG_NONE,
-                response_payload,
-                1);
+                session->response,
+                session->response_len) < 0)
+        {
+            session->state = DANP_FTP_REACTOR_STATE_DONE;
             break;
         }
 
-        command = message.payload[0];
-        file_id_len = message.payload[1];
-        file_id = &message.payload[2];
+        if (session->next_state != DANP_FTP_REACTOR_STATE_DONE)
+        {
+            ctx->sequence_number++;
+        }
+        session->deadline_ms = now_ms + DANP_FTP_SERVICE_TIMEOUT_MS;
+        session->state = session->next_state;
+        break;
 
-        if (file_id_len + 2 > message.header.payload_length)
+    case DANP_FTP_REACTOR_STATE_READ_DATA:
+        progress = danp_ftp_reactor_read_data(session, now_ms);
+        break;
+
+    case DANP_FTP_REACTOR_STATE_READ_ACK:
+        progress = danp_ftp_reactor_read_ack(session, now_ms);
+        break;
+
+    case DANP_FTP_REACTOR_STATE_WRITE_DATA:
+        progress = danp_ftp_reactor_write_data(session, now_ms);
+        break;
+
+    case DANP_FTP_REACTOR_STATE_STAT_DIGEST:
+        progress = danp_ftp_reactor_stat_digest(session);
+        break;
+
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_ASYNC)
+    case DANP_FTP_REACTOR_STATE_READ_FS:
+        if (danp_port_sem_take(&ctx->fs_op.done, 0) == 0)
         {
-            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service invalid file_id_len");
-            response_payload[0] = DANP_FTP_RESP_ERROR;
-            danp_ftp_service_send_message(
-                ctx,
-                DANP_FTP_PACKET_TYPE_RESPONSE,
-                DANP_FTP_FLAG_NONE,
-                response_payload,
-                1);
-            break;
+            progress = danp_ftp_reactor_read_done(session, ctx->fs_op.result);
         }
+        break;
 
-        switch (command)
+    case DANP_FTP_REACTOR_STATE_READ_SEND:
+        wait_ms = danp_ftp_service_rate_try(ctx, sizeof(danp_ftp_header_t) + session->chunk_len);
+        if (wait_ms > 0)
         {
-        case DANP_FTP_CMD_REQUEST_READ:
-            danp_ftp_service_handle_read_request(ctx, file_id, file_id_len);
+            session->wake_ms = now_ms + wait_ms;
             break;
+        }
 
-        case DANP_FTP_CMD_REQUEST_WRITE:
-            danp_ftp_service_handle_write_request(ctx, file_id, file_id_len);
-            break;
+        progress = true;
+        danp_ftp_reactor_send_chunk(session, now_ms, session->chunk);
+        break;
 
-        case DANP_FTP_CMD_ABORT:
-            danp_log_message(DANP_LOG_LEVEL_INF, "FTP service received abort command");
+    case DANP_FTP_REACTOR_STATE_WRITE_FS:
+        if (danp_port_sem_take(&ctx->fs_op.done, 0) == 0)
+        {
+            progress = danp_ftp_reactor_write_done(session, ctx->fs_op.result);
+        }
+        break;
+#endif
+
+    case DANP_FTP_REACTOR_STATE_WRITE_ACK:
+        wait_ms = danp_ftp_service_rate_try(ctx, sizeof(danp_ftp_header_t));
+        if (wait_ms > 0)
+        {
+            session->wake_ms = now_ms + wait_ms;
             break;
+        }
 
-        default:
-            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP service unknown command: %u", command);
-            response_payload[0] = DANP_FTP_RESP_ERROR;
-            danp_ftp_service_send_message(
-                ctx,
-                DANP_FTP_PACKET_TYPE_RESPONSE,
-                DANP_FTP_FLAG_NONE,
-                response_payload,
-                1);
+        progress = true;
+        if (danp_ftp_service_transmit(ctx, DANP_FTP_PACKET_TYPE_ACK, DANP_FTP_FLAG_NONE, NULL, 0) < 0)
+        {
+            session->state = DANP_FTP_REACTOR_STATE_DONE;
             break;
         }
 
+        session->offset += session->chunk_len;
+        ctx->sequence_number++;
+
+        if (session->chunk_flags & DANP_FTP_FLAG_LAST_CHUNK)
+        {
+            danp_log_message(DANP_LOG_LEVEL_INF, "FTP service write complete: %zu bytes", session->offset - ctx->range_start);
+            session->state = DANP_FTP_REACTOR_STATE_DONE;
+        }
+        else
+        {
+            session->deadline_ms = now_ms + DANP_FTP_SERVICE_TIMEOUT_MS;
+            session->state = DANP_FTP_REACTOR_STATE_WRITE_DATA;
+        }
+        break;
+
+    default:
         break;
     }
 
-    /* Cleanup */
-    if (ctx)
+    return progress;
+}
+
+/**
+ * @brief Release everything a finished session holds and free its slot.
+ * @param session Pointer to the reactor session.
+ */
+static void danp_ftp_reactor_close(danp_ftp_reactor_session_t *session)
+{
+    danp_ftp_client_context_t *ctx = &session->client;
+    danp_ftp_service_context_t *svc = ctx->service;
+
+    danp_ftp_service_session_end(ctx);
+#if defined(CONFIG_DANP_FTP_SERVICE_PROFILER)
+    danp_ftp_service_prof_commit(ctx);
+#endif
+
+    if (ctx->file_open)
     {
-        if (ctx->file_open && ctx->service)
+        svc->config.fs.close(ctx->file_handle, svc->config.user_data);
+    }
+
+    danp_close(ctx->socket);
+
+    danp_log_message(
+        DANP_LOG_LEVEL_INF,
+        "FTP service client session closed: srtt=%u ms rttvar=%u ms rto=%u ms retransmits=%u",
+        ctx->srtt_x8 >> 3,
+        ctx->rttvar_x4 >> 2,
+        ctx->rto_ms,
+        ctx->retransmits);
+
+    danp_port_mutex_lock(&svc->sched_lock);
+    svc->client_count--;
+    danp_port_mutex_unlock(&svc->sched_lock);
+
+    memset(session, 0, sizeof(danp_ftp_reactor_session_t));
+}
+
+/**
+ * @brief Single service thread multiplexing the listen socket and all sessions.
+ *
+ * DANP has no readiness API, so sockets are polled with zero timeouts.
+ * While a pass makes progress the next one starts at once; otherwise the
+ * thread backs off up to the idle period, or to the nearest session
+ * wakeup if that is sooner. With no sessions open it blocks in accept.
+ *
+ * @param arg Pointer to service context.
+ */
+static void danp_ftp_service_reactor_thread(void *arg)
+{
+    danp_ftp_service_context_t *svc = (danp_ftp_service_context_t *)arg;
+    danp_ftp_reactor_session_t *session;
+    danp_ftp_reactor_session_t *free_session;
+    danp_socket_t *client_socket;
+    uint32_t idle_ms = 0;
+    uint32_t sleep_ms;
+    uint32_t now_ms;
+    uint32_t live;
+    bool progress;
+
+    danp_log_message(DANP_LOG_LEVEL_INF, "FTP service reactor started");
+
+    while (svc->is_running)
+    {
+        progress = false;
+        free_session = NULL;
+        live = 0;
+
+        for (uint32_t i = 0; i < DANP_FTP_SERVICE_REACTOR_SESSIONS; i++)
         {
-            ctx->service->config.fs.close(
-                ctx->file_handle,
-                ctx->service->config.user_data);
+            if (ftp_reactor_sessions[i].state == DANP_FTP_REACTOR_STATE_FREE)
+            {
+                free_session = free_session ? free_session : &ftp_reactor_sessions[i];
+            }
+            else
+            {
+                live++;
+            }
         }
 
-        if (ctx->socket)
+        if (free_session)
         {
-            danp_close(ctx->socket);
+            /* Nothing else to do, so wait in accept like the threaded mode does */
+            client_socket = danp_accept(svc->listen_socket, (live == 0) ? 1000 : 0);
+            if (client_socket)
+            {
+                danp_log_message(
+                    DANP_LOG_LEVEL_INF,
+                    "FTP service accepted connection from node %u",
+                    client_socket->remote_node);
+
+                free_session->client.socket = client_socket;
+                free_session->client.service = svc;
+                free_session->client.priority = danp_ftp_service_lookup_priority(svc, client_socket->remote_node);
+                free_session->client.rto_ms = DANP_FTP_SERVICE_INITIAL_RTO_MS;
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_ASYNC)
+                danp_port_sem_init(&free_session->client.fs_op.done);
+#endif
+                free_session->wake_ms = danp_port_uptime_ms();
+                free_session->deadline_ms = free_session->wake_ms + DANP_FTP_SERVICE_TIMEOUT_MS;
+                free_session->state = DANP_FTP_REACTOR_STATE_COMMAND;
+
+                danp_port_mutex_lock(&svc->sched_lock);
+                svc->client_count++;
+                if (svc->client_count > svc->client_peak)
+                {
+                    svc->client_peak = svc->client_count;
+                }
+                danp_port_mutex_unlock(&svc->sched_lock);
+
+                progress = true;
+            }
+        }
+
+        now_ms = danp_port_uptime_ms();
+        sleep_ms = DANP_FTP_SERVICE_REACTOR_IDLE_MS;
+
+        for (uint32_t i = 0; i < DANP_FTP_SERVICE_REACTOR_SESSIONS; i++)
+        {
+            session = &ftp_reactor_sessions[i];
+            if (session->state == DANP_FTP_REACTOR_STATE_FREE)
+            {
+                continue;
+            }
+
+            if (danp_ftp_reactor_reached(now_ms, session->wake_ms))
+            {
+                session->wake_ms = now_ms;
+                progress |= danp_ftp_reactor_step(session, now_ms);
+            }
+            else if (session->wake_ms - now_ms < sleep_ms)
+            {
+                sleep_ms = session->wake_ms - now_ms;
+            }
+
+            if (session->state == DANP_FTP_REACTOR_STATE_DONE)
+            {
+                danp_ftp_reactor_close(session);
+                danp_ftp_service_stack_sample(svc, false);
+            }
+        }
+
+        if (progress)
+        {
+            idle_ms = 0;
+            continue;
         }
 
-        danp_log_message(DANP_LOG_LEVEL_INF, "FTP service client handler terminated");
+        idle_ms = (idle_ms == 0) ? 1 : idle_ms * 2;
+        if (idle_ms < sleep_ms)
+        {
+            sleep_ms = idle_ms;
+        }
 
-        /* Free client context */
-        memset(ctx, 0, sizeof(danp_ftp_client_context_t));
+        if (live > 0)
+        {
+            danp_port_sleep_ms(sleep_ms);
+        }
     }
+
+    danp_log_message(DANP_LOG_LEVEL_INF, "FTP service reactor terminated");
 }
+#endif
 
+#if !defined(CONFIG_DANP_FTP_SERVICE_REACTOR)
 /**
  * @brief Main service thread function.
  * @param arg Pointer to service context.
@@ -835,7 +4496,7 @@ static void danp_ftp_service_thread(void *arg)
     osal_thread_handle_t client_thread = NULL;
     osal_thread_attr_t client_thread_attr = {
         .name = "ftpClient",
-        .stack_size = DANP_FTP_SERVICE_STACK_SIZE,
+        .stack_size = DANP_FTP_SERVICE_CLIENT_STACK_SIZE,
         .stack_mem = NULL,
         .priority = OSAL_THREAD_PRIORITY_NORMAL,
         .cb_mem = NULL,
@@ -853,19 +4514,29 @@ static void danp_ftp_service_thread(void *arg)
 
         while (svc->is_running)
         {
+            /* Leave further connections in the backlog until a handler slot frees up */
+            if (svc->client_count >= DANP_FTP_SERVICE_MAX_CLIENTS)
+            {
+                danp_port_sleep_ms(DANP_FTP_SERVICE_SCHED_SLICE_MS);
+                continue;
+            }
+
             client_socket = danp_accept(svc->listen_socket, 1000);
             if (!client_socket)
             {
                 continue;
             }
 
+            danp_ftp_service_stack_sample(svc, false);
+
             danp_log_message(
                 DANP_LOG_LEVEL_INF,
                 "FTP service accepted connection from node %u",
                 client_socket->remote_node);
 
             /* Allocate client context */
-            client_ctx = (danp_ftp_client_context_t *)osal_memory_alloc(
+            client_ctx = (danp_ftp_client_context_t *)danp_ftp_service_alloc(
+                svc,
                 sizeof(danp_ftp_client_context_t));
 
             if (!client_ctx)
@@ -880,6 +4551,19 @@ static void danp_ftp_service_thread(void *arg)
             client_ctx->service = svc;
             client_ctx->sequence_number = 0;
             client_ctx->file_open = false;
+            client_ctx->priority = danp_ftp_service_lookup_priority(svc, client_socket->remote_node);
+            client_ctx->rto_ms = DANP_FTP_SERVICE_INITIAL_RTO_MS;
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_ASYNC)
+            danp_port_sem_init(&client_ctx->fs_op.done);
+#endif
+
+            danp_port_mutex_lock(&svc->sched_lock);
+            svc->client_count++;
+            if (svc->client_count > svc->client_peak)
+            {
+                svc->client_peak = svc->client_count;
+            }
+            danp_port_mutex_unlock(&svc->sched_lock);
 
             /* Create client handler thread */
             client_thread = osal_thread_create(
@@ -890,8 +4574,11 @@ static void danp_ftp_service_thread(void *arg)
             if (!client_thread)
             {
                 danp_log_message(DANP_LOG_LEVEL_ERR, "FTP service failed to create client thread");
+                danp_port_mutex_lock(&svc->sched_lock);
+                svc->client_count--;
+                danp_port_mutex_unlock(&svc->sched_lock);
                 danp_close(client_socket);
-                osal_memory_free(client_ctx);
+                danp_ftp_service_free(svc, client_ctx, sizeof(danp_ftp_client_context_t));
                 continue;
             }
         }
@@ -901,6 +4588,20 @@ static void danp_ftp_service_thread(void *arg)
 
     danp_log_message(DANP_LOG_LEVEL_INF, "FTP service thread terminated");
 }
+#endif
+
+#if defined(CONFIG_DANP_FTP_SERVICE_FS_ASYNC)
+/**
+ * @brief Complete a pending async filesystem operation.
+ * @param op Operation passed to the async callback.
+ * @param result Bytes read or written, negative status on error.
+ */
+void danp_ftp_service_fs_complete(danp_ftp_service_fs_op_t *op, danp_ftp_status_t result)
+{
+    op->result = result;
+    danp_port_sem_give(&op->done);
+}
+#endif
 
 /**
  * @brief Initialize the FTP service.
@@ -948,6 +4649,10 @@ int32_t danp_ftp_service_init(const danp_ftp_service_config_t *config)
 
         memset(&ftp_service_ctx, 0, sizeof(danp_ftp_service_context_t));
         memcpy(&ftp_service_ctx.config, config, sizeof(danp_ftp_service_config_t));
+        danp_port_mutex_init(&ftp_service_ctx.sched_lock);
+        ftp_service_ctx.tx_bucket.rate_bps = DANP_FTP_SERVICE_RATE_LIMIT_BPS;
+        ftp_service_ctx.session_rate_bps = DANP_FTP_SERVICE_SESSION_RATE_BPS;
+        ftp_service_ctx.rate_window_start_ms = danp_port_uptime_ms();
 
         /* Create listening socket */
         sock = danp_socket(DANP_TYPE_STREAM);
@@ -974,10 +4679,18 @@ int32_t danp_ftp_service_init(const danp_ftp_service_config_t *config)
         ftp_service_ctx.is_initialized = true;
 
         /* Create service thread */
+#if defined(CONFIG_DANP_FTP_SERVICE_REACTOR)
+        memset(ftp_reactor_sessions, 0, sizeof(ftp_reactor_sessions));
+        thread_handle = osal_thread_create(
+            danp_ftp_service_reactor_thread,
+            &ftp_service_ctx,
+            &thread_attr);
+#else
         thread_handle = osal_thread_create(
             danp_ftp_service_thread,
             &ftp_service_ctx,
             &thread_attr);
+#endif
 
         if (!thread_handle)
         {
@@ -1000,3 +4713,167 @@ int32_t danp_ftp_service_init(const danp_ftp_service_config_t *config)
 
     return ret;
 }
+
+/**
+ * @brief Set the transmit rate limits of the FTP service.
+ * @param global_bps Limit shared by all sessions in bytes per second, 0 = unlimited.
+ * @param session_bps Limit of each session in bytes per second, 0 = unlimited.
+ * @return 0 on success, negative on error.
+ */
+int32_t danp_ftp_service_set_rate_limit(uint32_t global_bps, uint32_t session_bps)
+{
+    if (!ftp_service_ctx.is_initialized)
+    {
+        return -1;
+    }
+
+    danp_port_mutex_lock(&ftp_service_ctx.sched_lock);
+    ftp_service_ctx.tx_bucket.rate_bps = global_bps;
+    ftp_service_ctx.tx_bucket.primed = false;
+    memset(ftp_service_ctx.class_bucket, 0, sizeof(ftp_service_ctx.class_bucket));
+    ftp_service_ctx.session_rate_bps = session_bps;
+
+    /* Measure the achieved rate against the new limits only */
+    ftp_service_ctx.achieved_bps = 0;
+    ftp_service_ctx.rate_window_bytes = 0;
+    ftp_service_ctx.rate_window_start_ms = danp_port_uptime_ms();
+    danp_port_mutex_unlock(&ftp_service_ctx.sched_lock);
+
+    danp_log_message(
+        DANP_LOG_LEVEL_INF,
+        "FTP service rate limit: global=%u B/s session=%u B/s",
+        global_bps,
+        session_bps);
+
+    return 0;
+}
+
+/**
+ * @brief Get the transmit rate limits and achieved rate of the FTP service.
+ * @param stats Pointer to store the statistics.
+ * @return 0 on success, negative on error.
+ */
+int32_t danp_ftp_service_get_rate_stats(danp_ftp_service_rate_stats_t *stats)
+{
+    if (!stats || !ftp_service_ctx.is_initialized)
+    {
+        return -1;
+    }
+
+    danp_port_mutex_lock(&ftp_service_ctx.sched_lock);
+    stats->global_limit_bps = ftp_service_ctx.tx_bucket.rate_bps;
+    stats->session_limit_bps = ftp_service_ctx.session_rate_bps;
+    stats->achieved_bps = ftp_service_ctx.achieved_bps;
+    stats->throttled_ms = ftp_service_ctx.throttled_ms;
+    stats->bytes_sent = ftp_service_ctx.bytes_sent;
+    stats->retransmits = ftp_service_ctx.retransmits;
+
+    /* Report idle once the current window has gone stale */
+    if (danp_port_uptime_ms() - ftp_service_ctx.rate_window_start_ms > 2 * DANP_FTP_SERVICE_RATE_WINDOW_MS)
+    {
+        stats->achieved_bps = 0;
+    }
+    danp_port_mutex_unlock(&ftp_service_ctx.sched_lock);
+
+    return 0;
+}
+
+/**
+ * @brief Get the number of live and peak concurrent client handlers.
+ * @param active Pointer to store the live handler count.
+ * @param peak Pointer to store the peak handler count since init.
+ * @return 0 on success, negative on error.
+ */
+int32_t danp_ftp_service_get_client_count(uint32_t *active, uint32_t *peak)
+{
+    if (!active || !peak || !ftp_service_ctx.is_initialized)
+    {
+        return -1;
+    }
+
+    danp_port_mutex_lock(&ftp_service_ctx.sched_lock);
+    *active = ftp_service_ctx.client_count;
+    *peak = ftp_service_ctx.client_peak;
+    danp_port_mutex_unlock(&ftp_service_ctx.sched_lock);
+
+    return 0;
+}
+
+/**
+ * @brief Get the stack high-water marks and heap usage of the FTP service.
+ * @param stats Pointer to store the statistics.
+ * @return 0 on success, negative on error.
+ */
+int32_t danp_ftp_service_get_mem_stats(danp_ftp_service_mem_stats_t *stats)
+{
+    if (!stats || !ftp_service_ctx.is_initialized)
+    {
+        return -1;
+    }
+
+    memset(stats, 0, sizeof(danp_ftp_service_mem_stats_t));
+    stats->service_stack_size = DANP_FTP_SERVICE_STACK_SIZE;
+    stats->client_stack_size = DANP_FTP_SERVICE_CLIENT_STACK_SIZE;
+    stats->context_size = sizeof(danp_ftp_client_context_t);
+#if defined(CONFIG_DANP_FTP_SERVICE_REACTOR)
+    stats->static_bytes = sizeof(ftp_reactor_sessions) + sizeof(ftp_reactor_message) + sizeof(ftp_reactor_chunk);
+#endif
+
+    danp_port_mutex_lock(&ftp_service_ctx.sched_lock);
+    stats->service_stack_used = ftp_service_ctx.service_stack_used;
+    stats->client_stack_peak = ftp_service_ctx.client_stack_peak;
+    stats->client_stack_last = ftp_service_ctx.client_stack_last;
+    stats->client_stack_samples = ftp_service_ctx.client_stack_samples;
+    stats->heap_in_use = ftp_service_ctx.heap_in_use;
+    stats->heap_peak = ftp_service_ctx.heap_peak;
+    danp_port_mutex_unlock(&ftp_service_ctx.sched_lock);
+
+    return 0;
+}
+
+#if defined(CONFIG_DANP_FTP_SERVICE_PROFILER)
+/**
+ * @brief Get the stage profile of the FTP service.
+ * @param total Pointer to store the profile summed over all finished sessions, may be NULL.
+ * @param last Pointer to store the profile of the last finished session, may be NULL.
+ * @return 0 on success, negative on error.
+ */
+int32_t danp_ftp_service_get_profile(
+    danp_ftp_service_profile_t *total,
+    danp_ftp_service_profile_t *last)
+{
+    if (!ftp_service_ctx.is_initialized)
+    {
+        return -1;
+    }
+
+    danp_port_mutex_lock(&ftp_service_ctx.sched_lock);
+    if (total)
+    {
+        memcpy(total, &ftp_service_ctx.profile_total, sizeof(danp_ftp_service_profile_t));
+    }
+    if (last)
+    {
+        memcpy(last, &ftp_service_ctx.profile_last, sizeof(danp_ftp_service_profile_t));
+    }
+    danp_port_mutex_unlock(&ftp_service_ctx.sched_lock);
+
+    return 0;
+}
+
+/**
+ * @brief Clear the stage profile of the FTP service.
+ */
+void danp_ftp_service_reset_profile(void)
+{
+    if (!ftp_service_ctx.is_initialized)
+    {
+        return;
+    }
+
+    danp_port_mutex_lock(&ftp_service_ctx.sched_lock);
+    memset(&ftp_service_ctx.profile_total, 0, sizeof(danp_ftp_service_profile_t));
+    memset(&ftp_service_ctx.profile_last, 0, sizeof(danp_ftp_service_profile_t));
+    danp_port_mutex_unlock(&ftp_service_ctx.sched_lock);
+}
+#endif
@@ -0,0 +1,2124 @@
+/* danp_ftp_service_client.c - Client helpers for extended FTP service commands */
+
+/* All Rights Reserved */
+
+/* Includes */
+
+#include "osal/osal_memory.h"
+#include "danp/services/danp_ftp_service_client.h"
+#include "danp/ftp/danp_ftp.h"
+#include "danp/danp.h"
+#include "danp_debug.h"
+#include "danp_port.h"
+#include "danp_trace.h"
+#include "services/danp_ftp_service_int.h"
+#include <string.h>
+
+/* Imports */
+
+
+/* Definitions */
+
+#define DANP_FTP_CLIENT_MAX_RETRIES           (3)
+#define DANP_FTP_CLIENT_POLL_MAX_MS           (10)
+
+/* Internal, the service answered DANP_FTP_RESP_WIDE and the command is to be sent again with u64 fields */
+#define DANP_FTP_CLIENT_STATUS_WIDE           (-0x101)
+
+/* Types */
+
+typedef struct danp_ftp_service_client_session_s
+{
+    danp_socket_t *socket;
+    uint16_t sequence_number;
+    bool wide;                                   /* Commands carry u64 offset and size fields */
+} danp_ftp_service_client_session_t;
+
+typedef struct danp_ftp_service_client_fec_block_s
+{
+    uint16_t first_seq;                          /* Sequence number of chunk 0 */
+    uint8_t count;                               /* Chunks in the block, 0 until known */
+    bool last;                                   /* Block ends the file */
+    uint32_t have;                               /* Bitmap of data chunks present */
+    uint32_t parity_have;                        /* Bitmap of parity chunks present */
+    uint16_t length[DANP_FTP_FEC_MAX_K];         /* Length of each data chunk */
+    uint16_t parity_length[DANP_FTP_FEC_MAX_R];  /* XOR of the lengths each parity covers */
+    uint8_t *data;                               /* fec_k chunks, zero padded */
+    uint8_t *parity;                             /* fec_r parity chunks, zero padded */
+} danp_ftp_service_client_fec_block_t;
+
+typedef struct danp_ftp_service_client_range_s
+{
+    danp_ftp_service_client_session_t session;
+    size_t start;                                /* First byte of the range */
+    size_t offset;                               /* Next byte expected */
+    uint32_t deadline_ms;                        /* Response or next chunk due */
+    bool started;                                /* Response received */
+    bool done;                                   /* LAST chunk received */
+} danp_ftp_service_client_range_t;
+
+/* Forward Declarations */
+
+
+/* Variables */
+
+
+/* Functions */
+
+/**
+ * @brief Turn a byte count into a return value.
+ * @param bytes Bytes transferred.
+ * @return The count, INT32_MAX for transfers past 2 GiB.
+ */
+static danp_ftp_status_t danp_ftp_service_client_count(size_t bytes)
+{
+    return (bytes > (size_t)INT32_MAX) ? INT32_MAX : (danp_ftp_status_t)bytes;
+}
+
+/**
+ * @brief Connect a client session to the FTP service of a remote node.
+ * @param session Pointer to the session.
+ * @param remote_node Node running the FTP service.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_client_open(
+    danp_ftp_service_client_session_t *session,
+    uint16_t remote_node)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+
+    for (;;)
+    {
+        memset(session, 0, sizeof(danp_ftp_service_client_session_t));
+
+        session->socket = danp_socket(DANP_TYPE_STREAM);
+        if (!session->socket)
+        {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP client failed to create socket");
+            status = DANP_FTP_STATUS_ERROR;
+            break;
+        }
+
+        if (danp_connect(session->socket, remote_node, DANP_FTP_SERVICE_PORT) < 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP client failed to connect to node %u", remote_node);
+            danp_close(session->socket);
+            session->socket = NULL;
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+
+        break;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Close a client session.
+ * @param session Pointer to the session.
+ */
+static void danp_ftp_service_client_close(danp_ftp_service_client_session_t *session)
+{
+    if (session->socket)
+    {
+        danp_close(session->socket);
+        session->socket = NULL;
+    }
+}
+
+/**
+ * @brief Send an FTP protocol message from client.
+ * @param session Pointer to the session.
+ * @param type Packet type.
+ * @param flags Packet flags.
+ * @param payload Pointer to the payload data.
+ * @param payload_length Length of the payload.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_client_send(
+    danp_ftp_service_client_session_t *session,
+    danp_ftp_packet_type_t type,
+    uint8_t flags,
+    const uint8_t *payload,
+    uint16_t payload_length)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    danp_ftp_message_t message;
+
+    for (;;)
+    {
+        if (payload_length > DANP_FTP_MAX_PAYLOAD_SIZE)
+        {
+            status = DANP_FTP_STATUS_INVALID_PARAM;
+            break;
+        }
+
+        memset(&message.header, 0, sizeof(danp_ftp_header_t));
+
+        message.header.type = (uint8_t)type;
+        message.header.flags = flags;
+        message.header.sequence_number = session->sequence_number;
+        message.header.payload_length = payload_length;
+
+        if (payload && payload_length > 0)
+        {
+            memcpy(message.payload, payload, payload_length);
+        }
+
+        message.header.crc = danp_ftp_service_crc32_update(
+            DANP_FTP_CRC32_INIT,
+            message.payload,
+            payload_length) ^ DANP_FTP_CRC32_INIT;
+
+        danp_trace(DANP_TRACE_FTP_CLIENT_TX, session->sequence_number, ((uint32_t)type << 16) | payload_length);
+
+        if (danp_send(session->socket, &message, sizeof(danp_ftp_header_t) + payload_length) < 0)
+        {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP client send failed");
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+
+        break;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Validate a message received by the client.
+ * @param message Pointer to the received message.
+ * @param recv_result Result of danp_recv.
+ * @return Payload length on success, negative status on error.
+ */
+static danp_ftp_status_t danp_ftp_service_client_check(
+    danp_ftp_message_t *message,
+    int32_t recv_result)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    uint32_t calculated_crc;
+
+    for (;;)
+    {
+        if (recv_result < (int32_t)sizeof(danp_ftp_header_t))
+        {
+            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP client receive failed: %d", recv_result);
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+
+        if (message->header.payload_length > DANP_FTP_MAX_PAYLOAD_SIZE)
+        {
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+
+        calculated_crc = danp_ftp_service_crc32_update(
+            DANP_FTP_CRC32_INIT,
+            message->payload,
+            message->header.payload_length) ^ DANP_FTP_CRC32_INIT;
+
+        if (calculated_crc != message->header.crc)
+        {
+            danp_log_message(DANP_LOG_LEVEL_WRN, "FTP client CRC mismatch");
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+
+        danp_trace(
+            DANP_TRACE_FTP_CLIENT_RX,
+            message->header.sequence_number,
+            ((uint32_t)message->header.type << 16) | message->header.payload_length);
+
+        status = (danp_ftp_status_t)message->header.payload_length;
+
+        break;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Receive an FTP protocol message on client side.
+ * @param session Pointer to the session.
+ * @param message Pointer to store the received message.
+ * @param timeout_ms Timeout in milliseconds.
+ * @return Payload length on success, negative status on error.
+ */
+static danp_ftp_status_t danp_ftp_service_client_receive(
+    danp_ftp_service_client_session_t *session,
+    danp_ftp_message_t *message,
+    uint32_t timeout_ms)
+{
+    int32_t recv_result;
+
+    recv_result = danp_recv(
+        session->socket,
+        message,
+        sizeof(danp_ftp_message_t),
+        timeout_ms);
+
+    return danp_ftp_service_client_check(message, recv_result);
+}
+
+/**
+ * @brief Receive an FTP protocol message without blocking.
+ * @param session Pointer to the session.
+ * @param message Pointer to store the received message.
+ * @return 1 if a message arrived, 0 if nothing arrived, negative status on error.
+ */
+static danp_ftp_status_t danp_ftp_service_client_poll(
+    danp_ftp_service_client_session_t *session,
+    danp_ftp_message_t *message)
+{
+    danp_ftp_status_t status;
+    int32_t recv_result;
+
+    recv_result = danp_recv(
+        session->socket,
+        message,
+        sizeof(danp_ftp_message_t),
+        0);
+
+    if (danp_port_recv_timed_out(recv_result))
+    {
+        return 0;
+    }
+
+    status = danp_ftp_service_client_check(message, recv_result);
+
+    return (status < 0) ? status : 1;
+}
+
+/**
+ * @brief Send a command to the service.
+ * @param session Pointer to a connected session.
+ * @param command Command code.
+ * @param file_id File name/id.
+ * @param file_id_len File name/id length.
+ * @param args Optional command arguments appended after the file id.
+ * @param args_len Length of the arguments.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_client_send_command(
+    danp_ftp_service_client_session_t *session,
+    uint8_t command,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    const uint8_t *args,
+    size_t args_len)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    uint8_t command_payload[DANP_FTP_MAX_PAYLOAD_SIZE];
+
+    for (;;)
+    {
+        if (file_id_len > UINT8_MAX || file_id_len + args_len + 2 > DANP_FTP_MAX_PAYLOAD_SIZE)
+        {
+            status = DANP_FTP_STATUS_INVALID_PARAM;
+            break;
+        }
+
+        command_payload[0] = command | (session->wide ? DANP_FTP_CMD_WIDE : 0);
+        command_payload[1] = (uint8_t)file_id_len;
+        memcpy(&command_payload[2], file_id, file_id_len);
+
+        if (args && args_len > 0)
+        {
+            memcpy(&command_payload[2 + file_id_len], args, args_len);
+        }
+
+        status = danp_ftp_service_client_send(
+            session,
+            DANP_FTP_PACKET_TYPE_COMMAND,
+            DANP_FTP_FLAG_NONE,
+            command_payload,
+            (uint16_t)(file_id_len + args_len + 2));
+
+        break;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Check the status byte of a service response.
+ * @param response Pointer to the response message.
+ * @param length Payload length of the response.
+ * @return Response payload length on success, negative status on error.
+ */
+static danp_ftp_status_t danp_ftp_service_client_check_response(
+    const danp_ftp_message_t *response,
+    danp_ftp_status_t length)
+{
+    danp_ftp_status_t status = length;
+
+    for (;;)
+    {
+        if (response->header.type != DANP_FTP_PACKET_TYPE_RESPONSE || length < 1)
+        {
+            danp_log_message(
+                DANP_LOG_LEVEL_WRN,
+                "FTP client unexpected response type: %u",
+                response->header.type);
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+
+        if (response->payload[0] == DANP_FTP_RESP_FILE_NOT_FOUND)
+        {
+            status = DANP_FTP_STATUS_FILE_NOT_FOUND;
+            break;
+        }
+
+        if (response->payload[0] == DANP_FTP_RESP_WIDE)
+        {
+            status = DANP_FTP_CLIENT_STATUS_WIDE;
+            break;
+        }
+
+        if (response->payload[0] != DANP_FTP_RESP_OK)
+        {
+            status = DANP_FTP_STATUS_ERROR;
+            break;
+        }
+
+        break;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Send a command and wait for the service response.
+ *
+ * DANP_FTP_CLIENT_STATUS_WIDE is returned when the service needs u64
+ * fields for the answer; the caller sends the command again on a new
+ * session with session->wide set.
+ *
+ * @param session Pointer to a connected session.
+ * @param command Command code.
+ * @param file_id File name/id.
+ * @param file_id_len File name/id length.
+ * @param args Optional command arguments appended after the file id.
+ * @param args_len Length of the arguments.
+ * @param response Pointer to store the response message.
+ * @param timeout_ms Response timeout in milliseconds.
+ * @return Response payload length on success, negative status on error.
+ */
+static danp_ftp_status_t danp_ftp_service_client_command(
+    danp_ftp_service_client_session_t *session,
+    uint8_t command,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    const uint8_t *args,
+    size_t args_len,
+    danp_ftp_message_t *response,
+    uint32_t timeout_ms)
+{
+    danp_ftp_status_t status;
+
+    status = danp_ftp_service_client_send_command(session, command, file_id, file_id_len, args, args_len);
+    if (status >= 0)
+    {
+        status = danp_ftp_service_client_receive(session, response, timeout_ms);
+    }
+    if (status >= 0)
+    {
+        status = danp_ftp_service_client_check_response(response, status);
+    }
+    if (status == DANP_FTP_CLIENT_STATUS_WIDE && session->wide)
+    {
+        status = DANP_FTP_STATUS_ERROR;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Wait for the ACK of the message last sent by the client.
+ *
+ * ACKs of earlier messages, left over from retransmits, are skipped.
+ *
+ * @param session Pointer to the session.
+ * @param timeout_ms Timeout in milliseconds.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_client_wait_for_ack(
+    danp_ftp_service_client_session_t *session,
+    uint32_t timeout_ms)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_TRANSFER_FAILED;
+    danp_ftp_message_t message;
+    uint32_t start_ms = danp_port_uptime_ms();
+    uint32_t elapsed_ms;
+
+    for (;;)
+    {
+        elapsed_ms = danp_port_uptime_ms() - start_ms;
+        if (elapsed_ms >= timeout_ms)
+        {
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+
+        status = danp_ftp_service_client_receive(session, &message, timeout_ms - elapsed_ms);
+        if (status < 0)
+        {
+            break;
+        }
+
+        if (message.header.type == DANP_FTP_PACKET_TYPE_ACK &&
+            message.header.sequence_number == session->sequence_number)
+        {
+            status = DANP_FTP_STATUS_OK;
+            break;
+        }
+
+        if (message.header.type != DANP_FTP_PACKET_TYPE_ACK)
+        {
+            danp_log_message(
+                DANP_LOG_LEVEL_WRN,
+                "FTP client expected ACK seq=%u, got type=%u seq=%u",
+                session->sequence_number,
+                message.header.type,
+                message.header.sequence_number);
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+    }
+
+    return status;
+}
+
+/**
+ * @brief Send a DATA message and wait for its ACK, retrying on loss.
+ * @param session Pointer to the session.
+ * @param flags Packet flags.
+ * @param payload Pointer to the payload data.
+ * @param payload_length Length of the payload.
+ * @param timeout_ms Per attempt timeout in milliseconds.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_client_send_reliable(
+    danp_ftp_service_client_session_t *session,
+    uint8_t flags,
+    const uint8_t *payload,
+    uint16_t payload_length,
+    uint32_t timeout_ms)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+
+    for (uint32_t attempt = 0; attempt <= DANP_FTP_CLIENT_MAX_RETRIES; attempt++)
+    {
+        status = danp_ftp_service_client_send(
+            session,
+            DANP_FTP_PACKET_TYPE_DATA,
+            flags,
+            payload,
+            payload_length);
+
+        if (status < 0)
+        {
+            break;
+        }
+
+        status = danp_ftp_service_client_wait_for_ack(session, timeout_ms);
+        if (status >= 0)
+        {
+            break;
+        }
+    }
+
+    return status;
+}
+
+/**
+ * @brief Compute the signature of one local block.
+ * @param offset Block offset in the local file.
+ * @param length Block length.
+ * @param read_cb Callback reading the local file.
+ * @param user_data User data passed to read_cb.
+ * @param crc Pointer to store the block CRC32.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_client_block_signature(
+    size_t offset,
+    size_t length,
+    danp_ftp_service_client_read_cb_t read_cb,
+    void *user_data,
+    uint32_t *crc)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    uint8_t buffer[DANP_FTP_MAX_PAYLOAD_SIZE];
+    uint32_t crc_register = DANP_FTP_CRC32_INIT;
+    size_t done = 0;
+    uint16_t piece;
+
+    while (done < length)
+    {
+        piece = DANP_FTP_MAX_PAYLOAD_SIZE;
+        if (length - done < piece)
+        {
+            piece = (uint16_t)(length - done);
+        }
+
+        status = read_cb(offset + done, buffer, piece, user_data);
+        if (status <= 0)
+        {
+            status = DANP_FTP_STATUS_ERROR;
+            break;
+        }
+
+        crc_register = danp_ftp_service_crc32_update(crc_register, buffer, (size_t)status);
+        done += (size_t)status;
+        status = DANP_FTP_STATUS_OK;
+    }
+
+    *crc = crc_register ^ DANP_FTP_CRC32_INIT;
+
+    return status;
+}
+
+/**
+ * @brief Receive the remote block signatures and mark the local blocks that differ.
+ *
+ * Block i of the local file is only compared with block i of the remote
+ * copy, the service updates its file in place and has no scratch space to
+ * move blocks that shifted.
+ *
+ * @param session Pointer to the session.
+ * @param size Size of the local file.
+ * @param block_size Block size in use.
+ * @param read_cb Callback reading the local file.
+ * @param user_data User data passed to read_cb.
+ * @param dirty Bitmap of local blocks, set bits are sent.
+ * @param remote_size Pointer to store the size of the remote copy.
+ * @param timeout_ms Per message timeout in milliseconds.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_client_sync_compare(
+    danp_ftp_service_client_session_t *session,
+    size_t size,
+    uint16_t block_size,
+    danp_ftp_service_client_read_cb_t read_cb,
+    void *user_data,
+    uint8_t *dirty,
+    size_t *remote_size,
+    uint32_t timeout_ms)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    danp_ftp_message_t message;
+    size_t blocks_total = (size + block_size - 1) / block_size;
+    size_t block_index = 0;
+    size_t entries;
+    size_t remote_blocks;
+    size_t last_common;
+    size_t block_length = 0;
+    size_t remote_length = 0;
+    uint32_t crc;
+    bool last = false;
+
+    while (!last)
+    {
+        status = danp_ftp_service_client_receive(session, &message, timeout_ms);
+        if (status < 0)
+        {
+            break;
+        }
+
+        if (message.header.type != DANP_FTP_PACKET_TYPE_DATA)
+        {
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+
+        if (message.header.sequence_number == (uint16_t)(session->sequence_number - 1))
+        {
+            /* Service retransmitted because our ACK was lost, repeat it */
+            session->sequence_number--;
+            status = danp_ftp_service_client_send(
+                session,
+                DANP_FTP_PACKET_TYPE_ACK,
+                DANP_FTP_FLAG_NONE,
+                NULL,
+                0);
+            session->sequence_number++;
+
+            if (status < 0)
+            {
+                break;
+            }
+            continue;
+        }
+
+        last = (message.header.flags & DANP_FTP_FLAG_LAST_CHUNK) != 0;
+        entries = (size_t)status;
+        if (last)
+        {
+            if (entries < 4)
+            {
+                status = DANP_FTP_STATUS_TRANSFER_FAILED;
+                break;
+            }
+            entries -= 4;
+            *remote_size = danp_ftp_service_get_u32(&message.payload[entries]);
+        }
+        entries /= DANP_FTP_SYNC_SIGNATURE_SIZE;
+
+        for (size_t i = 0; i < entries && status >= 0; i++, block_index++)
+        {
+            if (block_index >= blocks_total)
+            {
+                continue;
+            }
+
+            block_length = size - block_index * block_size;
+            if (block_length > block_size)
+            {
+                block_length = block_size;
+            }
+
+            status = danp_ftp_service_client_block_signature(
+                block_index * block_size,
+                block_length,
+                read_cb,
+                user_data,
+                &crc);
+
+            if (status >= 0 && crc == danp_ftp_service_get_u32(&message.payload[i * DANP_FTP_SYNC_SIGNATURE_SIZE]))
+            {
+                dirty[block_index / 8] &= (uint8_t)~(1U << (block_index % 8));
+            }
+        }
+
+        if (status < 0)
+        {
+            break;
+        }
+
+        session->sequence_number = message.header.sequence_number;
+        status = danp_ftp_service_client_send(
+            session,
+            DANP_FTP_PACKET_TYPE_ACK,
+            DANP_FTP_FLAG_NONE,
+            NULL,
+            0);
+
+        if (status < 0)
+        {
+            break;
+        }
+
+        session->sequence_number++;
+    }
+
+    if (status >= 0)
+    {
+        /* Only the last overlapping block may differ in length */
+        remote_blocks = (*remote_size + block_size - 1) / block_size;
+        last_common = (remote_blocks < blocks_total) ? remote_blocks : blocks_total;
+
+        if (last_common > 0)
+        {
+            block_length = size - (last_common - 1) * block_size;
+            remote_length = *remote_size - (last_common - 1) * block_size;
+            block_length = (block_length < block_size) ? block_length : block_size;
+            remote_length = (remote_length < block_size) ? remote_length : block_size;
+        }
+
+        if (last_common > 0 && block_length != remote_length)
+        {
+            dirty[(last_common - 1) / 8] |= (uint8_t)(1U << ((last_common - 1) % 8));
+        }
+
+        status = DANP_FTP_STATUS_OK;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Send the marked local blocks followed by the final file size.
+ * @param session Pointer to the session.
+ * @param size Size of the local file.
+ * @param block_size Block size in use.
+ * @param read_cb Callback reading the local file.
+ * @param user_data User data passed to read_cb.
+ * @param dirty Bitmap of local blocks to send.
+ * @param stats Pointer to the sync statistics.
+ * @param timeout_ms Per message timeout in milliseconds.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_client_sync_patch(
+    danp_ftp_service_client_session_t *session,
+    size_t size,
+    uint16_t block_size,
+    danp_ftp_service_client_read_cb_t read_cb,
+    void *user_data,
+    const uint8_t *dirty,
+    danp_ftp_service_sync_stats_t *stats,
+    uint32_t timeout_ms)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    uint8_t payload[DANP_FTP_MAX_PAYLOAD_SIZE];
+    size_t offset;
+    size_t end;
+    uint16_t piece;
+
+    for (size_t block = 0; block < stats->blocks_total && status >= 0; block++)
+    {
+        if (!(dirty[block / 8] & (1U << (block % 8))))
+        {
+            continue;
+        }
+
+        offset = block * block_size;
+        end = (size - offset < block_size) ? size : offset + block_size;
+
+        while (offset < end)
+        {
+            piece = DANP_FTP_MAX_PAYLOAD_SIZE - DANP_FTP_SYNC_PATCH_HEADER_SIZE;
+            if (end - offset < piece)
+            {
+                piece = (uint16_t)(end - offset);
+            }
+
+            status = read_cb(offset, &payload[DANP_FTP_SYNC_PATCH_HEADER_SIZE], piece, user_data);
+            if (status <= 0)
+            {
+                status = DANP_FTP_STATUS_ERROR;
+                break;
+            }
+            piece = (uint16_t)status;
+
+            danp_ftp_service_put_u32(payload, (uint32_t)offset);
+
+            status = danp_ftp_service_client_send_reliable(
+                session,
+                DANP_FTP_FLAG_NONE,
+                payload,
+                (uint16_t)(piece + DANP_FTP_SYNC_PATCH_HEADER_SIZE),
+                timeout_ms);
+
+            if (status < 0)
+            {
+                break;
+            }
+
+            session->sequence_number++;
+            offset += piece;
+            stats->bytes_sent += piece;
+        }
+
+        stats->blocks_sent++;
+    }
+
+    if (status >= 0)
+    {
+        danp_ftp_service_put_u32(payload, (uint32_t)size);
+
+        status = danp_ftp_service_client_send_reliable(
+            session,
+            DANP_FTP_FLAG_LAST_CHUNK,
+            payload,
+            DANP_FTP_SYNC_PATCH_HEADER_SIZE,
+            timeout_ms);
+    }
+
+    return status;
+}
+
+/**
+ * @brief Query size and whole-file CRC32 of a file on a remote FTP service.
+ * @param remote_node Node running the FTP service.
+ * @param file_id File name/id.
+ * @param file_id_len File name/id length.
+ * @param info Pointer to store the file information.
+ * @param timeout_ms Response timeout in milliseconds.
+ * @return Status code.
+ */
+danp_ftp_status_t danp_ftp_service_client_stat(
+    uint16_t remote_node,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    danp_ftp_service_file_info_t *info,
+    uint32_t timeout_ms)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    danp_ftp_service_client_session_t session;
+    danp_ftp_message_t response;
+    bool wide = false;
+
+    for (;;)
+    {
+        if (!file_id || !info)
+        {
+            status = DANP_FTP_STATUS_INVALID_PARAM;
+            break;
+        }
+
+        /* Files past 4 GiB are reported only to a command with u64 fields */
+        do
+        {
+            status = danp_ftp_service_client_open(&session, remote_node);
+            if (status < 0)
+            {
+                break;
+            }
+            session.wide = wide;
+
+            status = danp_ftp_service_client_command(
+                &session,
+                DANP_FTP_CMD_REQUEST_STAT,
+                file_id,
+                file_id_len,
+                NULL,
+                0,
+                &response,
+                timeout_ms);
+
+            danp_ftp_service_client_close(&session);
+            wide = true;
+        } while (status == DANP_FTP_CLIENT_STATUS_WIDE);
+
+        if (status < 0)
+        {
+            break;
+        }
+
+        if (status < DANP_FTP_STAT_RESPONSE_SIZE(session.wide))
+        {
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+
+        info->size = danp_ftp_service_to_size(danp_ftp_service_get_field(&response.payload[1], session.wide));
+        info->crc = danp_ftp_service_get_u32(&response.payload[1 + DANP_FTP_FIELD_SIZE(session.wide)]);
+        status = DANP_FTP_STATUS_OK;
+
+        break;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Reset an FEC block buffer for the block starting at a sequence number.
+ * @param block Pointer to the block.
+ * @param first_seq Sequence number of the first chunk.
+ * @param fec_k Data chunks per block.
+ * @param fec_r Parity chunks per block.
+ */
+static void danp_ftp_service_client_fec_reset(
+    danp_ftp_service_client_fec_block_t *block,
+    uint16_t first_seq,
+    uint8_t fec_k,
+    uint8_t fec_r)
+{
+    block->first_seq = first_seq;
+    block->count = 0;
+    block->last = false;
+    block->have = 0;
+    block->parity_have = 0;
+    memset(block->data, 0, (size_t)fec_k * DANP_FTP_FEC_CHUNK_SIZE);
+    memset(block->parity, 0, (size_t)fec_r * DANP_FTP_FEC_CHUNK_SIZE);
+}
+
+/**
+ * @brief Rebuild lost data chunks of a block from its parity.
+ *
+ * Parity j is the XOR of the chunks whose index is j modulo fec_r, so a
+ * residue class missing exactly one chunk can be completed.
+ *
+ * @param block Pointer to the block.
+ * @param fec_r Parity chunks per block.
+ * @return Number of chunks rebuilt.
+ */
+static uint32_t danp_ftp_service_client_fec_recover(
+    danp_ftp_service_client_fec_block_t *block,
+    uint8_t fec_r)
+{
+    uint32_t recovered = 0;
+    uint8_t *target;
+    uint16_t length;
+    uint8_t lost;
+    uint8_t lost_count;
+
+    for (uint8_t group = 0; group < fec_r && group < block->count; group++)
+    {
+        if (!(block->parity_have & (1UL << group)))
+        {
+            continue;
+        }
+
+        lost = 0;
+        lost_count = 0;
+        for (uint8_t i = group; i < block->count; i += fec_r)
+        {
+            if (!(block->have & (1UL << i)))
+            {
+                lost = i;
+                lost_count++;
+            }
+        }
+
+        if (lost_count != 1)
+        {
+            continue;
+        }
+
+        target = &block->data[(size_t)lost * DANP_FTP_FEC_CHUNK_SIZE];
+        memcpy(target, &block->parity[(size_t)group * DANP_FTP_FEC_CHUNK_SIZE], DANP_FTP_FEC_CHUNK_SIZE);
+        length = block->parity_length[group];
+
+        for (uint8_t i = group; i < block->count; i += fec_r)
+        {
+            if (i == lost)
+            {
+                continue;
+            }
+
+            for (uint16_t j = 0; j < DANP_FTP_FEC_CHUNK_SIZE; j++)
+            {
+                target[j] ^= block->data[(size_t)i * DANP_FTP_FEC_CHUNK_SIZE + j];
+            }
+            length ^= block->length[i];
+        }
+
+        if (length > DANP_FTP_FEC_CHUNK_SIZE)
+        {
+            memset(target, 0, DANP_FTP_FEC_CHUNK_SIZE);
+            continue;
+        }
+
+        block->length[lost] = length;
+        block->have |= (1UL << lost);
+        recovered++;
+    }
+
+    return recovered;
+}
+
+/**
+ * @brief Answer the BLOCK_END parity of an FEC block.
+ * @param session Pointer to the session.
+ * @param block_seq Sequence number of the first chunk of the block.
+ * @param missing Bitmap of chunks still missing, 0 when the block is complete.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_client_fec_ack(
+    danp_ftp_service_client_session_t *session,
+    uint16_t block_seq,
+    uint32_t missing)
+{
+    danp_ftp_status_t status;
+    uint8_t payload[DANP_FTP_FEC_ACK_SIZE];
+    uint16_t current = session->sequence_number;
+
+    danp_ftp_service_put_u32(payload, missing);
+
+    session->sequence_number = block_seq;
+    status = danp_ftp_service_client_send(
+        session,
+        DANP_FTP_PACKET_TYPE_ACK,
+        DANP_FTP_FLAG_NONE,
+        payload,
+        sizeof(payload));
+    session->sequence_number = current;
+
+    return status;
+}
+
+/**
+ * @brief Receive a file sent in FEC blocks.
+ *
+ * Data chunks are placed by sequence number, parity chunks fill in what
+ * was lost once the BLOCK_END parity arrives, and anything still missing
+ * is requested in the block ACK. A block is delivered to write_cb in
+ * order once complete.
+ *
+ * @param session Pointer to the session, positioned after the response.
+ * @param fec_k Data chunks per block.
+ * @param fec_r Parity chunks per block.
+ * @param start File offset of the first chunk.
+ * @param write_cb Callback storing the received data.
+ * @param user_data User data passed to write_cb.
+ * @param stats Pointer to store read statistics.
+ * @param timeout_ms Per message timeout in milliseconds.
+ * @return Number of bytes received, at most INT32_MAX, negative status on error.
+ */
+static danp_ftp_status_t danp_ftp_service_client_read_fec(
+    danp_ftp_service_client_session_t *session,
+    uint8_t fec_k,
+    uint8_t fec_r,
+    size_t start,
+    danp_ftp_service_client_write_cb_t write_cb,
+    void *user_data,
+    danp_ftp_service_read_stats_t *stats,
+    uint32_t timeout_ms)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    danp_ftp_service_client_fec_block_t block;
+    danp_ftp_message_t message;
+    size_t offset = start;
+    uint16_t previous_seq = 0;
+    bool previous_valid = false;
+    bool done = false;
+    uint16_t index;
+    uint8_t group;
+    uint32_t missing;
+
+    memset(&block, 0, sizeof(block));
+
+    for (;;)
+    {
+        block.data = (uint8_t *)osal_memory_alloc((size_t)fec_k * DANP_FTP_FEC_CHUNK_SIZE);
+        block.parity = (uint8_t *)osal_memory_alloc((size_t)fec_r * DANP_FTP_FEC_CHUNK_SIZE);
+        if (!block.data || !block.parity)
+        {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP client out of memory for FEC block");
+            status = DANP_FTP_STATUS_ERROR;
+            break;
+        }
+
+        danp_ftp_service_client_fec_reset(&block, session->sequence_number, fec_k, fec_r);
+
+        while (!done)
+        {
+            status = danp_ftp_service_client_receive(session, &message, timeout_ms);
+            if (status < 0)
+            {
+                break;
+            }
+
+            if (message.header.type != DANP_FTP_PACKET_TYPE_DATA)
+            {
+                status = DANP_FTP_STATUS_TRANSFER_FAILED;
+                break;
+            }
+
+            if (message.header.flags & DANP_FTP_FLAG_PARITY)
+            {
+                if (message.header.sequence_number != block.first_seq)
+                {
+                    if (previous_valid &&
+                        message.header.sequence_number == previous_seq &&
+                        (message.header.flags & DANP_FTP_FLAG_BLOCK_END))
+                    {
+                        /* Our ACK of the previous block was lost */
+                        status = danp_ftp_service_client_fec_ack(session, previous_seq, 0);
+                        if (status < 0)
+                        {
+                            break;
+                        }
+                    }
+                    continue;
+                }
+
+                group = message.payload[0];
+                if (status < DANP_FTP_FEC_HEADER_SIZE ||
+                    group >= fec_r ||
+                    message.payload[1] == 0 ||
+                    message.payload[1] > fec_k)
+                {
+                    continue;
+                }
+
+                block.count = message.payload[1];
+                block.parity_length[group] = danp_ftp_service_get_u16(&message.payload[2]);
+                memcpy(
+                    &block.parity[(size_t)group * DANP_FTP_FEC_CHUNK_SIZE],
+                    &message.payload[DANP_FTP_FEC_HEADER_SIZE],
+                    (size_t)status - DANP_FTP_FEC_HEADER_SIZE);
+                block.parity_have |= (1UL << group);
+                if (message.header.flags & DANP_FTP_FLAG_LAST_CHUNK)
+                {
+                    block.last = true;
+                }
+            }
+            else
+            {
+                /* Chunks of earlier blocks can still be in flight, only place ours */
+                index = (uint16_t)(message.header.sequence_number - block.first_seq);
+                if (index >= fec_k || status > (danp_ftp_status_t)DANP_FTP_FEC_CHUNK_SIZE)
+                {
+                    continue;
+                }
+
+                if (!(block.have & (1UL << index)))
+                {
+                    memcpy(&block.data[(size_t)index * DANP_FTP_FEC_CHUNK_SIZE], message.payload, (size_t)status);
+                    block.length[index] = (uint16_t)status;
+                    block.have |= (1UL << index);
+                }
+
+                if (message.header.flags & DANP_FTP_FLAG_LAST_CHUNK)
+                {
+                    block.last = true;
+                    block.count = (uint8_t)(index + 1);
+                }
+                continue;
+            }
+
+            if (!(message.header.flags & DANP_FTP_FLAG_BLOCK_END))
+            {
+                continue;
+            }
+
+            stats->fec_recovered += danp_ftp_service_client_fec_recover(&block, fec_r);
+
+            missing = ((block.count >= 32) ? 0xFFFFFFFFUL : ((1UL << block.count) - 1UL)) & ~block.have;
+            status = danp_ftp_service_client_fec_ack(session, block.first_seq, missing);
+            if (status < 0)
+            {
+                break;
+            }
+
+            if (missing)
+            {
+                for (; missing; missing &= missing - 1UL)
+                {
+                    stats->fec_repaired++;
+                }
+                continue;
+            }
+
+            for (uint8_t i = 0; i < block.count && status >= 0; i++)
+            {
+                if (block.length[i] > 0)
+                {
+                    status = write_cb(
+                        offset,
+                        &block.data[(size_t)i * DANP_FTP_FEC_CHUNK_SIZE],
+                        block.length[i],
+                        user_data);
+                }
+                offset += block.length[i];
+            }
+            if (status < 0)
+            {
+                break;
+            }
+
+            stats->fec_blocks++;
+            done = block.last;
+            previous_seq = block.first_seq;
+            previous_valid = true;
+            session->sequence_number = (uint16_t)(block.first_seq + block.count);
+            danp_ftp_service_client_fec_reset(&block, session->sequence_number, fec_k, fec_r);
+        }
+
+        break;
+    }
+
+    if (block.data)
+    {
+        osal_memory_free(block.data);
+    }
+    if (block.parity)
+    {
+        osal_memory_free(block.parity);
+    }
+
+    if (status >= 0)
+    {
+        status = danp_ftp_service_client_count(offset - start);
+    }
+
+    return status;
+}
+
+/**
+ * @brief Encode the READ arguments for a set of read options.
+ * @param args Buffer of 2 + DANP_FTP_RANGE_ARGS_SIZE(true) bytes.
+ * @param options Read options, NULL for a plain read.
+ * @param wide true for u64 range fields.
+ * @return Length of the arguments, more than 2 when a range is asked for.
+ */
+static size_t danp_ftp_service_client_read_args(
+    uint8_t *args,
+    const danp_ftp_service_read_options_t *options,
+    bool wide)
+{
+    size_t args_len = 0;
+
+    if (options && options->fec_k > 0 && options->fec_r > 0)
+    {
+        args[0] = (options->fec_k > DANP_FTP_FEC_MAX_K) ? DANP_FTP_FEC_MAX_K : options->fec_k;
+        args[1] = (options->fec_r > DANP_FTP_FEC_MAX_R) ? DANP_FTP_FEC_MAX_R : options->fec_r;
+        args_len = 2;
+    }
+
+    if (options && (options->offset != 0 || options->length > 0))
+    {
+        if (args_len == 0)
+        {
+            args[0] = 0;
+            args[1] = 0;
+        }
+        danp_ftp_service_put_field(&args[2], (uint64_t)options->offset, wide);
+        danp_ftp_service_put_field(&args[2 + DANP_FTP_FIELD_SIZE(wide)], options->length, wide);
+        args_len = 2 + DANP_FTP_RANGE_ARGS_SIZE(wide);
+    }
+
+    return args_len;
+}
+
+/**
+ * @brief Download a file from a remote FTP service.
+ * @param remote_node Node running the FTP service.
+ * @param file_id File name/id.
+ * @param file_id_len File name/id length.
+ * @param write_cb Callback storing the received data.
+ * @param user_data User data passed to write_cb.
+ * @param timeout_ms Per message timeout in milliseconds.
+ * @return Number of bytes received, at most INT32_MAX, negative status on error.
+ */
+danp_ftp_status_t danp_ftp_service_client_read(
+    uint16_t remote_node,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    danp_ftp_service_client_write_cb_t write_cb,
+    void *user_data,
+    uint32_t timeout_ms)
+{
+    return danp_ftp_service_client_read_ex(
+        remote_node,
+        file_id,
+        file_id_len,
+        NULL,
+        write_cb,
+        user_data,
+        NULL,
+        timeout_ms);
+}
+
+/**
+ * @brief Download a file from a remote FTP service with read options.
+ * @param remote_node Node running the FTP service.
+ * @param file_id File name/id.
+ * @param file_id_len File name/id length.
+ * @param options Optional read options, NULL for a plain read.
+ * @param write_cb Callback storing the received data.
+ * @param user_data User data passed to write_cb.
+ * @param stats Optional pointer to store read statistics.
+ * @param timeout_ms Per message timeout in milliseconds.
+ * @return Number of bytes received, at most INT32_MAX, negative status on error.
+ */
+danp_ftp_status_t danp_ftp_service_client_read_ex(
+    uint16_t remote_node,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    const danp_ftp_service_read_options_t *options,
+    danp_ftp_service_client_write_cb_t write_cb,
+    void *user_data,
+    danp_ftp_service_read_stats_t *stats,
+    uint32_t timeout_ms)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    danp_ftp_service_client_session_t session;
+    danp_ftp_service_read_stats_t local_stats;
+    danp_ftp_message_t message;
+    uint8_t args[2 + DANP_FTP_RANGE_ARGS_SIZE(true)];
+    size_t args_len = 0;
+    size_t start = 0;
+    size_t offset = 0;
+    bool session_open = false;
+    bool last = false;
+    bool wide;
+
+    if (!stats)
+    {
+        stats = &local_stats;
+    }
+    memset(stats, 0, sizeof(danp_ftp_service_read_stats_t));
+
+    for (;;)
+    {
+        if (!file_id || !write_cb)
+        {
+            status = DANP_FTP_STATUS_INVALID_PARAM;
+            break;
+        }
+
+        /*
+         * Only a u64 offset can count back from the end. Offsets past
+         * INT32_MAX go wide as well, services before unsigned u32 offsets
+         * read them as negative.
+         */
+        wide = options &&
+               (options->offset < 0 || options->offset > INT32_MAX ||
+                !danp_ftp_service_fits_u32(options->length));
+        do
+        {
+            if (session_open)
+            {
+                danp_ftp_service_client_close(&session);
+                session_open = false;
+            }
+
+            status = danp_ftp_service_client_open(&session, remote_node);
+            if (status < 0)
+            {
+                break;
+            }
+            session_open = true;
+            session.wide = wide;
+
+            args_len = danp_ftp_service_client_read_args(args, options, wide);
+            status = danp_ftp_service_client_command(
+                &session,
+                DANP_FTP_CMD_REQUEST_READ,
+                file_id,
+                file_id_len,
+                args,
+                args_len,
+                &message,
+                timeout_ms);
+            wide = true;
+        } while (status == DANP_FTP_CLIENT_STATUS_WIDE);
+
+        if (status < 0)
+        {
+            break;
+        }
+
+        session.sequence_number = message.header.sequence_number + 1;
+
+        if (args_len > 2)
+        {
+            /* A service without ranges would send the whole file */
+            if (status < DANP_FTP_RANGE_RESPONSE_SIZE(session.wide))
+            {
+                danp_log_message(DANP_LOG_LEVEL_ERR, "FTP client range reads not supported by node %u", remote_node);
+                status = DANP_FTP_STATUS_ERROR;
+                break;
+            }
+            start = danp_ftp_service_to_size(danp_ftp_service_get_field(&message.payload[3], session.wide));
+            offset = start;
+            stats->offset = start;
+        }
+
+        /* A service without FEC answers with the status byte alone */
+        if (args_len > 0 &&
+            status >= DANP_FTP_FEC_RESPONSE_SIZE &&
+            message.payload[1] > 0 &&
+            message.payload[1] <= DANP_FTP_FEC_MAX_K &&
+            message.payload[2] > 0 &&
+            message.payload[2] <= DANP_FTP_FEC_MAX_R)
+        {
+            stats->fec_k = message.payload[1];
+            stats->fec_r = message.payload[2];
+            status = danp_ftp_service_client_read_fec(
+                &session,
+                stats->fec_k,
+                stats->fec_r,
+                start,
+                write_cb,
+                user_data,
+                stats,
+                timeout_ms);
+            break;
+        }
+
+        while (!last)
+        {
+            status = danp_ftp_service_client_receive(&session, &message, timeout_ms);
+            if (status < 0)
+            {
+                break;
+            }
+
+            if (message.header.type != DANP_FTP_PACKET_TYPE_DATA)
+            {
+                status = DANP_FTP_STATUS_TRANSFER_FAILED;
+                break;
+            }
+
+            if (message.header.sequence_number == (uint16_t)(session.sequence_number - 1))
+            {
+                /* Our ACK was lost and the chunk was retransmitted */
+                session.sequence_number--;
+                status = danp_ftp_service_client_send(&session, DANP_FTP_PACKET_TYPE_ACK, DANP_FTP_FLAG_NONE, NULL, 0);
+                session.sequence_number++;
+                if (status < 0)
+                {
+                    break;
+                }
+                continue;
+            }
+
+            if (message.header.sequence_number != session.sequence_number)
+            {
+                status = DANP_FTP_STATUS_TRANSFER_FAILED;
+                break;
+            }
+
+            if (message.header.payload_length > 0)
+            {
+                status = write_cb(offset, message.payload, message.header.payload_length, user_data);
+                if (status < 0)
+                {
+                    break;
+                }
+            }
+
+            status = danp_ftp_service_client_send(&session, DANP_FTP_PACKET_TYPE_ACK, DANP_FTP_FLAG_NONE, NULL, 0);
+            if (status < 0)
+            {
+                break;
+            }
+
+            offset += message.header.payload_length;
+            last = (message.header.flags & DANP_FTP_FLAG_LAST_CHUNK) != 0;
+            session.sequence_number++;
+        }
+
+        if (status >= 0)
+        {
+            status = danp_ftp_service_client_count(offset - start);
+        }
+
+        break;
+    }
+
+    if (session_open)
+    {
+        danp_ftp_service_client_close(&session);
+    }
+
+    return status;
+}
+
+/**
+ * @brief Handle a message received on one session of a parallel read.
+ * @param range Pointer to the range the session transfers.
+ * @param message Pointer to the received message.
+ * @param length Payload length of the message.
+ * @param write_cb Callback storing the received data.
+ * @param user_data User data passed to write_cb.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_service_client_range_step(
+    danp_ftp_service_client_range_t *range,
+    const danp_ftp_message_t *message,
+    danp_ftp_status_t length,
+    danp_ftp_service_client_write_cb_t write_cb,
+    void *user_data)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    danp_ftp_service_client_session_t *session = &range->session;
+
+    for (;;)
+    {
+        if (!range->started &&
+            message->header.type == DANP_FTP_PACKET_TYPE_DATA &&
+            (message->header.flags & DANP_FTP_FLAG_FIRST_CHUNK))
+        {
+            /* The response was lost, the first chunk implies it */
+            session->sequence_number = message->header.sequence_number;
+            range->started = true;
+        }
+
+        if (!range->started)
+        {
+            status = danp_ftp_service_client_check_response(message, length);
+            if (status < 0)
+            {
+                break;
+            }
+
+            if (status < DANP_FTP_RANGE_RESPONSE_SIZE(session->wide) ||
+                danp_ftp_service_get_field(&message->payload[3], session->wide) != range->start)
+            {
+                danp_log_message(DANP_LOG_LEVEL_ERR, "FTP client range reads not supported");
+                status = DANP_FTP_STATUS_ERROR;
+                break;
+            }
+
+            session->sequence_number = message->header.sequence_number + 1;
+            range->started = true;
+            status = DANP_FTP_STATUS_OK;
+            break;
+        }
+
+        if (message->header.type != DANP_FTP_PACKET_TYPE_DATA)
+        {
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+
+        if (message->header.sequence_number == (uint16_t)(session->sequence_number - 1))
+        {
+            /* Our ACK was lost and the chunk was retransmitted */
+            session->sequence_number--;
+            status = danp_ftp_service_client_send(session, DANP_FTP_PACKET_TYPE_ACK, DANP_FTP_FLAG_NONE, NULL, 0);
+            session->sequence_number++;
+            break;
+        }
+
+        if (message->header.sequence_number != session->sequence_number)
+        {
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+
+        if (message->header.payload_length > 0)
+        {
+            status = write_cb(range->offset, message->payload, message->header.payload_length, user_data);
+            if (status < 0)
+            {
+                break;
+            }
+        }
+
+        status = danp_ftp_service_client_send(session, DANP_FTP_PACKET_TYPE_ACK, DANP_FTP_FLAG_NONE, NULL, 0);
+        if (status < 0)
+        {
+            break;
+        }
+
+        range->offset += message->header.payload_length;
+        range->done = (message->header.flags & DANP_FTP_FLAG_LAST_CHUNK) != 0;
+        session->sequence_number++;
+        break;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Download a file over several concurrent sessions.
+ *
+ * The ranges are whole multiples of the chunk size, the last one reads
+ * to the end of the file. DANP has no readiness API, so all sessions are
+ * polled with zero timeouts and the loop backs off while none of them
+ * makes progress.
+ *
+ * @param remote_node Node running the FTP service.
+ * @param file_id File name/id.
+ * @param file_id_len File name/id length.
+ * @param sessions Sessions to use, at most DANP_FTP_SERVICE_CLIENT_MAX_SESSIONS.
+ * @param write_cb Callback storing the received data.
+ * @param user_data User data passed to write_cb.
+ * @param timeout_ms Per message timeout in milliseconds.
+ * @return Number of bytes received, at most INT32_MAX, negative status on error.
+ */
+danp_ftp_status_t danp_ftp_service_client_read_parallel(
+    uint16_t remote_node,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    uint8_t sessions,
+    danp_ftp_service_client_write_cb_t write_cb,
+    void *user_data,
+    uint32_t timeout_ms)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    danp_ftp_service_client_range_t ranges[DANP_FTP_SERVICE_CLIENT_MAX_SESSIONS];
+    danp_ftp_service_client_range_t *range;
+    danp_ftp_service_file_info_t info;
+    danp_ftp_message_t message;
+    uint8_t args[2 + DANP_FTP_RANGE_ARGS_SIZE(true)];
+    size_t span;
+    size_t received = 0;
+    uint32_t now_ms;
+    uint32_t idle_ms = 0;
+    uint8_t count = 0;
+    uint8_t active;
+    bool progress;
+
+    memset(ranges, 0, sizeof(ranges));
+
+    for (;;)
+    {
+        if (!file_id || !write_cb || sessions == 0)
+        {
+            status = DANP_FTP_STATUS_INVALID_PARAM;
+            break;
+        }
+
+        if (sessions > DANP_FTP_SERVICE_CLIENT_MAX_SESSIONS)
+        {
+            sessions = DANP_FTP_SERVICE_CLIENT_MAX_SESSIONS;
+        }
+
+        status = danp_ftp_service_client_stat(remote_node, file_id, file_id_len, &info, timeout_ms);
+        if (status < 0)
+        {
+            break;
+        }
+
+        /* Whole chunks per range, so only the last chunk of each range is short */
+        span = (info.size + sessions - 1) / sessions;
+        span = ((span + DANP_FTP_MAX_PAYLOAD_SIZE - 1) / DANP_FTP_MAX_PAYLOAD_SIZE) * DANP_FTP_MAX_PAYLOAD_SIZE;
+
+        /* Send every command before waiting on any response */
+        do
+        {
+            range = &ranges[count];
+            range->start = (size_t)count * span;
+            range->offset = range->start;
+
+            status = danp_ftp_service_client_open(&range->session, remote_node);
+            if (status < 0)
+            {
+                break;
+            }
+            count++;
+            range->session.wide = range->start > INT32_MAX || !danp_ftp_service_fits_u32(span);
+
+            args[0] = 0;
+            args[1] = 0;
+            danp_ftp_service_put_field(&args[2], range->start, range->session.wide);
+            danp_ftp_service_put_field(
+                &args[2 + DANP_FTP_FIELD_SIZE(range->session.wide)],
+                (range->start + span < info.size) ? span : 0U,
+                range->session.wide);
+
+            status = danp_ftp_service_client_send_command(
+                &range->session,
+                DANP_FTP_CMD_REQUEST_READ,
+                file_id,
+                file_id_len,
+                args,
+                2 + DANP_FTP_RANGE_ARGS_SIZE(range->session.wide));
+            if (status < 0)
+            {
+                break;
+            }
+
+            range->deadline_ms = danp_port_uptime_ms() + timeout_ms;
+        } while (count < sessions && (size_t)count * span < info.size);
+
+        if (status < 0)
+        {
+            break;
+        }
+
+        active = count;
+        while (active > 0 && status >= 0)
+        {
+            progress = false;
+            now_ms = danp_port_uptime_ms();
+
+            for (uint8_t i = 0; i < count && status >= 0; i++)
+            {
+                range = &ranges[i];
+                if (range->done)
+                {
+                    continue;
+                }
+
+                status = danp_ftp_service_client_poll(&range->session, &message);
+                if (status == 0)
+                {
+                    if ((int32_t)(now_ms - range->deadline_ms) >= 0)
+                    {
+                        danp_log_message(DANP_LOG_LEVEL_WRN, "FTP client range %u timed out", i);
+                        status = DANP_FTP_STATUS_TIMEOUT;
+                    }
+                    continue;
+                }
+                if (status < 0)
+                {
+                    break;
+                }
+
+                progress = true;
+                range->deadline_ms = now_ms + timeout_ms;
+                status = danp_ftp_service_client_range_step(
+                    range,
+                    &message,
+                    (danp_ftp_status_t)message.header.payload_length,
+                    write_cb,
+                    user_data);
+
+                if (status >= 0 && range->done)
+                {
+                    received += range->offset - range->start;
+                    active--;
+                }
+            }
+
+            if (progress)
+            {
+                idle_ms = 0;
+                continue;
+            }
+
+            idle_ms = (idle_ms == 0) ? 1 : idle_ms * 2;
+            if (idle_ms > DANP_FTP_CLIENT_POLL_MAX_MS)
+            {
+                idle_ms = DANP_FTP_CLIENT_POLL_MAX_MS;
+            }
+            danp_port_sleep_ms(idle_ms);
+        }
+
+        break;
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        danp_ftp_service_client_close(&ranges[i].session);
+    }
+
+    if (status >= 0)
+    {
+        status = danp_ftp_service_client_count(received);
+    }
+
+    return status;
+}
+
+/**
+ * @brief Upload a whole file or a byte range of it.
+ * @param remote_node Node running the FTP service.
+ * @param file_id File name/id.
+ * @param file_id_len File name/id length.
+ * @param range true to update a range in place, false to replace the file.
+ * @param start First byte of the range.
+ * @param size Size of the local file or range.
+ * @param read_cb Callback reading the local file.
+ * @param user_data User data passed to read_cb.
+ * @param timeout_ms Per message timeout in milliseconds.
+ * @return Number of bytes sent, at most INT32_MAX, negative status on error.
+ */
+static danp_ftp_status_t danp_ftp_service_client_upload(
+    uint16_t remote_node,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    bool range,
+    size_t start,
+    size_t size,
+    danp_ftp_service_client_read_cb_t read_cb,
+    void *user_data,
+    uint32_t timeout_ms)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    danp_ftp_service_client_session_t session;
+    danp_ftp_message_t message;
+    uint8_t payload[DANP_FTP_MAX_PAYLOAD_SIZE];
+    uint8_t args[DANP_FTP_WRITE_RANGE_ARGS_SIZE(true)];
+    size_t offset = 0;
+    uint16_t piece;
+    uint8_t flags;
+    bool session_open = false;
+
+    for (;;)
+    {
+        if (!file_id || !read_cb)
+        {
+            status = DANP_FTP_STATUS_INVALID_PARAM;
+            break;
+        }
+
+        status = danp_ftp_service_client_open(&session, remote_node);
+        if (status < 0)
+        {
+            break;
+        }
+        session_open = true;
+        session.wide = !danp_ftp_service_fits_u32(size) || !danp_ftp_service_fits_u32(start);
+
+        /* The size lets the service prepare storage before the first chunk */
+        danp_ftp_service_put_field(&args[0], size, session.wide);
+        danp_ftp_service_put_field(&args[DANP_FTP_WRITE_SIZE_ARGS_SIZE(session.wide)], start, session.wide);
+        status = danp_ftp_service_client_command(
+            &session,
+            DANP_FTP_CMD_REQUEST_WRITE,
+            file_id,
+            file_id_len,
+            args,
+            range ? DANP_FTP_WRITE_RANGE_ARGS_SIZE(session.wide) : DANP_FTP_WRITE_SIZE_ARGS_SIZE(session.wide),
+            &message,
+            timeout_ms);
+
+        if (status < 0)
+        {
+            break;
+        }
+
+        /* A service without ranges has already truncated the file */
+        if (range && status < DANP_FTP_WRITE_RANGE_RESPONSE_SIZE(session.wide))
+        {
+            danp_log_message(DANP_LOG_LEVEL_ERR, "FTP client range writes not supported by node %u", remote_node);
+            status = DANP_FTP_STATUS_ERROR;
+            break;
+        }
+
+        session.sequence_number = message.header.sequence_number + 1;
+
+        do
+        {
+            piece = DANP_FTP_MAX_PAYLOAD_SIZE;
+            if (size - offset < piece)
+            {
+                piece = (uint16_t)(size - offset);
+            }
+
+            if (piece > 0)
+            {
+                status = read_cb(start + offset, payload, piece, user_data);
+                if (status <= 0)
+                {
+                    status = DANP_FTP_STATUS_ERROR;
+                    break;
+                }
+                piece = (uint16_t)status;
+            }
+
+            flags = DANP_FTP_FLAG_NONE;
+            if (offset == 0)
+            {
+                flags |= DANP_FTP_FLAG_FIRST_CHUNK;
+            }
+            if (offset + piece >= size)
+            {
+                flags |= DANP_FTP_FLAG_LAST_CHUNK;
+            }
+
+            status = danp_ftp_service_client_send_reliable(&session, flags, payload, piece, timeout_ms);
+            if (status < 0)
+            {
+                break;
+            }
+
+            offset += piece;
+            session.sequence_number++;
+        } while (offset < size);
+
+        if (status >= 0)
+        {
+            status = danp_ftp_service_client_count(offset);
+        }
+
+        break;
+    }
+
+    if (session_open)
+    {
+        danp_ftp_service_client_close(&session);
+    }
+
+    return status;
+}
+
+/**
+ * @brief Upload a file to a remote FTP service.
+ * @param remote_node Node running the FTP service.
+ * @param file_id File name/id.
+ * @param file_id_len File name/id length.
+ * @param size Size of the local file.
+ * @param read_cb Callback reading the local file.
+ * @param user_data User data passed to read_cb.
+ * @param timeout_ms Per message timeout in milliseconds.
+ * @return Number of bytes sent, at most INT32_MAX, negative status on error.
+ */
+danp_ftp_status_t danp_ftp_service_client_write(
+    uint16_t remote_node,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    size_t size,
+    danp_ftp_service_client_read_cb_t read_cb,
+    void *user_data,
+    uint32_t timeout_ms)
+{
+    return danp_ftp_service_client_upload(
+        remote_node,
+        file_id,
+        file_id_len,
+        false,
+        0,
+        size,
+        read_cb,
+        user_data,
+        timeout_ms);
+}
+
+/**
+ * @brief Update a byte range of a file on a remote FTP service.
+ * @param remote_node Node running the FTP service.
+ * @param file_id File name/id.
+ * @param file_id_len File name/id length.
+ * @param offset First byte of the range.
+ * @param size Size of the range.
+ * @param read_cb Callback reading the local file, called with file offsets.
+ * @param user_data User data passed to read_cb.
+ * @param timeout_ms Per message timeout in milliseconds.
+ * @return Number of bytes sent, at most INT32_MAX, negative status on error.
+ */
+danp_ftp_status_t danp_ftp_service_client_write_range(
+    uint16_t remote_node,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    size_t offset,
+    size_t size,
+    danp_ftp_service_client_read_cb_t read_cb,
+    void *user_data,
+    uint32_t timeout_ms)
+{
+    return danp_ftp_service_client_upload(
+        remote_node,
+        file_id,
+        file_id_len,
+        true,
+        offset,
+        size,
+        read_cb,
+        user_data,
+        timeout_ms);
+}
+
+/**
+ * @brief Bring a remote file up to date by sending only the blocks that differ.
+ * @param remote_node Node running the FTP service.
+ * @param file_id File name/id.
+ * @param file_id_len File name/id length.
+ * @param size Size of the local file.
+ * @param block_size Requested block size, 0 for the service default.
+ * @param read_cb Callback reading the local file.
+ * @param user_data User data passed to read_cb.
+ * @param stats Optional pointer to store sync statistics.
+ * @param timeout_ms Per message timeout in milliseconds.
+ * @return Status code.
+ */
+danp_ftp_status_t danp_ftp_service_client_sync(
+    uint16_t remote_node,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    size_t size,
+    uint16_t block_size,
+    danp_ftp_service_client_read_cb_t read_cb,
+    void *user_data,
+    danp_ftp_service_sync_stats_t *stats,
+    uint32_t timeout_ms)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_OK;
+    danp_ftp_service_client_session_t session;
+    danp_ftp_service_sync_stats_t local_stats;
+    danp_ftp_message_t response;
+    uint8_t args[2];
+    uint8_t *dirty = NULL;
+    size_t dirty_size;
+    bool session_open = false;
+
+    for (;;)
+    {
+        /* Patch offsets and the final size are u32 on the wire */
+        if (!file_id || !read_cb || !danp_ftp_service_fits_u32(size))
+        {
+            status = DANP_FTP_STATUS_INVALID_PARAM;
+            break;
+        }
+
+        if (!stats)
+        {
+            stats = &local_stats;
+        }
+        memset(stats, 0, sizeof(danp_ftp_service_sync_stats_t));
+
+        status = danp_ftp_service_client_open(&session, remote_node);
+        if (status < 0)
+        {
+            break;
+        }
+        session_open = true;
+
+        danp_ftp_service_put_u16(args, block_size ? block_size : DANP_FTP_SYNC_DEFAULT_BLOCK_SIZE);
+
+        status = danp_ftp_service_client_command(
+            &session,
+            DANP_FTP_CMD_REQUEST_SYNC,
+            file_id,
+            file_id_len,
+            args,
+            sizeof(args),
+            &response,
+            timeout_ms);
+
+        if (status < 0)
+        {
+            break;
+        }
+
+        if (status < 3)
+        {
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+
+        /* The service may have clamped the block size */
+        block_size = danp_ftp_service_get_u16(&response.payload[1]);
+        if (block_size == 0)
+        {
+            status = DANP_FTP_STATUS_TRANSFER_FAILED;
+            break;
+        }
+        session.sequence_number = response.header.sequence_number + 1;
+
+        stats->blocks_total = (uint32_t)((size + block_size - 1) / block_size);
+        dirty_size = (stats->blocks_total + 7) / 8;
+
+        if (dirty_size > 0)
+        {
+            dirty = (uint8_t *)osal_memory_alloc(dirty_size);
+            if (!dirty)
+            {
+                status = DANP_FTP_STATUS_ERROR;
+                break;
+            }
+            memset(dirty, 0xFF, dirty_size);
+        }
+
+        status = danp_ftp_service_client_sync_compare(
+            &session,
+            size,
+            block_size,
+            read_cb,
+            user_data,
+            dirty,
+            &stats->remote_size,
+            timeout_ms);
+
+        if (status < 0)
+        {
+            break;
+        }
+
+        status = danp_ftp_service_client_sync_patch(
+            &session,
+            size,
+            block_size,
+            read_cb,
+            user_data,
+            dirty,
+            stats,
+            timeout_ms);
+
+        if (status >= 0)
+        {
+            danp_log_message(
+                DANP_LOG_LEVEL_INF,
+                "FTP client sync complete: %u/%u blocks sent",
+                stats->blocks_sent,
+                stats->blocks_total);
+            status = DANP_FTP_STATUS_OK;
+        }
+
+        break;
+    }
+
+    if (dirty)
+    {
+        osal_memory_free(dirty);
+    }
+
+    if (session_open)
+    {
+        danp_ftp_service_client_close(&session);
+    }
+
+    return status;
+}
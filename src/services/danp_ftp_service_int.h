@@ -0,0 +1,178 @@
+/* danp_ftp_service_int.h - FTP service internal protocol definitions */
+
+/* All Rights Reserved */
+
+#ifndef INC_DANP_FTP_SERVICE_INT_H
+#define INC_DANP_FTP_SERVICE_INT_H
+
+/* Includes */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "danp/ftp/danp_ftp.h"
+#include "danp/danp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Configurations */
+
+
+/* Definitions */
+
+#define DANP_FTP_SERVICE_PORT                 (CONFIG_DANP_FTP_SERVICE_PORT)
+
+#define DANP_FTP_MAX_PAYLOAD_SIZE             (DANP_MAX_PACKET_SIZE - sizeof(danp_ftp_header_t))
+
+#define DANP_FTP_CMD_REQUEST_READ             (0x01)
+#define DANP_FTP_CMD_REQUEST_WRITE            (0x02)
+#define DANP_FTP_CMD_ABORT                    (0x03)
+#define DANP_FTP_CMD_REQUEST_STAT             (0x04)
+#define DANP_FTP_CMD_REQUEST_SYNC             (0x05)
+#define DANP_FTP_CMD_MASK                     (0x1F)
+
+/* Offset and size fields of the command and its response are u64, needed for files past 4 GiB */
+#define DANP_FTP_CMD_WIDE                     (0x20)
+
+/* Optional session priority in the top bits of the command byte, 0 = node default */
+#define DANP_FTP_CMD_PRIORITY_SHIFT           (6)
+#define DANP_FTP_CMD_PRIORITY_MASK            (0xC0)
+
+#define DANP_FTP_RESP_OK                      (0x00)
+#define DANP_FTP_RESP_ERROR                   (0x01)
+#define DANP_FTP_RESP_FILE_NOT_FOUND          (0x02)
+#define DANP_FTP_RESP_BUSY                    (0x03)
+/* A field of the response does not fit u32, repeat the command with DANP_FTP_CMD_WIDE */
+#define DANP_FTP_RESP_WIDE                    (0x04)
+
+#define DANP_FTP_FLAG_NONE                    (0x00)
+#define DANP_FTP_FLAG_LAST_CHUNK              (0x01)
+#define DANP_FTP_FLAG_FIRST_CHUNK             (0x02)
+#define DANP_FTP_FLAG_PARITY                  (0x04)
+#define DANP_FTP_FLAG_BLOCK_END               (0x08)
+
+/* Offset and size fields: u32, or u64 under DANP_FTP_CMD_WIDE, little endian */
+#define DANP_FTP_FIELD_SIZE(wide)             ((wide) ? 8 : 4)
+
+/* STAT response: status(1) + size(field) + crc32(4) */
+#define DANP_FTP_STAT_RESPONSE_SIZE(wide)     (1 + DANP_FTP_FIELD_SIZE(wide) + 4)
+
+/* SYNC: optional block size argument after file id, u16 little endian */
+#define DANP_FTP_SYNC_DEFAULT_BLOCK_SIZE      (512)
+#define DANP_FTP_SYNC_MIN_BLOCK_SIZE          (64)
+/* SYNC signature entry: crc32(4) of the block */
+#define DANP_FTP_SYNC_SIGNATURE_SIZE          (4)
+/* SYNC patch chunk: offset(4) + data */
+#define DANP_FTP_SYNC_PATCH_HEADER_SIZE       (4)
+
+/* READ FEC: optional k(1) + r(1) after file id, accepted values echoed after the OK status */
+#define DANP_FTP_FEC_MAX_K                    (32)
+#define DANP_FTP_FEC_MAX_R                    (4)
+#define DANP_FTP_FEC_RESPONSE_SIZE            (3)
+/* FEC parity chunk: group index(1) + block chunk count(1) + XOR of chunk lengths(2) + XOR of data */
+#define DANP_FTP_FEC_HEADER_SIZE              (4)
+/* FEC data chunks leave room for the parity header, all but the last one are full */
+#define DANP_FTP_FEC_CHUNK_SIZE               (DANP_FTP_MAX_PAYLOAD_SIZE - DANP_FTP_FEC_HEADER_SIZE)
+/* FEC block ACK: bitmap of chunks still missing after recovery, u32 little endian */
+#define DANP_FTP_FEC_ACK_SIZE                 (4)
+
+/*
+ * READ range: offset(field) + length(field) after the FEC arguments, length 0 = to the end.
+ * A u32 offset is unsigned, a u64 offset below 0 counts back from the end of the file.
+ */
+#define DANP_FTP_RANGE_ARGS_SIZE(wide)        (2 * DANP_FTP_FIELD_SIZE(wide))
+/* Range READ response: FEC response + first offset sent(field) */
+#define DANP_FTP_RANGE_RESPONSE_SIZE(wide)    (DANP_FTP_FEC_RESPONSE_SIZE + DANP_FTP_FIELD_SIZE(wide))
+/* WRITE size hint: total bytes to be sent(field) after file id, passed to fs.prepare */
+#define DANP_FTP_WRITE_SIZE_ARGS_SIZE(wide)   (DANP_FTP_FIELD_SIZE(wide))
+/* Range WRITE: size hint + offset(field), updates the file in place and the offset is echoed after the OK status */
+#define DANP_FTP_WRITE_RANGE_ARGS_SIZE(wide)  (2 * DANP_FTP_FIELD_SIZE(wide))
+#define DANP_FTP_WRITE_RANGE_RESPONSE_SIZE(wide) (1 + DANP_FTP_FIELD_SIZE(wide))
+
+#define DANP_FTP_CRC32_INIT                   (0xFFFFFFFFU)
+
+/* Types */
+
+typedef struct danp_ftp_message_s
+{
+    danp_ftp_header_t header;
+    uint8_t payload[DANP_FTP_MAX_PAYLOAD_SIZE];
+} PACKED danp_ftp_message_t;
+
+/* External Declarations */
+
+/**
+ * @brief Feed data into a running CRC32 register.
+ * @param crc Current register value, DANP_FTP_CRC32_INIT for a new digest.
+ * @param data Pointer to the data buffer.
+ * @param length Length of the data.
+ * @return Updated register value. XOR with DANP_FTP_CRC32_INIT to finalize.
+ */
+extern uint32_t danp_ftp_service_crc32_update(uint32_t crc, const uint8_t *data, size_t length);
+
+static inline void danp_ftp_service_put_u16(uint8_t *buffer, uint16_t value)
+{
+    buffer[0] = (uint8_t)(value);
+    buffer[1] = (uint8_t)(value >> 8);
+}
+
+static inline uint16_t danp_ftp_service_get_u16(const uint8_t *buffer)
+{
+    return (uint16_t)((uint16_t)buffer[0] | ((uint16_t)buffer[1] << 8));
+}
+
+static inline void danp_ftp_service_put_u32(uint8_t *buffer, uint32_t value)
+{
+    buffer[0] = (uint8_t)(value);
+    buffer[1] = (uint8_t)(value >> 8);
+    buffer[2] = (uint8_t)(value >> 16);
+    buffer[3] = (uint8_t)(value >> 24);
+}
+
+static inline uint32_t danp_ftp_service_get_u32(const uint8_t *buffer)
+{
+    return (uint32_t)buffer[0] |
+           ((uint32_t)buffer[1] << 8) |
+           ((uint32_t)buffer[2] << 16) |
+           ((uint32_t)buffer[3] << 24);
+}
+
+static inline void danp_ftp_service_put_field(uint8_t *buffer, uint64_t value, bool wide)
+{
+    danp_ftp_service_put_u32(buffer, (uint32_t)value);
+    if (wide)
+    {
+        danp_ftp_service_put_u32(&buffer[4], (uint32_t)(value >> 32));
+    }
+}
+
+static inline uint64_t danp_ftp_service_get_field(const uint8_t *buffer, bool wide)
+{
+    uint64_t value = danp_ftp_service_get_u32(buffer);
+
+    if (wide)
+    {
+        value |= (uint64_t)danp_ftp_service_get_u32(&buffer[4]) << 32;
+    }
+
+    return value;
+}
+
+static inline bool danp_ftp_service_fits_u32(uint64_t value)
+{
+    return value <= UINT32_MAX;
+}
+
+static inline size_t danp_ftp_service_to_size(uint64_t value)
+{
+    return (value > SIZE_MAX) ? SIZE_MAX : (size_t)value;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_DANP_FTP_SERVICE_INT_H */
@@ -10,6 +10,11 @@
 #include <stdlib.h>
 
 #include "danp/ftp/danp_ftp.h"
+#include "danp/services/danp_ftp_service.h"
+#include "danp/services/danp_ftp_service_client.h"
+#include "danp/services/danp_ftp_mcast.h"
+#include "danp_trace.h"
+#include "services/danp_ftp_service_int.h"
 
 /* Definitions */
 
@@ -17,8 +22,13 @@
 #define DANP_FTP_TEST_DEFAULT_CHUNK_SIZE      (64)
 #define DANP_FTP_TEST_DEFAULT_TIMEOUT_MS      (5000)
 #define DANP_FTP_TEST_DEFAULT_MAX_RETRIES     (3)
-#define DANP_FTP_TEST_MAX_FILE_SIZE           (4096)
 #define DANP_FTP_TEST_PATTERN_SIZE            (1024)
+#define DANP_FTP_TEST_PATTERN_BLOCK           (64)
+#define DANP_FTP_TEST_MAX_CHUNK_CRCS          (64)
+#define DANP_FTP_TEST_BENCH_MAX_STEPS         (8)
+#define DANP_FTP_TEST_BENCH_ITERATIONS        (3)
+#define DANP_FTP_TEST_BENCH_SETTLE_MS         (100)
+#define DANP_FTP_TEST_BENCH_FILE_ID           "bench_file"
 
 /* Types */
 
@@ -26,24 +36,40 @@ typedef struct danp_ftp_test_stats_s
 {
     uint32_t chunks_transferred;
     uint32_t total_bytes;
-    uint32_t chunk_crcs[64];
+    uint32_t running_crc;                        /* CRC register over in-order data */
     uint32_t total_crc;
     uint32_t expected_total_crc;
+    uint32_t retries;                            /* Chunks requested again at an earlier offset */
+    uint32_t mismatches;                         /* Received bytes that differ from the pattern */
+    size_t first_mismatch;
+    uint8_t first_mismatch_value;
+    size_t next_offset;
     bool verified;
 } danp_ftp_test_stats_t;
 
+typedef struct danp_ftp_test_bench_result_s
+{
+    uint32_t passed;
+    uint32_t elapsed_ms;
+    uint64_t bytes;
+    uint32_t chunks;
+    uint32_t retries;
+} danp_ftp_test_bench_result_t;
+
 typedef struct danp_ftp_test_context_s
 {
-    uint8_t tx_buffer[DANP_FTP_TEST_MAX_FILE_SIZE];
-    uint8_t rx_buffer[DANP_FTP_TEST_MAX_FILE_SIZE];
     size_t tx_size;
+    uint8_t tx_seed;
     size_t rx_size;
+    uint8_t rx_seed;
+    bool rx_check_pattern;                       /* Verify received bytes against the pattern */
     danp_ftp_test_stats_t tx_stats;
     danp_ftp_test_stats_t rx_stats;
     uint16_t remote_node;
     uint16_t chunk_size;
     uint32_t timeout_ms;
     uint8_t max_retries;
+    bool skip_identical;
     const struct shell *shell;
 } danp_ftp_test_context_t;
 
@@ -66,41 +92,55 @@ static bool handle_initialized = false;
  */
 static uint32_t danp_ftp_test_calculate_crc(const uint8_t *data, size_t length)
 {
-    uint32_t crc = 0xFFFFFFFFU;
-
-    for (size_t i = 0; i < length; i++)
-    {
-        crc ^= data[i];
-        for (int j = 0; j < 8; j++)
-        {
-            if (crc & 1)
-            {
-                crc = (crc >> 1) ^ DANP_FTP_CRC32_POLYNOMIAL;
-            }
-            else
-            {
-                crc >>= 1;
-            }
-        }
-    }
-
-    return crc ^ 0xFFFFFFFFU;
+    return danp_ftp_service_crc32_update(DANP_FTP_CRC32_INIT, data, length) ^ DANP_FTP_CRC32_INIT;
 }
 
 /**
- * @brief Generate a known test pattern.
+ * @brief Generate a slice of the known test pattern.
+ *
+ * Every byte depends only on its file offset, so any slice can be produced
+ * or checked on the fly without holding the file in RAM.
+ *
  * @param buffer Output buffer.
- * @param size Size of the pattern.
+ * @param offset File offset of the first byte.
+ * @param size Size of the slice.
  * @param seed Seed for pattern generation.
  */
-static void danp_ftp_test_generate_pattern(uint8_t *buffer, size_t size, uint8_t seed)
+static void danp_ftp_test_generate_pattern(uint8_t *buffer, size_t offset, size_t size, uint8_t seed)
 {
     for (size_t i = 0; i < size; i++)
     {
-        buffer[i] = (uint8_t)((seed + i) ^ (i >> 3));
+        size_t pos = offset + i;
+
+        buffer[i] = (uint8_t)((seed + pos) ^ (pos >> 3));
     }
 }
 
+/**
+ * @brief Calculate the CRC32 of a slice of the test pattern.
+ * @param offset File offset of the first byte.
+ * @param size Size of the slice.
+ * @param seed Pattern seed.
+ * @return Calculated CRC32 value.
+ */
+static uint32_t danp_ftp_test_pattern_crc(size_t offset, size_t size, uint8_t seed)
+{
+    uint8_t block[DANP_FTP_TEST_PATTERN_BLOCK];
+    uint32_t crc = DANP_FTP_CRC32_INIT;
+    size_t length;
+
+    while (size > 0)
+    {
+        length = (size < sizeof(block)) ? size : sizeof(block);
+        danp_ftp_test_generate_pattern(block, offset, length, seed);
+        crc = danp_ftp_service_crc32_update(crc, block, length);
+        offset += length;
+        size -= length;
+    }
+
+    return crc ^ DANP_FTP_CRC32_INIT;
+}
+
 /**
  * @brief Print test statistics.
  * @param sh Shell instance.
@@ -115,24 +155,33 @@ static void danp_ftp_test_print_stats(
     shell_print(sh, "=== %s Statistics ===", label);
     shell_print(sh, "  Chunks transferred: %u", stats->chunks_transferred);
     shell_print(sh, "  Total bytes: %u", stats->total_bytes);
+    shell_print(sh, "  Retries: %u", stats->retries);
     shell_print(sh, "  Total CRC: 0x%08X", stats->total_crc);
     shell_print(sh, "  Expected CRC: 0x%08X", stats->expected_total_crc);
-    shell_print(sh, "  Verified: %s", stats->verified ? "YES" : "NO");
-
-    if (stats->chunks_transferred > 0 && stats->chunks_transferred <= 64)
+    if (stats->mismatches > 0)
     {
-        shell_print(sh, "  Chunk CRCs:");
-        for (uint32_t i = 0; i < stats->chunks_transferred; i++)
-        {
-            shell_print(sh, "    [%u]: 0x%08X", i, stats->chunk_crcs[i]);
-        }
+        shell_print(sh, "  Pattern mismatches: %u (first at offset %zu)",
+            stats->mismatches, stats->first_mismatch);
     }
+    shell_print(sh, "  Verified: %s", stats->verified ? "YES" : "NO");
+}
+
+/**
+ * @brief Reset statistics before a transfer.
+ * @param stats Pointer to stats structure.
+ * @param expected_crc Expected CRC of the whole transfer.
+ */
+static void danp_ftp_test_reset_stats(danp_ftp_test_stats_t *stats, uint32_t expected_crc)
+{
+    memset(stats, 0, sizeof(danp_ftp_test_stats_t));
+    stats->running_crc = DANP_FTP_CRC32_INIT;
+    stats->expected_total_crc = expected_crc;
 }
 
 /* FTP Callbacks */
 
 /**
- * @brief Source callback for transmit test.
+ * @brief Source callback for transmit test, generating the pattern from the offset.
  */
 static danp_ftp_status_t danp_ftp_test_source_cb(
     danp_ftp_handle_t *handle,
@@ -168,20 +217,24 @@ static danp_ftp_status_t danp_ftp_test_source_cb(
         remaining = ctx->tx_size - offset;
         to_copy = (remaining < length) ? remaining : length;
 
-        memcpy(data, &ctx->tx_buffer[offset], to_copy);
-
-        /* Calculate chunk CRC */
-        chunk_crc = danp_ftp_test_calculate_crc(data, to_copy);
+        danp_ftp_test_generate_pattern(data, offset, to_copy, ctx->tx_seed);
+        danp_trace(DANP_TRACE_FTP_TEST_TX, (uint32_t)offset, (uint32_t)to_copy);
 
-        if (ctx->tx_stats.chunks_transferred < 64)
+        if (offset < ctx->tx_stats.next_offset)
+        {
+            ctx->tx_stats.retries++;
+        }
+        else
         {
-            ctx->tx_stats.chunk_crcs[ctx->tx_stats.chunks_transferred] = chunk_crc;
+            ctx->tx_stats.running_crc = danp_ftp_service_crc32_update(ctx->tx_stats.running_crc, data, to_copy);
+            ctx->tx_stats.total_bytes += to_copy;
+            ctx->tx_stats.next_offset = offset + to_copy;
         }
         ctx->tx_stats.chunks_transferred++;
-        ctx->tx_stats.total_bytes += to_copy;
 
         if (ctx->shell)
         {
+            chunk_crc = danp_ftp_test_calculate_crc(data, to_copy);
             shell_print(ctx->shell, "[TX] Chunk %u: offset=%zu len=%zu CRC=0x%08X",
                 ctx->tx_stats.chunks_transferred - 1, offset, to_copy, chunk_crc);
         }
@@ -196,7 +249,7 @@ static danp_ftp_status_t danp_ftp_test_source_cb(
 }
 
 /**
- * @brief Sink callback for receive test.
+ * @brief Sink callback for receive test, folding data into a running CRC.
  */
 static danp_ftp_status_t danp_ftp_test_sink_cb(
     danp_ftp_handle_t *handle,
@@ -207,7 +260,10 @@ static danp_ftp_status_t danp_ftp_test_sink_cb(
     void *user_data)
 {
     danp_ftp_test_context_t *ctx = (danp_ftp_test_context_t *)user_data;
+    uint8_t expected[DANP_FTP_TEST_PATTERN_BLOCK];
     uint32_t chunk_crc;
+    size_t checked;
+    size_t block;
 
     (void)handle;
     (void)more;
@@ -219,30 +275,59 @@ static danp_ftp_status_t danp_ftp_test_sink_cb(
             return DANP_FTP_STATUS_INVALID_PARAM;
         }
 
-        if (offset + length > DANP_FTP_TEST_MAX_FILE_SIZE)
+        danp_trace(DANP_TRACE_FTP_TEST_RX, (uint32_t)offset, length);
+
+        if (offset > ctx->rx_stats.next_offset)
         {
             if (ctx->shell)
             {
-                shell_error(ctx->shell, "[RX] Buffer overflow at offset %zu", offset);
+                shell_error(ctx->shell, "[RX] Gap at offset %zu, expected %zu",
+                    offset, ctx->rx_stats.next_offset);
             }
             return DANP_FTP_STATUS_ERROR;
         }
 
-        memcpy(&ctx->rx_buffer[offset], data, length);
-        ctx->rx_size = offset + length;
+        if (offset < ctx->rx_stats.next_offset)
+        {
+            /* Duplicate of data already folded into the CRC */
+            ctx->rx_stats.retries++;
+        }
+        else
+        {
+            ctx->rx_stats.running_crc = danp_ftp_service_crc32_update(ctx->rx_stats.running_crc, data, length);
+            ctx->rx_stats.total_bytes += length;
+            ctx->rx_stats.next_offset = offset + length;
+            ctx->rx_size = ctx->rx_stats.next_offset;
 
-        /* Calculate chunk CRC */
-        chunk_crc = danp_ftp_test_calculate_crc(data, length);
+            for (checked = 0; ctx->rx_check_pattern && checked < length; checked += block)
+            {
+                block = length - checked;
+                if (block > sizeof(expected))
+                {
+                    block = sizeof(expected);
+                }
 
-        if (ctx->rx_stats.chunks_transferred < 64)
-        {
-            ctx->rx_stats.chunk_crcs[ctx->rx_stats.chunks_transferred] = chunk_crc;
+                danp_ftp_test_generate_pattern(expected, offset + checked, block, ctx->rx_seed);
+
+                for (size_t i = 0; i < block; i++)
+                {
+                    if (expected[i] != data[checked + i])
+                    {
+                        if (ctx->rx_stats.mismatches == 0)
+                        {
+                            ctx->rx_stats.first_mismatch = offset + checked + i;
+                            ctx->rx_stats.first_mismatch_value = data[checked + i];
+                        }
+                        ctx->rx_stats.mismatches++;
+                    }
+                }
+            }
         }
         ctx->rx_stats.chunks_transferred++;
-        ctx->rx_stats.total_bytes += length;
 
         if (ctx->shell)
         {
+            chunk_crc = danp_ftp_test_calculate_crc(data, length);
             shell_print(ctx->shell, "[RX] Chunk %u: offset=%zu len=%u CRC=0x%08X",
                 ctx->rx_stats.chunks_transferred - 1, offset, length, chunk_crc);
         }
@@ -251,6 +336,64 @@ static danp_ftp_status_t danp_ftp_test_sink_cb(
     }
 }
 
+/**
+ * @brief Local file read callback for differential sync.
+ */
+static danp_ftp_status_t danp_ftp_test_sync_read_cb(
+    size_t offset,
+    uint8_t *buffer,
+    uint16_t length,
+    void *user_data)
+{
+    danp_ftp_test_context_t *ctx = (danp_ftp_test_context_t *)user_data;
+    size_t to_copy;
+
+    if (!ctx || !buffer || offset > ctx->tx_size)
+    {
+        return DANP_FTP_STATUS_INVALID_PARAM;
+    }
+
+    to_copy = ctx->tx_size - offset;
+    if (to_copy > length)
+    {
+        to_copy = length;
+    }
+
+    danp_ftp_test_generate_pattern(buffer, offset, to_copy, ctx->tx_seed);
+
+    return (danp_ftp_status_t)to_copy;
+}
+
+/**
+ * @brief Remote file write callback printing the received bytes.
+ */
+static danp_ftp_status_t danp_ftp_test_tail_cb(
+    size_t offset,
+    const uint8_t *data,
+    uint16_t length,
+    void *user_data)
+{
+    const struct shell *sh = (const struct shell *)user_data;
+
+    for (size_t i = 0; i < length; i += 16)
+    {
+        char hex_str[50] = {0};
+        char ascii_str[17] = {0};
+        size_t line_len = (length - i < 16) ? (length - i) : 16;
+
+        for (size_t j = 0; j < line_len; j++)
+        {
+            uint8_t byte = data[i + j];
+            sprintf(&hex_str[j * 3], "%02X ", byte);
+            ascii_str[j] = (byte >= 32 && byte < 127) ? byte : '.';
+        }
+
+        shell_print(sh, "  %04zX: %-48s |%s|", offset + i, hex_str, ascii_str);
+    }
+
+    return (danp_ftp_status_t)length;
+}
+
 /* Shell Commands */
 
 /**
@@ -329,9 +472,10 @@ static int cmd_ftp_config(const struct shell *sh, size_t argc, char **argv)
         shell_print(sh, "  Chunk size: %u", test_ctx.chunk_size);
         shell_print(sh, "  Timeout: %u ms", test_ctx.timeout_ms);
         shell_print(sh, "  Max retries: %u", test_ctx.max_retries);
+        shell_print(sh, "  Skip identical: %s", test_ctx.skip_identical ? "YES" : "NO");
         shell_print(sh, "");
         shell_print(sh, "Usage: ftp config <param> <value>");
-        shell_print(sh, "  param: node, chunk, timeout, retries");
+        shell_print(sh, "  param: node, chunk, timeout, retries, skip");
         return 0;
     }
 
@@ -355,6 +499,11 @@ static int cmd_ftp_config(const struct shell *sh, size_t argc, char **argv)
         test_ctx.max_retries = (uint8_t)strtoul(argv[2], NULL, 0);
         shell_print(sh, "Max retries set to %u", test_ctx.max_retries);
     }
+    else if (strcmp(argv[1], "skip") == 0)
+    {
+        test_ctx.skip_identical = (strtoul(argv[2], NULL, 0) != 0);
+        shell_print(sh, "Skip identical set to %s", test_ctx.skip_identical ? "YES" : "NO");
+    }
     else
     {
         shell_error(sh, "Unknown parameter: %s", argv[1]);
@@ -378,11 +527,6 @@ static int cmd_ftp_generate(const struct shell *sh, size_t argc, char **argv)
     if (argc > 1)
     {
         size = (size_t)strtoul(argv[1], NULL, 0);
-        if (size > DANP_FTP_TEST_MAX_FILE_SIZE)
-        {
-            size = DANP_FTP_TEST_MAX_FILE_SIZE;
-            shell_warn(sh, "Size clamped to %u", DANP_FTP_TEST_MAX_FILE_SIZE);
-        }
     }
 
     if (argc > 2)
@@ -392,15 +536,14 @@ static int cmd_ftp_generate(const struct shell *sh, size_t argc, char **argv)
 
     shell_print(sh, "Generating test pattern: size=%zu seed=0x%02X", size, seed);
 
-    danp_ftp_test_generate_pattern(test_ctx.tx_buffer, size, seed);
     test_ctx.tx_size = size;
+    test_ctx.tx_seed = seed;
 
     /* Calculate total CRC */
-    total_crc = danp_ftp_test_calculate_crc(test_ctx.tx_buffer, size);
+    total_crc = danp_ftp_test_pattern_crc(0, size, seed);
 
     /* Reset stats */
-    memset(&test_ctx.tx_stats, 0, sizeof(danp_ftp_test_stats_t));
-    test_ctx.tx_stats.expected_total_crc = total_crc;
+    danp_ftp_test_reset_stats(&test_ctx.tx_stats, total_crc);
 
     shell_print(sh, "Pattern generated:");
     shell_print(sh, "  Size: %zu bytes", size);
@@ -409,12 +552,11 @@ static int cmd_ftp_generate(const struct shell *sh, size_t argc, char **argv)
     /* Pre-calculate expected chunk CRCs */
     shell_print(sh, "Expected chunk CRCs (chunk_size=%u):", test_ctx.chunk_size);
 
-    while (offset < size && chunk_idx < 64)
+    while (offset < size && chunk_idx < DANP_FTP_TEST_MAX_CHUNK_CRCS)
     {
         size_t chunk_len = (size - offset < test_ctx.chunk_size) ?
                            (size - offset) : test_ctx.chunk_size;
-        uint32_t chunk_crc = danp_ftp_test_calculate_crc(
-            &test_ctx.tx_buffer[offset], chunk_len);
+        uint32_t chunk_crc = danp_ftp_test_pattern_crc(offset, chunk_len, seed);
 
         shell_print(sh, "  [%u] offset=%zu len=%zu CRC=0x%08X",
             chunk_idx, offset, chunk_len, chunk_crc);
@@ -433,6 +575,7 @@ static int cmd_ftp_tx(const struct shell *sh, size_t argc, char **argv)
 {
     const char *file_id = "test_file";
     danp_ftp_transfer_config_t config;
+    danp_ftp_service_file_info_t remote_info;
     danp_ftp_status_t status;
 
     if (argc > 1)
@@ -453,9 +596,9 @@ static int cmd_ftp_tx(const struct shell *sh, size_t argc, char **argv)
     }
 
     /* Reset TX stats */
-    memset(&test_ctx.tx_stats, 0, sizeof(danp_ftp_test_stats_t));
-    test_ctx.tx_stats.expected_total_crc = danp_ftp_test_calculate_crc(
-        test_ctx.tx_buffer, test_ctx.tx_size);
+    danp_ftp_test_reset_stats(
+        &test_ctx.tx_stats,
+        danp_ftp_test_pattern_crc(0, test_ctx.tx_size, test_ctx.tx_seed));
     test_ctx.shell = sh;
 
     config.file_id = (const uint8_t *)file_id;
@@ -464,6 +607,25 @@ static int cmd_ftp_tx(const struct shell *sh, size_t argc, char **argv)
     config.timeout_ms = test_ctx.timeout_ms;
     config.max_retries = test_ctx.max_retries;
 
+    if (test_ctx.skip_identical)
+    {
+        status = danp_ftp_service_client_stat(
+            test_ctx.remote_node,
+            config.file_id,
+            config.file_id_len,
+            &remote_info,
+            test_ctx.timeout_ms);
+
+        if (status == DANP_FTP_STATUS_OK &&
+            remote_info.size == test_ctx.tx_size &&
+            remote_info.crc == test_ctx.tx_stats.expected_total_crc)
+        {
+            shell_print(sh, "Remote file is identical (size=%zu CRC=0x%08X), transfer skipped",
+                remote_info.size, remote_info.crc);
+            return 0;
+        }
+    }
+
     shell_print(sh, "Starting FTP transmit test...");
     shell_print(sh, "  File ID: %s", file_id);
     shell_print(sh, "  Size: %zu bytes", test_ctx.tx_size);
@@ -485,14 +647,33 @@ static int cmd_ftp_tx(const struct shell *sh, size_t argc, char **argv)
         return -1;
     }
 
-    /* Calculate actual total CRC from sent data */
-    test_ctx.tx_stats.total_crc = danp_ftp_test_calculate_crc(
-        test_ctx.tx_buffer, test_ctx.tx_stats.total_bytes);
+    /* Finalize the CRC of the data handed to the transfer */
+    test_ctx.tx_stats.total_crc = test_ctx.tx_stats.running_crc ^ DANP_FTP_CRC32_INIT;
 
     test_ctx.tx_stats.verified =
         (test_ctx.tx_stats.total_crc == test_ctx.tx_stats.expected_total_crc) &&
         (test_ctx.tx_stats.total_bytes == test_ctx.tx_size);
 
+    /* Verify end-to-end against the digest computed by the service */
+    status = danp_ftp_service_client_stat(
+        test_ctx.remote_node,
+        config.file_id,
+        config.file_id_len,
+        &remote_info,
+        test_ctx.timeout_ms);
+
+    if (status == DANP_FTP_STATUS_OK)
+    {
+        shell_print(sh, "Remote digest: size=%zu CRC=0x%08X", remote_info.size, remote_info.crc);
+        test_ctx.tx_stats.verified = test_ctx.tx_stats.verified &&
+            (remote_info.size == test_ctx.tx_size) &&
+            (remote_info.crc == test_ctx.tx_stats.expected_total_crc);
+    }
+    else
+    {
+        shell_warn(sh, "Remote digest unavailable: %d", status);
+    }
+
     danp_ftp_test_print_stats(sh, "TX", &test_ctx.tx_stats);
 
     if (test_ctx.tx_stats.verified)
@@ -534,11 +715,10 @@ static int cmd_ftp_rx(const struct shell *sh, size_t argc, char **argv)
         return -1;
     }
 
-    /* Reset RX context */
-    memset(test_ctx.rx_buffer, 0, sizeof(test_ctx.rx_buffer));
+    /* Reset RX context, the file is not necessarily our pattern */
     test_ctx.rx_size = 0;
-    memset(&test_ctx.rx_stats, 0, sizeof(danp_ftp_test_stats_t));
-    test_ctx.rx_stats.expected_total_crc = expected_crc;
+    test_ctx.rx_check_pattern = false;
+    danp_ftp_test_reset_stats(&test_ctx.rx_stats, expected_crc);
     test_ctx.shell = sh;
 
     config.file_id = (const uint8_t *)file_id;
@@ -570,9 +750,8 @@ static int cmd_ftp_rx(const struct shell *sh, size_t argc, char **argv)
         return -1;
     }
 
-    /* Calculate actual total CRC from received data */
-    test_ctx.rx_stats.total_crc = danp_ftp_test_calculate_crc(
-        test_ctx.rx_buffer, test_ctx.rx_size);
+    /* Finalize the CRC of the received data */
+    test_ctx.rx_stats.total_crc = test_ctx.rx_stats.running_crc ^ DANP_FTP_CRC32_INIT;
 
     if (expected_crc != 0)
     {
@@ -616,10 +795,6 @@ static int cmd_ftp_loopback(const struct shell *sh, size_t argc, char **argv)
     if (argc > 1)
     {
         size = (size_t)strtoul(argv[1], NULL, 0);
-        if (size > DANP_FTP_TEST_MAX_FILE_SIZE)
-        {
-            size = DANP_FTP_TEST_MAX_FILE_SIZE;
-        }
     }
 
     if (argc > 2)
@@ -637,17 +812,16 @@ static int cmd_ftp_loopback(const struct shell *sh, size_t argc, char **argv)
     shell_print(sh, "Size: %zu bytes, Seed: 0x%02X", size, seed);
     shell_print(sh, "");
 
-    /* Generate test pattern */
-    danp_ftp_test_generate_pattern(test_ctx.tx_buffer, size, seed);
+    /* Select test pattern */
     test_ctx.tx_size = size;
-    tx_crc = danp_ftp_test_calculate_crc(test_ctx.tx_buffer, size);
+    test_ctx.tx_seed = seed;
+    tx_crc = danp_ftp_test_pattern_crc(0, size, seed);
 
     shell_print(sh, "Generated TX pattern CRC: 0x%08X", tx_crc);
 
     /* Reset stats */
-    memset(&test_ctx.tx_stats, 0, sizeof(danp_ftp_test_stats_t));
-    memset(&test_ctx.rx_stats, 0, sizeof(danp_ftp_test_stats_t));
-    test_ctx.tx_stats.expected_total_crc = tx_crc;
+    danp_ftp_test_reset_stats(&test_ctx.tx_stats, tx_crc);
+    danp_ftp_test_reset_stats(&test_ctx.rx_stats, tx_crc);
     test_ctx.shell = sh;
 
     config.file_id = (const uint8_t *)file_id;
@@ -671,8 +845,7 @@ static int cmd_ftp_loopback(const struct shell *sh, size_t argc, char **argv)
         return -1;
     }
 
-    test_ctx.tx_stats.total_crc = danp_ftp_test_calculate_crc(
-        test_ctx.tx_buffer, test_ctx.tx_stats.total_bytes);
+    test_ctx.tx_stats.total_crc = test_ctx.tx_stats.running_crc ^ DANP_FTP_CRC32_INIT;
 
     shell_print(sh, "TX complete: %u bytes, CRC=0x%08X",
         test_ctx.tx_stats.total_bytes, test_ctx.tx_stats.total_crc);
@@ -689,12 +862,12 @@ static int cmd_ftp_loopback(const struct shell *sh, size_t argc, char **argv)
         return -1;
     }
 
-    /* Phase 2: Receive */
+    /* Phase 2: Receive, checking every byte against the pattern */
     shell_print(sh, "\n--- Phase 2: Receive ---");
 
-    memset(test_ctx.rx_buffer, 0, sizeof(test_ctx.rx_buffer));
     test_ctx.rx_size = 0;
-    test_ctx.rx_stats.expected_total_crc = tx_crc;
+    test_ctx.rx_seed = seed;
+    test_ctx.rx_check_pattern = true;
 
     status = danp_ftp_receive(
         &test_handle,
@@ -702,13 +875,15 @@ static int cmd_ftp_loopback(const struct shell *sh, size_t argc, char **argv)
         danp_ftp_test_sink_cb,
         &test_ctx);
 
+    test_ctx.rx_check_pattern = false;
+
     if (status < 0)
     {
         shell_error(sh, "RX phase failed: %d", status);
         return -1;
     }
 
-    rx_crc = danp_ftp_test_calculate_crc(test_ctx.rx_buffer, test_ctx.rx_size);
+    rx_crc = test_ctx.rx_stats.running_crc ^ DANP_FTP_CRC32_INIT;
     test_ctx.rx_stats.total_crc = rx_crc;
 
     shell_print(sh, "RX complete: %zu bytes, CRC=0x%08X",
@@ -718,7 +893,9 @@ static int cmd_ftp_loopback(const struct shell *sh, size_t argc, char **argv)
     shell_print(sh, "\n--- Phase 3: Verification ---");
 
     data_match = (test_ctx.tx_size == test_ctx.rx_size) &&
-                 (memcmp(test_ctx.tx_buffer, test_ctx.rx_buffer, test_ctx.tx_size) == 0);
+                 (test_ctx.rx_stats.mismatches == 0);
+    test_ctx.tx_stats.verified = (test_ctx.tx_stats.total_crc == tx_crc);
+    test_ctx.rx_stats.verified = data_match && (rx_crc == tx_crc);
 
     shell_print(sh, "TX size: %zu, RX size: %zu", test_ctx.tx_size, test_ctx.rx_size);
     shell_print(sh, "TX CRC: 0x%08X, RX CRC: 0x%08X", tx_crc, rx_crc);
@@ -739,32 +916,251 @@ static int cmd_ftp_loopback(const struct shell *sh, size_t argc, char **argv)
     {
         shell_error(sh, "\n[FAIL] Loopback test FAILED");
 
-        /* Find first mismatch */
-        if (!data_match && test_ctx.tx_size == test_ctx.rx_size)
+        if (test_ctx.rx_stats.mismatches > 0)
+        {
+            uint8_t expected;
+
+            danp_ftp_test_generate_pattern(&expected, test_ctx.rx_stats.first_mismatch, 1, seed);
+            shell_error(sh, "First mismatch at offset %zu: TX=0x%02X RX=0x%02X",
+                test_ctx.rx_stats.first_mismatch, expected, test_ctx.rx_stats.first_mismatch_value);
+        }
+        return -1;
+    }
+}
+
+/**
+ * @brief Parse a comma separated list of numbers.
+ * @param arg Argument string, e.g. "32,64,128".
+ * @param values Output array.
+ * @param max_values Capacity of the output array.
+ * @return Number of values parsed.
+ */
+static size_t danp_ftp_test_parse_list(const char *arg, uint32_t *values, size_t max_values)
+{
+    size_t count = 0;
+    char *end;
+
+    while (arg && *arg && count < max_values)
+    {
+        values[count++] = (uint32_t)strtoul(arg, &end, 0);
+        if (end == arg || *end != ',')
+        {
+            break;
+        }
+        arg = end + 1;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Re-open the FTP handle so every bench transfer starts on a fresh connection.
+ * @return Status code.
+ */
+static danp_ftp_status_t danp_ftp_test_bench_reconnect(void)
+{
+    danp_ftp_status_t status;
+
+    if (handle_initialized)
+    {
+        danp_ftp_deinit(&test_handle);
+        handle_initialized = false;
+        k_msleep(DANP_FTP_TEST_BENCH_SETTLE_MS);
+    }
+
+    status = danp_ftp_init(&test_handle, test_ctx.remote_node);
+    if (status == DANP_FTP_STATUS_OK)
+    {
+        handle_initialized = true;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Run one bench step: repeated silent TX then RX of the same file.
+ * @param config Transfer configuration.
+ * @param size File size.
+ * @param iterations Transfers per direction.
+ * @param tx Output TX result.
+ * @param rx Output RX result.
+ */
+static void danp_ftp_test_bench_step(
+    const danp_ftp_transfer_config_t *config,
+    size_t size,
+    uint32_t iterations,
+    danp_ftp_test_bench_result_t *tx,
+    danp_ftp_test_bench_result_t *rx)
+{
+    uint32_t expected_crc;
+    uint32_t start_ms;
+    danp_ftp_status_t status;
+
+    memset(tx, 0, sizeof(danp_ftp_test_bench_result_t));
+    memset(rx, 0, sizeof(danp_ftp_test_bench_result_t));
+
+    test_ctx.tx_size = size;
+    test_ctx.tx_seed = (uint8_t)size;
+    test_ctx.rx_seed = test_ctx.tx_seed;
+    expected_crc = danp_ftp_test_pattern_crc(0, size, test_ctx.tx_seed);
+
+    danp_trace(DANP_TRACE_FTP_BENCH_BEGIN, (uint32_t)size, iterations);
+
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        if (danp_ftp_test_bench_reconnect() != DANP_FTP_STATUS_OK)
         {
-            for (size_t i = 0; i < test_ctx.tx_size; i++)
+            break;
+        }
+
+        danp_ftp_test_reset_stats(&test_ctx.tx_stats, expected_crc);
+        start_ms = k_uptime_get_32();
+        status = danp_ftp_transmit(&test_handle, config, danp_ftp_test_source_cb, &test_ctx);
+        tx->elapsed_ms += k_uptime_get_32() - start_ms;
+        tx->chunks += test_ctx.tx_stats.chunks_transferred;
+        tx->retries += test_ctx.tx_stats.retries;
+
+        if (status >= 0)
+        {
+            tx->passed++;
+            tx->bytes += size;
+        }
+
+        if (danp_ftp_test_bench_reconnect() != DANP_FTP_STATUS_OK)
+        {
+            break;
+        }
+
+        danp_ftp_test_reset_stats(&test_ctx.rx_stats, expected_crc);
+        test_ctx.rx_size = 0;
+        test_ctx.rx_check_pattern = true;
+        start_ms = k_uptime_get_32();
+        status = danp_ftp_receive(&test_handle, config, danp_ftp_test_sink_cb, &test_ctx);
+        test_ctx.rx_check_pattern = false;
+        rx->elapsed_ms += k_uptime_get_32() - start_ms;
+        rx->chunks += test_ctx.rx_stats.chunks_transferred;
+        rx->retries += test_ctx.rx_stats.retries;
+
+        if (status >= 0 &&
+            test_ctx.rx_size == size &&
+            test_ctx.rx_stats.mismatches == 0 &&
+            (test_ctx.rx_stats.running_crc ^ DANP_FTP_CRC32_INIT) == expected_crc)
+        {
+            rx->passed++;
+            rx->bytes += size;
+        }
+    }
+
+    danp_trace(DANP_TRACE_FTP_BENCH_END, tx->passed, rx->passed);
+}
+
+/**
+ * @brief Print one bench table row.
+ */
+static void danp_ftp_test_bench_print_row(
+    const struct shell *sh,
+    const char *op,
+    size_t size,
+    const danp_ftp_transfer_config_t *config,
+    uint32_t iterations,
+    const danp_ftp_test_bench_result_t *result)
+{
+    uint32_t elapsed_ms = (result->elapsed_ms > 0) ? result->elapsed_ms : 1;
+
+    shell_print(sh, "%-3s %6zu %5u %4u %3u/%-3u %7u %9llu %8u %5u",
+        op,
+        size,
+        config->chunk_size,
+        config->max_retries,
+        result->passed,
+        iterations,
+        result->elapsed_ms,
+        (unsigned long long)(result->bytes * 1000U / elapsed_ms),
+        (uint32_t)((uint64_t)result->chunks * 1000U / elapsed_ms),
+        result->retries);
+}
+
+/**
+ * @brief Silent TX/RX benchmark sweeping file size, chunk size and retries.
+ */
+static int cmd_ftp_bench(const struct shell *sh, size_t argc, char **argv)
+{
+    uint32_t iterations = DANP_FTP_TEST_BENCH_ITERATIONS;
+    uint32_t sizes[DANP_FTP_TEST_BENCH_MAX_STEPS] = {DANP_FTP_TEST_PATTERN_SIZE};
+    uint32_t chunks[DANP_FTP_TEST_BENCH_MAX_STEPS] = {test_ctx.chunk_size};
+    uint32_t retries[DANP_FTP_TEST_BENCH_MAX_STEPS] = {test_ctx.max_retries};
+    size_t size_count = 1;
+    size_t chunk_count = 1;
+    size_t retry_count = 1;
+    danp_ftp_transfer_config_t config;
+    danp_ftp_test_bench_result_t tx;
+    danp_ftp_test_bench_result_t rx;
+    const struct shell *saved_shell = test_ctx.shell;
+
+    if (argc > 1)
+    {
+        iterations = (uint32_t)strtoul(argv[1], NULL, 0);
+    }
+    if (argc > 2)
+    {
+        size_count = danp_ftp_test_parse_list(argv[2], sizes, DANP_FTP_TEST_BENCH_MAX_STEPS);
+    }
+    if (argc > 3)
+    {
+        chunk_count = danp_ftp_test_parse_list(argv[3], chunks, DANP_FTP_TEST_BENCH_MAX_STEPS);
+    }
+    if (argc > 4)
+    {
+        retry_count = danp_ftp_test_parse_list(argv[4], retries, DANP_FTP_TEST_BENCH_MAX_STEPS);
+    }
+
+    if (iterations == 0 || size_count == 0 || chunk_count == 0 || retry_count == 0)
+    {
+        shell_error(sh, "Invalid bench arguments");
+        return -1;
+    }
+
+    config.file_id = (const uint8_t *)DANP_FTP_TEST_BENCH_FILE_ID;
+    config.file_id_len = strlen(DANP_FTP_TEST_BENCH_FILE_ID);
+    config.timeout_ms = test_ctx.timeout_ms;
+
+    /* Chunk callbacks print only when a shell is attached */
+    test_ctx.shell = NULL;
+
+    shell_print(sh, "=== FTP Bench: node %u, %u iterations ===", test_ctx.remote_node, iterations);
+    shell_print(sh, "%-3s %6s %5s %4s %7s %7s %9s %8s %5s",
+        "op", "size", "chunk", "rtry", "ok", "ms", "B/s", "chunks/s", "retry");
+
+    for (size_t s = 0; s < size_count; s++)
+    {
+        for (size_t c = 0; c < chunk_count; c++)
+        {
+            for (size_t r = 0; r < retry_count; r++)
             {
-                if (test_ctx.tx_buffer[i] != test_ctx.rx_buffer[i])
-                {
-                    shell_error(sh, "First mismatch at offset %zu: TX=0x%02X RX=0x%02X",
-                        i, test_ctx.tx_buffer[i], test_ctx.rx_buffer[i]);
-                    break;
-                }
+                config.chunk_size = (uint16_t)chunks[c];
+                config.max_retries = (uint8_t)retries[r];
+
+                danp_ftp_test_bench_step(&config, sizes[s], iterations, &tx, &rx);
+                danp_ftp_test_bench_print_row(sh, "tx", sizes[s], &config, iterations, &tx);
+                danp_ftp_test_bench_print_row(sh, "rx", sizes[s], &config, iterations, &rx);
             }
         }
-        return -1;
     }
+
+    test_ctx.shell = saved_shell;
+
+    return 0;
 }
 
 /**
- * @brief Dump buffer contents.
+ * @brief Dump TX pattern contents.
  */
 static int cmd_ftp_dump(const struct shell *sh, size_t argc, char **argv)
 {
     const char *buffer_name = "tx";
     size_t offset = 0;
     size_t length = 64;
-    uint8_t *buffer;
+    uint8_t line[16];
     size_t buffer_size;
 
     if (argc > 1)
@@ -784,13 +1180,12 @@ static int cmd_ftp_dump(const struct shell *sh, size_t argc, char **argv)
 
     if (strcmp(buffer_name, "tx") == 0)
     {
-        buffer = test_ctx.tx_buffer;
         buffer_size = test_ctx.tx_size;
     }
     else if (strcmp(buffer_name, "rx") == 0)
     {
-        buffer = test_ctx.rx_buffer;
-        buffer_size = test_ctx.rx_size;
+        shell_error(sh, "RX data is verified on the fly and not stored, see 'ftp status'");
+        return -1;
     }
     else
     {
@@ -824,9 +1219,11 @@ static int cmd_ftp_dump(const struct shell *sh, size_t argc, char **argv)
         char ascii_str[17] = {0};
         size_t line_len = (length - i < 16) ? (length - i) : 16;
 
+        danp_ftp_test_generate_pattern(line, offset + i, line_len, test_ctx.tx_seed);
+
         for (size_t j = 0; j < line_len; j++)
         {
-            uint8_t byte = buffer[offset + i + j];
+            uint8_t byte = line[j];
             sprintf(&hex_str[j * 3], "%02X ", byte);
             ascii_str[j] = (byte >= 32 && byte < 127) ? byte : '.';
         }
@@ -856,21 +1253,21 @@ static int cmd_ftp_status(const struct shell *sh, size_t argc, char **argv)
     shell_print(sh, "  Max retries: %u", test_ctx.max_retries);
     shell_print(sh, "");
 
-    shell_print(sh, "TX Buffer:");
+    shell_print(sh, "TX Pattern:");
     shell_print(sh, "  Size: %zu bytes", test_ctx.tx_size);
     if (test_ctx.tx_size > 0)
     {
+        shell_print(sh, "  Seed: 0x%02X", test_ctx.tx_seed);
         shell_print(sh, "  CRC: 0x%08X",
-            danp_ftp_test_calculate_crc(test_ctx.tx_buffer, test_ctx.tx_size));
+            danp_ftp_test_pattern_crc(0, test_ctx.tx_size, test_ctx.tx_seed));
     }
     shell_print(sh, "");
 
-    shell_print(sh, "RX Buffer:");
+    shell_print(sh, "Last RX:");
     shell_print(sh, "  Size: %zu bytes", test_ctx.rx_size);
     if (test_ctx.rx_size > 0)
     {
-        shell_print(sh, "  CRC: 0x%08X",
-            danp_ftp_test_calculate_crc(test_ctx.rx_buffer, test_ctx.rx_size));
+        shell_print(sh, "  CRC: 0x%08X", test_ctx.rx_stats.running_crc ^ DANP_FTP_CRC32_INIT);
     }
 
     if (test_ctx.tx_stats.chunks_transferred > 0)
@@ -888,6 +1285,202 @@ static int cmd_ftp_status(const struct shell *sh, size_t argc, char **argv)
     return 0;
 }
 
+/**
+ * @brief Query size and digest of a remote file.
+ */
+static int cmd_ftp_stat(const struct shell *sh, size_t argc, char **argv)
+{
+    const char *file_id = "test_file";
+    danp_ftp_service_file_info_t info;
+    danp_ftp_status_t status;
+
+    if (argc > 1)
+    {
+        file_id = argv[1];
+    }
+
+    status = danp_ftp_service_client_stat(
+        test_ctx.remote_node,
+        (const uint8_t *)file_id,
+        strlen(file_id),
+        &info,
+        test_ctx.timeout_ms);
+
+    if (status < 0)
+    {
+        shell_error(sh, "FTP stat failed: %d", status);
+        return -1;
+    }
+
+    shell_print(sh, "File '%s' on node %u:", file_id, test_ctx.remote_node);
+    shell_print(sh, "  Size: %zu bytes", info.size);
+    shell_print(sh, "  CRC: 0x%08X", info.crc);
+
+    if (test_ctx.tx_size > 0)
+    {
+        bool identical = (info.size == test_ctx.tx_size) &&
+            (info.crc == danp_ftp_test_pattern_crc(0, test_ctx.tx_size, test_ctx.tx_seed));
+
+        shell_print(sh, "  Identical to TX pattern: %s", identical ? "YES" : "NO");
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Print the last bytes of a remote file.
+ */
+static int cmd_ftp_tail(const struct shell *sh, size_t argc, char **argv)
+{
+    const char *file_id = "test_file";
+    danp_ftp_service_read_options_t options;
+    danp_ftp_service_read_stats_t stats;
+    danp_ftp_status_t status;
+    uint32_t bytes = 64;
+
+    if (argc > 1)
+    {
+        file_id = argv[1];
+    }
+
+    if (argc > 2)
+    {
+        bytes = (uint32_t)strtoul(argv[2], NULL, 0);
+    }
+
+    if (bytes == 0 || bytes > INT32_MAX)
+    {
+        shell_error(sh, "Invalid byte count: %u", bytes);
+        return -1;
+    }
+
+    memset(&options, 0, sizeof(options));
+    options.offset = -(int32_t)bytes;
+
+    status = danp_ftp_service_client_read_ex(
+        test_ctx.remote_node,
+        (const uint8_t *)file_id,
+        strlen(file_id),
+        &options,
+        danp_ftp_test_tail_cb,
+        (void *)sh,
+        &stats,
+        test_ctx.timeout_ms);
+
+    if (status < 0)
+    {
+        shell_error(sh, "FTP tail failed: %d", status);
+        return -1;
+    }
+
+    shell_print(sh, "File '%s' on node %u: %d bytes from offset %zu",
+        file_id, test_ctx.remote_node, status, stats.offset);
+
+    return 0;
+}
+
+/**
+ * @brief Differential sync of the TX pattern to a remote file.
+ */
+static int cmd_ftp_sync(const struct shell *sh, size_t argc, char **argv)
+{
+    const char *file_id = "test_file";
+    uint16_t block_size = 0;
+    danp_ftp_service_sync_stats_t stats;
+    danp_ftp_status_t status;
+
+    if (argc > 1)
+    {
+        file_id = argv[1];
+    }
+
+    if (argc > 2)
+    {
+        block_size = (uint16_t)strtoul(argv[2], NULL, 0);
+    }
+
+    if (test_ctx.tx_size == 0)
+    {
+        shell_error(sh, "No test pattern generated. Run 'ftp generate' first.");
+        return -1;
+    }
+
+    shell_print(sh, "Syncing %zu bytes to '%s' on node %u...", test_ctx.tx_size, file_id, test_ctx.remote_node);
+
+    status = danp_ftp_service_client_sync(
+        test_ctx.remote_node,
+        (const uint8_t *)file_id,
+        strlen(file_id),
+        test_ctx.tx_size,
+        block_size,
+        danp_ftp_test_sync_read_cb,
+        &test_ctx,
+        &stats,
+        test_ctx.timeout_ms);
+
+    if (status < 0)
+    {
+        shell_error(sh, "FTP sync failed: %d", status);
+        return -1;
+    }
+
+    shell_print(sh, "=== Sync Statistics ===");
+    shell_print(sh, "  Remote size before: %zu bytes", stats.remote_size);
+    shell_print(sh, "  Blocks sent: %u/%u", stats.blocks_sent, stats.blocks_total);
+    shell_print(sh, "  Bytes sent: %zu/%zu", stats.bytes_sent, test_ctx.tx_size);
+
+    return 0;
+}
+
+/**
+ * @brief Distribute the TX pattern to a group of nodes.
+ */
+static int cmd_ftp_mcast(const struct shell *sh, size_t argc, char **argv)
+{
+    danp_ftp_mcast_config_t config;
+    danp_ftp_mcast_stats_t stats;
+    danp_ftp_status_t status;
+
+    if (test_ctx.tx_size == 0)
+    {
+        shell_error(sh, "No test pattern generated. Run 'ftp generate' first.");
+        return -1;
+    }
+
+    memset(&config, 0, sizeof(config));
+    config.local_node = (uint16_t)strtoul(argv[1], NULL, 0);
+    config.group_node = (uint16_t)strtoul(argv[2], NULL, 0);
+    config.session_id = (uint16_t)(k_uptime_get_32() | 1U);
+
+    if (argc > 3)
+    {
+        config.receivers = (uint16_t)strtoul(argv[3], NULL, 0);
+    }
+
+    shell_print(sh, "Distributing %zu bytes to group node %u...", test_ctx.tx_size, config.group_node);
+
+    status = danp_ftp_mcast_send(
+        &config,
+        test_ctx.tx_size,
+        danp_ftp_test_sync_read_cb,
+        &test_ctx,
+        &stats);
+
+    if (status < 0)
+    {
+        shell_error(sh, "FTP mcast failed: %d (%u receivers complete)", status, stats.completed);
+        return -1;
+    }
+
+    shell_print(sh, "=== Multicast Statistics ===");
+    shell_print(sh, "  Receivers complete: %d", status);
+    shell_print(sh, "  Rounds: %u", stats.rounds);
+    shell_print(sh, "  Chunks: %u, repaired: %u", stats.chunks, stats.repairs);
+    shell_print(sh, "  NACKs collected: %u", stats.nacks);
+
+    return 0;
+}
+
 /**
  * @brief Calculate CRC of arbitrary data.
  */
@@ -932,8 +1525,207 @@ static int cmd_ftp_crc(const struct shell *sh, size_t argc, char **argv)
     return 0;
 }
 
+/**
+ * @brief Show or set the FTP service transmit rate limits.
+ */
+static int cmd_ftp_svc_rate(const struct shell *sh, size_t argc, char **argv)
+{
+    danp_ftp_service_rate_stats_t stats;
+    uint32_t global_bps;
+    uint32_t session_bps;
+
+    if (danp_ftp_service_get_rate_stats(&stats) < 0)
+    {
+        shell_error(sh, "FTP service not initialized");
+        return -1;
+    }
+
+    if (argc > 1)
+    {
+        global_bps = (uint32_t)strtoul(argv[1], NULL, 0);
+        session_bps = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : stats.session_limit_bps;
+
+        danp_ftp_service_set_rate_limit(global_bps, session_bps);
+        danp_ftp_service_get_rate_stats(&stats);
+    }
+
+    shell_print(sh, "=== FTP Service Rate ===");
+    shell_print(sh, "  Global limit: %u B/s%s", stats.global_limit_bps,
+        stats.global_limit_bps ? "" : " (unlimited)");
+    shell_print(sh, "  Session limit: %u B/s%s", stats.session_limit_bps,
+        stats.session_limit_bps ? "" : " (unlimited)");
+    shell_print(sh, "  Achieved: %u B/s", stats.achieved_bps);
+    shell_print(sh, "  Throttled: %u ms", stats.throttled_ms);
+    shell_print(sh, "  Bytes sent: %llu", (unsigned long long)stats.bytes_sent);
+    shell_print(sh, "  Retransmits: %u", stats.retransmits);
+
+    return 0;
+}
+
+/**
+ * @brief Show the stack high-water marks and heap usage of the FTP service.
+ */
+static int cmd_ftp_svc_mem(const struct shell *sh, size_t argc, char **argv)
+{
+    danp_ftp_service_mem_stats_t stats;
+    uint32_t active;
+    uint32_t peak;
+
+    ARG_UNUSED(argc);
+    ARG_UNUSED(argv);
+
+    if (danp_ftp_service_get_mem_stats(&stats) < 0 ||
+        danp_ftp_service_get_client_count(&active, &peak) < 0)
+    {
+        shell_error(sh, "FTP service not initialized");
+        return -1;
+    }
+
+    shell_print(sh, "=== FTP Service Memory ===");
+    if (stats.service_stack_used)
+    {
+        shell_print(sh, "  Service stack: %u / %u bytes", stats.service_stack_used, stats.service_stack_size);
+    }
+    else
+    {
+        shell_print(sh, "  Service stack: ? / %u bytes", stats.service_stack_size);
+    }
+
+    if (stats.client_stack_samples)
+    {
+        shell_print(sh, "  Client stack: peak %u, last %u / %u bytes (%u sessions)",
+            stats.client_stack_peak, stats.client_stack_last,
+            stats.client_stack_size, stats.client_stack_samples);
+    }
+    else
+    {
+        shell_print(sh, "  Client stack: ? / %u bytes (enable CONFIG_THREAD_STACK_INFO and CONFIG_INIT_STACKS)",
+            stats.client_stack_size);
+    }
+
+    shell_print(sh, "  Clients: %u active, %u peak", active, peak);
+    shell_print(sh, "  Heap: %u bytes in use, %u peak (%u per context)",
+        stats.heap_in_use, stats.heap_peak, stats.context_size);
+    if (stats.static_bytes)
+    {
+        shell_print(sh, "  Static sessions: %u bytes", stats.static_bytes);
+    }
+
+    return 0;
+}
+
+#if defined(CONFIG_DANP_FTP_SERVICE_PROFILER)
+/**
+ * @brief Print min/avg/max and the non-empty histogram buckets of each stage.
+ */
+static void danp_ftp_test_print_profile(
+    const struct shell *sh,
+    const char *title,
+    const danp_ftp_service_profile_t *profile)
+{
+    static const char *const stage_names[DANP_FTP_SERVICE_PROF_STAGE_COUNT] = {
+        "fs_read", "fs_write", "crc", "send", "recv", "ack_wait",
+    };
+    const danp_ftp_service_prof_stat_t *stat;
+    uint32_t avg_ns;
+
+    shell_print(sh, "=== %s (%u sessions) ===", title, profile->sessions);
+    shell_print(sh, "  %-8s %8s %10s %10s %10s", "stage", "count", "min us", "avg us", "max us");
+
+    for (uint32_t stage = 0; stage < DANP_FTP_SERVICE_PROF_STAGE_COUNT; stage++)
+    {
+        stat = &profile->stages[stage];
+        if (stat->count == 0)
+        {
+            continue;
+        }
+
+        avg_ns = (uint32_t)(stat->total_ns / stat->count);
+        shell_print(sh, "  %-8s %8u %6u.%03u %6u.%03u %6u.%03u",
+            stage_names[stage],
+            stat->count,
+            stat->min_ns / 1000U, stat->min_ns % 1000U,
+            avg_ns / 1000U, avg_ns % 1000U,
+            stat->max_ns / 1000U, stat->max_ns % 1000U);
+
+        for (uint32_t bucket = 0; bucket < DANP_FTP_SERVICE_PROF_BUCKETS; bucket++)
+        {
+            if (stat->histogram[bucket] == 0)
+            {
+                continue;
+            }
+
+            if (bucket == 0)
+            {
+                shell_print(sh, "           < 1 us: %u", stat->histogram[bucket]);
+            }
+            else if (bucket == DANP_FTP_SERVICE_PROF_BUCKETS - 1)
+            {
+                shell_print(sh, "           >= %u us: %u", 1U << (bucket - 1), stat->histogram[bucket]);
+            }
+            else
+            {
+                shell_print(sh, "           %u-%u us: %u",
+                    1U << (bucket - 1), (1U << bucket) - 1U, stat->histogram[bucket]);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Dump or clear the FTP service stage profile.
+ */
+static int cmd_ftp_svc_prof(const struct shell *sh, size_t argc, char **argv)
+{
+    static danp_ftp_service_profile_t total;
+    static danp_ftp_service_profile_t last;
+
+    if (argc > 1)
+    {
+        if (strcmp(argv[1], "reset") != 0)
+        {
+            shell_error(sh, "Unknown argument: %s", argv[1]);
+            return -1;
+        }
+
+        danp_ftp_service_reset_profile();
+        shell_print(sh, "FTP service profile cleared");
+        return 0;
+    }
+
+    if (danp_ftp_service_get_profile(&total, &last) < 0)
+    {
+        shell_error(sh, "FTP service not initialized");
+        return -1;
+    }
+
+    danp_ftp_test_print_profile(sh, "FTP Service Profile", &total);
+    danp_ftp_test_print_profile(sh, "Last Session", &last);
+
+    return 0;
+}
+#endif
+
 /* Shell Command Registration */
 
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_ftp_svc_cmds,
+    SHELL_CMD_ARG(rate, NULL,
+        "Show or set service transmit rate limits\n"
+        "Usage: ftp svc rate [global_bps] [session_bps]\n"
+        "  0 disables a limit",
+        cmd_ftp_svc_rate, 1, 2),
+    SHELL_CMD(mem, NULL,
+        "Show stack high-water marks and heap usage of the service",
+        cmd_ftp_svc_mem),
+#if defined(CONFIG_DANP_FTP_SERVICE_PROFILER)
+    SHELL_CMD_ARG(prof, NULL,
+        "Show per-stage timings of the transfer loops\n"
+        "Usage: ftp svc prof [reset]",
+        cmd_ftp_svc_prof, 1, 1),
+#endif
+    SHELL_SUBCMD_SET_END
+);
+
 SHELL_STATIC_SUBCMD_SET_CREATE(sub_ftp_cmds,
     SHELL_CMD_ARG(init, NULL,
         "Initialize FTP connection\n"
@@ -946,7 +1738,7 @@ SHELL_STATIC_SUBCMD_SET_CREATE(sub_ftp_cmds,
     SHELL_CMD_ARG(config, NULL,
         "Configure test parameters\n"
         "Usage: ftp config [param] [value]\n"
-        "  param: node, chunk, timeout, retries",
+        "  param: node, chunk, timeout, retries, skip",
         cmd_ftp_config, 1, 2),
     SHELL_CMD_ARG(generate, NULL,
         "Generate test pattern\n"
@@ -969,17 +1761,44 @@ SHELL_STATIC_SUBCMD_SET_CREATE(sub_ftp_cmds,
         "Run full loopback test (TX then RX)\n"
         "Usage: ftp loopback [size] [seed]",
         cmd_ftp_loopback, 1, 2),
+    SHELL_CMD_ARG(bench, NULL,
+        "Silent TX/RX benchmark with parameter sweeps\n"
+        "Usage: ftp bench [iterations] [sizes] [chunk_sizes] [retries]\n"
+        "  Lists are comma separated, e.g. ftp bench 5 1024,4096 32,64,128 0,3\n"
+        "  Defaults: 3 iterations, 1024 bytes, configured chunk size and retries",
+        cmd_ftp_bench, 1, 4),
     SHELL_CMD_ARG(dump, NULL,
-        "Dump buffer contents\n"
-        "Usage: ftp dump [tx|rx] [offset] [length]",
+        "Dump the TX pattern\n"
+        "Usage: ftp dump [tx] [offset] [length]",
         cmd_ftp_dump, 1, 3),
     SHELL_CMD(status, NULL,
         "Show test status and statistics",
         cmd_ftp_status),
+    SHELL_CMD_ARG(stat, NULL,
+        "Query size and CRC32 of a remote file\n"
+        "Usage: ftp stat [file_id]",
+        cmd_ftp_stat, 1, 1),
+    SHELL_CMD_ARG(tail, NULL,
+        "Print the last bytes of a remote file\n"
+        "Usage: ftp tail [file_id] [bytes]\n"
+        "  bytes: Bytes from the end of the file (default: 64)",
+        cmd_ftp_tail, 1, 2),
+    SHELL_CMD_ARG(sync, NULL,
+        "Differential sync of the TX pattern to a remote file\n"
+        "Usage: ftp sync [file_id] [block_size]",
+        cmd_ftp_sync, 1, 2),
+    SHELL_CMD_ARG(mcast, NULL,
+        "Distribute the TX pattern to a group with NACK repair\n"
+        "Usage: ftp mcast <local_node> <group_node> [receivers]\n"
+        "  receivers: Completions to wait for, 0 stops after a round without NACKs",
+        cmd_ftp_mcast, 3, 1),
     SHELL_CMD_ARG(crc, NULL,
         "Calculate CRC32 of hex data\n"
         "Usage: ftp crc <hex_data>",
         cmd_ftp_crc, 2, 0),
+    SHELL_CMD(svc, &sub_ftp_svc_cmds,
+        "FTP service commands",
+        NULL),
     SHELL_SUBCMD_SET_END
 );
 
@@ -0,0 +1,232 @@
+/* test_danp_bench_service.c - Echo, discard and chargen tests over the loopback transport */
+
+/* All Rights Reserved */
+
+/* Includes */
+
+#include <string.h>
+#include "danp/danp.h"
+#include "danp/services/danp_bench_service.h"
+#include "danp_loopback.h"
+#include "danp_port.h"
+#include "unity.h"
+
+/* Imports */
+
+
+/* Definitions */
+
+#define TEST_LOCAL_NODE                       (1)
+#define TEST_ECHO_PORT                        (7)
+#define TEST_DISCARD_PORT                     (9)
+#define TEST_CHARGEN_PORT                     (19)
+#define TEST_TIMEOUT_MS                       (500)
+#define TEST_PACKET_COUNT                     (4)
+#define TEST_REPLY_PORT                       (30)
+
+/* Types */
+
+
+/* Forward Declarations */
+
+
+/* Variables */
+
+static danp_socket_t *test_socket;
+
+/* Functions */
+
+static void test_connect(uint16_t port)
+{
+    test_socket = danp_socket(DANP_TYPE_STREAM);
+    TEST_ASSERT_NOT_NULL(test_socket);
+    TEST_ASSERT_EQUAL_INT32(0, danp_connect(test_socket, TEST_LOCAL_NODE, port));
+}
+
+static void test_wait_for_close(danp_bench_service_kind_t kind, danp_bench_service_stats_t *stats)
+{
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        TEST_ASSERT_EQUAL_INT32(0, danp_bench_service_get_stats(kind, stats));
+        if (stats->connections > 0 && stats->active == 0)
+        {
+            return;
+        }
+        danp_port_sleep_ms(5);
+    }
+}
+
+static void test_wait_for_datagrams(uint32_t count, danp_bench_service_stats_t *stats)
+{
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        TEST_ASSERT_EQUAL_INT32(0, danp_bench_service_get_stats(DANP_BENCH_SERVICE_ECHO, stats));
+        if (stats->datagrams >= count)
+        {
+            return;
+        }
+        danp_port_sleep_ms(5);
+    }
+}
+
+void setUp(void)
+{
+    test_socket = NULL;
+}
+
+void tearDown(void)
+{
+    if (test_socket)
+    {
+        danp_close(test_socket);
+    }
+}
+
+void test_echo_should_returnEveryPacket(void)
+{
+    uint8_t tx[DANP_MAX_PACKET_SIZE];
+    uint8_t rx[DANP_MAX_PACKET_SIZE];
+    danp_bench_service_stats_t stats;
+
+    test_connect(TEST_ECHO_PORT);
+
+    for (uint32_t i = 0; i < TEST_PACKET_COUNT; i++)
+    {
+        memset(tx, (int)(0x30 + i), sizeof(tx));
+        TEST_ASSERT_EQUAL_INT32(sizeof(tx), danp_send(test_socket, tx, sizeof(tx)));
+        TEST_ASSERT_EQUAL_INT32(sizeof(rx), danp_recv(test_socket, rx, sizeof(rx), TEST_TIMEOUT_MS));
+        TEST_ASSERT_EQUAL_MEMORY(tx, rx, sizeof(tx));
+    }
+
+    danp_close(test_socket);
+    test_socket = NULL;
+
+    test_wait_for_close(DANP_BENCH_SERVICE_ECHO, &stats);
+    TEST_ASSERT_EQUAL_UINT32(TEST_ECHO_PORT, stats.port);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.active);
+    TEST_ASSERT_EQUAL_UINT32(TEST_PACKET_COUNT * DANP_MAX_PACKET_SIZE, (uint32_t)stats.rx_bytes);
+    TEST_ASSERT_EQUAL_UINT32(TEST_PACKET_COUNT * DANP_MAX_PACKET_SIZE, (uint32_t)stats.tx_bytes);
+}
+
+void test_discard_should_countWithoutReplying(void)
+{
+    uint8_t tx[DANP_MAX_PACKET_SIZE];
+    danp_bench_service_stats_t stats;
+
+    memset(tx, 0x5A, sizeof(tx));
+    test_connect(TEST_DISCARD_PORT);
+
+    for (uint32_t i = 0; i < TEST_PACKET_COUNT; i++)
+    {
+        TEST_ASSERT_EQUAL_INT32(sizeof(tx), danp_send(test_socket, tx, sizeof(tx)));
+    }
+    TEST_ASSERT_TRUE(danp_port_recv_timed_out(danp_recv(test_socket, tx, sizeof(tx), 50)));
+
+    danp_close(test_socket);
+    test_socket = NULL;
+
+    test_wait_for_close(DANP_BENCH_SERVICE_DISCARD, &stats);
+    TEST_ASSERT_EQUAL_UINT32(TEST_PACKET_COUNT * DANP_MAX_PACKET_SIZE, (uint32_t)stats.rx_bytes);
+    TEST_ASSERT_EQUAL_UINT32(0, (uint32_t)stats.tx_bytes);
+}
+
+void test_chargen_should_streamPrintablePattern(void)
+{
+    uint8_t rx[DANP_MAX_PACKET_SIZE];
+    uint8_t expected = ' ';
+    danp_bench_service_stats_t stats;
+
+    test_connect(TEST_CHARGEN_PORT);
+
+    for (uint32_t i = 0; i < TEST_PACKET_COUNT; i++)
+    {
+        TEST_ASSERT_EQUAL_INT32(sizeof(rx), danp_recv(test_socket, rx, sizeof(rx), TEST_TIMEOUT_MS));
+        for (uint32_t j = 0; j < sizeof(rx); j++)
+        {
+            TEST_ASSERT_EQUAL_UINT8(expected, rx[j]);
+            expected = (expected == '~') ? ' ' : (uint8_t)(expected + 1);
+        }
+    }
+
+    danp_close(test_socket);
+    test_socket = NULL;
+
+    test_wait_for_close(DANP_BENCH_SERVICE_CHARGEN, &stats);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.active);
+    TEST_ASSERT_TRUE(stats.tx_bytes >= TEST_PACKET_COUNT * DANP_MAX_PACKET_SIZE);
+}
+
+static int32_t test_dgram_echo(uint8_t magic)
+{
+    uint8_t tx[DANP_BENCH_DGRAM_ECHO_HEADER_SIZE + 4] = {
+        TEST_LOCAL_NODE, 0, TEST_REPLY_PORT, 0, magic, 0x11, 0x22, 0x33,
+    };
+    uint8_t rx[sizeof(tx)];
+    danp_socket_t *reply;
+    int32_t length;
+
+    reply = danp_socket(DANP_TYPE_DGRAM);
+    TEST_ASSERT_NOT_NULL(reply);
+    TEST_ASSERT_EQUAL_INT32(0, danp_bind(reply, TEST_REPLY_PORT));
+
+    test_socket = danp_socket(DANP_TYPE_DGRAM);
+    TEST_ASSERT_NOT_NULL(test_socket);
+    TEST_ASSERT_EQUAL_INT32(0, danp_connect(test_socket, TEST_LOCAL_NODE, TEST_ECHO_PORT));
+    TEST_ASSERT_EQUAL_INT32(sizeof(tx), danp_send(test_socket, tx, sizeof(tx)));
+
+    length = danp_recv(reply, rx, sizeof(rx), TEST_TIMEOUT_MS);
+    if (length == (int32_t)sizeof(tx))
+    {
+        TEST_ASSERT_EQUAL_MEMORY(tx, rx, sizeof(tx));
+    }
+    danp_close(reply);
+
+    return length;
+}
+
+void test_dgramEcho_should_answerToNamedPort(void)
+{
+    danp_bench_service_stats_t before;
+    danp_bench_service_stats_t after;
+
+    TEST_ASSERT_EQUAL_INT32(0, danp_bench_service_get_stats(DANP_BENCH_SERVICE_ECHO, &before));
+    TEST_ASSERT_EQUAL_INT32(DANP_BENCH_DGRAM_ECHO_HEADER_SIZE + 4, test_dgram_echo(DANP_BENCH_DGRAM_ECHO_MAGIC));
+    /* The echo thread counts the datagram after sending the reply. */
+    test_wait_for_datagrams(before.datagrams + 1, &after);
+    TEST_ASSERT_EQUAL_UINT32(before.datagrams + 1, after.datagrams);
+}
+
+void test_dgramEcho_should_dropWithoutMagic(void)
+{
+    danp_bench_service_stats_t before;
+    danp_bench_service_stats_t after;
+
+    TEST_ASSERT_EQUAL_INT32(0, danp_bench_service_get_stats(DANP_BENCH_SERVICE_ECHO, &before));
+    TEST_ASSERT_TRUE(danp_port_recv_timed_out(test_dgram_echo((uint8_t)~DANP_BENCH_DGRAM_ECHO_MAGIC)));
+    TEST_ASSERT_EQUAL_INT32(0, danp_bench_service_get_stats(DANP_BENCH_SERVICE_ECHO, &after));
+    TEST_ASSERT_EQUAL_UINT32(before.datagrams, after.datagrams);
+}
+
+int main(void)
+{
+    danp_bench_service_config_t config = {
+        .echo_port = TEST_ECHO_PORT,
+        .discard_port = TEST_DISCARD_PORT,
+        .chargen_port = TEST_CHARGEN_PORT,
+    };
+
+    danp_loopback_init(TEST_LOCAL_NODE);
+
+    if (danp_bench_service_init(&config) != 0)
+    {
+        return 1;
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_echo_should_returnEveryPacket);
+    RUN_TEST(test_discard_should_countWithoutReplying);
+    RUN_TEST(test_chargen_should_streamPrintablePattern);
+    RUN_TEST(test_dgramEcho_should_answerToNamedPort);
+    RUN_TEST(test_dgramEcho_should_dropWithoutMagic);
+    return UNITY_END();
+}
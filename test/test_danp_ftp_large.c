@@ -0,0 +1,475 @@
+/* test_danp_ftp_large.c - FTP service tests on a synthetic multi-gigabyte file */
+
+/* All Rights Reserved */
+
+/* Includes */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "danp/services/danp_ftp_service.h"
+#include "danp/services/danp_ftp_service_client.h"
+#include "danp_loopback.h"
+#include "danp_port.h"
+#include "unity.h"
+
+/* Imports */
+
+
+/* Definitions */
+
+#define TEST_LOCAL_NODE                       (1)
+#define TEST_TIMEOUT_MS                       (500)
+#define TEST_FILE_NAME                        "disk.img"
+#define TEST_GIB                              ((uint64_t)1 << 30)
+#define TEST_FILE_SIZE                        (6 * TEST_GIB)
+#define TEST_FILE_CRC                         (0x5EEDF11EU)
+/* More chunks than 16-bit sequence numbers, whatever the payload size */
+#define TEST_WRAP_SIZE                        (70000U * DANP_MAX_PACKET_SIZE)
+/* Between 2 and 4 GiB, so ranges start past INT32_MAX while the size fits u32 */
+#define TEST_SPLIT_FILE_NAME                  "split.img"
+#define TEST_SPLIT_FILE_SIZE                  (3 * TEST_GIB)
+#define TEST_SPLIT_SESSIONS                   (4)
+/* Bytes each open of the split file serves before reporting EOF */
+#define TEST_SPLIT_RUN                        (8U * DANP_MAX_PACKET_SIZE)
+
+/* Types */
+
+typedef struct test_file_s
+{
+    size_t written;                              /* Bytes written to the file that matched the pattern */
+    uint32_t mismatches;                         /* Bytes written that did not */
+    size_t prepare_offset;
+    size_t prepare_size;
+} test_file_t;
+
+typedef struct test_sink_s
+{
+    size_t start;                                /* Offset of the first byte */
+    size_t next;                                 /* Offset expected next */
+    uint32_t mismatches;                         /* Bytes out of place or not matching the pattern */
+} test_sink_t;
+
+typedef struct test_run_s
+{
+    bool used;
+    bool started;
+    size_t end;                                  /* EOF of this open, TEST_SPLIT_RUN past the first read */
+} test_run_t;
+
+typedef struct test_spread_s
+{
+    size_t received;                             /* Bytes delivered to the sink */
+    size_t highest;                              /* Highest offset delivered */
+    uint32_t mismatches;                         /* Bytes not matching the pattern */
+} test_spread_t;
+
+/* Forward Declarations */
+
+
+/* Variables */
+
+static test_file_t test_file;
+static test_sink_t test_sink;
+static test_run_t test_runs[TEST_SPLIT_SESSIONS + 1];
+static test_spread_t test_spread;
+DANP_PORT_MUTEX_DEFINE(test_run_lock);
+
+/* Functions */
+
+/**
+ * @brief Byte of the synthetic file at an offset, depends on the bits above 4 GiB too.
+ */
+static uint8_t test_pattern(uint64_t offset)
+{
+    return (uint8_t)(offset ^ (offset >> 11) ^ ((offset >> 32) * 29U));
+}
+
+static danp_ftp_status_t test_fs_open(
+    danp_ftp_file_handle_t *file_handle,
+    const uint8_t *file_id,
+    size_t file_id_len,
+    danp_ftp_service_fs_mode_t mode,
+    void *user_data)
+{
+    danp_ftp_status_t status = DANP_FTP_STATUS_FILE_NOT_FOUND;
+
+    (void)mode;
+    (void)user_data;
+
+    if (file_id_len == strlen(TEST_FILE_NAME) && memcmp(file_id, TEST_FILE_NAME, file_id_len) == 0)
+    {
+        *file_handle = (danp_ftp_file_handle_t)&test_file;
+        status = DANP_FTP_STATUS_OK;
+    }
+    else if (file_id_len == strlen(TEST_SPLIT_FILE_NAME) &&
+             memcmp(file_id, TEST_SPLIT_FILE_NAME, file_id_len) == 0)
+    {
+        /* Every session gets its own short run of the file, wherever it starts */
+        danp_port_mutex_lock(&test_run_lock);
+        for (size_t i = 0; i < sizeof(test_runs) / sizeof(test_runs[0]); i++)
+        {
+            if (!test_runs[i].used)
+            {
+                test_runs[i].used = true;
+                test_runs[i].started = false;
+                *file_handle = (danp_ftp_file_handle_t)&test_runs[i];
+                status = DANP_FTP_STATUS_OK;
+                break;
+            }
+        }
+        danp_port_mutex_unlock(&test_run_lock);
+    }
+
+    return status;
+}
+
+static bool test_is_run(danp_ftp_file_handle_t file_handle)
+{
+    return file_handle != (danp_ftp_file_handle_t)&test_file;
+}
+
+static danp_ftp_status_t test_fs_close(danp_ftp_file_handle_t file_handle, void *user_data)
+{
+    (void)user_data;
+
+    if (test_is_run(file_handle))
+    {
+        danp_port_mutex_lock(&test_run_lock);
+        ((test_run_t *)file_handle)->used = false;
+        danp_port_mutex_unlock(&test_run_lock);
+    }
+
+    return DANP_FTP_STATUS_OK;
+}
+
+static danp_ftp_status_t test_fs_read(
+    danp_ftp_file_handle_t file_handle,
+    size_t offset,
+    uint8_t *buffer,
+    uint16_t length,
+    void *user_data)
+{
+    test_run_t *run = test_is_run(file_handle) ? (test_run_t *)file_handle : NULL;
+    size_t available = (offset < TEST_FILE_SIZE) ? (size_t)(TEST_FILE_SIZE - offset) : 0;
+    size_t copy;
+
+    (void)user_data;
+
+    if (run)
+    {
+        if (!run->started)
+        {
+            run->started = true;
+            run->end = offset + TEST_SPLIT_RUN;
+        }
+        available = (offset < run->end) ? run->end - offset : 0;
+    }
+    copy = (available < length) ? available : length;
+
+    for (size_t i = 0; i < copy; i++)
+    {
+        buffer[i] = test_pattern(offset + i);
+    }
+
+    return (danp_ftp_status_t)copy;
+}
+
+static danp_ftp_status_t test_fs_write(
+    danp_ftp_file_handle_t file_handle,
+    size_t offset,
+    const uint8_t *data,
+    uint16_t length,
+    void *user_data)
+{
+    test_file_t *file = (test_file_t *)file_handle;
+
+    (void)user_data;
+
+    for (uint16_t i = 0; i < length; i++)
+    {
+        if (data[i] == test_pattern(offset + i))
+        {
+            file->written++;
+        }
+        else
+        {
+            file->mismatches++;
+        }
+    }
+
+    return (danp_ftp_status_t)length;
+}
+
+static danp_ftp_status_t test_fs_digest(
+    danp_ftp_file_handle_t file_handle,
+    size_t *size,
+    uint32_t *crc,
+    void *user_data)
+{
+    (void)user_data;
+
+    /* Streaming gigabytes through CRC32 would dominate the test */
+    *size = test_is_run(file_handle) ? (size_t)TEST_SPLIT_FILE_SIZE : (size_t)TEST_FILE_SIZE;
+    *crc = TEST_FILE_CRC;
+
+    return DANP_FTP_STATUS_OK;
+}
+
+static danp_ftp_status_t test_fs_prepare(
+    danp_ftp_file_handle_t file_handle,
+    size_t offset,
+    size_t size,
+    void *user_data)
+{
+    test_file_t *file = (test_file_t *)file_handle;
+
+    (void)user_data;
+
+    file->prepare_offset = offset;
+    file->prepare_size = size;
+
+    return DANP_FTP_STATUS_OK;
+}
+
+static danp_ftp_status_t test_source_cb(size_t offset, uint8_t *buffer, uint16_t length, void *user_data)
+{
+    (void)user_data;
+
+    for (uint16_t i = 0; i < length; i++)
+    {
+        buffer[i] = test_pattern(offset + i);
+    }
+
+    return (danp_ftp_status_t)length;
+}
+
+static danp_ftp_status_t test_sink_cb(size_t offset, const uint8_t *data, uint16_t length, void *user_data)
+{
+    test_sink_t *sink = (test_sink_t *)user_data;
+
+    if (offset != sink->next)
+    {
+        sink->mismatches++;
+    }
+
+    for (uint16_t i = 0; i < length; i++)
+    {
+        if (data[i] != test_pattern(offset + i))
+        {
+            sink->mismatches++;
+        }
+    }
+    sink->next = offset + length;
+
+    return (danp_ftp_status_t)length;
+}
+
+static danp_ftp_status_t test_spread_cb(size_t offset, const uint8_t *data, uint16_t length, void *user_data)
+{
+    test_spread_t *spread = (test_spread_t *)user_data;
+
+    for (uint16_t i = 0; i < length; i++)
+    {
+        if (data[i] != test_pattern(offset + i))
+        {
+            spread->mismatches++;
+        }
+    }
+    spread->received += length;
+    if (offset > spread->highest)
+    {
+        spread->highest = offset;
+    }
+
+    return (danp_ftp_status_t)length;
+}
+
+static void test_sink_expect(size_t start)
+{
+    test_sink.start = start;
+    test_sink.next = start;
+    test_sink.mismatches = 0;
+}
+
+void setUp(void)
+{
+    memset(&test_file, 0, sizeof(test_file));
+    memset(&test_sink, 0, sizeof(test_sink));
+    memset(&test_spread, 0, sizeof(test_spread));
+}
+
+void tearDown(void)
+{
+}
+
+void test_stat_should_reportSizePast4GiB(void)
+{
+    danp_ftp_service_file_info_t info;
+
+    TEST_ASSERT_EQUAL_INT32(DANP_FTP_STATUS_OK, danp_ftp_service_client_stat(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        &info,
+        TEST_TIMEOUT_MS));
+    TEST_ASSERT_TRUE((uint64_t)info.size == TEST_FILE_SIZE);
+    TEST_ASSERT_EQUAL_HEX32(TEST_FILE_CRC, info.crc);
+}
+
+void test_readTail_should_startPast4GiB(void)
+{
+    danp_ftp_service_read_options_t options;
+    danp_ftp_service_read_stats_t stats;
+    danp_ftp_status_t status;
+
+    /* A from-end offset goes out in u64 fields, which also echo the start */
+    memset(&options, 0, sizeof(options));
+    options.offset = -5000;
+    test_sink_expect((size_t)(TEST_FILE_SIZE - 5000));
+
+    status = danp_ftp_service_client_read_ex(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        &options,
+        test_sink_cb,
+        &test_sink,
+        &stats,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(5000, status);
+    TEST_ASSERT_TRUE((uint64_t)stats.offset == TEST_FILE_SIZE - 5000);
+    TEST_ASSERT_TRUE((uint64_t)test_sink.next == TEST_FILE_SIZE);
+    TEST_ASSERT_EQUAL_UINT32(0, test_sink.mismatches);
+}
+
+void test_readRange_should_crossSequenceWrap(void)
+{
+    danp_ftp_service_read_options_t options;
+    danp_ftp_service_read_stats_t stats;
+    danp_ftp_status_t status;
+
+    memset(&options, 0, sizeof(options));
+    options.offset = (int64_t)(5 * TEST_GIB + 7);
+    options.length = TEST_WRAP_SIZE;
+    test_sink_expect((size_t)options.offset);
+
+    status = danp_ftp_service_client_read_ex(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        &options,
+        test_sink_cb,
+        &test_sink,
+        &stats,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(TEST_WRAP_SIZE, status);
+    TEST_ASSERT_TRUE((uint64_t)stats.offset == 5 * TEST_GIB + 7);
+    TEST_ASSERT_TRUE(test_sink.next - test_sink.start == TEST_WRAP_SIZE);
+    TEST_ASSERT_EQUAL_UINT32(0, test_sink.mismatches);
+}
+
+void test_readParallel_should_startRangesPast2GiB(void)
+{
+    danp_ftp_status_t status;
+
+    /* The last of four ranges of a 3 GiB file starts near 2.25 GiB */
+    status = danp_ftp_service_client_read_parallel(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_SPLIT_FILE_NAME,
+        strlen(TEST_SPLIT_FILE_NAME),
+        TEST_SPLIT_SESSIONS,
+        test_spread_cb,
+        &test_spread,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(TEST_SPLIT_SESSIONS * TEST_SPLIT_RUN, status);
+    TEST_ASSERT_EQUAL_size_t(TEST_SPLIT_SESSIONS * TEST_SPLIT_RUN, test_spread.received);
+    TEST_ASSERT_TRUE(test_spread.highest > INT32_MAX);
+    TEST_ASSERT_EQUAL_UINT32(0, test_spread.mismatches);
+}
+
+void test_writeRange_should_crossSequenceWrapPast4GiB(void)
+{
+    size_t offset = (size_t)(4 * TEST_GIB + 100);
+    danp_ftp_status_t status;
+
+    status = danp_ftp_service_client_write_range(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        offset,
+        TEST_WRAP_SIZE,
+        test_source_cb,
+        NULL,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(TEST_WRAP_SIZE, status);
+    TEST_ASSERT_TRUE(test_file.prepare_offset == offset);
+    TEST_ASSERT_EQUAL_size_t(TEST_WRAP_SIZE, test_file.prepare_size);
+    TEST_ASSERT_EQUAL_size_t(TEST_WRAP_SIZE, test_file.written);
+    TEST_ASSERT_EQUAL_UINT32(0, test_file.mismatches);
+}
+
+void test_sync_should_rejectFilesPast4GiB(void)
+{
+    danp_ftp_service_sync_stats_t stats;
+
+    /* Refused by the client for the local size, by the service for its copy */
+    TEST_ASSERT_EQUAL_INT32(DANP_FTP_STATUS_INVALID_PARAM, danp_ftp_service_client_sync(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        (size_t)TEST_FILE_SIZE,
+        0,
+        test_source_cb,
+        NULL,
+        &stats,
+        TEST_TIMEOUT_MS));
+    TEST_ASSERT_TRUE(danp_ftp_service_client_sync(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        1000,
+        0,
+        test_source_cb,
+        NULL,
+        &stats,
+        TEST_TIMEOUT_MS) < 0);
+    TEST_ASSERT_EQUAL_size_t(0, test_file.written);
+    TEST_ASSERT_EQUAL_UINT32(0, test_file.mismatches);
+}
+
+int main(void)
+{
+    danp_ftp_service_config_t config;
+
+    danp_loopback_init(TEST_LOCAL_NODE);
+
+    memset(&config, 0, sizeof(config));
+    config.fs.open = test_fs_open;
+    config.fs.close = test_fs_close;
+    config.fs.read = test_fs_read;
+    config.fs.write = test_fs_write;
+    config.fs.digest = test_fs_digest;
+    config.fs.prepare = test_fs_prepare;
+
+    if (danp_ftp_service_init(&config) != 0)
+    {
+        return 1;
+    }
+
+    UNITY_BEGIN();
+    /* A 32-bit size_t cannot address the file */
+#if SIZE_MAX > UINT32_MAX
+    RUN_TEST(test_stat_should_reportSizePast4GiB);
+    RUN_TEST(test_readTail_should_startPast4GiB);
+    RUN_TEST(test_readRange_should_crossSequenceWrap);
+    RUN_TEST(test_readParallel_should_startRangesPast2GiB);
+    RUN_TEST(test_writeRange_should_crossSequenceWrapPast4GiB);
+    RUN_TEST(test_sync_should_rejectFilesPast4GiB);
+#endif
+    return UNITY_END();
+}
@@ -0,0 +1,265 @@
+/* test_danp_ftp_mcast.c - Group file distribution tests over the loopback transport */
+
+/* All Rights Reserved */
+
+/* Includes */
+
+#include <pthread.h>
+#include <string.h>
+#include "danp/services/danp_ftp_mcast.h"
+#include "danp_loopback.h"
+#include "danp_port.h"
+#include "unity.h"
+
+/* Imports */
+
+
+/* Definitions */
+
+#define TEST_LOCAL_NODE                       (1)
+#define TEST_RECEIVER_NODE                    (2)
+#define TEST_GROUP_NODE                       (0xFF)
+#define TEST_SESSION_ID                       (0x44)
+#define TEST_FILE_SIZE                        (5000)
+#define TEST_TIMEOUT_MS                       (2000)
+#define TEST_MAX_RECEIVERS                    (3)
+#define TEST_IDLE_TIMEOUT_MS                  (200)
+#define TEST_NOISE_PORT                       (40)
+
+/* Types */
+
+typedef struct test_buffer_s
+{
+    uint8_t data[TEST_FILE_SIZE];
+    size_t size;
+} test_buffer_t;
+
+typedef struct test_receiver_s
+{
+    pthread_t thread;
+    test_buffer_t sink;
+    danp_ftp_mcast_config_t config;
+    danp_ftp_mcast_stats_t stats;
+    uint32_t timeout_ms;
+    danp_ftp_status_t status;
+    volatile bool done;
+} test_receiver_t;
+
+/* Forward Declarations */
+
+
+/* Variables */
+
+static test_buffer_t test_source;
+static test_receiver_t test_receivers[TEST_MAX_RECEIVERS];
+
+/* Functions */
+
+static danp_ftp_status_t test_source_cb(size_t offset, uint8_t *buffer, uint16_t length, void *user_data)
+{
+    test_buffer_t *source = (test_buffer_t *)user_data;
+    size_t available = (offset < source->size) ? source->size - offset : 0;
+    size_t copy = (available < length) ? available : length;
+
+    memcpy(buffer, &source->data[offset], copy);
+
+    return (danp_ftp_status_t)copy;
+}
+
+static danp_ftp_status_t test_sink_cb(size_t offset, const uint8_t *data, uint16_t length, void *user_data)
+{
+    test_buffer_t *sink = (test_buffer_t *)user_data;
+
+    if (offset + length > sizeof(sink->data))
+    {
+        return DANP_FTP_STATUS_ERROR;
+    }
+
+    memcpy(&sink->data[offset], data, length);
+    if (offset + length > sink->size)
+    {
+        sink->size = offset + length;
+    }
+
+    return (danp_ftp_status_t)length;
+}
+
+static void *test_receiver_thread(void *arg)
+{
+    test_receiver_t *receiver = (test_receiver_t *)arg;
+
+    /* Each receiver is a node of its own with its own group socket */
+    danp_loopback_set_thread_node(receiver->config.local_node);
+
+    receiver->status = danp_ftp_mcast_receive(
+        &receiver->config,
+        test_sink_cb,
+        &receiver->sink,
+        &receiver->stats,
+        receiver->timeout_ms);
+    receiver->done = true;
+
+    return NULL;
+}
+
+static danp_ftp_status_t test_distribute(uint16_t receivers, danp_ftp_mcast_stats_t *stats)
+{
+    danp_ftp_mcast_config_t config = {
+        .local_node = TEST_LOCAL_NODE,
+        .group_node = TEST_GROUP_NODE,
+        .session_id = TEST_SESSION_ID,
+        .receivers = receivers,
+        .round_ms = 50,
+    };
+    danp_ftp_status_t status;
+
+    for (uint16_t i = 0; i < receivers; i++)
+    {
+        test_receivers[i].config.local_node = (uint16_t)(TEST_RECEIVER_NODE + i);
+        test_receivers[i].timeout_ms = TEST_TIMEOUT_MS;
+        pthread_create(&test_receivers[i].thread, NULL, test_receiver_thread, &test_receivers[i]);
+    }
+
+    /* Let the receivers bind the group port before the first announcement */
+    danp_port_sleep_ms(20);
+
+    status = danp_ftp_mcast_send(&config, test_source.size, test_source_cb, &test_source, stats);
+
+    for (uint16_t i = 0; i < receivers; i++)
+    {
+        pthread_join(test_receivers[i].thread, NULL);
+    }
+
+    return status;
+}
+
+void setUp(void)
+{
+    for (size_t i = 0; i < TEST_FILE_SIZE; i++)
+    {
+        test_source.data[i] = (uint8_t)(i * 13U + 1U);
+    }
+    test_source.size = TEST_FILE_SIZE;
+    memset(test_receivers, 0, sizeof(test_receivers));
+    danp_loopback_set_impairment(NULL);
+}
+
+void tearDown(void)
+{
+    danp_loopback_set_impairment(NULL);
+    for (uint16_t i = 0; i < TEST_MAX_RECEIVERS; i++)
+    {
+        danp_loopback_set_node_impairment((uint16_t)(TEST_RECEIVER_NODE + i), NULL);
+    }
+}
+
+void test_mcast_should_deliverFileInOnePass(void)
+{
+    danp_ftp_mcast_stats_t stats;
+
+    TEST_ASSERT_EQUAL_INT32(1, test_distribute(1, &stats));
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, test_receivers[0].status);
+    TEST_ASSERT_EQUAL_MEMORY(test_source.data, test_receivers[0].sink.data, TEST_FILE_SIZE);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.rounds);
+    TEST_ASSERT_EQUAL_UINT32(stats.chunks, stats.data_packets);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.repairs);
+    TEST_ASSERT_EQUAL_UINT32(0, test_receivers[0].stats.nacks);
+}
+
+void test_mcast_should_repairLostChunks(void)
+{
+    danp_ftp_mcast_stats_t stats;
+    danp_loopback_impairment_t impairment;
+
+    memset(&impairment, 0, sizeof(impairment));
+    impairment.loss_ppm = 100000;
+    impairment.seed = 0x44U;
+    danp_loopback_set_impairment(&impairment);
+
+    TEST_ASSERT_EQUAL_INT32(1, test_distribute(1, &stats));
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, test_receivers[0].status);
+    TEST_ASSERT_EQUAL_MEMORY(test_source.data, test_receivers[0].sink.data, TEST_FILE_SIZE);
+    TEST_ASSERT_GREATER_THAN_UINT32(1, stats.rounds);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, stats.repairs);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, test_receivers[0].stats.nacks);
+    /* Only the lost chunks are sent again */
+    TEST_ASSERT_TRUE(stats.repairs < stats.chunks);
+}
+
+void test_mcast_should_repairUnionOfLossesAcrossReceivers(void)
+{
+    danp_ftp_mcast_stats_t stats;
+    danp_loopback_impairment_t impairment;
+
+    memset(&impairment, 0, sizeof(impairment));
+    impairment.loss_ppm = 100000;
+    for (uint16_t i = 0; i < TEST_MAX_RECEIVERS; i++)
+    {
+        impairment.seed = 0x51U + i * 0x1000U;
+        danp_loopback_set_node_impairment((uint16_t)(TEST_RECEIVER_NODE + i), &impairment);
+    }
+
+    TEST_ASSERT_EQUAL_INT32(TEST_MAX_RECEIVERS, test_distribute(TEST_MAX_RECEIVERS, &stats));
+    TEST_ASSERT_EQUAL_UINT32(TEST_MAX_RECEIVERS, stats.completed);
+    for (uint16_t i = 0; i < TEST_MAX_RECEIVERS; i++)
+    {
+        TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, test_receivers[i].status);
+        TEST_ASSERT_EQUAL_MEMORY(test_source.data, test_receivers[i].sink.data, TEST_FILE_SIZE);
+        TEST_ASSERT_GREATER_THAN_UINT32(0, test_receivers[i].stats.nacks);
+        /* Every member hears the same transmissions, minus its own losses */
+        TEST_ASSERT_TRUE(test_receivers[i].stats.data_packets <= stats.data_packets);
+    }
+
+    /* One pass plus the repaired union, not one copy per receiver */
+    TEST_ASSERT_EQUAL_UINT32(stats.chunks + stats.repairs, stats.data_packets);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, stats.repairs);
+    TEST_ASSERT_TRUE(stats.data_packets < TEST_MAX_RECEIVERS * stats.chunks);
+}
+
+void test_mcast_should_timeOut_whenOnlyNoiseArrives(void)
+{
+    test_receiver_t *receiver = &test_receivers[0];
+    uint8_t noise[4] = {0xDE, 0xAD, 0xBE, 0xEF};
+    danp_socket_t *socket;
+    uint32_t start_ms;
+    uint32_t elapsed_ms;
+
+    socket = danp_socket(DANP_TYPE_DGRAM);
+    TEST_ASSERT_NOT_NULL(socket);
+    TEST_ASSERT_EQUAL_INT32(0, danp_connect(socket, TEST_GROUP_NODE, TEST_NOISE_PORT));
+
+    receiver->config.local_node = TEST_RECEIVER_NODE;
+    receiver->config.data_port = TEST_NOISE_PORT;
+    receiver->config.session_id = TEST_SESSION_ID;
+    receiver->timeout_ms = TEST_IDLE_TIMEOUT_MS;
+
+    start_ms = danp_port_uptime_ms();
+    pthread_create(&receiver->thread, NULL, test_receiver_thread, receiver);
+    danp_port_sleep_ms(20);
+
+    /* Runt packets keep arriving, well within the timeout of each other */
+    while (!receiver->done && danp_port_uptime_ms() - start_ms < 10 * TEST_IDLE_TIMEOUT_MS)
+    {
+        danp_send(socket, noise, sizeof(noise));
+        danp_port_sleep_ms(5);
+    }
+    pthread_join(receiver->thread, NULL);
+    elapsed_ms = danp_port_uptime_ms() - start_ms;
+    danp_close(socket);
+
+    TEST_ASSERT_EQUAL_INT32(DANP_FTP_STATUS_TIMEOUT, receiver->status);
+    TEST_ASSERT_TRUE(elapsed_ms < 3 * TEST_IDLE_TIMEOUT_MS);
+}
+
+int main(void)
+{
+    danp_loopback_init(TEST_LOCAL_NODE);
+    danp_loopback_set_group_node(TEST_GROUP_NODE);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_mcast_should_deliverFileInOnePass);
+    RUN_TEST(test_mcast_should_repairLostChunks);
+    RUN_TEST(test_mcast_should_repairUnionOfLossesAcrossReceivers);
+    RUN_TEST(test_mcast_should_timeOut_whenOnlyNoiseArrives);
+    return UNITY_END();
+}
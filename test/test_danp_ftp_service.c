@@ -0,0 +1,1319 @@
+/* test_danp_ftp_service.c - FTP service tests over the loopback transport */
+
+/* All Rights Reserved */
+
+/* Includes */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "danp/services/danp_ftp_service.h"
+#include "danp/services/danp_ftp_service_client.h"
+#include "danp_loopback.h"
+#include "danp_port.h"
+#include "danp_ram_fs.h"
+#include "services/danp_ftp_service_int.h"
+#include "unity.h"
+
+/* Imports */
+
+
+/* Definitions */
+
+#define TEST_LOCAL_NODE                       (1)
+#define TEST_TIMEOUT_MS                       (500)
+#define TEST_FILE_NAME                        "test.bin"
+#define TEST_FILE_SIZE                        (3000)
+#define TEST_FEC_K                            (8)
+#define TEST_FEC_R                            (2)
+#define TEST_URGENT_NODE                      (7)
+#define TEST_BULK_NODE                        (8)
+#define TEST_URGENT_FILE_NAME                 "urgent.bin"
+#define TEST_SHARE_RATE_BPS                   (8000)
+#define TEST_SESSION_RATE_BPS                 (4000)
+#define TEST_LOSS_PPM                         (50000)
+#define TEST_LOSS_TIMEOUT_MS                  (10000)
+#define TEST_GIVE_UP_MS                       (5000)
+
+/* Types */
+
+typedef struct test_buffer_s
+{
+    uint8_t data[TEST_FILE_SIZE * 2];
+    size_t size;
+} test_buffer_t;
+
+typedef struct test_reader_s
+{
+    pthread_t thread;
+    uint16_t node;                               /* Mapped to a priority by the service */
+    const char *file_name;
+    test_buffer_t sink;
+    danp_ftp_status_t status;
+    uint32_t done_ms;
+} test_reader_t;
+
+typedef struct test_async_op_s
+{
+    danp_ftp_file_handle_t file_handle;
+    size_t offset;
+    uint8_t *buffer;                             /* NULL for a write */
+    const uint8_t *data;
+    uint16_t length;
+    danp_ftp_service_fs_op_t *op;
+    void *user_data;
+} test_async_op_t;
+
+/* Forward Declarations */
+
+
+/* Variables */
+
+static test_buffer_t test_local;
+static test_buffer_t test_remote;
+static const danp_ftp_service_priority_map_t test_priority_map[] = {
+    {TEST_URGENT_NODE, DANP_FTP_SERVICE_PRIORITY_URGENT},
+    {TEST_BULK_NODE, DANP_FTP_SERVICE_PRIORITY_BULK},
+};
+static danp_ftp_service_fs_prepare_cb_t test_fs_prepare;
+static size_t test_prepare_offset;
+static size_t test_prepare_size;
+static size_t test_prepare_limit;
+static uint32_t test_prepare_calls;
+static danp_ftp_service_fs_read_cb_t test_fs_read;
+static danp_ftp_service_fs_write_cb_t test_fs_write;
+static danp_ftp_service_fs_truncate_cb_t test_fs_truncate;
+static bool test_truncate_fail;
+static volatile bool test_async;
+static volatile uint32_t test_async_ops;
+static size_t test_loss_after;                   /* Offset from which every packet is lost */
+#if defined(TEST_FS_VECTORED)
+static danp_ftp_service_fs_readv_cb_t test_fs_readv;
+static danp_ftp_service_fs_writev_cb_t test_fs_writev;
+static uint32_t test_readv_calls;
+static uint32_t test_writev_calls;
+#endif
+
+/* Functions */
+
+static danp_ftp_status_t test_source_cb(size_t offset, uint8_t *buffer, uint16_t length, void *user_data)
+{
+    test_buffer_t *source = (test_buffer_t *)user_data;
+    size_t available = (offset < source->size) ? source->size - offset : 0;
+    size_t copy = (available < length) ? available : length;
+
+    memcpy(buffer, &source->data[offset], copy);
+
+    return (danp_ftp_status_t)copy;
+}
+
+static danp_ftp_status_t test_sink_cb(size_t offset, const uint8_t *data, uint16_t length, void *user_data)
+{
+    test_buffer_t *sink = (test_buffer_t *)user_data;
+
+    if (offset + length > sizeof(sink->data))
+    {
+        return DANP_FTP_STATUS_ERROR;
+    }
+
+    memcpy(&sink->data[offset], data, length);
+    if (offset + length > sink->size)
+    {
+        sink->size = offset + length;
+    }
+
+    return (danp_ftp_status_t)length;
+}
+
+static void test_set_loss(uint32_t loss_ppm, uint32_t seed)
+{
+    danp_loopback_impairment_t impairment;
+
+    memset(&impairment, 0, sizeof(impairment));
+    impairment.loss_ppm = loss_ppm;
+    impairment.seed = seed;
+    danp_loopback_set_impairment(&impairment);
+}
+
+static danp_ftp_status_t test_cut_source_cb(size_t offset, uint8_t *buffer, uint16_t length, void *user_data)
+{
+    if (offset >= test_loss_after)
+    {
+        test_set_loss(1000000, 0);
+    }
+
+    return test_source_cb(offset, buffer, length, user_data);
+}
+
+static danp_ftp_status_t test_cut_sink_cb(size_t offset, const uint8_t *data, uint16_t length, void *user_data)
+{
+    /* Lose the ACK of this chunk and everything after it */
+    if (offset >= test_loss_after)
+    {
+        test_set_loss(1000000, 0);
+    }
+
+    return test_sink_cb(offset, data, length, user_data);
+}
+
+static uint32_t test_get_retransmits(void)
+{
+    danp_ftp_service_rate_stats_t stats;
+
+    TEST_ASSERT_EQUAL_INT32(0, danp_ftp_service_get_rate_stats(&stats));
+
+    return stats.retransmits;
+}
+
+static danp_ftp_status_t test_prepare_cb(
+    danp_ftp_file_handle_t file_handle,
+    size_t offset,
+    size_t size,
+    void *user_data)
+{
+    test_prepare_offset = offset;
+    test_prepare_size = size;
+    test_prepare_calls++;
+
+    if (test_prepare_limit > 0 && offset + size > test_prepare_limit)
+    {
+        return DANP_FTP_STATUS_ERROR;
+    }
+
+    return test_fs_prepare(file_handle, offset, size, user_data);
+}
+
+static danp_ftp_status_t test_truncate_cb(danp_ftp_file_handle_t file_handle, size_t size, void *user_data)
+{
+    /* A backend that cannot shrink files */
+    if (test_truncate_fail)
+    {
+        return DANP_FTP_STATUS_ERROR;
+    }
+
+    return test_fs_truncate(file_handle, size, user_data);
+}
+
+#if !defined(TEST_FS_VECTORED)
+static void *test_async_thread(void *arg)
+{
+    test_async_op_t *async_op = (test_async_op_t *)arg;
+    danp_ftp_status_t result;
+
+    /* Storage works on the buffer after the callback has returned, like a DMA transfer */
+    danp_port_sleep_ms(1);
+
+    if (async_op->buffer)
+    {
+        result = test_fs_read(
+            async_op->file_handle,
+            async_op->offset,
+            async_op->buffer,
+            async_op->length,
+            async_op->user_data);
+    }
+    else
+    {
+        result = test_fs_write(
+            async_op->file_handle,
+            async_op->offset,
+            async_op->data,
+            async_op->length,
+            async_op->user_data);
+    }
+
+    danp_ftp_service_fs_complete(async_op->op, result);
+    free(async_op);
+
+    return NULL;
+}
+
+static danp_ftp_status_t test_async_start(const test_async_op_t *request)
+{
+    test_async_op_t *async_op;
+    pthread_t thread;
+
+    async_op = malloc(sizeof(test_async_op_t));
+    if (!async_op)
+    {
+        return DANP_FTP_STATUS_ERROR;
+    }
+
+    *async_op = *request;
+    if (pthread_create(&thread, NULL, test_async_thread, async_op) != 0)
+    {
+        free(async_op);
+        return DANP_FTP_STATUS_ERROR;
+    }
+    pthread_detach(thread);
+    test_async_ops++;
+
+    return DANP_FTP_SERVICE_FS_PENDING;
+}
+
+static danp_ftp_status_t test_read_async_cb(
+    danp_ftp_file_handle_t file_handle,
+    size_t offset,
+    uint8_t *buffer,
+    uint16_t length,
+    danp_ftp_service_fs_op_t *op,
+    void *user_data)
+{
+    test_async_op_t request = {
+        .file_handle = file_handle,
+        .offset = offset,
+        .buffer = buffer,
+        .length = length,
+        .op = op,
+        .user_data = user_data,
+    };
+
+    /* Completing at once is allowed too */
+    if (!test_async)
+    {
+        return test_fs_read(file_handle, offset, buffer, length, user_data);
+    }
+
+    return test_async_start(&request);
+}
+
+static danp_ftp_status_t test_write_async_cb(
+    danp_ftp_file_handle_t file_handle,
+    size_t offset,
+    const uint8_t *data,
+    uint16_t length,
+    danp_ftp_service_fs_op_t *op,
+    void *user_data)
+{
+    test_async_op_t request = {
+        .file_handle = file_handle,
+        .offset = offset,
+        .data = data,
+        .length = length,
+        .op = op,
+        .user_data = user_data,
+    };
+
+    if (!test_async)
+    {
+        return test_fs_write(file_handle, offset, data, length, user_data);
+    }
+
+    return test_async_start(&request);
+}
+#else
+static danp_ftp_status_t test_readv_cb(
+    danp_ftp_file_handle_t file_handle,
+    size_t offset,
+    const danp_ftp_service_fs_iovec_t *iov,
+    uint8_t iov_count,
+    void *user_data)
+{
+    test_readv_calls++;
+
+    return test_fs_readv(file_handle, offset, iov, iov_count, user_data);
+}
+
+static danp_ftp_status_t test_writev_cb(
+    danp_ftp_file_handle_t file_handle,
+    size_t offset,
+    const danp_ftp_service_fs_iovec_t *iov,
+    uint8_t iov_count,
+    void *user_data)
+{
+    test_writev_calls++;
+
+    return test_fs_writev(file_handle, offset, iov, iov_count, user_data);
+}
+#endif
+
+static void test_fill_pattern(test_buffer_t *buffer, size_t size, uint8_t seed)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        buffer->data[i] = (uint8_t)(i * 7U + seed);
+    }
+    buffer->size = size;
+}
+
+static void test_raw_send(
+    danp_socket_t *socket,
+    uint8_t type,
+    uint16_t sequence_number,
+    const uint8_t *payload,
+    uint16_t payload_length)
+{
+    danp_ftp_message_t message;
+
+    memset(&message, 0, sizeof(message));
+    message.header.type = type;
+    message.header.sequence_number = sequence_number;
+    message.header.payload_length = payload_length;
+    message.header.crc = danp_ftp_service_crc32_update(DANP_FTP_CRC32_INIT, payload, payload_length) ^
+                         DANP_FTP_CRC32_INIT;
+    memcpy(message.payload, payload, payload_length);
+
+    TEST_ASSERT_TRUE(danp_send(socket, &message, (uint16_t)(sizeof(danp_ftp_header_t) + payload_length)) > 0);
+}
+
+static void test_raw_receive(danp_socket_t *socket, danp_ftp_message_t *message)
+{
+    TEST_ASSERT_TRUE(danp_recv(socket, message, sizeof(*message), TEST_TIMEOUT_MS) >= (int32_t)sizeof(danp_ftp_header_t));
+}
+
+static int32_t test_get_remote(void)
+{
+    int32_t size = danp_ram_fs_get(TEST_FILE_NAME, test_remote.data, sizeof(test_remote.data));
+
+    test_remote.size = (size > 0) ? (size_t)size : 0;
+
+    return size;
+}
+
+void setUp(void)
+{
+    danp_ram_fs_reset();
+    memset(&test_local, 0, sizeof(test_local));
+    memset(&test_remote, 0, sizeof(test_remote));
+    test_prepare_offset = 0;
+    test_prepare_size = 0;
+    test_prepare_limit = 0;
+    test_prepare_calls = 0;
+    test_truncate_fail = false;
+    test_async = false;
+    test_async_ops = 0;
+    test_loss_after = 0;
+#if defined(TEST_FS_VECTORED)
+    test_readv_calls = 0;
+    test_writev_calls = 0;
+#endif
+}
+
+void tearDown(void)
+{
+    danp_loopback_set_impairment(NULL);
+}
+
+void test_read_should_returnFileContents(void)
+{
+    test_fill_pattern(&test_remote, TEST_FILE_SIZE, 3);
+    TEST_ASSERT_EQUAL_INT32(0, danp_ram_fs_put(TEST_FILE_NAME, test_remote.data, test_remote.size));
+
+    danp_ftp_status_t status = danp_ftp_service_client_read(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_sink_cb,
+        &test_local,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, status);
+    TEST_ASSERT_EQUAL_size_t(TEST_FILE_SIZE, test_local.size);
+    TEST_ASSERT_EQUAL_MEMORY(test_remote.data, test_local.data, TEST_FILE_SIZE);
+}
+
+void test_read_should_fail_whenFileMissing(void)
+{
+    danp_ftp_status_t status = danp_ftp_service_client_read(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_sink_cb,
+        &test_local,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_TRUE(status < 0);
+}
+
+void test_readFec_should_returnFileContents(void)
+{
+    danp_ftp_service_read_options_t options = {
+        .fec_k = TEST_FEC_K,
+        .fec_r = TEST_FEC_R,
+    };
+    danp_ftp_service_read_stats_t stats;
+
+    test_fill_pattern(&test_remote, TEST_FILE_SIZE, 5);
+    TEST_ASSERT_EQUAL_INT32(0, danp_ram_fs_put(TEST_FILE_NAME, test_remote.data, test_remote.size));
+
+    danp_ftp_status_t status = danp_ftp_service_client_read_ex(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        &options,
+        test_sink_cb,
+        &test_local,
+        &stats,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, status);
+    TEST_ASSERT_EQUAL_MEMORY(test_remote.data, test_local.data, TEST_FILE_SIZE);
+    TEST_ASSERT_EQUAL_UINT32(TEST_FEC_K, stats.fec_k);
+    TEST_ASSERT_EQUAL_UINT32(TEST_FEC_R, stats.fec_r);
+    TEST_ASSERT_GREATER_THAN_UINT32(1, stats.fec_blocks);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.fec_recovered);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.fec_repaired);
+}
+
+void test_readFec_should_recoverLostChunks(void)
+{
+    danp_ftp_service_read_options_t options = {
+        .fec_k = TEST_FEC_K,
+        .fec_r = TEST_FEC_R,
+    };
+    danp_ftp_service_read_stats_t stats;
+    danp_loopback_impairment_t impairment;
+
+    test_fill_pattern(&test_remote, TEST_FILE_SIZE * 2, 9);
+    TEST_ASSERT_EQUAL_INT32(0, danp_ram_fs_put(TEST_FILE_NAME, test_remote.data, test_remote.size));
+
+    memset(&impairment, 0, sizeof(impairment));
+    impairment.loss_ppm = 50000;
+    impairment.seed = 0xFECU;
+    danp_loopback_set_impairment(&impairment);
+
+    danp_ftp_status_t status = danp_ftp_service_client_read_ex(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        &options,
+        test_sink_cb,
+        &test_local,
+        &stats,
+        TEST_TIMEOUT_MS);
+
+    danp_loopback_set_impairment(NULL);
+
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE * 2, status);
+    TEST_ASSERT_EQUAL_MEMORY(test_remote.data, test_local.data, TEST_FILE_SIZE * 2);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, stats.fec_recovered);
+}
+
+void test_readRange_should_returnOnlyRange(void)
+{
+    danp_ftp_service_read_options_t options = {
+        .offset = 1000,
+        .length = 500,
+    };
+
+    test_fill_pattern(&test_remote, TEST_FILE_SIZE, 13);
+    TEST_ASSERT_EQUAL_INT32(0, danp_ram_fs_put(TEST_FILE_NAME, test_remote.data, test_remote.size));
+
+    danp_ftp_status_t status = danp_ftp_service_client_read_ex(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        &options,
+        test_sink_cb,
+        &test_local,
+        NULL,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(500, status);
+    TEST_ASSERT_EQUAL_size_t(1500, test_local.size);
+    TEST_ASSERT_EQUAL_MEMORY(&test_remote.data[1000], &test_local.data[1000], 500);
+    TEST_ASSERT_EQUAL_UINT8(0, test_local.data[999]);
+
+    /* A range past the end of the file is empty */
+    options.offset = TEST_FILE_SIZE + 10;
+    status = danp_ftp_service_client_read_ex(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        &options,
+        test_sink_cb,
+        &test_local,
+        NULL,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(0, status);
+}
+
+void test_readRange_should_tailFromEnd(void)
+{
+    danp_ftp_service_read_options_t options = {
+        .offset = -500,
+    };
+    danp_ftp_service_read_stats_t stats;
+
+    test_fill_pattern(&test_remote, TEST_FILE_SIZE, 29);
+    TEST_ASSERT_EQUAL_INT32(0, danp_ram_fs_put(TEST_FILE_NAME, test_remote.data, test_remote.size));
+
+    danp_ftp_status_t status = danp_ftp_service_client_read_ex(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        &options,
+        test_sink_cb,
+        &test_local,
+        &stats,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(500, status);
+    TEST_ASSERT_EQUAL_size_t(TEST_FILE_SIZE - 500, stats.offset);
+    TEST_ASSERT_EQUAL_size_t(TEST_FILE_SIZE, test_local.size);
+    TEST_ASSERT_EQUAL_MEMORY(&test_remote.data[TEST_FILE_SIZE - 500], &test_local.data[TEST_FILE_SIZE - 500], 500);
+
+    /* Counting back past the start clamps to the whole file */
+    options.offset = -(TEST_FILE_SIZE + 10);
+    options.length = 100;
+    status = danp_ftp_service_client_read_ex(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        &options,
+        test_sink_cb,
+        &test_local,
+        &stats,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(100, status);
+    TEST_ASSERT_EQUAL_size_t(0, stats.offset);
+    TEST_ASSERT_EQUAL_MEMORY(test_remote.data, test_local.data, 100);
+}
+
+void test_readParallel_should_reassembleFile(void)
+{
+    test_fill_pattern(&test_remote, TEST_FILE_SIZE, 17);
+    TEST_ASSERT_EQUAL_INT32(0, danp_ram_fs_put(TEST_FILE_NAME, test_remote.data, test_remote.size));
+
+    danp_ftp_status_t status = danp_ftp_service_client_read_parallel(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        4,
+        test_sink_cb,
+        &test_local,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, status);
+    TEST_ASSERT_EQUAL_size_t(TEST_FILE_SIZE, test_local.size);
+    TEST_ASSERT_EQUAL_MEMORY(test_remote.data, test_local.data, TEST_FILE_SIZE);
+}
+
+#if !defined(TEST_FS_VECTORED)
+void test_fsAsync_should_completeTransfers(void)
+{
+    danp_ftp_status_t status;
+
+    test_async = true;
+    test_fill_pattern(&test_local, TEST_FILE_SIZE, 23);
+
+    status = danp_ftp_service_client_write(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_local.size,
+        test_source_cb,
+        &test_local,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, status);
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, test_get_remote());
+    TEST_ASSERT_EQUAL_MEMORY(test_local.data, test_remote.data, TEST_FILE_SIZE);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, test_async_ops);
+
+    /* Sessions waiting on storage must not hold up each other */
+    memset(&test_local, 0, sizeof(test_local));
+    test_async_ops = 0;
+    status = danp_ftp_service_client_read_parallel(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        4,
+        test_sink_cb,
+        &test_local,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, status);
+    TEST_ASSERT_EQUAL_MEMORY(test_remote.data, test_local.data, TEST_FILE_SIZE);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, test_async_ops);
+
+    test_async = false;
+}
+#endif
+
+#if defined(TEST_FS_VECTORED)
+void test_fsVectored_should_batchChunks(void)
+{
+    /* Fewer calls than even full packets of data would take one by one */
+    uint32_t chunks = TEST_FILE_SIZE / DANP_MAX_PACKET_SIZE;
+    danp_ftp_status_t status;
+
+    test_fill_pattern(&test_local, TEST_FILE_SIZE, 29);
+
+    status = danp_ftp_service_client_write(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_local.size,
+        test_source_cb,
+        &test_local,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, status);
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, test_get_remote());
+    TEST_ASSERT_EQUAL_MEMORY(test_local.data, test_remote.data, TEST_FILE_SIZE);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, test_writev_calls);
+    TEST_ASSERT_TRUE(test_writev_calls < chunks);
+
+    memset(&test_local, 0, sizeof(test_local));
+    status = danp_ftp_service_client_read(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_sink_cb,
+        &test_local,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, status);
+    TEST_ASSERT_EQUAL_MEMORY(test_remote.data, test_local.data, TEST_FILE_SIZE);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, test_readv_calls);
+    TEST_ASSERT_TRUE(test_readv_calls < chunks);
+}
+#endif
+
+void test_read_should_resendChunk_whenNacked(void)
+{
+    danp_socket_t *socket;
+    danp_ftp_message_t message;
+    uint8_t command[2 + sizeof(TEST_FILE_NAME) - 1];
+    uint16_t first_length;
+
+    test_fill_pattern(&test_remote, TEST_FILE_SIZE, 6);
+    TEST_ASSERT_EQUAL_INT32(0, danp_ram_fs_put(TEST_FILE_NAME, test_remote.data, test_remote.size));
+
+    socket = danp_socket(DANP_TYPE_STREAM);
+    TEST_ASSERT_NOT_NULL(socket);
+    TEST_ASSERT_EQUAL_INT32(0, danp_connect(socket, TEST_LOCAL_NODE, DANP_FTP_SERVICE_PORT));
+
+    command[0] = DANP_FTP_CMD_REQUEST_READ;
+    command[1] = (uint8_t)(sizeof(command) - 2);
+    memcpy(&command[2], TEST_FILE_NAME, sizeof(command) - 2);
+    test_raw_send(socket, DANP_FTP_PACKET_TYPE_COMMAND, 0, command, sizeof(command));
+
+    test_raw_receive(socket, &message);
+    TEST_ASSERT_EQUAL_UINT8(DANP_FTP_PACKET_TYPE_RESPONSE, message.header.type);
+    TEST_ASSERT_EQUAL_UINT8(DANP_FTP_RESP_OK, message.payload[0]);
+
+    test_raw_receive(socket, &message);
+    TEST_ASSERT_EQUAL_UINT8(DANP_FTP_PACKET_TYPE_DATA, message.header.type);
+    TEST_ASSERT_EQUAL_UINT16(1, message.header.sequence_number);
+    first_length = message.header.payload_length;
+
+    /* Both service modes treat the NACK as a lost chunk */
+    test_raw_send(socket, DANP_FTP_PACKET_TYPE_NACK, 1, NULL, 0);
+
+    test_raw_receive(socket, &message);
+    TEST_ASSERT_EQUAL_UINT8(DANP_FTP_PACKET_TYPE_DATA, message.header.type);
+    TEST_ASSERT_EQUAL_UINT16(1, message.header.sequence_number);
+    TEST_ASSERT_EQUAL_UINT16(first_length, message.header.payload_length);
+    TEST_ASSERT_EQUAL_MEMORY(test_remote.data, message.payload, first_length);
+
+    test_raw_send(socket, DANP_FTP_PACKET_TYPE_ACK, 1, NULL, 0);
+    test_raw_receive(socket, &message);
+    TEST_ASSERT_EQUAL_UINT16(2, message.header.sequence_number);
+
+    danp_close(socket);
+}
+
+void test_read_should_retransmitLostChunks(void)
+{
+    uint32_t retransmits = test_get_retransmits();
+
+    test_fill_pattern(&test_remote, TEST_FILE_SIZE * 2, 13);
+    TEST_ASSERT_EQUAL_INT32(0, danp_ram_fs_put(TEST_FILE_NAME, test_remote.data, test_remote.size));
+
+    test_set_loss(TEST_LOSS_PPM, 0xACEU);
+
+    danp_ftp_status_t status = danp_ftp_service_client_read(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_sink_cb,
+        &test_local,
+        TEST_LOSS_TIMEOUT_MS);
+
+    danp_loopback_set_impairment(NULL);
+
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE * 2, status);
+    TEST_ASSERT_EQUAL_MEMORY(test_remote.data, test_local.data, TEST_FILE_SIZE * 2);
+    TEST_ASSERT_GREATER_THAN_UINT32(retransmits, test_get_retransmits());
+}
+
+void test_read_should_fail_whenRetransmitsRunOut(void)
+{
+    uint32_t retransmits = test_get_retransmits();
+    danp_ftp_status_t status;
+
+    test_fill_pattern(&test_remote, TEST_FILE_SIZE * 2, 17);
+    TEST_ASSERT_EQUAL_INT32(0, danp_ram_fs_put(TEST_FILE_NAME, test_remote.data, test_remote.size));
+
+    /*
+     * Cut the link once a few chunks have sampled the RTT. The client
+     * outwaits the backoff so the service, not a closed socket, ends it.
+     */
+    test_loss_after = TEST_FILE_SIZE;
+    status = danp_ftp_service_client_read(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_cut_sink_cb,
+        &test_local,
+        TEST_GIVE_UP_MS);
+
+    danp_loopback_set_impairment(NULL);
+
+    TEST_ASSERT_TRUE(status < 0);
+    TEST_ASSERT_EQUAL_UINT32(CONFIG_DANP_FTP_SERVICE_MAX_RETRANSMITS, test_get_retransmits() - retransmits);
+
+    /* Once given up the session is gone and the service still serves reads */
+    memset(&test_local, 0, sizeof(test_local));
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE * 2, danp_ftp_service_client_read(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_sink_cb,
+        &test_local,
+        TEST_TIMEOUT_MS));
+    TEST_ASSERT_EQUAL_MEMORY(test_remote.data, test_local.data, TEST_FILE_SIZE * 2);
+}
+
+void test_write_should_storeFileContents(void)
+{
+    test_fill_pattern(&test_local, TEST_FILE_SIZE, 11);
+
+    danp_ftp_status_t status = danp_ftp_service_client_write(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_local.size,
+        test_source_cb,
+        &test_local,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, status);
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, test_get_remote());
+    TEST_ASSERT_EQUAL_MEMORY(test_local.data, test_remote.data, TEST_FILE_SIZE);
+}
+
+void test_write_should_announceSizeToPrepare(void)
+{
+    test_fill_pattern(&test_local, TEST_FILE_SIZE, 17);
+
+    danp_ftp_status_t status = danp_ftp_service_client_write(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_local.size,
+        test_source_cb,
+        &test_local,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, status);
+    TEST_ASSERT_EQUAL_UINT32(1, test_prepare_calls);
+    TEST_ASSERT_EQUAL_size_t(0, test_prepare_offset);
+    TEST_ASSERT_EQUAL_size_t(TEST_FILE_SIZE, test_prepare_size);
+
+    status = danp_ftp_service_client_write_range(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        1000,
+        200,
+        test_source_cb,
+        &test_local,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(200, status);
+    TEST_ASSERT_EQUAL_size_t(1000, test_prepare_offset);
+    TEST_ASSERT_EQUAL_size_t(200, test_prepare_size);
+
+    /* A backend without room rejects the upload before any data is sent */
+    test_prepare_limit = TEST_FILE_SIZE / 2;
+    status = danp_ftp_service_client_write(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_local.size,
+        test_source_cb,
+        &test_local,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_TRUE(status < 0);
+    TEST_ASSERT_EQUAL_UINT32(3, test_prepare_calls);
+}
+
+void test_write_should_retryLostChunks(void)
+{
+    danp_loopback_stats_t before;
+    danp_loopback_stats_t after;
+    uint64_t lossless;
+    danp_ftp_status_t status;
+
+    test_fill_pattern(&test_local, TEST_FILE_SIZE * 2, 19);
+
+    /* Packets of the same write over a perfect link */
+    danp_loopback_get_stats(&before);
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE * 2, danp_ftp_service_client_write(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_local.size,
+        test_source_cb,
+        &test_local,
+        TEST_TIMEOUT_MS));
+    danp_loopback_get_stats(&after);
+    lossless = after.packets_sent - before.packets_sent;
+
+    danp_ram_fs_reset();
+    test_set_loss(TEST_LOSS_PPM, 0xBEEU);
+
+    danp_loopback_get_stats(&before);
+    status = danp_ftp_service_client_write(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_local.size,
+        test_source_cb,
+        &test_local,
+        TEST_TIMEOUT_MS);
+    danp_loopback_get_stats(&after);
+
+    danp_loopback_set_impairment(NULL);
+
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE * 2, status);
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE * 2, test_get_remote());
+    TEST_ASSERT_EQUAL_MEMORY(test_local.data, test_remote.data, TEST_FILE_SIZE * 2);
+
+    /* Every lost packet was sent again */
+    TEST_ASSERT_GREATER_THAN_UINT32(0, (uint32_t)(after.packets_dropped - before.packets_dropped));
+    TEST_ASSERT_GREATER_THAN_UINT32((uint32_t)lossless, (uint32_t)(after.packets_sent - before.packets_sent));
+}
+
+void test_write_should_fail_whenRetriesRunOut(void)
+{
+    test_fill_pattern(&test_local, TEST_FILE_SIZE * 2, 21);
+
+    test_loss_after = TEST_FILE_SIZE;
+    danp_ftp_status_t status = danp_ftp_service_client_write(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_local.size,
+        test_cut_source_cb,
+        &test_local,
+        TEST_TIMEOUT_MS);
+
+    danp_loopback_set_impairment(NULL);
+
+    TEST_ASSERT_TRUE(status < 0);
+
+    /* A fresh write over the restored link replaces the partial file */
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE * 2, danp_ftp_service_client_write(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_local.size,
+        test_source_cb,
+        &test_local,
+        TEST_TIMEOUT_MS));
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE * 2, test_get_remote());
+    TEST_ASSERT_EQUAL_MEMORY(test_local.data, test_remote.data, TEST_FILE_SIZE * 2);
+}
+
+void test_write_should_replaceLongerFile(void)
+{
+    test_fill_pattern(&test_remote, TEST_FILE_SIZE * 2, 5);
+    TEST_ASSERT_EQUAL_INT32(0, danp_ram_fs_put(TEST_FILE_NAME, test_remote.data, test_remote.size));
+    test_fill_pattern(&test_local, TEST_FILE_SIZE / 3, 9);
+
+    danp_ftp_status_t status = danp_ftp_service_client_write(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_local.size,
+        test_source_cb,
+        &test_local,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE / 3, status);
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE / 3, test_get_remote());
+    TEST_ASSERT_EQUAL_MEMORY(test_local.data, test_remote.data, TEST_FILE_SIZE / 3);
+}
+
+void test_writeRange_should_updateInPlace(void)
+{
+    test_fill_pattern(&test_remote, TEST_FILE_SIZE, 5);
+    TEST_ASSERT_EQUAL_INT32(0, danp_ram_fs_put(TEST_FILE_NAME, test_remote.data, test_remote.size));
+    test_fill_pattern(&test_local, TEST_FILE_SIZE, 21);
+
+    danp_ftp_status_t status = danp_ftp_service_client_write_range(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        500,
+        300,
+        test_source_cb,
+        &test_local,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(300, status);
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, danp_ram_fs_get(TEST_FILE_NAME, test_remote.data, sizeof(test_remote.data)));
+    TEST_ASSERT_EQUAL_MEMORY(&test_local.data[500], &test_remote.data[500], 300);
+
+    test_fill_pattern(&test_local, TEST_FILE_SIZE, 5);
+    TEST_ASSERT_EQUAL_MEMORY(test_local.data, test_remote.data, 500);
+    TEST_ASSERT_EQUAL_MEMORY(&test_local.data[800], &test_remote.data[800], TEST_FILE_SIZE - 800);
+}
+
+void test_stat_should_reportSizeAndCrc(void)
+{
+    danp_ftp_service_file_info_t info_a;
+    danp_ftp_service_file_info_t info_b;
+
+    test_fill_pattern(&test_remote, TEST_FILE_SIZE, 1);
+    TEST_ASSERT_EQUAL_INT32(0, danp_ram_fs_put(TEST_FILE_NAME, test_remote.data, test_remote.size));
+    TEST_ASSERT_EQUAL_INT32(
+        DANP_FTP_STATUS_OK,
+        danp_ftp_service_client_stat(
+            TEST_LOCAL_NODE,
+            (const uint8_t *)TEST_FILE_NAME,
+            strlen(TEST_FILE_NAME),
+            &info_a,
+            TEST_TIMEOUT_MS));
+
+    test_remote.data[TEST_FILE_SIZE / 2] ^= 0x01;
+    TEST_ASSERT_EQUAL_INT32(0, danp_ram_fs_put(TEST_FILE_NAME, test_remote.data, test_remote.size));
+    TEST_ASSERT_EQUAL_INT32(
+        DANP_FTP_STATUS_OK,
+        danp_ftp_service_client_stat(
+            TEST_LOCAL_NODE,
+            (const uint8_t *)TEST_FILE_NAME,
+            strlen(TEST_FILE_NAME),
+            &info_b,
+            TEST_TIMEOUT_MS));
+
+    TEST_ASSERT_EQUAL_size_t(TEST_FILE_SIZE, info_a.size);
+    TEST_ASSERT_EQUAL_size_t(TEST_FILE_SIZE, info_b.size);
+    TEST_ASSERT_NOT_EQUAL(info_a.crc, info_b.crc);
+}
+
+void test_sync_should_sendOnlyChangedBlocks(void)
+{
+    danp_ftp_service_sync_stats_t stats;
+
+    test_fill_pattern(&test_remote, TEST_FILE_SIZE, 2);
+    TEST_ASSERT_EQUAL_INT32(0, danp_ram_fs_put(TEST_FILE_NAME, test_remote.data, test_remote.size));
+    memcpy(test_local.data, test_remote.data, TEST_FILE_SIZE);
+    test_local.size = TEST_FILE_SIZE;
+    test_local.data[100] ^= 0xFF;
+
+    danp_ftp_status_t status = danp_ftp_service_client_sync(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_local.size,
+        256,
+        test_source_cb,
+        &test_local,
+        &stats,
+        TEST_TIMEOUT_MS);
+
+    TEST_ASSERT_EQUAL_INT32(DANP_FTP_STATUS_OK, status);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.blocks_sent);
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, test_get_remote());
+    TEST_ASSERT_EQUAL_MEMORY(test_local.data, test_remote.data, TEST_FILE_SIZE);
+}
+
+static danp_ftp_status_t test_sync_shorter_local(danp_ftp_service_sync_stats_t *stats)
+{
+    test_fill_pattern(&test_remote, TEST_FILE_SIZE + 700, 2);
+    TEST_ASSERT_EQUAL_INT32(0, danp_ram_fs_put(TEST_FILE_NAME, test_remote.data, test_remote.size));
+    memcpy(test_local.data, test_remote.data, TEST_FILE_SIZE);
+    test_local.size = TEST_FILE_SIZE;
+
+    return danp_ftp_service_client_sync(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_local.size,
+        256,
+        test_source_cb,
+        &test_local,
+        stats,
+        TEST_TIMEOUT_MS);
+}
+
+void test_sync_should_truncateLongerRemote(void)
+{
+    danp_ftp_service_sync_stats_t stats;
+
+    TEST_ASSERT_EQUAL_INT32(DANP_FTP_STATUS_OK, test_sync_shorter_local(&stats));
+    TEST_ASSERT_EQUAL_size_t(TEST_FILE_SIZE + 700, stats.remote_size);
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, test_get_remote());
+    TEST_ASSERT_EQUAL_MEMORY(test_local.data, test_remote.data, TEST_FILE_SIZE);
+}
+
+void test_sync_should_fail_whenRemoteCannotShrink(void)
+{
+    danp_ftp_service_sync_stats_t stats;
+
+    test_truncate_fail = true;
+
+    TEST_ASSERT_TRUE(test_sync_shorter_local(&stats) < 0);
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE + 700, test_get_remote());
+}
+
+void test_rateLimit_should_reportConfiguredLimits(void)
+{
+    danp_ftp_service_rate_stats_t stats;
+
+    TEST_ASSERT_EQUAL_INT32(0, danp_ftp_service_set_rate_limit(1000000, 500000));
+    TEST_ASSERT_EQUAL_INT32(0, danp_ftp_service_get_rate_stats(&stats));
+    TEST_ASSERT_EQUAL_UINT32(1000000, stats.global_limit_bps);
+    TEST_ASSERT_EQUAL_UINT32(500000, stats.session_limit_bps);
+
+    TEST_ASSERT_EQUAL_INT32(0, danp_ftp_service_set_rate_limit(0, 0));
+}
+
+void test_rateLimit_should_paceSessionToLimit(void)
+{
+    const size_t size = sizeof(test_local.data);
+    danp_ftp_service_rate_stats_t stats;
+    uint32_t start_ms;
+    uint32_t elapsed_ms;
+    uint32_t burst;
+
+    test_fill_pattern(&test_remote, size, 23);
+    TEST_ASSERT_EQUAL_INT32(0, danp_ram_fs_put(TEST_FILE_NAME, test_remote.data, test_remote.size));
+    TEST_ASSERT_EQUAL_INT32(0, danp_ftp_service_set_rate_limit(0, TEST_SESSION_RATE_BPS));
+
+    start_ms = danp_port_uptime_ms();
+    TEST_ASSERT_EQUAL_INT32((int32_t)size, danp_ftp_service_client_read(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_sink_cb,
+        &test_local,
+        TEST_TIMEOUT_MS));
+    elapsed_ms = danp_port_uptime_ms() - start_ms;
+    TEST_ASSERT_EQUAL_INT32(0, danp_ftp_service_get_rate_stats(&stats));
+    TEST_ASSERT_EQUAL_INT32(0, danp_ftp_service_set_rate_limit(0, 0));
+
+    TEST_ASSERT_EQUAL_MEMORY(test_remote.data, test_local.data, size);
+
+    /* Only the initial bucket depth may go out ahead of the rate */
+    burst = (TEST_SESSION_RATE_BPS * 100U) / 1000U;
+    TEST_ASSERT_TRUE(elapsed_ms >= (uint32_t)(((size - burst) * 1000U) / TEST_SESSION_RATE_BPS));
+
+    /* The transfer spans a full rate window, headers and burst included */
+    TEST_ASSERT_TRUE(stats.achieved_bps >= TEST_SESSION_RATE_BPS * 3U / 4U);
+    TEST_ASSERT_TRUE(stats.achieved_bps <= TEST_SESSION_RATE_BPS * 5U / 4U);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, stats.throttled_ms);
+}
+
+static void *test_reader_thread(void *arg)
+{
+    test_reader_t *reader = (test_reader_t *)arg;
+
+    /* Sessions opened from this thread come from the reader's node */
+    danp_loopback_set_thread_node(reader->node);
+
+    reader->status = danp_ftp_service_client_read(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)reader->file_name,
+        strlen(reader->file_name),
+        test_sink_cb,
+        &reader->sink,
+        TEST_TIMEOUT_MS);
+    reader->done_ms = danp_port_uptime_ms();
+
+    return NULL;
+}
+
+void test_priority_should_giveUrgentReadTheLargerShare(void)
+{
+    static test_reader_t bulk;
+    static test_reader_t urgent;
+    size_t bulk_before;
+    size_t bulk_after;
+
+    memset(&bulk, 0, sizeof(bulk));
+    memset(&urgent, 0, sizeof(urgent));
+    bulk.node = TEST_BULK_NODE;
+    bulk.file_name = TEST_FILE_NAME;
+    urgent.node = TEST_URGENT_NODE;
+    urgent.file_name = TEST_URGENT_FILE_NAME;
+
+    test_fill_pattern(&test_remote, TEST_FILE_SIZE, 21);
+    TEST_ASSERT_EQUAL_INT32(0, danp_ram_fs_put(TEST_FILE_NAME, test_remote.data, test_remote.size));
+    TEST_ASSERT_EQUAL_INT32(0, danp_ram_fs_put(TEST_URGENT_FILE_NAME, test_remote.data, test_remote.size));
+    TEST_ASSERT_EQUAL_INT32(0, danp_ftp_service_set_rate_limit(TEST_SHARE_RATE_BPS, 0));
+
+    /* The bulk read owns the link until the urgent one starts */
+    pthread_create(&bulk.thread, NULL, test_reader_thread, &bulk);
+    danp_port_sleep_ms(50);
+    bulk_before = bulk.sink.size;
+    pthread_create(&urgent.thread, NULL, test_reader_thread, &urgent);
+    pthread_join(urgent.thread, NULL);
+    bulk_after = bulk.sink.size;
+    pthread_join(bulk.thread, NULL);
+
+    TEST_ASSERT_EQUAL_INT32(0, danp_ftp_service_set_rate_limit(0, 0));
+
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, urgent.status);
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, bulk.status);
+    TEST_ASSERT_EQUAL_MEMORY(test_remote.data, urgent.sink.data, TEST_FILE_SIZE);
+    TEST_ASSERT_EQUAL_MEMORY(test_remote.data, bulk.sink.data, TEST_FILE_SIZE);
+    TEST_ASSERT_TRUE(bulk_before < TEST_FILE_SIZE);
+
+    /* Started later, finished first, and moved most of the bytes meanwhile */
+    TEST_ASSERT_TRUE((int32_t)(bulk.done_ms - urgent.done_ms) > 0);
+    TEST_ASSERT_TRUE((bulk_after - bulk_before) * 4U < TEST_FILE_SIZE);
+}
+
+static void test_wait_for_idle_service(void)
+{
+    uint32_t active = 1;
+    uint32_t peak;
+
+    for (uint32_t i = 0; i < 100 && active > 0; i++)
+    {
+        danp_ftp_service_get_client_count(&active, &peak);
+        if (active > 0)
+        {
+            danp_port_sleep_ms(5);
+        }
+    }
+}
+
+void test_memStats_should_releaseContextHeap(void)
+{
+    danp_ftp_service_mem_stats_t stats;
+
+    test_wait_for_idle_service();
+
+    TEST_ASSERT_EQUAL_INT32(0, danp_ftp_service_get_mem_stats(&stats));
+    TEST_ASSERT_EQUAL_UINT32(0, stats.heap_in_use);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, stats.context_size);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, stats.client_stack_size);
+#if defined(CONFIG_DANP_FTP_SERVICE_REACTOR)
+    TEST_ASSERT_GREATER_THAN_UINT32(0, stats.static_bytes);
+#else
+    TEST_ASSERT_TRUE(stats.heap_peak >= stats.context_size);
+#endif
+}
+
+#if defined(CONFIG_DANP_FTP_SERVICE_PROFILER)
+void test_profile_should_recordTransferStages(void)
+{
+    danp_ftp_service_profile_t total;
+    danp_ftp_service_profile_t last;
+
+    test_wait_for_idle_service();
+    danp_ftp_service_reset_profile();
+
+    test_fill_pattern(&test_local, TEST_FILE_SIZE, 4);
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, danp_ftp_service_client_write(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_local.size,
+        test_source_cb,
+        &test_local,
+        TEST_TIMEOUT_MS));
+    TEST_ASSERT_EQUAL_INT32(TEST_FILE_SIZE, danp_ftp_service_client_read(
+        TEST_LOCAL_NODE,
+        (const uint8_t *)TEST_FILE_NAME,
+        strlen(TEST_FILE_NAME),
+        test_sink_cb,
+        &test_remote,
+        TEST_TIMEOUT_MS));
+    test_wait_for_idle_service();
+
+    TEST_ASSERT_EQUAL_INT32(0, danp_ftp_service_get_profile(&total, &last));
+    TEST_ASSERT_EQUAL_UINT32(2, total.sessions);
+    TEST_ASSERT_EQUAL_UINT32(1, last.sessions);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, total.stages[DANP_FTP_SERVICE_PROF_FS_WRITE].count);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, last.stages[DANP_FTP_SERVICE_PROF_FS_READ].count);
+#if !defined(TEST_FS_VECTORED)
+    TEST_ASSERT_EQUAL_UINT32(
+        last.stages[DANP_FTP_SERVICE_PROF_FS_READ].count,
+        last.stages[DANP_FTP_SERVICE_PROF_ACK_WAIT].count);
+#endif
+    TEST_ASSERT_GREATER_THAN_UINT32(0, total.stages[DANP_FTP_SERVICE_PROF_SEND].count);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, total.stages[DANP_FTP_SERVICE_PROF_CRC].count);
+    TEST_ASSERT_TRUE(
+        total.stages[DANP_FTP_SERVICE_PROF_SEND].min_ns <= total.stages[DANP_FTP_SERVICE_PROF_SEND].max_ns);
+}
+#endif
+
+int main(void)
+{
+    danp_ftp_service_config_t config;
+
+    danp_loopback_init(TEST_LOCAL_NODE);
+
+    memset(&config, 0, sizeof(config));
+    danp_ram_fs_get_api(&config.fs);
+    test_fs_prepare = config.fs.prepare;
+    config.fs.prepare = test_prepare_cb;
+    test_fs_read = config.fs.read;
+    test_fs_write = config.fs.write;
+    test_fs_truncate = config.fs.truncate;
+    config.fs.truncate = test_truncate_cb;
+    config.priority_map = test_priority_map;
+    config.priority_map_len = sizeof(test_priority_map) / sizeof(test_priority_map[0]);
+#if defined(TEST_FS_VECTORED)
+    test_fs_readv = config.fs.readv;
+    test_fs_writev = config.fs.writev;
+    config.fs.readv = test_readv_cb;
+    config.fs.writev = test_writev_cb;
+#else
+    config.fs.readv = NULL;
+    config.fs.writev = NULL;
+    config.fs.read_async = test_read_async_cb;
+    config.fs.write_async = test_write_async_cb;
+#endif
+
+    if (danp_ftp_service_init(&config) != 0)
+    {
+        return 1;
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_read_should_returnFileContents);
+    RUN_TEST(test_read_should_fail_whenFileMissing);
+    RUN_TEST(test_readFec_should_returnFileContents);
+    RUN_TEST(test_readFec_should_recoverLostChunks);
+    RUN_TEST(test_readRange_should_returnOnlyRange);
+    RUN_TEST(test_readRange_should_tailFromEnd);
+    RUN_TEST(test_readParallel_should_reassembleFile);
+    RUN_TEST(test_read_should_resendChunk_whenNacked);
+    RUN_TEST(test_read_should_retransmitLostChunks);
+    RUN_TEST(test_read_should_fail_whenRetransmitsRunOut);
+    RUN_TEST(test_write_should_storeFileContents);
+    RUN_TEST(test_write_should_retryLostChunks);
+    RUN_TEST(test_write_should_fail_whenRetriesRunOut);
+    RUN_TEST(test_write_should_announceSizeToPrepare);
+#if defined(TEST_FS_VECTORED)
+    RUN_TEST(test_fsVectored_should_batchChunks);
+#else
+    RUN_TEST(test_fsAsync_should_completeTransfers);
+#endif
+    RUN_TEST(test_write_should_replaceLongerFile);
+    RUN_TEST(test_writeRange_should_updateInPlace);
+    RUN_TEST(test_stat_should_reportSizeAndCrc);
+    RUN_TEST(test_sync_should_sendOnlyChangedBlocks);
+    RUN_TEST(test_sync_should_truncateLongerRemote);
+    RUN_TEST(test_sync_should_fail_whenRemoteCannotShrink);
+    RUN_TEST(test_rateLimit_should_reportConfiguredLimits);
+    RUN_TEST(test_rateLimit_should_paceSessionToLimit);
+    RUN_TEST(test_priority_should_giveUrgentReadTheLargerShare);
+    RUN_TEST(test_memStats_should_releaseContextHeap);
+#if defined(CONFIG_DANP_FTP_SERVICE_PROFILER)
+    RUN_TEST(test_profile_should_recordTransferStages);
+#endif
+    return UNITY_END();
+}
@@ -0,0 +1,244 @@
+/* test_danp_utilities.c - DANP utility tests over the loopback transport */
+
+/* All Rights Reserved */
+
+/* Includes */
+
+#include <string.h>
+#include "danp/danp.h"
+#include "danp_port.h"
+#include "danp/danp_utilities.h"
+#include "danp/services/danp_bench_service.h"
+#include "danp_loopback.h"
+#include "unity.h"
+
+/* Imports */
+
+
+/* Definitions */
+
+#define TEST_LOCAL_NODE                       (1)
+#define TEST_PORT                             (40)
+#define TEST_PACKET_SIZE                      (32)
+#define TEST_PACKET_COUNT                     (5)
+#define TEST_ECHO_PORT                        (7)
+#define TEST_CLOSED_PORT                      (8)
+
+/* Types */
+
+
+/* Forward Declarations */
+
+
+/* Variables */
+
+static danp_socket_t *test_rx_socket;
+static danp_socket_t *test_tx_socket;
+
+/* Functions */
+
+static void test_send_packets(uint32_t count)
+{
+    uint8_t buffer[TEST_PACKET_SIZE];
+
+    memset(buffer, 0xA5, sizeof(buffer));
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        TEST_ASSERT_EQUAL_INT32(TEST_PACKET_SIZE, danp_send(test_tx_socket, buffer, sizeof(buffer)));
+    }
+}
+
+void setUp(void)
+{
+    danp_loopback_set_impairment(NULL);
+    danp_loopback_reset_stats();
+
+    test_rx_socket = danp_socket(DANP_TYPE_DGRAM);
+    test_tx_socket = danp_socket(DANP_TYPE_DGRAM);
+    TEST_ASSERT_NOT_NULL(test_rx_socket);
+    TEST_ASSERT_NOT_NULL(test_tx_socket);
+    TEST_ASSERT_EQUAL_INT32(0, danp_bind(test_rx_socket, TEST_PORT));
+    TEST_ASSERT_EQUAL_INT32(0, danp_connect(test_tx_socket, TEST_LOCAL_NODE, TEST_PORT));
+}
+
+void tearDown(void)
+{
+    danp_close(test_tx_socket);
+    danp_close(test_rx_socket);
+    danp_loopback_set_impairment(NULL);
+}
+
+void test_getStats_should_collectPrintedCounters(void)
+{
+    danp_stats_t stats;
+    uint64_t value;
+
+    test_send_packets(TEST_PACKET_COUNT);
+
+    TEST_ASSERT_GREATER_THAN_INT32(0, danp_get_stats(&stats));
+    TEST_ASSERT_EQUAL_INT32(0, danp_stats_find(&stats, "tx.packets", &value));
+    TEST_ASSERT_EQUAL_UINT32(TEST_PACKET_COUNT, (uint32_t)value);
+    TEST_ASSERT_EQUAL_INT32(0, danp_stats_find(&stats, "RX.Bytes", &value));
+    TEST_ASSERT_EQUAL_UINT32(TEST_PACKET_COUNT * TEST_PACKET_SIZE, (uint32_t)value);
+    TEST_ASSERT_EQUAL_INT32(0, danp_stats_find(&stats, "Impairment.Reordered", &value));
+    TEST_ASSERT_EQUAL_UINT32(0, (uint32_t)value);
+    TEST_ASSERT_EQUAL_INT32(-1, danp_stats_find(&stats, "RX.Missing", &value));
+}
+
+void test_getStats_should_sumCategories(void)
+{
+    danp_stats_t before;
+    danp_stats_t after;
+    danp_loopback_impairment_t impairment;
+
+    TEST_ASSERT_GREATER_THAN_INT32(0, danp_get_stats(&before));
+    test_send_packets(TEST_PACKET_COUNT);
+
+    memset(&impairment, 0, sizeof(impairment));
+    impairment.loss_ppm = 1000000;
+    danp_loopback_set_impairment(&impairment);
+    test_send_packets(2);
+
+    TEST_ASSERT_GREATER_THAN_INT32(0, danp_get_stats(&after));
+
+    /* Sent plus delivered */
+    TEST_ASSERT_EQUAL_UINT32(TEST_PACKET_COUNT * 2 + 2, (uint32_t)(after.packets - before.packets));
+    TEST_ASSERT_EQUAL_UINT32(TEST_PACKET_COUNT * TEST_PACKET_SIZE, (uint32_t)(after.bytes - before.bytes));
+    TEST_ASSERT_EQUAL_UINT32(2, (uint32_t)(after.drops - before.drops));
+    TEST_ASSERT_EQUAL_UINT32(0, (uint32_t)after.retransmits);
+}
+
+/**
+ * @brief Stack style dump, several pairs per line and labels sharing letters with other categories.
+ */
+static void test_stack_printer(void (*print_func)(const char *, ...))
+{
+    print_func("DANP Statistics:\n");
+    print_func("  Sockets open: %u\n", 3U);
+    print_func("  TX:\n");
+    print_func("    Packets sent: %u\n", 120U);
+    print_func("    Bytes transferred: %u\n", 9000U);
+    print_func("    Retransmitted packets: %u, Retries: %u\n", 4U, 2U);
+    print_func("    Transfer errors: %u\n", 1U);
+    print_func("  RX:\n");
+    print_func("    Packets received: %u\n", 100U);
+    print_func("    Bytes received: %u\n", 7000U);
+    print_func("    Packets dropped: %u | Lost fragments: %u\n", 5U, 6U);
+    print_func("    Route lookups failed = %u\n", 7U);
+    print_func("    Buffer errorless = %u\n", 50U);
+}
+
+void test_getStats_should_sumWholeWordsOfStackLabels(void)
+{
+    danp_stats_t stats;
+    uint64_t value;
+
+    danp_loopback_set_stats_printer(test_stack_printer);
+    TEST_ASSERT_EQUAL_INT32(12, danp_get_stats(&stats));
+    danp_loopback_set_stats_printer(NULL);
+
+    /* "transferred" is not an error counter and "errorless" is no error */
+    TEST_ASSERT_EQUAL_UINT32(220, (uint32_t)stats.packets);
+    TEST_ASSERT_EQUAL_UINT32(16000, (uint32_t)stats.bytes);
+    TEST_ASSERT_EQUAL_UINT32(1 + 5 + 6 + 7, (uint32_t)stats.drops);
+    TEST_ASSERT_EQUAL_UINT32(6, (uint32_t)stats.retransmits);
+    TEST_ASSERT_EQUAL_INT32(0, danp_stats_find(&stats, "TX.Bytes transferred", &value));
+    TEST_ASSERT_EQUAL_UINT32(9000, (uint32_t)value);
+    TEST_ASSERT_EQUAL_INT32(0, danp_stats_find(&stats, "RX.Route lookups failed", &value));
+    TEST_ASSERT_EQUAL_UINT32(7, (uint32_t)value);
+}
+
+void test_map_should_measureReachableNodes(void)
+{
+    const uint16_t nodes[] = {1, 2, 3};
+    danp_map_result_t results[3];
+    danp_map_config_t config = {
+        .local_node = TEST_LOCAL_NODE,
+        .port = TEST_ECHO_PORT,
+        .pings = 3,
+        .burst = 4,
+        .timeout_ms = 200,
+    };
+
+    TEST_ASSERT_EQUAL_INT32(3, danp_map(nodes, 3, &config, results));
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT32(nodes[i], results[i].node);
+        TEST_ASSERT_TRUE(results[i].reachable);
+        TEST_ASSERT_EQUAL_UINT32(3, results[i].sent);
+        TEST_ASSERT_EQUAL_UINT32(3, results[i].received);
+        TEST_ASSERT_TRUE(results[i].rtt_min_us <= results[i].rtt_avg_us);
+        TEST_ASSERT_TRUE(results[i].rtt_avg_us <= results[i].rtt_max_us);
+        TEST_ASSERT_GREATER_THAN_UINT32(0, results[i].throughput_bps);
+    }
+}
+
+void test_map_should_reportDownNodes(void)
+{
+    const uint16_t nodes[] = {4, 5};
+    danp_map_result_t results[2];
+    danp_map_config_t config = {
+        .local_node = TEST_LOCAL_NODE,
+        .port = TEST_CLOSED_PORT,
+        .pings = 2,
+        .burst = 0,
+        .timeout_ms = 50,
+    };
+
+    TEST_ASSERT_EQUAL_INT32(0, danp_map(nodes, 2, &config, results));
+    TEST_ASSERT_FALSE(results[0].reachable);
+    TEST_ASSERT_FALSE(results[1].reachable);
+    TEST_ASSERT_EQUAL_UINT32(5, results[1].node);
+}
+
+void test_map_should_timeOutDeadNodesTogether(void)
+{
+    uint16_t nodes[8];
+    danp_map_result_t results[8];
+    danp_map_config_t config = {
+        .local_node = TEST_LOCAL_NODE,
+        .port = TEST_CLOSED_PORT,
+        .pings = 1,
+        .burst = 0,
+        .timeout_ms = 100,
+    };
+    uint32_t start_ms;
+
+    for (uint16_t i = 0; i < 8; i++)
+    {
+        nodes[i] = (uint16_t)(10 + i);
+    }
+
+    start_ms = danp_port_uptime_ms();
+    TEST_ASSERT_EQUAL_INT32(0, danp_map(nodes, 8, &config, results));
+
+    /* One timeout for the batch, not one per node */
+    TEST_ASSERT_TRUE(danp_port_uptime_ms() - start_ms < 3U * config.timeout_ms);
+    TEST_ASSERT_EQUAL_UINT32(1, results[7].sent);
+    TEST_ASSERT_EQUAL_UINT32(0, results[7].received);
+}
+
+int main(void)
+{
+    danp_bench_service_config_t bench = {
+        .echo_port = TEST_ECHO_PORT,
+    };
+
+    danp_loopback_init(TEST_LOCAL_NODE);
+
+    if (danp_bench_service_init(&bench) != 0)
+    {
+        return 1;
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_getStats_should_collectPrintedCounters);
+    RUN_TEST(test_getStats_should_sumCategories);
+    RUN_TEST(test_getStats_should_sumWholeWordsOfStackLabels);
+    RUN_TEST(test_map_should_measureReachableNodes);
+    RUN_TEST(test_map_should_reportDownNodes);
+    RUN_TEST(test_map_should_timeOutDeadNodesTogether);
+    return UNITY_END();
+}